@@ -0,0 +1,68 @@
+#include "bsp_lv_draw.h"
+#include "bsp_lv_blend.h"
+
+#if LV_COLOR_DEPTH != 16
+#error "bsp_lv_draw needs LV_COLOR_DEPTH 16"
+#endif
+
+static void bsp_lv_draw_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc) {
+  const lv_opa_t *mask = dsc->mask_buf;
+  if (mask && dsc->mask_res == LV_DRAW_MASK_RES_TRANSP) return;
+  if (dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER) mask = NULL;
+
+  // Direct pixel writes, alpha screens and layers, blend modes other than
+  // normal and aliased masks go the stock way
+  lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+  if (disp->driver->set_px_cb || disp->driver->screen_transp || dsc->blend_mode != LV_BLEND_MODE_NORMAL ||
+      (mask && !disp->driver->antialiasing)) {
+    lv_draw_sw_blend_basic(draw_ctx, dsc);
+    return;
+  }
+
+  lv_area_t blend_area;
+  if (!_lv_area_intersect(&blend_area, dsc->blend_area, draw_ctx->clip_area)) return;
+
+  int w = lv_area_get_width(&blend_area);
+  int h = lv_area_get_height(&blend_area);
+  int dest_stride = lv_area_get_width(draw_ctx->buf_area);
+  uint16_t *dest = (uint16_t *)draw_ctx->buf;
+  dest += dest_stride * (blend_area.y1 - draw_ctx->buf_area->y1) + (blend_area.x1 - draw_ctx->buf_area->x1);
+
+  int mask_stride = 0;
+  if (mask) {
+    mask_stride = lv_area_get_width(dsc->mask_area);
+    mask += mask_stride * (blend_area.y1 - dsc->mask_area->y1) + (blend_area.x1 - dsc->mask_area->x1);
+  }
+
+  bool swap = LV_COLOR_16_SWAP != 0;
+  if (dsc->src_buf == NULL) {
+    if (mask) {
+      blend565_fill_mask(dest, dest_stride, w, h, dsc->color.full, dsc->opa, mask, mask_stride, swap);
+    } else if (dsc->opa >= LV_OPA_MAX) {
+      blend565_fill(dest, dest_stride, w, h, dsc->color.full);
+    } else {
+      blend565_fill_opa(dest, dest_stride, w, h, dsc->color.full, dsc->opa, swap);
+    }
+    return;
+  }
+
+  int src_stride = lv_area_get_width(dsc->blend_area);
+  const uint16_t *src = (const uint16_t *)dsc->src_buf;
+  src += src_stride * (blend_area.y1 - dsc->blend_area->y1) + (blend_area.x1 - dsc->blend_area->x1);
+  if (mask) {
+    blend565_map_mask(dest, dest_stride, src, src_stride, w, h, dsc->opa, mask, mask_stride, swap);
+  } else if (dsc->opa >= LV_OPA_MAX) {
+    blend565_copy(dest, dest_stride, src, src_stride, w, h);
+  } else {
+    blend565_map_opa(dest, dest_stride, src, src_stride, w, h, dsc->opa, swap);
+  }
+}
+
+void bsp_lv_draw_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx) {
+  lv_draw_sw_init_ctx(drv, draw_ctx);
+  ((bsp_lv_draw_ctx_t *)draw_ctx)->blend = bsp_lv_draw_blend;
+}
+
+void bsp_lv_draw_ctx_deinit(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx) {
+  lv_draw_sw_deinit_ctx(drv, draw_ctx);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "lvgl.h"
+#include "draw/sw/lv_draw_sw.h"
+
+// LVGL software renderer with its RGB565 blend step (fills, image blits,
+// opacity and masks) run by the word-wide kernels in bsp_lv_blend.cpp.
+// Everything else (shapes, text, blend modes, layers with alpha) stays on
+// LVGL's own code. Register on the display driver before
+// lv_disp_drv_register():
+//   disp_drv.draw_ctx_init = bsp_lv_draw_ctx_init;
+//   disp_drv.draw_ctx_deinit = bsp_lv_draw_ctx_deinit;
+//   disp_drv.draw_ctx_size = sizeof(bsp_lv_draw_ctx_t);
+typedef lv_draw_sw_ctx_t bsp_lv_draw_ctx_t;
+
+void bsp_lv_draw_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+void bsp_lv_draw_ctx_deinit(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
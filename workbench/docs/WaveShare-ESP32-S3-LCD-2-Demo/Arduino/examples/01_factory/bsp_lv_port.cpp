@@ -7,6 +7,7 @@
 
 #include "bsp_spi.h"
 #include "bsp_button.h"
+#include "bsp_lv_draw.h"
 
 #include "lvgl.h"
 // #include "demos/lv_demos.h"
@@ -123,16 +124,19 @@ void lv_display_init(void) {
   if (!gfx->begin()) {
     Serial.println("gfx->begin() failed!");
   }
-  gfx->fillScreen(RED);
+  gfx->fillScreen(BLACK);
 #ifdef GFX_BL
   pinMode(GFX_BL, OUTPUT);
   digitalWrite(GFX_BL, HIGH);
 #endif
+#if EXAMPLE_LCD_COLOR_TEST
+  gfx->fillScreen(RED);
   delay(1000);
   gfx->fillScreen(GREEN);
   delay(1000);
   gfx->fillScreen(BLUE);
   delay(1000);
+#endif
 }
 
 
@@ -187,6 +191,11 @@ void bsp_lv_port_init(void) {
   // disp_drv.drv_update_cb = example_lvgl_port_update_callback;
   disp_drv.draw_buf = &disp_buf;
   disp_drv.full_refresh = 1;
+#if EXAMPLE_LVGL_FAST_BLEND
+  disp_drv.draw_ctx_init = bsp_lv_draw_ctx_init;
+  disp_drv.draw_ctx_deinit = bsp_lv_draw_ctx_deinit;
+  disp_drv.draw_ctx_size = sizeof(bsp_lv_draw_ctx_t);
+#endif
   // disp_drv.user_data = panel_handle;
   lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
 
@@ -18,6 +18,12 @@
 #define EXAMPLE_LCD_H_RES                   240
 #define EXAMPLE_LCD_V_RES                   320
 
+// 1 = cycle RED/GREEN/BLUE for 1 s each at boot (panel bring-up check, +3 s boot)
+#define EXAMPLE_LCD_COLOR_TEST              0
+
+// 1 = blend through the word-wide RGB565 kernels (bsp_lv_draw.h), 0 = stock LVGL
+#define EXAMPLE_LVGL_FAST_BLEND             1
+
 #define EXAMPLE_LVGL_TICK_PERIOD_MS         2
 #define EXAMPLE_LVGL_TASK_MAX_DELAY_MS      500
 #define EXAMPLE_LVGL_TASK_MIN_DELAY_MS      1
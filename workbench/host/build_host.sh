@@ -0,0 +1,62 @@
+#!/bin/bash
+# build_host.sh - Build an Arduino sketch as a Linux executable
+#
+# Compiles the sketch's .ino and .cpp files against the stand-in headers in
+# host/include (Arduino core, SD/FFat as directories, FreeRTOS on pthreads,
+# reference ESP-DSP). Device-only files guard themselves with #ifdef ARDUINO.
+#
+# Usage: ./build_host.sh <sketch_dir> [output]
+#   ./build_host.sh ../working_protos/03_interaction_pipeline
+#   ./_host_build/03_interaction_pipeline.host --mic speech.wav --seconds 20
+
+set -e
+
+HOST_DIR="$(cd "$(dirname "$0")" && pwd)"
+SKETCH_DIR="$(cd "${1:?usage: $0 <sketch_dir> [output]}" && pwd)"
+SKETCH_NAME="$(basename "$SKETCH_DIR")"
+BUILD_DIR="$HOST_DIR/_host_build"
+OUTPUT="${2:-$BUILD_DIR/$SKETCH_NAME.host}"
+CXX="${CXX:-g++}"
+CXXFLAGS="${CXXFLAGS:--O2 -g}"
+
+# glcdfont.h for the PPM display backend
+FONT_DIR="$HOST_DIR/../docs/WaveShare-ESP32-S3-LCD-2-Demo/Arduino/libraries/GFX_Library_for_Arduino/src/font"
+
+INO="$SKETCH_DIR/$SKETCH_NAME.ino"
+if [ ! -f "$INO" ]; then
+    echo "ERROR: $INO not found"
+    exit 1
+fi
+
+mkdir -p "$BUILD_DIR"
+
+# The Arduino builder inserts prototypes for every .ino function before the
+# first definition; do the same so functions can be used before they appear
+INO_CPP="$BUILD_DIR/$SKETCH_NAME.ino.cpp"
+DEF_RE='^[A-Za-z_][A-Za-z0-9_:<>*& ]*[ *&]+[A-Za-z_][A-Za-z0-9_]*\([^;]*\)[[:space:]]*\{'
+FIRST_DEF=$(grep -nE "$DEF_RE" "$INO" | head -1 | cut -d: -f1)
+{
+    echo "#include <Arduino.h>"
+    if [ -n "$FIRST_DEF" ]; then
+        echo "#line 1 \"$INO\""
+        head -n $((FIRST_DEF - 1)) "$INO"
+        grep -E "$DEF_RE" "$INO" | sed -E 's/[[:space:]]*\{.*$/;/'
+        echo "#line $FIRST_DEF \"$INO\""
+        tail -n +"$FIRST_DEF" "$INO"
+    else
+        echo "#line 1 \"$INO\""
+        cat "$INO"
+    fi
+} > "$INO_CPP"
+
+# Sketches may be a lone .ino
+shopt -s nullglob
+SKETCH_CPP=("$SKETCH_DIR"/*.cpp)
+
+echo "Building $SKETCH_NAME for host..."
+$CXX -std=gnu++17 $CXXFLAGS -Wall -Wno-sign-compare -Wno-reorder -Wno-unused-variable -Wno-unused-function \
+    -I"$HOST_DIR/include" -I"$SKETCH_DIR" -I"$FONT_DIR" \
+    "$INO_CPP" "${SKETCH_CPP[@]}" "$HOST_DIR"/src/*.cpp \
+    -lpthread -lm -o "$OUTPUT"
+
+echo "OK: $OUTPUT"
@@ -0,0 +1,190 @@
+// Arduino.h - Host stand-in for the arduino-esp32 core
+// Enough of Serial, String, timing, pins and ESP heap queries for the
+// sketches in working_protos/ to compile and run on Linux.
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define PROGMEM
+#define pgm_read_byte(addr)  (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t*)(addr))
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+// ============================================================================
+// Host Options (set by host_main from --name value pairs)
+// ============================================================================
+
+const char* host_arg(const char* name, const char* fallback);
+long host_arg_int(const char* name, long fallback);
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+static inline void yield() { sched_yield(); }
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+template <typename T> static inline T constrain(T x, T lo, T hi) {
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+// ============================================================================
+// Pins (no-ops; devices go through the HAL)
+// ============================================================================
+
+#define LOW          0
+#define HIGH         1
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+static inline void pinMode(uint8_t, uint8_t) {}
+static inline void digitalWrite(uint8_t, uint8_t) {}
+static inline int digitalRead(uint8_t) { return HIGH; }
+static inline void analogWrite(uint8_t, int) {}
+
+// ============================================================================
+// Memory (one host heap; PSRAM figures are nominal 8MB minus bytes in use)
+// ============================================================================
+
+typedef int esp_err_t;
+#define ESP_OK    0
+#define ESP_FAIL  -1
+
+#define MALLOC_CAP_8BIT      (1 << 2)
+#define MALLOC_CAP_DMA       (1 << 3)
+#define MALLOC_CAP_INTERNAL  (1 << 11)
+#define MALLOC_CAP_SPIRAM    (1 << 10)
+
+static inline void* ps_malloc(size_t size) { return malloc(size); }
+static inline void* ps_calloc(size_t n, size_t size) { return calloc(n, size); }
+static inline void* ps_realloc(void* p, size_t size) { return realloc(p, size); }
+static inline void* heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+static inline void* heap_caps_calloc(size_t n, size_t size, uint32_t) { return calloc(n, size); }
+static inline void heap_caps_free(void* p) { free(p); }
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+
+uint32_t esp_get_free_heap_size();
+
+// CPU clock is recorded only; host code runs at host speed
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+
+class EspClass {
+public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getPsramSize();
+    uint32_t getFreePsram();
+    uint32_t getCpuFreqMHz() { return getCpuFrequencyMhz(); }
+    uint32_t getCycleCount();       // Host clock ticks, not ESP32-S3 cycles
+    void restart() { exit(0); }
+};
+
+extern EspClass ESP;
+
+// ============================================================================
+// String
+// ============================================================================
+
+class String {
+public:
+    String(const char* s = "");
+    String(const String& other);
+    String(int value);
+    ~String();
+
+    String& operator=(const String& other);
+    String& operator+=(const String& other);
+    String& operator+=(const char* s);
+    String& operator+=(char c);
+    bool operator==(const char* s) const { return strcmp(buf_, s) == 0; }
+
+    const char* c_str() const { return buf_; }
+    unsigned int length() const { return len_; }
+    char operator[](unsigned int i) const { return i < len_ ? buf_[i] : 0; }
+
+    void trim();
+    int indexOf(char c) const;
+    bool startsWith(const char* prefix) const;
+    String substring(unsigned int from, unsigned int to = 0xFFFFFFFF) const;
+    long toInt() const { return atol(buf_); }
+    float toFloat() const { return (float)atof(buf_); }
+
+private:
+    void assign(const char* s, unsigned int len);
+    char* buf_;
+    unsigned int len_;
+};
+
+// ============================================================================
+// Serial (stdout / stdin)
+// ============================================================================
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(const uint8_t* data, size_t len) = 0;
+    size_t write(uint8_t c) { return write(&c, 1); }
+
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return printf("%d", v); }
+    size_t print(unsigned int v) { return printf("%u", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+    size_t println() { return print("\n"); }
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    size_t println(double v, int digits) { size_t n = print(v, digits); return n + println(); }
+
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HostSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    operator bool() const { return true; }
+    void setDebugOutput(bool) {}
+
+    size_t write(const uint8_t* data, size_t len) override;
+    using Print::write;
+    void flush();
+
+    int available();
+    int read();
+    int peek();
+    String readStringUntil(char terminator);
+};
+
+extern HostSerial Serial;
+
+#endif // HOST_ARDUINO_H
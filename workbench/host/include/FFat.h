@@ -0,0 +1,23 @@
+// FFat.h - Host stand-in: FFat partition as a host directory (--ffat DIR, default ./ffat)
+
+#ifndef HOST_FFAT_H
+#define HOST_FFAT_H
+
+#include <FS.h>
+
+class F_Fat : public fs::FS {
+public:
+    F_Fat() : fs::FS("ffat") {}
+
+    bool begin(bool formatOnFail = false, const char* basePath = "/ffat", uint8_t maxOpenFiles = 10,
+               const char* partitionLabel = "ffat");
+    void end() {}
+    bool format(bool full_wipe = false, char* partitionLabel = nullptr);
+    size_t totalBytes();
+    size_t usedBytes();
+    size_t freeBytes();
+};
+
+extern F_Fat FFat;
+
+#endif // HOST_FFAT_H
@@ -0,0 +1,82 @@
+// FS.h - Host stand-in for the arduino-esp32 fs::FS / fs::File API
+// Each filesystem is a directory on the host (see SD.h / FFat.h).
+
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <Arduino.h>
+#include <memory>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+namespace fs {
+
+struct FileImpl;
+
+class File : public Print {
+public:
+    File() {}
+    explicit File(std::shared_ptr<FileImpl> impl) : impl_(impl) {}
+
+    operator bool() const;
+
+    size_t write(const uint8_t* data, size_t len) override;
+    using Print::write;
+    size_t read(uint8_t* buffer, size_t len);
+    int read();
+    int available();
+    int peek();
+    void flush();
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void close();
+
+    const char* path() const;
+    const char* name() const;
+    bool isDirectory() const;
+    File openNextFile(const char* mode = FILE_READ);
+    void rewindDirectory();
+
+private:
+    std::shared_ptr<FileImpl> impl_;
+};
+
+class FS {
+public:
+    explicit FS(const char* default_root) : default_root_(default_root), root_(nullptr) {}
+
+    File open(const char* path, const char* mode = FILE_READ, bool create = false);
+    File open(const String& path, const char* mode = FILE_READ) { return open(path.c_str(), mode); }
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool rename(const char* from, const char* to);
+    bool mkdir(const char* path);
+    bool rmdir(const char* path);
+
+    // Host directory backing this filesystem
+    const char* root();
+
+protected:
+    bool mountRoot(const char* arg_name);
+    String hostPath(const char* path);
+
+    const char* default_root_;
+    const char* root_;
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+
+#endif // HOST_FS_H
@@ -0,0 +1,33 @@
+// SD.h - Host stand-in: SD card as a host directory (--sd DIR, default ./sd)
+// Raw sector access for HalBlockStorage uses a disk image instead (--sd-image).
+
+#ifndef HOST_SD_H
+#define HOST_SD_H
+
+#include <FS.h>
+#include <SPI.h>
+
+typedef enum {
+    CARD_NONE,
+    CARD_MMC,
+    CARD_SD,
+    CARD_SDHC,
+    CARD_UNKNOWN
+} sdcard_type_t;
+
+class SDFS : public fs::FS {
+public:
+    SDFS() : fs::FS("sd") {}
+
+    bool begin(uint8_t ssPin = 0, SPIClass& spi = SPI, uint32_t frequency = 4000000,
+               const char* mountpoint = "/sd", uint8_t max_files = 5, bool format_if_empty = false);
+    void end() {}
+    sdcard_type_t cardType();
+    uint64_t cardSize();
+    uint64_t totalBytes();
+    uint64_t usedBytes();
+};
+
+extern SDFS SD;
+
+#endif // HOST_SD_H
@@ -0,0 +1,28 @@
+// SPI.h - Host stand-in: the SPI bus itself is not emulated (SD and LCD are)
+
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+#include <Arduino.h>
+
+#define MSBFIRST  1
+#define SPI_MODE0 0
+
+class SPISettings {
+public:
+    SPISettings(uint32_t = 1000000, uint8_t = MSBFIRST, uint8_t = SPI_MODE0) {}
+};
+
+class SPIClass {
+public:
+    void begin(int8_t = -1, int8_t = -1, int8_t = -1, int8_t = -1) {}
+    void end() {}
+    void beginTransaction(SPISettings) {}
+    void endTransaction() {}
+    uint8_t transfer(uint8_t) { return 0xFF; }
+    void setFrequency(uint32_t) {}
+};
+
+extern SPIClass SPI;
+
+#endif // HOST_SPI_H
@@ -0,0 +1,18 @@
+// driver/gpio.h - Host stand-in: only the wake-up configuration calls
+
+#ifndef HOST_DRIVER_GPIO_H
+#define HOST_DRIVER_GPIO_H
+
+#include <Arduino.h>
+
+typedef int gpio_num_t;
+
+typedef enum {
+    GPIO_INTR_LOW_LEVEL = 4,
+    GPIO_INTR_HIGH_LEVEL = 5,
+} gpio_int_type_t;
+
+static inline esp_err_t gpio_wakeup_enable(gpio_num_t, gpio_int_type_t) { return ESP_OK; }
+static inline esp_err_t gpio_wakeup_disable(gpio_num_t) { return ESP_OK; }
+
+#endif // HOST_DRIVER_GPIO_H
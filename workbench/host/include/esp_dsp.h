@@ -0,0 +1,34 @@
+// esp_dsp.h - Host stand-in for the ESP-DSP routines the sketches call
+// Plain C reference versions with the same signatures and output ordering
+// (dsps_fft2r_fc32 leaves the result bit-reversed, like the library).
+
+#ifndef HOST_ESP_DSP_H
+#define HOST_ESP_DSP_H
+
+#include <Arduino.h>
+
+#define ESP_ERR_DSP_PARAM_OUTOFRANGE 0x70002
+#define CONFIG_DSP_MAX_FFT_SIZE      4096
+
+esp_err_t dsps_dotprod_f32_ansi(const float* src1, const float* src2, float* dest, int len);
+esp_err_t dsps_dotprod_f32_aes3(const float* src1, const float* src2, float* dest, int len);
+esp_err_t dsps_dotprod_s16_ansi(const int16_t* src1, const int16_t* src2, int16_t* dest, int len, int8_t shift);
+
+esp_err_t dsps_fft2r_init_fc32(float* fft_table_buff, int table_size);
+void dsps_fft2r_deinit_fc32();
+esp_err_t dsps_fft2r_fc32(float* data, int N);
+esp_err_t dsps_bit_rev_fc32(float* data, int N);
+esp_err_t dsps_cplx2reC_fc32(float* data, int N);
+
+void dsps_wind_hann_f32(float* window, int len);
+esp_err_t dsps_mulc_f32(const float* input, float* output, int len, float C, int step_in, int step_out);
+esp_err_t dsps_add_f32(const float* input1, const float* input2, float* output, int len,
+                       int step1, int step2, int step_out);
+esp_err_t dsps_mul_f32(const float* input1, const float* input2, float* output, int len,
+                       int step1, int step2, int step_out);
+
+#define dsps_dotprod_f32   dsps_dotprod_f32_ansi
+#define dsps_fft2r_fc32_ae32 dsps_fft2r_fc32
+#define dsps_fft2r_fc32_ansi dsps_fft2r_fc32
+
+#endif // HOST_ESP_DSP_H
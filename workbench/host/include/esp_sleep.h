@@ -0,0 +1,13 @@
+// esp_sleep.h - Host stand-in: light sleep is a plain wait for the timer
+// wake-up (GPIO wake-up sources are accepted and ignored)
+
+#ifndef HOST_ESP_SLEEP_H
+#define HOST_ESP_SLEEP_H
+
+#include <Arduino.h>
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_us);
+esp_err_t esp_sleep_enable_gpio_wakeup();
+esp_err_t esp_light_sleep_start();
+
+#endif // HOST_ESP_SLEEP_H
@@ -0,0 +1,37 @@
+// task.h - Host stand-in: FreeRTOS tasks on pthreads
+
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include <sched.h>
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void*);
+typedef struct HostTask* TaskHandle_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core);
+
+static inline BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_depth,
+                                     void* param, UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, param, priority, handle, tskNO_AFFINITY);
+}
+
+// vTaskDelete(NULL) ends the calling thread; other handles are detached and
+// left to run (pthreads cannot be killed safely mid-call)
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+const char* pcTaskGetName(TaskHandle_t task);
+
+// Core the task was pinned to (the host does not enforce it)
+BaseType_t xTaskGetAffinity(TaskHandle_t task);
+
+// No stack watermark on the host: reports the full configured depth
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+static inline void taskYIELD() { sched_yield(); }
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,315 @@
+// arduino_host.cpp - Serial, String, timing and heap queries for the host build
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <esp_sleep.h>
+#include <malloc.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define HOST_HEAP_SIZE   (512 * 1024)          // ESP32-S3 internal SRAM
+#define HOST_PSRAM_SIZE  (8 * 1024 * 1024)     // OPI PSRAM on the badge
+
+HostSerial Serial;
+EspClass ESP;
+SPIClass SPI;
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+static uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static const uint64_t boot_us = monotonic_us();
+
+unsigned long millis() {
+    return (unsigned long)((monotonic_us() - boot_us) / 1000);
+}
+
+unsigned long micros() {
+    // Wraps at 2^32 like the ESP32 core, so unsigned deltas stay valid
+    return (unsigned long)(uint32_t)(monotonic_us() - boot_us);
+}
+
+void delay(uint32_t ms) {
+    usleep((useconds_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    usleep(us);
+}
+
+static uint32_t cpu_mhz = 240;
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+    if (mhz != 80 && mhz != 160 && mhz != 240) return false;
+    cpu_mhz = mhz;
+    return true;
+}
+
+uint32_t getCpuFrequencyMhz() {
+    return cpu_mhz;
+}
+
+// x86 time-stamp counter (constant rate, near the nominal clock), else
+// nanoseconds. Wraps at 2^32 like CCOUNT, so unsigned deltas stay valid.
+uint32_t EspClass::getCycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+static uint32_t rng_state = 1;
+
+void randomSeed(unsigned long seed) {
+    rng_state = seed ? (uint32_t)seed : 1;
+}
+
+long random(long max) {
+    if (max <= 0) return 0;
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return (long)(rng_state % (uint32_t)max);
+}
+
+long random(long min, long max) {
+    return max <= min ? min : min + random(max - min);
+}
+
+// ============================================================================
+// Light sleep (esp_sleep.h)
+// ============================================================================
+
+static uint64_t sleep_timer_us = 0;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_us) {
+    sleep_timer_us = time_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup() {
+    return ESP_OK;
+}
+
+esp_err_t esp_light_sleep_start() {
+    if (sleep_timer_us) usleep((useconds_t)sleep_timer_us);
+    return ESP_OK;
+}
+
+// ============================================================================
+// Heap
+// ============================================================================
+
+static size_t host_bytes_in_use() {
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+}
+
+uint32_t EspClass::getHeapSize() { return HOST_HEAP_SIZE; }
+uint32_t EspClass::getFreeHeap() { return HOST_HEAP_SIZE; }
+uint32_t EspClass::getPsramSize() { return HOST_PSRAM_SIZE; }
+
+// Low-water mark of the free figures seen by queries (no allocator hook)
+static uint32_t psram_min_free = HOST_PSRAM_SIZE;
+
+uint32_t EspClass::getFreePsram() {
+    size_t used = host_bytes_in_use();
+    uint32_t free_bytes = used >= HOST_PSRAM_SIZE ? 0 : (uint32_t)(HOST_PSRAM_SIZE - used);
+    if (free_bytes < psram_min_free) psram_min_free = free_bytes;
+    return free_bytes;
+}
+
+uint32_t esp_get_free_heap_size() {
+    return ESP.getFreeHeap() + ESP.getFreePsram();
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) ? ESP.getFreePsram() : ESP.getFreeHeap();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    if (!(caps & MALLOC_CAP_SPIRAM)) return ESP.getFreeHeap();
+    ESP.getFreePsram();
+    return psram_min_free;
+}
+
+// ============================================================================
+// String
+// ============================================================================
+
+void String::assign(const char* s, unsigned int len) {
+    char* buf = (char*)malloc(len + 1);
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    free(buf_);
+    buf_ = buf;
+    len_ = len;
+}
+
+String::String(const char* s) : buf_(nullptr), len_(0) {
+    if (!s) s = "";
+    assign(s, strlen(s));
+}
+
+String::String(const String& other) : buf_(nullptr), len_(0) {
+    assign(other.buf_, other.len_);
+}
+
+String::String(int value) : buf_(nullptr), len_(0) {
+    char tmp[16];
+    snprintf(tmp, sizeof(tmp), "%d", value);
+    assign(tmp, strlen(tmp));
+}
+
+String::~String() {
+    free(buf_);
+}
+
+String& String::operator=(const String& other) {
+    if (this != &other) assign(other.buf_, other.len_);
+    return *this;
+}
+
+String& String::operator+=(const char* s) {
+    size_t add = strlen(s);
+    char* buf = (char*)malloc(len_ + add + 1);
+    memcpy(buf, buf_, len_);
+    memcpy(buf + len_, s, add + 1);
+    free(buf_);
+    buf_ = buf;
+    len_ += add;
+    return *this;
+}
+
+String& String::operator+=(const String& other) {
+    return *this += other.c_str();
+}
+
+String& String::operator+=(char c) {
+    char tmp[2] = {c, '\0'};
+    return *this += tmp;
+}
+
+void String::trim() {
+    unsigned int start = 0;
+    while (start < len_ && isspace((unsigned char)buf_[start])) start++;
+    unsigned int end = len_;
+    while (end > start && isspace((unsigned char)buf_[end - 1])) end--;
+    String tmp;
+    tmp.assign(buf_ + start, end - start);
+    *this = tmp;
+}
+
+int String::indexOf(char c) const {
+    const char* p = strchr(buf_, c);
+    return p ? (int)(p - buf_) : -1;
+}
+
+bool String::startsWith(const char* prefix) const {
+    return strncmp(buf_, prefix, strlen(prefix)) == 0;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (to > len_) to = len_;
+    String out;
+    if (from < to) out.assign(buf_ + from, to - from);
+    return out;
+}
+
+// ============================================================================
+// Print / Serial
+// ============================================================================
+
+size_t Print::printf(const char* fmt, ...) {
+    char stack_buf[256];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(stack_buf, sizeof(stack_buf), fmt, args);
+    va_end(args);
+    if (len < 0) return 0;
+
+    if ((size_t)len < sizeof(stack_buf)) {
+        return write((const uint8_t*)stack_buf, len);
+    }
+
+    char* heap_buf = (char*)malloc(len + 1);
+    va_start(args, fmt);
+    vsnprintf(heap_buf, len + 1, fmt, args);
+    va_end(args);
+    size_t n = write((const uint8_t*)heap_buf, len);
+    free(heap_buf);
+    return n;
+}
+
+size_t HostSerial::write(const uint8_t* data, size_t len) {
+    size_t n = fwrite(data, 1, len, stdout);
+    if (memchr(data, '\n', len)) fflush(stdout);
+    return n;
+}
+
+void HostSerial::flush() {
+    fflush(stdout);
+}
+
+// Bytes pulled from stdin but not yet consumed
+static char rx_buf[256];
+static int rx_len = 0;
+
+static void rx_fill() {
+    if (rx_len >= (int)sizeof(rx_buf)) return;
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN)) return;
+    ssize_t n = ::read(STDIN_FILENO, rx_buf + rx_len, sizeof(rx_buf) - rx_len);
+    if (n > 0) rx_len += n;
+}
+
+int HostSerial::available() {
+    rx_fill();
+    return rx_len;
+}
+
+int HostSerial::peek() {
+    rx_fill();
+    return rx_len ? (uint8_t)rx_buf[0] : -1;
+}
+
+int HostSerial::read() {
+    rx_fill();
+    if (!rx_len) return -1;
+    int c = (uint8_t)rx_buf[0];
+    memmove(rx_buf, rx_buf + 1, --rx_len);
+    return c;
+}
+
+String HostSerial::readStringUntil(char terminator) {
+    // Stream::readStringUntil waits up to its 1s timeout for more input
+    String out;
+    unsigned long start = millis();
+    while (millis() - start < 1000) {
+        int c = read();
+        if (c < 0) {
+            delay(1);
+            continue;
+        }
+        if (c == terminator) break;
+        out += (char)c;
+    }
+    return out;
+}
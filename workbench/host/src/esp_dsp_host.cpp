@@ -0,0 +1,158 @@
+// esp_dsp_host.cpp - Reference (non-SIMD) ESP-DSP routines for the host build
+
+#include <esp_dsp.h>
+
+// ============================================================================
+// Dot Product
+// ============================================================================
+
+esp_err_t dsps_dotprod_f32_ansi(const float* src1, const float* src2, float* dest, int len) {
+    float acc = 0.0f;
+    for (int i = 0; i < len; i++) {
+        acc += src1[i] * src2[i];
+    }
+    *dest = acc;
+    return ESP_OK;
+}
+
+esp_err_t dsps_dotprod_f32_aes3(const float* src1, const float* src2, float* dest, int len) {
+    return dsps_dotprod_f32_ansi(src1, src2, dest, len);
+}
+
+esp_err_t dsps_dotprod_s16_ansi(const int16_t* src1, const int16_t* src2, int16_t* dest, int len, int8_t shift) {
+    int64_t acc = 0x7fff >> shift;
+    for (int i = 0; i < len; i++) {
+        acc += (int32_t)src1[i] * src2[i];
+    }
+    *dest = (int16_t)(acc >> (15 - shift));
+    return ESP_OK;
+}
+
+// ============================================================================
+// Radix-2 FFT (interleaved complex, in place)
+// ============================================================================
+
+static int fft_max_size = 0;
+
+esp_err_t dsps_fft2r_init_fc32(float* fft_table_buff, int table_size) {
+    if (table_size > CONFIG_DSP_MAX_FFT_SIZE || (table_size & (table_size - 1))) {
+        return ESP_ERR_DSP_PARAM_OUTOFRANGE;
+    }
+    fft_max_size = table_size;
+    return ESP_OK;
+}
+
+void dsps_fft2r_deinit_fc32() {
+    fft_max_size = 0;
+}
+
+// Decimation in frequency: natural-order input, bit-reversed output
+esp_err_t dsps_fft2r_fc32(float* data, int N) {
+    if (N > fft_max_size || (N & (N - 1))) {
+        return ESP_ERR_DSP_PARAM_OUTOFRANGE;
+    }
+
+    for (int len = N; len >= 2; len >>= 1) {
+        int half = len / 2;
+        for (int j = 0; j < half; j++) {
+            float angle = -2.0f * (float)M_PI * j / len;
+            float wr = cosf(angle);
+            float wi = sinf(angle);
+            for (int i = j; i < N; i += len) {
+                float* a = &data[2 * i];
+                float* b = &data[2 * (i + half)];
+                float dr = a[0] - b[0];
+                float di = a[1] - b[1];
+                a[0] += b[0];
+                a[1] += b[1];
+                b[0] = dr * wr - di * wi;
+                b[1] = dr * wi + di * wr;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t dsps_bit_rev_fc32(float* data, int N) {
+    int j = 0;
+    for (int i = 1; i < N - 1; i++) {
+        int bit = N >> 1;
+        while (j & bit) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+        if (i < j) {
+            float re = data[2 * i];
+            float im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+    return ESP_OK;
+}
+
+// Split a 2-real-signals-in-one complex FFT into two real spectra
+esp_err_t dsps_cplx2reC_fc32(float* data, int N) {
+    int n2 = N << 1;
+    float rkl, rkh, rnl, rnh, ikl, ikh, inl, inh;
+    for (int i = 0; i <= N / 4; i++) {
+        rkl = data[i * 2 + 0];
+        ikl = data[i * 2 + 1];
+        rnl = data[n2 - i * 2 - 2];
+        inl = data[n2 - i * 2 - 1];
+        rkh = data[i * 2 + 0 + N];
+        ikh = data[i * 2 + 1 + N];
+        rnh = data[n2 - i * 2 - 2 - N];
+        inh = data[n2 - i * 2 - 1 - N];
+
+        data[i * 2 + 0] = (rkl + rnl) * 0.5f;
+        data[i * 2 + 1] = (ikl - inl) * 0.5f;
+        data[n2 - i * 2 - 2] = (ikl + inl) * 0.5f;
+        data[n2 - i * 2 - 1] = (rnl - rkl) * 0.5f;
+        data[i * 2 + 0 + N] = (rkh + rnh) * 0.5f;
+        data[i * 2 + 1 + N] = (ikh - inh) * 0.5f;
+        data[n2 - i * 2 - 2 - N] = (ikh + inh) * 0.5f;
+        data[n2 - i * 2 - 1 - N] = (rnh - rkh) * 0.5f;
+    }
+    data[N] = data[1];
+    data[1] = 0;
+    data[N + 1] = 0;
+    return ESP_OK;
+}
+
+// ============================================================================
+// Windows and Vector Math
+// ============================================================================
+
+void dsps_wind_hann_f32(float* window, int len) {
+    float inv = 1.0f / (len - 1);
+    for (int i = 0; i < len; i++) {
+        window[i] = 0.5f * (1.0f - cosf(2.0f * (float)M_PI * i * inv));
+    }
+}
+
+esp_err_t dsps_mulc_f32(const float* input, float* output, int len, float C, int step_in, int step_out) {
+    for (int i = 0; i < len; i++) {
+        output[i * step_out] = input[i * step_in] * C;
+    }
+    return ESP_OK;
+}
+
+esp_err_t dsps_add_f32(const float* input1, const float* input2, float* output, int len,
+                       int step1, int step2, int step_out) {
+    for (int i = 0; i < len; i++) {
+        output[i * step_out] = input1[i * step1] + input2[i * step2];
+    }
+    return ESP_OK;
+}
+
+esp_err_t dsps_mul_f32(const float* input1, const float* input2, float* output, int len,
+                       int step1, int step2, int step_out) {
+    for (int i = 0; i < len; i++) {
+        output[i * step_out] = input1[i * step1] * input2[i * step2];
+    }
+    return ESP_OK;
+}
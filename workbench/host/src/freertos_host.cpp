@@ -0,0 +1,506 @@
+// freertos_host.cpp - FreeRTOS tasks, queues, semaphores and event groups on pthreads
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// How long a binary semaphore given by a task stays reserved for other
+// waiters before the giver may take it back itself. On the chip the consumer
+// (e.g. the matmul helper at priority 19) preempts the giver immediately;
+// without priorities on the host the giver could otherwise steal its own give.
+#define SEM_HANDOFF_GRACE_MS 2
+
+// ============================================================================
+// Time
+// ============================================================================
+
+static void deadline_from_ticks(struct timespec* ts, TickType_t ticks) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+// Wait on cond until woken or deadline; returns false on timeout
+static bool cond_wait_until(pthread_cond_t* cond, pthread_mutex_t* mutex,
+                            TickType_t timeout, const struct timespec* deadline) {
+    if (timeout == portMAX_DELAY) {
+        pthread_cond_wait(cond, mutex);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, mutex, deadline) != ETIMEDOUT;
+}
+
+TickType_t xTaskGetTickCount() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+}
+
+// ============================================================================
+// Tasks
+// ============================================================================
+
+struct HostTask {
+    pthread_t thread;
+    char name[16];
+    TaskFunction_t fn;
+    void* param;
+    UBaseType_t priority;
+    BaseType_t core;
+    uint32_t stack_depth;
+};
+
+static thread_local HostTask* current_task = nullptr;
+static HostTask main_task = {0, "loopTask", nullptr, nullptr, 1, 1, 8192};
+
+static void* task_entry(void* arg) {
+    HostTask* t = (HostTask*)arg;
+    current_task = t;
+    t->fn(t->param);
+    return nullptr;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core) {
+    HostTask* t = (HostTask*)calloc(1, sizeof(HostTask));
+    if (!t) return pdFAIL;
+    strncpy(t->name, name ? name : "task", sizeof(t->name) - 1);
+    t->fn = fn;
+    t->param = param;
+    t->priority = priority;
+    t->core = core;
+    t->stack_depth = stack_depth;
+
+    // Host code paths (libc printf, larger frames) need more than the
+    // ESP32 stack depth, so every task gets at least 256 KB
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    size_t stack = stack_depth < 256 * 1024 ? 256 * 1024 : stack_depth;
+    pthread_attr_setstacksize(&attr, stack);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    int err = pthread_create(&t->thread, &attr, task_entry, t);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        free(t);
+        return pdFAIL;
+    }
+    if (handle) *handle = t;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == nullptr || task == current_task) {
+        pthread_exit(nullptr);
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    usleep((useconds_t)ticks * 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return current_task ? current_task : &main_task;
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+    if (!task) task = xTaskGetCurrentTaskHandle();
+    return task->name;
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t task) {
+    if (!task) task = xTaskGetCurrentTaskHandle();
+    return task->core;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    if (!task) task = xTaskGetCurrentTaskHandle();
+    return task->stack_depth;
+}
+
+// ============================================================================
+// Queues
+// ============================================================================
+
+struct HostQueue {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t* items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    HostQueue* q = (HostQueue*)calloc(1, sizeof(HostQueue));
+    if (!q) return nullptr;
+    q->items = (uint8_t*)malloc((size_t)length * item_size);
+    if (!q->items) {
+        free(q);
+        return nullptr;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->mutex, nullptr);
+    pthread_cond_init(&q->not_empty, nullptr);
+    pthread_cond_init(&q->not_full, nullptr);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    if (!q) return;
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->items);
+    free(q);
+}
+
+static BaseType_t queue_send(QueueHandle_t q, const void* item, TickType_t timeout, bool front) {
+    struct timespec deadline;
+    deadline_from_ticks(&deadline, timeout);
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == q->length) {
+        if (timeout == 0 || !cond_wait_until(&q->not_full, &q->mutex, timeout, &deadline)) {
+            if (q->count == q->length) {
+                pthread_mutex_unlock(&q->mutex);
+                return pdFALSE;
+            }
+        }
+    }
+
+    UBaseType_t slot;
+    if (front) {
+        q->head = (q->head + q->length - 1) % q->length;
+        slot = q->head;
+    } else {
+        slot = (q->head + q->count) % q->length;
+    }
+    memcpy(q->items + (size_t)slot * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t timeout) {
+    return queue_send(q, item, timeout, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void* item, TickType_t timeout) {
+    return queue_send(q, item, timeout, true);
+}
+
+static BaseType_t queue_receive(QueueHandle_t q, void* item, TickType_t timeout, bool remove) {
+    struct timespec deadline;
+    deadline_from_ticks(&deadline, timeout);
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == 0) {
+        if (timeout == 0 || !cond_wait_until(&q->not_empty, &q->mutex, timeout, &deadline)) {
+            if (q->count == 0) {
+                pthread_mutex_unlock(&q->mutex);
+                return pdFALSE;
+            }
+        }
+    }
+
+    memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+    if (remove) {
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t timeout) {
+    return queue_receive(q, item, timeout, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void* item, TickType_t timeout) {
+    return queue_receive(q, item, timeout, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t q) {
+    pthread_mutex_lock(&q->mutex);
+    q->head = 0;
+    q->count = 0;
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->mutex);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->mutex);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->mutex);
+    return n;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) {
+    pthread_mutex_lock(&q->mutex);
+    UBaseType_t n = q->length - q->count;
+    pthread_mutex_unlock(&q->mutex);
+    return n;
+}
+
+// ============================================================================
+// Semaphores
+// ============================================================================
+
+struct HostSemaphore {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max_count;
+    bool recursive;
+    pthread_t owner;            // Recursive mutex holder
+    UBaseType_t depth;
+    pthread_t giver;            // Last task to give a binary semaphore
+    bool has_giver;
+};
+
+static SemaphoreHandle_t sem_create(UBaseType_t max_count, UBaseType_t initial, bool recursive) {
+    HostSemaphore* s = (HostSemaphore*)calloc(1, sizeof(HostSemaphore));
+    if (!s) return nullptr;
+    pthread_mutex_init(&s->mutex, nullptr);
+    pthread_cond_init(&s->cond, nullptr);
+    s->count = initial;
+    s->max_count = max_count;
+    s->recursive = recursive;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return sem_create(1, 0, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    return sem_create(max_count, initial_count, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return sem_create(1, 1, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return sem_create(1, 1, true);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s) {
+    if (!s) return;
+    pthread_mutex_destroy(&s->mutex);
+    pthread_cond_destroy(&s->cond);
+    free(s);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t timeout) {
+    struct timespec deadline;
+    deadline_from_ticks(&deadline, timeout);
+
+    pthread_mutex_lock(&s->mutex);
+
+    // Let another waiter consume our own give first (see SEM_HANDOFF_GRACE_MS)
+    if (s->max_count == 1 && s->count > 0 && s->has_giver &&
+        pthread_equal(s->giver, pthread_self()) && timeout != 0) {
+        struct timespec grace;
+        deadline_from_ticks(&grace, SEM_HANDOFF_GRACE_MS);
+        while (s->count > 0 &&
+               pthread_cond_timedwait(&s->cond, &s->mutex, &grace) != ETIMEDOUT) {
+        }
+    }
+
+    while (s->count == 0) {
+        if (timeout == 0 || !cond_wait_until(&s->cond, &s->mutex, timeout, &deadline)) {
+            if (s->count == 0) {
+                pthread_mutex_unlock(&s->mutex);
+                return pdFALSE;
+            }
+        }
+    }
+    s->count--;
+    s->has_giver = false;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    pthread_mutex_lock(&s->mutex);
+    if (s->count >= s->max_count) {
+        pthread_mutex_unlock(&s->mutex);
+        return pdFALSE;
+    }
+    s->count++;
+    s->giver = pthread_self();
+    s->has_giver = true;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t timeout) {
+    pthread_t self = pthread_self();
+    pthread_mutex_lock(&s->mutex);
+    if (s->depth > 0 && pthread_equal(s->owner, self)) {
+        s->depth++;
+        pthread_mutex_unlock(&s->mutex);
+        return pdTRUE;
+    }
+    pthread_mutex_unlock(&s->mutex);
+
+    if (xSemaphoreTake(s, timeout) != pdTRUE) {
+        return pdFALSE;
+    }
+
+    pthread_mutex_lock(&s->mutex);
+    s->owner = self;
+    s->depth = 1;
+    pthread_mutex_unlock(&s->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s) {
+    pthread_mutex_lock(&s->mutex);
+    if (s->depth == 0 || !pthread_equal(s->owner, pthread_self())) {
+        pthread_mutex_unlock(&s->mutex);
+        return pdFALSE;
+    }
+    bool release = --s->depth == 0;
+    pthread_mutex_unlock(&s->mutex);
+
+    if (release) {
+        // A mutex is never "handed off" to its own holder, so no giver mark
+        pthread_mutex_lock(&s->mutex);
+        s->count = 1;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+    }
+    return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t s) {
+    pthread_mutex_lock(&s->mutex);
+    UBaseType_t n = s->count;
+    pthread_mutex_unlock(&s->mutex);
+    return n;
+}
+
+// ============================================================================
+// Event Groups
+// ============================================================================
+
+struct HostEventGroup {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    EventBits_t bits;
+    uint32_t sync_generation;   // Bumped each time an xEventGroupSync completes
+};
+
+EventGroupHandle_t xEventGroupCreate() {
+    HostEventGroup* g = (HostEventGroup*)calloc(1, sizeof(HostEventGroup));
+    if (!g) return nullptr;
+    pthread_mutex_init(&g->mutex, nullptr);
+    pthread_cond_init(&g->cond, nullptr);
+    return g;
+}
+
+void vEventGroupDelete(EventGroupHandle_t g) {
+    if (!g) return;
+    pthread_mutex_destroy(&g->mutex);
+    pthread_cond_destroy(&g->cond);
+    free(g);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits) {
+    pthread_mutex_lock(&g->mutex);
+    g->bits |= bits;
+    EventBits_t now = g->bits;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->mutex);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits) {
+    pthread_mutex_lock(&g->mutex);
+    EventBits_t before = g->bits;
+    g->bits &= ~bits;
+    pthread_mutex_unlock(&g->mutex);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g) {
+    pthread_mutex_lock(&g->mutex);
+    EventBits_t now = g->bits;
+    pthread_mutex_unlock(&g->mutex);
+    return now;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t timeout) {
+    struct timespec deadline;
+    deadline_from_ticks(&deadline, timeout);
+
+    pthread_mutex_lock(&g->mutex);
+    for (;;) {
+        EventBits_t hit = g->bits & bits;
+        if (wait_for_all ? hit == bits : hit != 0) break;
+        if (timeout == 0 || !cond_wait_until(&g->cond, &g->mutex, timeout, &deadline)) {
+            hit = g->bits & bits;
+            if (!(wait_for_all ? hit == bits : hit != 0)) {
+                EventBits_t now = g->bits;
+                pthread_mutex_unlock(&g->mutex);
+                return now;
+            }
+            break;
+        }
+    }
+    EventBits_t now = g->bits;
+    if (clear_on_exit) g->bits &= ~bits;
+    pthread_mutex_unlock(&g->mutex);
+    return now;
+}
+
+EventBits_t xEventGroupSync(EventGroupHandle_t g, EventBits_t set_bits, EventBits_t wait_bits,
+                            TickType_t timeout) {
+    struct timespec deadline;
+    deadline_from_ticks(&deadline, timeout);
+
+    pthread_mutex_lock(&g->mutex);
+    g->bits |= set_bits;
+
+    // Last task to arrive completes the rendezvous and clears the bits
+    if ((g->bits & wait_bits) == wait_bits) {
+        EventBits_t now = g->bits;
+        g->bits &= ~wait_bits;
+        g->sync_generation++;
+        pthread_cond_broadcast(&g->cond);
+        pthread_mutex_unlock(&g->mutex);
+        return now;
+    }
+
+    uint32_t generation = g->sync_generation;
+    while (g->sync_generation == generation) {
+        if (!cond_wait_until(&g->cond, &g->mutex, timeout, &deadline)) break;
+    }
+    EventBits_t now = (g->sync_generation != generation) ? (g->bits | wait_bits) : g->bits;
+    pthread_mutex_unlock(&g->mutex);
+    return now;
+}
@@ -0,0 +1,244 @@
+// fs_host.cpp - fs::FS / fs::File on host directories (SD and FFat stand-ins)
+
+#include <FS.h>
+#include <SD.h>
+#include <FFat.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+SDFS SD;
+F_Fat FFat;
+
+namespace fs {
+
+struct FileImpl {
+    FILE* fp;
+    DIR* dir;
+    String path;            // Path as seen by the sketch ("/dir/file")
+    String host_path;
+    String name;
+    FS* owner;
+
+    ~FileImpl() {
+        if (fp) fclose(fp);
+        if (dir) closedir(dir);
+    }
+};
+
+// ============================================================================
+// File
+// ============================================================================
+
+File::operator bool() const {
+    return impl_ && (impl_->fp || impl_->dir);
+}
+
+size_t File::write(const uint8_t* data, size_t len) {
+    if (!impl_ || !impl_->fp) return 0;
+    return fwrite(data, 1, len, impl_->fp);
+}
+
+size_t File::read(uint8_t* buffer, size_t len) {
+    if (!impl_ || !impl_->fp) return 0;
+    return fread(buffer, 1, len, impl_->fp);
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+    if (!impl_ || !impl_->fp) return -1;
+    int c = fgetc(impl_->fp);
+    if (c != EOF) ungetc(c, impl_->fp);
+    return c == EOF ? -1 : c;
+}
+
+int File::available() {
+    if (!impl_ || !impl_->fp) return 0;
+    size_t pos = position();
+    size_t total = size();
+    return pos < total ? (int)(total - pos) : 0;
+}
+
+void File::flush() {
+    if (impl_ && impl_->fp) fflush(impl_->fp);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!impl_ || !impl_->fp) return false;
+    int whence = mode == SeekCur ? SEEK_CUR : (mode == SeekEnd ? SEEK_END : SEEK_SET);
+    return fseek(impl_->fp, pos, whence) == 0;
+}
+
+size_t File::position() const {
+    if (!impl_ || !impl_->fp) return 0;
+    long pos = ftell(impl_->fp);
+    return pos < 0 ? 0 : (size_t)pos;
+}
+
+size_t File::size() const {
+    if (!impl_ || !impl_->fp) return 0;
+    fflush(impl_->fp);
+    struct stat st;
+    return fstat(fileno(impl_->fp), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+void File::close() {
+    impl_.reset();
+}
+
+const char* File::path() const {
+    return impl_ ? impl_->path.c_str() : "";
+}
+
+const char* File::name() const {
+    return impl_ ? impl_->name.c_str() : "";
+}
+
+bool File::isDirectory() const {
+    return impl_ && impl_->dir;
+}
+
+File File::openNextFile(const char* mode) {
+    if (!impl_ || !impl_->dir) return File();
+    struct dirent* ent;
+    while ((ent = readdir(impl_->dir)) != nullptr) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        String child = impl_->path;
+        if (child.length() == 0 || child[child.length() - 1] != '/') child += "/";
+        child += ent->d_name;
+        return impl_->owner->open(child.c_str(), mode);
+    }
+    return File();
+}
+
+void File::rewindDirectory() {
+    if (impl_ && impl_->dir) rewinddir(impl_->dir);
+}
+
+// ============================================================================
+// FS
+// ============================================================================
+
+const char* FS::root() {
+    return root_ ? root_ : host_arg(default_root_, default_root_);
+}
+
+bool FS::mountRoot(const char* arg_name) {
+    root_ = host_arg(arg_name, default_root_);
+    struct stat st;
+    if (stat(root_, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "[host] --%s directory '%s' not found\n", arg_name, root_);
+        return false;
+    }
+    return true;
+}
+
+String FS::hostPath(const char* path) {
+    String out = root();
+    if (path[0] != '/') out += "/";
+    out += path;
+    return out;
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+    String host = hostPath(path);
+
+    struct stat st;
+    bool is_dir = stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+
+    auto impl = std::make_shared<FileImpl>();
+    impl->fp = nullptr;
+    impl->dir = nullptr;
+    impl->path = path;
+    impl->host_path = host;
+    impl->owner = this;
+    const char* slash = strrchr(path, '/');
+    impl->name = slash ? slash + 1 : path;
+
+    if (is_dir) {
+        impl->dir = opendir(host.c_str());
+    } else {
+        // Arduino "w" truncates like stdio; binary mode is implicit on Linux
+        impl->fp = fopen(host.c_str(), mode[0] == 'r' && mode[1] == '+' ? "r+" : mode);
+    }
+    if (!impl->fp && !impl->dir) return File();
+    return File(impl);
+}
+
+bool FS::exists(const char* path) {
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) {
+    return ::unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+bool FS::rmdir(const char* path) {
+    return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+} // namespace fs
+
+// ============================================================================
+// Volume sizes (reported from the host filesystem holding the directory)
+// ============================================================================
+
+static uint64_t volume_bytes(const char* root, bool free_only) {
+    struct statvfs vfs;
+    if (statvfs(root, &vfs) != 0) return 0;
+    return (uint64_t)vfs.f_frsize * (free_only ? vfs.f_bavail : vfs.f_blocks);
+}
+
+bool SDFS::begin(uint8_t, SPIClass&, uint32_t, const char*, uint8_t, bool) {
+    return mountRoot("sd");
+}
+
+sdcard_type_t SDFS::cardType() {
+    return root_ ? CARD_SDHC : CARD_NONE;
+}
+
+uint64_t SDFS::cardSize() {
+    return volume_bytes(root(), false);
+}
+
+uint64_t SDFS::totalBytes() {
+    return volume_bytes(root(), false);
+}
+
+uint64_t SDFS::usedBytes() {
+    return totalBytes() - volume_bytes(root(), true);
+}
+
+bool F_Fat::begin(bool, const char*, uint8_t, const char*) {
+    return mountRoot("ffat");
+}
+
+bool F_Fat::format(bool, char*) {
+    return false;
+}
+
+size_t F_Fat::totalBytes() {
+    return (size_t)volume_bytes(root(), false);
+}
+
+size_t F_Fat::usedBytes() {
+    return totalBytes() - (size_t)volume_bytes(root(), true);
+}
+
+size_t F_Fat::freeBytes() {
+    return (size_t)volume_bytes(root(), true);
+}
@@ -0,0 +1,68 @@
+// host_main.cpp - Runs an Arduino sketch (setup + loop) as a Linux process
+//
+// Usage: <sketch>.host [--name value ...]
+//   --sd DIR         SD card root (default ./sd)
+//   --ffat DIR       FFat partition root (default ./ffat)
+//   --seconds N      Exit after N seconds of wall time (default: run forever)
+// Any other --name value pair is readable by the sketch with host_arg(),
+// e.g. the HAL's --mic / --spk / --frames / --imu / --buttons / --sd-image.
+
+#include <Arduino.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define HOST_MAX_ARGS 32
+
+void setup();
+void loop();
+
+static const char* arg_names[HOST_MAX_ARGS];
+static const char* arg_values[HOST_MAX_ARGS];
+static int num_args = 0;
+
+const char* host_arg(const char* name, const char* fallback) {
+    for (int i = 0; i < num_args; i++) {
+        if (strcmp(arg_names[i], name) == 0) return arg_values[i];
+    }
+    return fallback;
+}
+
+long host_arg_int(const char* name, long fallback) {
+    const char* v = host_arg(name, nullptr);
+    return v ? atol(v) : fallback;
+}
+
+// setup() may block forever (error_halt), so the time limit runs on its own thread
+static void* run_timer(void* param) {
+    long seconds = (long)param;
+    sleep(seconds);
+    fflush(stdout);
+    fprintf(stderr, "[host] %ld s elapsed, exiting\n", seconds);
+    exit(0);
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0 || i + 1 >= argc || num_args >= HOST_MAX_ARGS) {
+            fprintf(stderr, "usage: %s [--name value ...]\n", argv[0]);
+            return 1;
+        }
+        arg_names[num_args] = argv[i] + 2;
+        arg_values[num_args] = argv[++i];
+        num_args++;
+    }
+
+    long seconds = host_arg_int("seconds", 0);
+    if (seconds > 0) {
+        pthread_t timer;
+        pthread_create(&timer, nullptr, run_timer, (void*)seconds);
+        pthread_detach(timer);
+    }
+
+    setup();
+    for (;;) {
+        loop();
+    }
+    return 0;
+}
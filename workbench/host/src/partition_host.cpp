@@ -0,0 +1,112 @@
+// partition_host.cpp - Flash partitions as image files (--partition-<label>)
+
+#include <esp_partition.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HOST_MAX_PARTITIONS 4
+#define HOST_MAX_MAPPINGS   8
+
+struct HostPartition {
+    esp_partition_t part;
+    char path[256];
+};
+
+struct HostMapping {
+    void* addr;
+    size_t len;
+};
+
+static HostPartition partitions[HOST_MAX_PARTITIONS];
+static int num_partitions = 0;
+static HostMapping mappings[HOST_MAX_MAPPINGS];
+
+static const HostPartition* host_partition(const esp_partition_t* partition) {
+    for (int i = 0; i < num_partitions; i++) {
+        if (&partitions[i].part == partition) return &partitions[i];
+    }
+    return nullptr;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char* label) {
+    if (!label) return nullptr;
+    for (int i = 0; i < num_partitions; i++) {
+        if (strcmp(partitions[i].part.label, label) == 0) return &partitions[i].part;
+    }
+
+    char name[40];
+    snprintf(name, sizeof(name), "partition-%s", label);
+    const char* path = host_arg(name, nullptr);
+    struct stat st;
+    if (!path || stat(path, &st) != 0 || num_partitions >= HOST_MAX_PARTITIONS) {
+        return nullptr;
+    }
+
+    HostPartition* hp = &partitions[num_partitions++];
+    hp->part.type = type;
+    hp->part.subtype = subtype;
+    hp->part.address = 0;
+    hp->part.size = (uint32_t)st.st_size;
+    snprintf(hp->part.label, sizeof(hp->part.label), "%s", label);
+    hp->part.encrypted = false;
+    snprintf(hp->path, sizeof(hp->path), "%s", path);
+    return &hp->part;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset,
+                             void* dst, size_t size) {
+    const HostPartition* hp = host_partition(partition);
+    if (!hp || src_offset + size > partition->size) return ESP_FAIL;
+
+    FILE* fp = fopen(hp->path, "rb");
+    if (!fp) return ESP_FAIL;
+    bool ok = fseek(fp, src_offset, SEEK_SET) == 0 && fread(dst, 1, size, fp) == size;
+    fclose(fp);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void** out_ptr,
+                             esp_partition_mmap_handle_t* out_handle) {
+    const HostPartition* hp = host_partition(partition);
+    if (!hp || offset + size > partition->size) return ESP_FAIL;
+
+    int slot = -1;
+    for (int i = 0; i < HOST_MAX_MAPPINGS; i++) {
+        if (!mappings[i].addr) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) return ESP_FAIL;
+
+    int fd = open(hp->path, O_RDONLY);
+    if (fd < 0) return ESP_FAIL;
+
+    // mmap offsets must be page aligned, like the 64 KB MMU pages on the chip
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t base = offset & ~(page - 1);
+    size_t len = size + (offset - base);
+    void* addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, base);
+    close(fd);
+    if (addr == MAP_FAILED) return ESP_FAIL;
+
+    mappings[slot].addr = addr;
+    mappings[slot].len = len;
+    *out_ptr = (const uint8_t*)addr + (offset - base);
+    *out_handle = slot + 1;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+    if (handle == 0 || handle > HOST_MAX_MAPPINGS) return;
+    HostMapping* m = &mappings[handle - 1];
+    if (m->addr) {
+        munmap(m->addr, m->len);
+        m->addr = nullptr;
+    }
+}
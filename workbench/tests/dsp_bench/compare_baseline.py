@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""Compare a dsp_bench run with the checked-in baseline.
+
+dsp_bench prints one csv line per measurement next to its table. Save the
+Serial Monitor output (or the host binary's stdout) and compare it with
+baseline_<platform>.csv; measurements slower than the baseline by more than
+the tolerance are listed and the exit status is 1. --update rewrites the
+baseline from the run instead, after a change that should move it.
+
+Usage:
+    python3 compare_baseline.py run.log
+    python3 compare_baseline.py run.log --tolerance 0.05
+    python3 compare_baseline.py run.log --update
+"""
+
+import argparse
+import csv
+import os
+import sys
+
+FIELDS = ["platform", "kernel", "shape", "mem", "align", "cache", "cycles", "cyc_per_elem"]
+KEY = FIELDS[1:6]
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def read_log(path):
+    """Measurements from csv lines in a dsp_bench log, by platform. A log
+    holding several runs keeps the last value of each measurement."""
+    runs = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("csv,"):
+                continue
+            row = dict(zip(FIELDS, line.split(",")[1:]))
+            if len(row) != len(FIELDS):
+                continue
+            runs.setdefault(row["platform"], {})[tuple(row[k] for k in KEY)] = row
+    return runs
+
+
+def baseline_path(platform):
+    return os.path.join(HERE, f"baseline_{platform}.csv")
+
+
+def read_baseline(platform):
+    path = baseline_path(platform)
+    if not os.path.exists(path):
+        return None
+    with open(path, newline="") as f:
+        return {tuple(row[k] for k in KEY): row for row in csv.DictReader(f)}
+
+
+def write_baseline(platform, rows):
+    with open(baseline_path(platform), "w", newline="") as f:
+        out = csv.DictWriter(f, fieldnames=FIELDS, lineterminator="\n")
+        out.writeheader()
+        for row in rows.values():
+            out.writerow(row)
+
+
+def compare(platform, rows, base, tolerance):
+    """Print the changes past the tolerance; returns the number of regressions."""
+    slower = 0
+    print(f"{platform}: {len(rows)} measurements, baseline {len(base)}")
+    print("  kernel    shape   mem   align cache      base       now  change")
+    for key, row in rows.items():
+        if key not in base:
+            print("  " + " ".join(f"{v:<5}" for v in key) + "  (not in baseline)")
+            continue
+        before = int(base[key]["cycles"])
+        now = int(row["cycles"])
+        change = now / before - 1 if before else 0.0
+        if abs(change) <= tolerance:
+            continue
+        kernel, shape, mem, align, cache = key
+        mark = "  SLOWER" if change > 0 else ""
+        print(f"  {kernel:<9} {shape:<7} {mem:<5} {align:<5} {cache:<5} {before:9} {now:9} "
+              f"{change:+7.1%}{mark}")
+        slower += change > 0
+    missing = [k for k in base if k not in rows]
+    if missing:
+        print(f"  {len(missing)} baseline measurements missing from the run")
+    return slower
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("log", help="dsp_bench output with its csv lines")
+    ap.add_argument("--tolerance", type=float, default=0.10,
+                    help="Relative change that counts (default 0.10)")
+    ap.add_argument("--update", action="store_true", help="Write the run as the new baseline")
+    args = ap.parse_args()
+
+    runs = read_log(args.log)
+    if not runs:
+        sys.exit(f"{args.log}: no dsp_bench csv lines")
+
+    regressions = 0
+    for platform, rows in runs.items():
+        base = read_baseline(platform)
+        if args.update or base is None:
+            write_baseline(platform, rows)
+            print(f"Wrote {len(rows)} measurements to {baseline_path(platform)}")
+            continue
+        regressions += compare(platform, rows, base, args.tolerance)
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
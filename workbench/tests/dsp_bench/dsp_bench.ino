@@ -0,0 +1,285 @@
+// dsp_bench.ino - Cycle counts of the DSP kernels at the shapes the project runs
+// Every kernel optimization needs a number to beat. This times the kernels
+// the LLM, YAMNet front end and match index spend their time in, at their
+// real sizes:
+//   dot aes3 / dot loop   n = 64 (stories260K rows), 288 / 768 (stories15M
+//                         rows), 1024 (similarity_match float rows)
+//   dot s8                n = 256 (similarity_match int8 rows, projected)
+//   fft2r, bit_rev        512-point complex FFT (mel_spectrogram)
+//   window, power         512-sample window + int16 convert, 257-bin |X|^2
+//   mel loop / mel aes3   64 x 257 filterbank as a loop and as per-row dots
+// each with its buffers in PSRAM and in internal SRAM, 16-byte aligned and
+// 4 bytes off, with a warm data cache and after evicting it (cold).
+// Results are CPU cycles (ESP.getCycleCount) per call and per element,
+// the best warm and the median cold run of BENCH_RUNS, plus csv lines
+// for compare_baseline.py.
+// On the host the ESP-DSP calls are the plain C stand-ins and the counts
+// are host clock ticks.
+
+#include <Arduino.h>
+#include <esp_dsp.h>
+
+#define BENCH_RUNS          31
+#define BENCH_FFT_SIZE      512
+#define BENCH_MEL_BINS      64
+#define BENCH_FREQ_BINS     (BENCH_FFT_SIZE / 2 + 1)
+#define BENCH_MISALIGN      4           // Bytes off a 16-byte boundary
+
+#ifdef ARDUINO
+#define BENCH_PLATFORM      "esp32s3"
+#define BENCH_FLUSH_BYTES   (256 * 1024)        // 4x the largest data cache
+#else
+#define BENCH_PLATFORM      "host"
+#define BENCH_FLUSH_BYTES   (64 * 1024 * 1024)  // Past the last-level cache
+#endif
+
+typedef enum { MEM_PSRAM, MEM_SRAM } Placement;
+
+typedef struct {
+    float* a;           // Input vector, or the in-place FFT buffer
+    float* b;           // Second input: weights, window or filterbank
+    float* out;
+    const float* fresh; // Unmodified copy of a, for kernels that work in place
+    int16_t* pcm;
+    int n;
+    int rows;
+} Args;
+
+typedef void (*KernelFn)(const Args* args);
+
+typedef struct {
+    const char* name;
+    KernelFn run;
+    KernelFn prep;      // Before every run, untimed (nullptr = none)
+    int n;
+    int rows;
+    bool misalign;      // Also run with the operands 4 bytes off
+} Kernel;
+
+static uint8_t* flush_buf;
+
+// ---- Kernels ----
+
+static void k_dot_aes3(const Args* p) {
+    dsps_dotprod_f32_aes3(p->a, p->b, p->out, p->n);
+}
+
+static void k_dot_loop(const Args* p) {
+    float sum = 0.0f;
+    for (int i = 0; i < p->n; i++) sum += p->a[i] * p->b[i];
+    p->out[0] = sum;
+}
+
+// SimilarityMatcher::match(const int8_t*): a and b hold int8 rows
+static void k_dot_s8(const Args* p) {
+    const int8_t* a = (const int8_t*)p->a;
+    const int8_t* b = (const int8_t*)p->b;
+    int32_t dot = 0;
+    for (int i = 0; i < p->n; i++) dot += (int32_t)a[i] * b[i];
+    p->out[0] = (float)dot;
+}
+
+static void k_fft(const Args* p) {
+    dsps_fft2r_fc32(p->a, p->n);
+}
+
+static void k_bit_rev(const Args* p) {
+    dsps_bit_rev_fc32(p->a, p->n);
+}
+
+// Fresh samples for the in-place FFT, so repeated runs do not overflow
+static void prep_fft(const Args* p) {
+    memcpy(p->a, p->fresh, p->n * 2 * sizeof(float));
+}
+
+// MelSpectrogram::computeFFTFrame(): window and scale int16 samples
+static void k_window(const Args* p) {
+    for (int i = 0; i < p->n; i++) {
+        p->a[i] = (float)p->pcm[i] * p->b[i] / 32768.0f;
+    }
+}
+
+static void k_power(const Args* p) {
+    for (int k = 0; k < p->n / 2 + 1; k++) {
+        float re = p->a[k * 2];
+        float im = p->a[k * 2 + 1];
+        p->out[k] = re * re + im * im;
+    }
+}
+
+// MelSpectrogram::applyMelFilterbank() before the log
+static void k_mel_loop(const Args* p) {
+    for (int m = 0; m < p->rows; m++) {
+        float sum = 0.0f;
+        const float* row = p->b + m * p->n;
+        for (int k = 0; k < p->n; k++) sum += row[k] * p->a[k];
+        p->out[m] = sum;
+    }
+}
+
+static void k_mel_aes3(const Args* p) {
+    for (int m = 0; m < p->rows; m++) {
+        dsps_dotprod_f32_aes3(p->b + m * p->n, p->a, p->out + m, p->n);
+    }
+}
+
+static const Kernel KERNELS[] = {
+    {"dot aes3",  k_dot_aes3, nullptr,  64,             1,              true},
+    {"dot aes3",  k_dot_aes3, nullptr,  288,            1,              true},
+    {"dot aes3",  k_dot_aes3, nullptr,  768,            1,              true},
+    {"dot aes3",  k_dot_aes3, nullptr,  1024,           1,              true},
+    {"dot loop",  k_dot_loop, nullptr,  64,             1,              true},
+    {"dot loop",  k_dot_loop, nullptr,  288,            1,              true},
+    {"dot loop",  k_dot_loop, nullptr,  768,            1,              true},
+    {"dot loop",  k_dot_loop, nullptr,  1024,           1,              true},
+    {"dot s8",    k_dot_s8,   nullptr,  256,            1,              true},
+    {"fft2r",     k_fft,      prep_fft, BENCH_FFT_SIZE, 1,              false},
+    {"bit_rev",   k_bit_rev,  nullptr,  BENCH_FFT_SIZE, 1,              false},
+    {"window",    k_window,   nullptr,  BENCH_FFT_SIZE, 1,              false},
+    {"power",     k_power,    nullptr,  BENCH_FFT_SIZE, 1,              false},
+    {"mel loop",  k_mel_loop, nullptr,  BENCH_FREQ_BINS, BENCH_MEL_BINS, false},
+    {"mel aes3",  k_mel_aes3, nullptr,  BENCH_FREQ_BINS, BENCH_MEL_BINS, false},
+};
+
+// Elements a kernel processes per call: multiply-adds, or points
+static int elements(const Kernel* k) {
+    if (k->run == k_power) return k->n / 2 + 1;
+    return k->n * k->rows;
+}
+
+// ---- Buffers ----
+
+static void* bench_alloc(size_t bytes, Placement mem) {
+    if (mem == MEM_PSRAM) return ps_malloc(bytes);
+    return heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+// 16-byte aligned, or BENCH_MISALIGN past it, inside a block from bench_alloc
+static float* place(void* block, bool misalign) {
+    uintptr_t p = ((uintptr_t)block + 15) & ~(uintptr_t)15;
+    return (float*)(p + (misalign ? BENCH_MISALIGN : 0));
+}
+
+static void fill_random(float* v, int count) {
+    for (int i = 0; i < count; i++) {
+        v[i] = (random(20001) - 10000) / 10000.0f;
+    }
+}
+
+// Read enough other memory to push the operands out of the data cache
+static void evict_cache() {
+    volatile uint32_t sum = 0;
+    const uint32_t* p = (const uint32_t*)flush_buf;
+    for (size_t i = 0; i < BENCH_FLUSH_BYTES / 4; i += 8) sum += p[i];
+    (void)sum;
+}
+
+static int cmp_u32(const void* x, const void* y) {
+    uint32_t a = *(const uint32_t*)x, b = *(const uint32_t*)y;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// Cycles of BENCH_RUNS runs: the fastest warm run (the kernel without
+// interrupts in the way), the median cold run
+static uint32_t time_kernel(const Kernel* k, const Args* args, bool cold) {
+    uint32_t cycles[BENCH_RUNS];
+    if (!cold) {
+        if (k->prep) k->prep(args);
+        k->run(args);
+    }
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        if (k->prep) k->prep(args);
+        if (cold) evict_cache();
+        uint32_t t0 = ESP.getCycleCount();
+        k->run(args);
+        cycles[r] = ESP.getCycleCount() - t0;
+    }
+    qsort(cycles, BENCH_RUNS, sizeof(uint32_t), cmp_u32);
+    return cold ? cycles[BENCH_RUNS / 2] : cycles[0];
+}
+
+static bool bench_kernel(const Kernel* k, Placement mem, bool misalign) {
+    // a: FFT buffer (2n) or vector; b: weights / window / filterbank
+    size_t a_floats = 2 * k->n;
+    size_t b_floats = (size_t)k->n * k->rows;
+    size_t out_floats = k->n / 2 + 1 > k->rows ? k->n / 2 + 1 : k->rows;
+    void* a_block = bench_alloc(a_floats * sizeof(float) + 32, mem);
+    void* b_block = bench_alloc(b_floats * sizeof(float) + 32, mem);
+    float* out = (float*)bench_alloc(out_floats * sizeof(float), mem);
+    float* fresh = (float*)bench_alloc(a_floats * sizeof(float), mem);
+    int16_t* pcm = (int16_t*)bench_alloc(k->n * sizeof(int16_t), mem);
+    bool ok = a_block && b_block && out && fresh && pcm;
+
+    if (ok) {
+        Args args = {place(a_block, misalign), place(b_block, misalign), out, fresh, pcm, k->n, k->rows};
+        fill_random(args.a, a_floats);
+        fill_random(args.b, b_floats);
+        memcpy(fresh, args.a, a_floats * sizeof(float));
+        for (int i = 0; i < k->n; i++) pcm[i] = random(-32768, 32768);
+
+        const char* mem_name = mem == MEM_PSRAM ? "psram" : "sram";
+        const char* align_name = misalign ? "+4" : "16";
+        char shape[16];
+        if (k->rows > 1) snprintf(shape, sizeof(shape), "%dx%d", k->rows, k->n);
+        else snprintf(shape, sizeof(shape), "%d", k->n);
+
+        for (int cold = 0; cold < 2; cold++) {
+            uint32_t cycles = time_kernel(k, &args, cold);
+            float per_elem = (float)cycles / elements(k);
+            Serial.printf("  %-9s %-7s %-5s %-5s %-5s %9u %9.2f\n", k->name, shape, mem_name, align_name,
+                          cold ? "cold" : "warm", (unsigned)cycles, per_elem);
+            Serial.printf("csv,%s,%s,%s,%s,%s,%s,%u,%.3f\n", BENCH_PLATFORM, k->name, shape, mem_name,
+                          align_name, cold ? "cold" : "warm", (unsigned)cycles, per_elem);
+        }
+    } else {
+        Serial.printf("ERROR: No %s for %s n=%d\n", mem == MEM_PSRAM ? "PSRAM" : "SRAM", k->name, k->n);
+    }
+    heap_caps_free(a_block);
+    heap_caps_free(b_block);
+    heap_caps_free(out);
+    heap_caps_free(fresh);
+    heap_caps_free(pcm);
+    return ok;
+}
+
+void run_bench() {
+    Serial.printf("\n%s, CPU %u MHz, %d runs per measurement\n", BENCH_PLATFORM, (unsigned)getCpuFrequencyMhz(),
+                  BENCH_RUNS);
+    Serial.println("  kernel    shape   mem   align cache    cycles  cyc/elem");
+    for (const Kernel& k : KERNELS) {
+        for (int mem = MEM_PSRAM; mem <= MEM_SRAM; mem++) {
+            bench_kernel(&k, (Placement)mem, false);
+            if (k.misalign) bench_kernel(&k, (Placement)mem, true);
+        }
+    }
+    Serial.println("\nSend any line to run again");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n========================================");
+    Serial.println("DSP Kernel Benchmark");
+    Serial.println("========================================");
+    Serial.printf("Free PSRAM: %d bytes, free SRAM: %d bytes\n", (int)ESP.getFreePsram(),
+                  (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+
+    flush_buf = (uint8_t*)ps_malloc(BENCH_FLUSH_BYTES);
+    if (!flush_buf || dsps_fft2r_init_fc32(NULL, BENCH_FFT_SIZE) != ESP_OK) {
+        Serial.println("ERROR: No memory for the FFT table or cache flush buffer");
+        while (true) delay(1000);
+    }
+    memset(flush_buf, 1, BENCH_FLUSH_BYTES);
+
+    randomSeed(1234);
+    run_bench();
+}
+
+void loop() {
+    if (Serial.available()) {
+        while (Serial.available()) Serial.read();
+        run_bench();
+    }
+    delay(50);
+}
@@ -0,0 +1,175 @@
+// fast_math_test.ino - Accuracy and speed of fast_math.h against libm
+// Sweeps each kernel over its documented range, reports the worst error
+// against a double-precision libm reference and fails when it exceeds the
+// bound in fast_math.h. Then times fast vs libm per element. Runs on the
+// board or on the host (../../host/build_host.sh .).
+// fast_math.{h,cpp} are copies from 03_interaction_pipeline.
+
+#include <Arduino.h>
+#include "fast_math.h"
+
+#define TIMING_N 4096
+
+static int failures = 0;
+
+typedef double (*RefFn)(double x);
+typedef float (*FastFn)(float x);
+
+// Error metric: |err| / max(floor, |ref|) (floor 0 = relative error)
+static double worst_error(FastFn fast, RefFn ref, float x, double floor, float* worst_x, double worst) {
+    double r = ref(x);
+    double denom = fabs(r) > floor ? fabs(r) : floor;
+    double err = fabs((double)fast(x) - r) / denom;
+    if (err > worst) *worst_x = x;
+    return err > worst ? err : worst;
+}
+
+static void report(const char* name, double worst, float worst_x, float bound) {
+    bool ok = worst <= bound;
+    if (!ok) failures++;
+    Serial.printf("  %-12s max err %.3e at %-12g bound %.1e  %s\n", name, worst, worst_x, bound,
+                  ok ? "PASS" : "FAIL");
+}
+
+static double ref_exp(double x) { return exp(x); }
+static double ref_log2(double x) { return log2(x); }
+static double ref_rsqrt(double x) { return 1.0 / sqrt(x); }
+static double ref_silu(double x) { return x / (1.0 + exp(-x)); }
+
+// Linear sweep over [lo, hi]
+static void sweep_linear(const char* name, FastFn fast, RefFn ref, float lo, float hi, int steps,
+                         double floor, float bound) {
+    double worst = 0;
+    float worst_x = lo;
+    for (int i = 0; i <= steps; i++) {
+        float x = lo + (hi - lo) * i / steps;
+        worst = worst_error(fast, ref, x, floor, &worst_x, worst);
+    }
+    report(name, worst, worst_x, bound);
+}
+
+// Every stride-th float from FLT_MIN to FLT_MAX (covers every exponent)
+static void sweep_bits(const char* name, FastFn fast, RefFn ref, uint32_t stride, double floor,
+                       float bound) {
+    double worst = 0;
+    float worst_x = 1.0f;
+    for (uint32_t u = 0x00800000; u < 0x7F800000; u += stride) {
+        float x;
+        memcpy(&x, &u, 4);
+        worst = worst_error(fast, ref, x, floor, &worst_x, worst);
+    }
+    report(name, worst, worst_x, bound);
+}
+
+static void check_arrays() {
+    static float x[TIMING_N], gate[TIMING_N], out[TIMING_N];
+    for (int i = 0; i < TIMING_N; i++) {
+        x[i] = (random(20001) - 10000) / 1000.0f;       // [-10, 10]
+        gate[i] = (random(20001) - 10000) / 10000.0f;
+    }
+
+    // Softmax normalizer
+    double ref_sum = 0;
+    for (int i = 0; i < TIMING_N; i++) ref_sum += exp((double)x[i] - 10.0);
+    memcpy(out, x, sizeof(out));
+    double sum = fast_exp_shift_sum(out, TIMING_N, 10.0f);
+    report("exp_sum", fabs(sum - ref_sum) / ref_sum, 10.0f, 1e-5f);
+
+    double worst = 0;
+    float worst_x = 0;
+    memcpy(out, x, sizeof(out));
+    fast_silu_mul(out, gate, TIMING_N);
+    for (int i = 0; i < TIMING_N; i++) {
+        double r = ref_silu(x[i]) * gate[i];
+        double err = fabs(out[i] - r) / (fabs(r) > 1.0 ? fabs(r) : 1.0);
+        if (err > worst) {
+            worst = err;
+            worst_x = x[i];
+        }
+    }
+    report("silu_mul", worst, worst_x, 2 * FAST_SILU_MAX_ERR);
+
+    // Mel log: power sums from 0 up to ~1e4
+    worst = 0;
+    for (int i = 0; i < TIMING_N; i++) x[i] = fabsf(x[i]) * fabsf(x[i]) * x[i] * x[i];
+    fast_log10_array(out, x, TIMING_N, 1e-10f);
+    for (int i = 0; i < TIMING_N; i++) {
+        double r = log10((double)x[i] + 1e-10);
+        double err = fabs(out[i] - r) / (fabs(r) > 1.0 ? fabs(r) : 1.0);
+        if (err > worst) {
+            worst = err;
+            worst_x = x[i];
+        }
+    }
+    report("log10_array", worst, worst_x, 2 * FAST_LOG2_MAX_ERR);
+}
+
+// ns per element, fast vs libm (float)
+static void time_pair(const char* name, FastFn fast, float (*libm)(float), float lo, float hi) {
+    static float in[TIMING_N];
+    for (int i = 0; i < TIMING_N; i++) in[i] = lo + (hi - lo) * i / TIMING_N;
+
+    volatile float sink = 0;
+    float acc = 0;
+    uint32_t t0 = micros();
+    for (int i = 0; i < TIMING_N; i++) acc += fast(in[i]);
+    uint32_t t_fast = micros() - t0;
+    sink = acc;
+
+    acc = 0;
+    t0 = micros();
+    for (int i = 0; i < TIMING_N; i++) acc += libm(in[i]);
+    uint32_t t_libm = micros() - t0;
+    sink = acc;
+    (void)sink;
+
+    Serial.printf("  %-12s fast %7.1f ns  libm %7.1f ns  %5.2fx\n", name,
+                  t_fast * 1000.0f / TIMING_N, t_libm * 1000.0f / TIMING_N,
+                  t_fast > 0 ? (float)t_libm / t_fast : 0.0f);
+}
+
+static float libm_rsqrt(float x) { return 1.0f / sqrtf(x); }
+static float libm_silu(float x) { return x / (1.0f + expf(-x)); }
+
+void run_tests() {
+    failures = 0;
+
+    Serial.println("\nAccuracy vs double libm:");
+    sweep_linear("fast_expf", fast_expf, ref_exp, -87.0f, 88.0f, 200000, 0.0, FAST_EXP_MAX_REL_ERR);
+    sweep_bits("fast_log2f", fast_log2f, ref_log2, 1021, 1.0, FAST_LOG2_MAX_ERR);
+    sweep_bits("fast_rsqrtf", fast_rsqrtf, ref_rsqrt, 1021, 0.0, FAST_RSQRT_MAX_REL_ERR);
+    sweep_linear("fast_siluf", fast_siluf, ref_silu, -87.0f, 88.0f, 200000, 1.0, FAST_SILU_MAX_ERR);
+    check_arrays();
+
+    Serial.println("\nSpeed (per element):");
+    time_pair("exp", fast_expf, expf, -20.0f, 20.0f);
+    time_pair("log2", fast_log2f, log2f, 1e-6f, 1e6f);
+    time_pair("rsqrt", fast_rsqrtf, libm_rsqrt, 1e-6f, 1e6f);
+    time_pair("silu", fast_siluf, libm_silu, -20.0f, 20.0f);
+
+    if (failures == 0) {
+        Serial.println("\nALL PASS");
+    } else {
+        Serial.printf("\nFAILED: %d checks\n", failures);
+    }
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n========================================");
+    Serial.println("Fast Math Test");
+    Serial.println("========================================");
+
+    randomSeed(42);
+    run_tests();
+}
+
+void loop() {
+    if (Serial.available()) {
+        while (Serial.available()) Serial.read();
+        run_tests();
+    }
+    delay(50);
+}
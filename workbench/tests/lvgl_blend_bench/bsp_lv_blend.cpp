@@ -0,0 +1,301 @@
+// bsp_lv_blend.cpp - Word-wide RGB565 fill and blend kernels
+// Arduino builds with -Os, which neither unrolls nor schedules these loops
+#pragma GCC optimize("O2")
+
+#include "bsp_lv_blend.h"
+#include <string.h>
+
+#define RGB565_SPREAD 0x07E0F81Fu   // Green moved up 16 bits, gaps above every channel
+
+#define BLEND565_OPA_MAX 253        // LV_OPA_MAX: opacity at or above this counts as cover
+
+// One RGB565 pixel with green moved out of the way, so red/blue and green
+// are mixed by a single 32-bit multiply
+static inline uint32_t spread(uint32_t c) {
+  return (c | (c << 16)) & RGB565_SPREAD;
+}
+
+// lv_color_mix() on spread colors, a5 = (opa + 4) >> 3
+static inline uint32_t mix_spread(uint32_t f, uint32_t b, uint32_t a5) {
+  uint32_t r = ((((f - b) * a5) >> 5) + b) & RGB565_SPREAD;
+  return (r | (r >> 16)) & 0xFFFF;
+}
+
+static inline uint32_t alpha5(uint32_t opa) {
+  return (opa + 4) >> 3;
+}
+
+// Byte swap both pixels of a pair in one go
+static inline uint32_t swap_pair(uint32_t v) {
+  return ((v & 0x00FF00FFu) << 8) | ((v >> 8) & 0x00FF00FFu);
+}
+
+static inline uint32_t swap16(uint32_t v) {
+  return ((v << 8) | (v >> 8)) & 0xFFFF;
+}
+
+template<bool SWAP> static inline uint32_t native(uint32_t px) {
+  return SWAP ? swap16(px) : px;
+}
+
+// A stored pixel pair mixed over a stored pixel pair with one alpha per pixel
+template<bool SWAP> static inline uint32_t mix_pair(uint32_t fg, uint32_t bg, uint32_t a0, uint32_t a1) {
+  if (SWAP) {
+    fg = swap_pair(fg);
+    bg = swap_pair(bg);
+  }
+  uint32_t lo = mix_spread(spread(fg & 0xFFFF), spread(bg & 0xFFFF), a0);
+  uint32_t hi = mix_spread(spread(fg >> 16), spread(bg >> 16), a1);
+  uint32_t r = lo | (hi << 16);
+  return SWAP ? swap_pair(r) : r;
+}
+
+// A constant color (already spread) over a stored pixel pair
+template<bool SWAP> static inline uint32_t mix_color_pair(uint32_t fs, uint32_t bg, uint32_t a0, uint32_t a1) {
+  if (SWAP) bg = swap_pair(bg);
+  uint32_t lo = mix_spread(fs, spread(bg & 0xFFFF), a0);
+  uint32_t hi = mix_spread(fs, spread(bg >> 16), a1);
+  uint32_t r = lo | (hi << 16);
+  return SWAP ? swap_pair(r) : r;
+}
+
+template<bool SWAP> static inline uint16_t mix_color_px(uint32_t fs, uint32_t bg, uint32_t a5) {
+  return (uint16_t)native<SWAP>(mix_spread(fs, spread(native<SWAP>(bg)), a5));
+}
+
+template<bool SWAP> static inline uint16_t mix_px(uint32_t fg, uint32_t bg, uint32_t a5) {
+  uint32_t r = mix_spread(spread(native<SWAP>(fg)), spread(native<SWAP>(bg)), a5);
+  return (uint16_t)native<SWAP>(r);
+}
+
+// Per-pixel opacity of the masked paths, with LVGL's thresholds
+static inline uint32_t fill_alpha(uint32_t m, uint32_t opa) {
+  if (opa >= BLEND565_OPA_MAX) return m;
+  return m == 255 ? opa : (m * opa) >> 8;
+}
+
+static inline uint32_t map_alpha(uint32_t m, uint32_t opa) {
+  if (opa > BLEND565_OPA_MAX) return m;
+  return m >= BLEND565_OPA_MAX ? opa : (opa * m) >> 8;
+}
+
+// Pixels before the first 4-byte boundary of a row
+static inline int head_pixels(const uint16_t *d, int w) {
+  return ((uintptr_t)d & 2) && w > 0 ? 1 : 0;
+}
+
+// Two pixels from a 2-byte aligned source
+static inline uint32_t load_pair(const uint16_t *s) {
+  return s[0] | ((uint32_t)s[1] << 16);
+}
+
+// Four pixels as two aligned words, or as pixel, aligned word, pixel
+static inline void store4(uint16_t *d, bool aligned, uint32_t c32) {
+  if (aligned) {
+    ((uint32_t *)d)[0] = c32;
+    ((uint32_t *)d)[1] = c32;
+  } else {
+    d[0] = (uint16_t)c32;
+    *(uint32_t *)(d + 1) = c32;
+    d[3] = (uint16_t)c32;
+  }
+}
+
+static inline void copy4(uint16_t *d, bool aligned, const uint16_t *s) {
+  if (aligned) {
+    ((uint32_t *)d)[0] = load_pair(s);
+    ((uint32_t *)d)[1] = load_pair(s + 2);
+  } else {
+    d[0] = s[0];
+    *(uint32_t *)(d + 1) = load_pair(s + 1);
+    d[3] = s[3];
+  }
+}
+
+void blend565_fill(uint16_t *dst, int dst_stride, int w, int h, uint16_t color) {
+  uint32_t c32 = color | ((uint32_t)color << 16);
+  for (int y = 0; y < h; y++, dst += dst_stride) {
+    uint16_t *d = dst;
+    int n = w;
+    if (head_pixels(d, n)) {
+      *d++ = color;
+      n--;
+    }
+    uint32_t *d32 = (uint32_t *)d;
+    for (; n >= 8; n -= 8, d32 += 4) {
+      d32[0] = c32;
+      d32[1] = c32;
+      d32[2] = c32;
+      d32[3] = c32;
+    }
+    for (; n >= 2; n -= 2) *d32++ = c32;
+    if (n) *(uint16_t *)d32 = color;
+  }
+}
+
+template<bool SWAP> static void fill_opa(uint16_t *dst, int dst_stride, int w, int h, uint16_t color, uint8_t opa) {
+  uint32_t fs = spread(native<SWAP>(color));
+  uint32_t a5 = alpha5(opa);
+  // Flat backgrounds repeat the same pair, so most pairs are a compare and a store
+  uint32_t last_in = 0;
+  uint32_t last_out = mix_color_pair<SWAP>(fs, 0, a5, a5);
+  for (int y = 0; y < h; y++, dst += dst_stride) {
+    uint16_t *d = dst;
+    int n = w;
+    if (head_pixels(d, n)) {
+      *d = mix_color_px<SWAP>(fs, *d, a5);
+      d++;
+      n--;
+    }
+    uint32_t *d32 = (uint32_t *)d;
+    for (; n >= 2; n -= 2, d32++) {
+      uint32_t bg = *d32;
+      if (bg != last_in) {
+        last_in = bg;
+        last_out = mix_color_pair<SWAP>(fs, bg, a5, a5);
+      }
+      *d32 = last_out;
+    }
+    if (n) {
+      d = (uint16_t *)d32;
+      *d = mix_color_px<SWAP>(fs, *d, a5);
+    }
+  }
+}
+
+template<bool SWAP> static void fill_mask(uint16_t *dst, int dst_stride, int w, int h, uint16_t color, uint8_t opa,
+                                          const uint8_t *mask, int mask_stride) {
+  uint32_t fs = spread(native<SWAP>(color));
+  uint32_t c32 = color | ((uint32_t)color << 16);
+  // Fully covered pixels are plain stores only at full opacity
+  bool cover = opa >= BLEND565_OPA_MAX;
+  for (int y = 0; y < h; y++, dst += dst_stride, mask += mask_stride) {
+    uint16_t *d = dst;
+    const uint8_t *m = mask;
+    int n = w;
+    for (; n > 0 && ((uintptr_t)m & 3); n--, m++, d++) {
+      if (*m) *d = mix_color_px<SWAP>(fs, *d, alpha5(fill_alpha(*m, opa)));
+    }
+    // Four pixels per mask word: two aligned pairs, or pixel, pair, pixel
+    bool aligned = !((uintptr_t)d & 2);
+    for (; n >= 4; n -= 4, m += 4, d += 4) {
+      uint32_t m32 = *(const uint32_t *)m;
+      if (m32 == 0) continue;
+      if (m32 == 0xFFFFFFFF && cover) {
+        store4(d, aligned, c32);
+        continue;
+      }
+      uint32_t a0 = alpha5(fill_alpha(m32 & 0xFF, opa));
+      uint32_t a1 = alpha5(fill_alpha((m32 >> 8) & 0xFF, opa));
+      uint32_t a2 = alpha5(fill_alpha((m32 >> 16) & 0xFF, opa));
+      uint32_t a3 = alpha5(fill_alpha(m32 >> 24, opa));
+      if (aligned) {
+        uint32_t *d32 = (uint32_t *)d;
+        d32[0] = mix_color_pair<SWAP>(fs, d32[0], a0, a1);
+        d32[1] = mix_color_pair<SWAP>(fs, d32[1], a2, a3);
+      } else {
+        uint32_t *d32 = (uint32_t *)(d + 1);
+        d[0] = mix_color_px<SWAP>(fs, d[0], a0);
+        *d32 = mix_color_pair<SWAP>(fs, *d32, a1, a2);
+        d[3] = mix_color_px<SWAP>(fs, d[3], a3);
+      }
+    }
+    for (; n > 0; n--, m++, d++) {
+      if (*m) *d = mix_color_px<SWAP>(fs, *d, alpha5(fill_alpha(*m, opa)));
+    }
+  }
+}
+
+template<bool SWAP> static void map_opa(uint16_t *dst, int dst_stride, const uint16_t *src, int src_stride,
+                                        int w, int h, uint8_t opa) {
+  uint32_t a5 = alpha5(opa);
+  for (int y = 0; y < h; y++, dst += dst_stride, src += src_stride) {
+    uint16_t *d = dst;
+    const uint16_t *s = src;
+    int n = w;
+    if (head_pixels(d, n)) {
+      *d = mix_px<SWAP>(*s, *d, a5);
+      d++;
+      s++;
+      n--;
+    }
+    uint32_t *d32 = (uint32_t *)d;
+    for (; n >= 2; n -= 2, s += 2, d32++) {
+      *d32 = mix_pair<SWAP>(load_pair(s), *d32, a5, a5);
+    }
+    if (n) {
+      d = (uint16_t *)d32;
+      *d = mix_px<SWAP>(*s, *d, a5);
+    }
+  }
+}
+
+template<bool SWAP> static void map_mask(uint16_t *dst, int dst_stride, const uint16_t *src, int src_stride,
+                                         int w, int h, uint8_t opa, const uint8_t *mask, int mask_stride) {
+  // Mask 255 copies the source only when it also maps to full opacity
+  bool cover = map_alpha(255, opa) == 255;
+  for (int y = 0; y < h; y++, dst += dst_stride, src += src_stride, mask += mask_stride) {
+    uint16_t *d = dst;
+    const uint16_t *s = src;
+    const uint8_t *m = mask;
+    int n = w;
+    for (; n > 0 && ((uintptr_t)m & 3); n--, m++, s++, d++) {
+      if (*m) *d = mix_px<SWAP>(*s, *d, alpha5(map_alpha(*m, opa)));
+    }
+    bool aligned = !((uintptr_t)d & 2);
+    for (; n >= 4; n -= 4, m += 4, s += 4, d += 4) {
+      uint32_t m32 = *(const uint32_t *)m;
+      if (m32 == 0) continue;
+      if (m32 == 0xFFFFFFFF && cover) {
+        copy4(d, aligned, s);
+        continue;
+      }
+      uint32_t a0 = alpha5(map_alpha(m32 & 0xFF, opa));
+      uint32_t a1 = alpha5(map_alpha((m32 >> 8) & 0xFF, opa));
+      uint32_t a2 = alpha5(map_alpha((m32 >> 16) & 0xFF, opa));
+      uint32_t a3 = alpha5(map_alpha(m32 >> 24, opa));
+      if (aligned) {
+        uint32_t *d32 = (uint32_t *)d;
+        d32[0] = mix_pair<SWAP>(load_pair(s), d32[0], a0, a1);
+        d32[1] = mix_pair<SWAP>(load_pair(s + 2), d32[1], a2, a3);
+      } else {
+        uint32_t *d32 = (uint32_t *)(d + 1);
+        d[0] = mix_px<SWAP>(s[0], d[0], a0);
+        *d32 = mix_pair<SWAP>(load_pair(s + 1), *d32, a1, a2);
+        d[3] = mix_px<SWAP>(s[3], d[3], a3);
+      }
+    }
+    for (; n > 0; n--, m++, s++, d++) {
+      if (*m) *d = mix_px<SWAP>(*s, *d, alpha5(map_alpha(*m, opa)));
+    }
+  }
+}
+
+void blend565_fill_opa(uint16_t *dst, int dst_stride, int w, int h, uint16_t color, uint8_t opa, bool swap) {
+  if (swap) fill_opa<true>(dst, dst_stride, w, h, color, opa);
+  else fill_opa<false>(dst, dst_stride, w, h, color, opa);
+}
+
+void blend565_fill_mask(uint16_t *dst, int dst_stride, int w, int h, uint16_t color, uint8_t opa,
+                        const uint8_t *mask, int mask_stride, bool swap) {
+  if (swap) fill_mask<true>(dst, dst_stride, w, h, color, opa, mask, mask_stride);
+  else fill_mask<false>(dst, dst_stride, w, h, color, opa, mask, mask_stride);
+}
+
+void blend565_copy(uint16_t *dst, int dst_stride, const uint16_t *src, int src_stride, int w, int h) {
+  for (int y = 0; y < h; y++, dst += dst_stride, src += src_stride) {
+    memcpy(dst, src, w * sizeof(uint16_t));
+  }
+}
+
+void blend565_map_opa(uint16_t *dst, int dst_stride, const uint16_t *src, int src_stride, int w, int h,
+                      uint8_t opa, bool swap) {
+  if (swap) map_opa<true>(dst, dst_stride, src, src_stride, w, h, opa);
+  else map_opa<false>(dst, dst_stride, src, src_stride, w, h, opa);
+}
+
+void blend565_map_mask(uint16_t *dst, int dst_stride, const uint16_t *src, int src_stride, int w, int h,
+                       uint8_t opa, const uint8_t *mask, int mask_stride, bool swap) {
+  if (swap) map_mask<true>(dst, dst_stride, src, src_stride, w, h, opa, mask, mask_stride);
+  else map_mask<false>(dst, dst_stride, src, src_stride, w, h, opa, mask, mask_stride);
+}
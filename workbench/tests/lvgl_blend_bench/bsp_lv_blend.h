@@ -0,0 +1,40 @@
+// bsp_lv_blend.h - Word-wide RGB565 fill and blend kernels for the LVGL draw buffer
+// LVGL's generic blend code works one 16-bit pixel at a time and, with
+// LV_COLOR_16_SWAP, swaps the bytes of both colors in and out of every
+// lv_color_mix() call. These kernels move two pixels per aligned 32-bit
+// load/store, swap a pixel pair with one mask-and-shift, skip or copy four
+// pixels per mask word, and reuse the last result when the destination
+// repeats (flat backgrounds). They round exactly like lv_color_mix(), so a
+// frame drawn with them matches a stock frame pixel for pixel, except
+// blend565_fill_opa (see below).
+//
+// Pixels are RGB565 as stored in the buffer: big-endian when swap is true.
+// Strides are in pixels. opa and mask follow LVGL: 0 = transparent,
+// 255 = cover.
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Solid fill
+void blend565_fill(uint16_t *dst, int dst_stride, int w, int h, uint16_t color);
+
+// Fill with opacity. Mixes like lv_color_mix(); LVGL's fill_normal() uses a
+// premultiplied divide by 255 here instead, which can differ by 1 LSB, and
+// at opa 252 its rounded opacity wraps to 0 and the fill does nothing.
+void blend565_fill_opa(uint16_t *dst, int dst_stride, int w, int h, uint16_t color, uint8_t opa, bool swap);
+
+// Fill through an 8-bit mask (anti-aliased edges, rounded corners, text)
+void blend565_fill_mask(uint16_t *dst, int dst_stride, int w, int h, uint16_t color, uint8_t opa,
+                        const uint8_t *mask, int mask_stride, bool swap);
+
+// Image blit
+void blend565_copy(uint16_t *dst, int dst_stride, const uint16_t *src, int src_stride, int w, int h);
+
+// Image blit with opacity
+void blend565_map_opa(uint16_t *dst, int dst_stride, const uint16_t *src, int src_stride, int w, int h,
+                      uint8_t opa, bool swap);
+
+// Image blit through an 8-bit mask
+void blend565_map_mask(uint16_t *dst, int dst_stride, const uint16_t *src, int src_stride, int w, int h,
+                       uint8_t opa, const uint8_t *mask, int mask_stride, bool swap);
@@ -0,0 +1,445 @@
+// lvgl_blend_bench.ino - Word-wide RGB565 blend kernels vs LVGL 8.4's stock blend loops
+// Times each blend step the LVGL port (01_factory) runs on its 320x240 draw
+// buffer in PSRAM, with LV_COLOR_16_SWAP pixels as configured there:
+//   fill      solid fill (screen and widget backgrounds)
+//   fill opa  translucent fill, over a flat and a noisy background
+//   fill mask anti-aliased shape or text over the background
+//   map       image blit, opaque, with opacity and through a mask
+// The stock side is a transcription of fill_normal(), map_normal(),
+// lv_color_fill() and lv_color_mix() from lv_draw_sw_blend.c / lv_color.{c,h}.
+// A random-rectangle sweep then checks both against each other at every
+// alignment, opacity and byte order.
+// bsp_lv_blend.{h,cpp} are copies from the 01_factory example.
+
+#include <Arduino.h>
+#include "bsp_lv_blend.h"
+
+#define BENCH_W             320
+#define BENCH_H             240
+#define BENCH_TARGET_PX     4000000     // Pixels per timed run (sets repetitions)
+#define BENCH_SWEEP_RUNS    2000
+#define OPA_MAX             253         // LV_OPA_MAX
+
+typedef struct {
+    const char* name;
+    const uint16_t* bg;
+    bool map;
+    uint8_t opa;
+    const uint8_t* mask;
+} Case;             // One timed full-screen blend
+
+// ---- Stock LVGL, 16-bit color, LV_COLOR_MIX_ROUND_OFS 0 ----
+
+static inline uint16_t swap16(uint16_t v) {
+    return (uint16_t)((v << 8) | (v >> 8));
+}
+
+static uint16_t ref_mix(uint16_t c1, uint16_t c2, uint8_t mix, bool swap) {
+    if (swap) {
+        c1 = swap16(c1);
+        c2 = swap16(c2);
+    }
+    uint32_t m = ((uint32_t)mix + 4) >> 3;
+    uint32_t bg = ((uint32_t)c2 | ((uint32_t)c2 << 16)) & 0x7E0F81F;
+    uint32_t fg = ((uint32_t)c1 | ((uint32_t)c1 << 16)) & 0x7E0F81F;
+    uint32_t result = ((((fg - bg) * m) >> 5) + bg) & 0x7E0F81F;
+    uint16_t ret = (uint16_t)((result >> 16) | result);
+    return swap ? swap16(ret) : ret;
+}
+
+#define UDIV255(x) (((x) * 0x8081U) >> 0x17)
+
+static void ref_color_fill(uint16_t* buf, uint16_t color, uint32_t px_num) {
+    if ((uintptr_t)buf & 0x3) {
+        *buf++ = color;
+        px_num--;
+    }
+    uint32_t c32 = (uint32_t)color + ((uint32_t)color << 16);
+    uint32_t* buf32 = (uint32_t*)buf;
+    while (px_num > 16) {
+        for (int i = 0; i < 8; i++) *buf32++ = c32;
+        px_num -= 16;
+    }
+    buf = (uint16_t*)buf32;
+    while (px_num) {
+        *buf++ = color;
+        px_num--;
+    }
+}
+
+static void ref_fill(uint16_t* dest_buf, int dest_stride, int w, int h, uint16_t color, uint8_t opa,
+                     const uint8_t* mask, int mask_stride, bool swap) {
+    if (mask == nullptr) {
+        if (opa >= OPA_MAX) {
+            for (int y = 0; y < h; y++) {
+                ref_color_fill(dest_buf, color, w);
+                dest_buf += dest_stride;
+            }
+            return;
+        }
+        // lv_color_premult() / lv_color_mix_premult() on the bitfields
+        uint16_t last_dest = 0;
+        uint16_t last_res = ref_mix(color, last_dest, opa, swap);
+        opa = ((opa + 4) >> 3) << 3;
+        uint16_t c = swap ? swap16(color) : color;
+        uint32_t pr = (c >> 11) * opa, pg = ((c >> 5) & 0x3F) * opa, pb = (c & 0x1F) * opa;
+        uint32_t inv = 255 - opa;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                if (last_dest != dest_buf[x]) {
+                    last_dest = dest_buf[x];
+                    uint16_t d = swap ? swap16(last_dest) : last_dest;
+                    uint16_t r = (uint16_t)(UDIV255(pr + (d >> 11) * inv) << 11 |
+                                            UDIV255(pg + ((d >> 5) & 0x3F) * inv) << 5 |
+                                            UDIV255(pb + (d & 0x1F) * inv));
+                    last_res = swap ? swap16(r) : r;
+                }
+                dest_buf[x] = last_res;
+            }
+            dest_buf += dest_stride;
+        }
+        return;
+    }
+
+    if (opa >= OPA_MAX) {
+        uint32_t c32 = color + ((uint32_t)color << 16);
+        int x_end4 = w - 4;
+        for (int y = 0; y < h; y++) {
+#define FILL_NORMAL_MASK_PX()                                   \
+            if (*mask == 255) *dest_buf = color;                \
+            else *dest_buf = ref_mix(color, *dest_buf, *mask, swap); \
+            mask++;                                             \
+            dest_buf++;
+            int x;
+            for (x = 0; x < w && ((uintptr_t)mask & 0x3); x++) {
+                FILL_NORMAL_MASK_PX()
+            }
+            for (; x <= x_end4; x += 4) {
+                uint32_t mask32 = *(const uint32_t*)mask;
+                if (mask32 == 0xFFFFFFFF) {
+                    if ((uintptr_t)dest_buf & 0x3) {
+                        dest_buf[0] = color;
+                        *(uint32_t*)(dest_buf + 1) = c32;
+                        dest_buf[3] = color;
+                    } else {
+                        ((uint32_t*)dest_buf)[0] = c32;
+                        ((uint32_t*)dest_buf)[1] = c32;
+                    }
+                    dest_buf += 4;
+                    mask += 4;
+                } else if (mask32) {
+                    FILL_NORMAL_MASK_PX()
+                    FILL_NORMAL_MASK_PX()
+                    FILL_NORMAL_MASK_PX()
+                    FILL_NORMAL_MASK_PX()
+                } else {
+                    mask += 4;
+                    dest_buf += 4;
+                }
+            }
+            for (; x < w; x++) {
+                FILL_NORMAL_MASK_PX()
+            }
+#undef FILL_NORMAL_MASK_PX
+            dest_buf += dest_stride - w;
+            mask += mask_stride - w;
+        }
+        return;
+    }
+
+    uint16_t last_dest = dest_buf[0];
+    uint16_t last_res = dest_buf[0];
+    uint8_t last_mask = 0;
+    uint8_t opa_tmp = 0;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (*mask) {
+                if (*mask != last_mask) opa_tmp = *mask == 255 ? opa : (uint32_t)(*mask * opa) >> 8;
+                if (*mask != last_mask || last_dest != dest_buf[x]) {
+                    last_res = opa_tmp == 255 ? color : ref_mix(color, dest_buf[x], opa_tmp, swap);
+                    last_mask = *mask;
+                    last_dest = dest_buf[x];
+                }
+                dest_buf[x] = last_res;
+            }
+            mask++;
+        }
+        dest_buf += dest_stride;
+        mask += mask_stride - w;
+    }
+}
+
+static void ref_map(uint16_t* dest_buf, int dest_stride, const uint16_t* src_buf, int src_stride, int w, int h,
+                    uint8_t opa, const uint8_t* mask, int mask_stride, bool swap) {
+    if (mask == nullptr) {
+        for (int y = 0; y < h; y++) {
+            if (opa >= OPA_MAX) {
+                memcpy(dest_buf, src_buf, w * sizeof(uint16_t));
+            } else {
+                for (int x = 0; x < w; x++) dest_buf[x] = ref_mix(src_buf[x], dest_buf[x], opa, swap);
+            }
+            dest_buf += dest_stride;
+            src_buf += src_stride;
+        }
+        return;
+    }
+
+    if (opa > OPA_MAX) {
+        int x_end4 = w - 4;
+        for (int y = 0; y < h; y++) {
+            const uint8_t* mask_tmp_x = mask;
+#define MAP_NORMAL_MASK_PX(x)                                                       \
+            if (*mask_tmp_x) {                                                      \
+                if (*mask_tmp_x == 255) dest_buf[x] = src_buf[x];                   \
+                else dest_buf[x] = ref_mix(src_buf[x], dest_buf[x], *mask_tmp_x, swap); \
+            }                                                                       \
+            mask_tmp_x++;
+            int x;
+            for (x = 0; x < w && ((uintptr_t)mask_tmp_x & 0x3); x++) {
+                MAP_NORMAL_MASK_PX(x)
+            }
+            const uint32_t* mask32 = (const uint32_t*)mask_tmp_x;
+            for (; x < x_end4; x += 4) {
+                if (*mask32) {
+                    if (*mask32 == 0xFFFFFFFF) {
+                        dest_buf[x] = src_buf[x];
+                        dest_buf[x + 1] = src_buf[x + 1];
+                        dest_buf[x + 2] = src_buf[x + 2];
+                        dest_buf[x + 3] = src_buf[x + 3];
+                    } else {
+                        mask_tmp_x = (const uint8_t*)mask32;
+                        MAP_NORMAL_MASK_PX(x)
+                        MAP_NORMAL_MASK_PX(x + 1)
+                        MAP_NORMAL_MASK_PX(x + 2)
+                        MAP_NORMAL_MASK_PX(x + 3)
+                    }
+                }
+                mask32++;
+            }
+            mask_tmp_x = (const uint8_t*)mask32;
+            for (; x < w; x++) {
+                MAP_NORMAL_MASK_PX(x)
+            }
+#undef MAP_NORMAL_MASK_PX
+            dest_buf += dest_stride;
+            src_buf += src_stride;
+            mask += mask_stride;
+        }
+        return;
+    }
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (mask[x]) {
+                uint8_t opa_tmp = mask[x] >= OPA_MAX ? opa : ((opa * mask[x]) >> 8);
+                dest_buf[x] = ref_mix(src_buf[x], dest_buf[x], opa_tmp, swap);
+            }
+        }
+        dest_buf += dest_stride;
+        src_buf += src_stride;
+        mask += mask_stride;
+    }
+}
+
+// ---- Kernels, dispatched like bsp_lv_draw_blend() ----
+
+static void new_fill(uint16_t* dst, int stride, int w, int h, uint16_t color, uint8_t opa,
+                     const uint8_t* mask, int mask_stride, bool swap) {
+    if (mask) blend565_fill_mask(dst, stride, w, h, color, opa, mask, mask_stride, swap);
+    else if (opa >= OPA_MAX) blend565_fill(dst, stride, w, h, color);
+    else blend565_fill_opa(dst, stride, w, h, color, opa, swap);
+}
+
+static void new_map(uint16_t* dst, int stride, const uint16_t* src, int src_stride, int w, int h,
+                    uint8_t opa, const uint8_t* mask, int mask_stride, bool swap) {
+    if (mask) blend565_map_mask(dst, stride, src, src_stride, w, h, opa, mask, mask_stride, swap);
+    else if (opa >= OPA_MAX) blend565_copy(dst, stride, src, src_stride, w, h);
+    else blend565_map_opa(dst, stride, src, src_stride, w, h, opa, swap);
+}
+
+// ---- Test data ----
+
+static uint16_t* bg_flat;       // Screen background, one color
+static uint16_t* bg_noise;      // Photo-like background
+static uint16_t* image;         // Source image
+static uint8_t* mask_shape;     // Rounded rectangle: covered inside, anti-aliased edge
+static uint8_t* mask_noise;     // Random coverage (text-like worst case)
+static uint16_t* dst_ref;
+static uint16_t* dst_new;
+
+static uint16_t random565() {
+    return (uint16_t)random(0x10000);
+}
+
+static bool alloc_buffers() {
+    size_t px = BENCH_W * BENCH_H;
+    bg_flat = (uint16_t*)ps_malloc(px * 2);
+    bg_noise = (uint16_t*)ps_malloc(px * 2);
+    image = (uint16_t*)ps_malloc(px * 2);
+    mask_shape = (uint8_t*)ps_malloc(px);
+    mask_noise = (uint8_t*)ps_malloc(px);
+    dst_ref = (uint16_t*)ps_malloc(px * 2);
+    dst_new = (uint16_t*)ps_malloc(px * 2);
+    if (!bg_flat || !bg_noise || !image || !mask_shape || !mask_noise || !dst_ref || !dst_new) return false;
+
+    for (size_t i = 0; i < px; i++) {
+        bg_flat[i] = swap16(0x18E3);
+        bg_noise[i] = random565();
+        image[i] = random565();
+        mask_noise[i] = random(4) == 0 ? 0 : (random(3) == 0 ? 255 : random(256));
+    }
+
+    // Rounded rectangle with a 1 px anti-aliased edge, 24 px radius
+    const float r = 24.0f;
+    for (int y = 0; y < BENCH_H; y++) {
+        for (int x = 0; x < BENCH_W; x++) {
+            float cx = x + 0.5f < r ? r : (x + 0.5f > BENCH_W - r ? BENCH_W - r : x + 0.5f);
+            float cy = y + 0.5f < r ? r : (y + 0.5f > BENCH_H - r ? BENCH_H - r : y + 0.5f);
+            float d = sqrtf((x + 0.5f - cx) * (x + 0.5f - cx) + (y + 0.5f - cy) * (y + 0.5f - cy));
+            float cover = r + 0.5f - d;
+            mask_shape[y * BENCH_W + x] = cover >= 1.0f ? 255 : (cover <= 0.0f ? 0 : (uint8_t)(cover * 255));
+        }
+    }
+    return true;
+}
+
+// Largest difference of any channel, in LSBs
+static int max_diff(const uint16_t* a, const uint16_t* b, size_t n, bool swap) {
+    int m = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint16_t x = swap ? swap16(a[i]) : a[i];
+        uint16_t y = swap ? swap16(b[i]) : b[i];
+        int dr = abs((x >> 11) - (y >> 11));
+        int dg = abs(((x >> 5) & 0x3F) - ((y >> 5) & 0x3F));
+        int db = abs((x & 0x1F) - (y & 0x1F));
+        if (dr > m) m = dr;
+        if (dg > m) m = dg;
+        if (db > m) m = db;
+    }
+    return m;
+}
+
+// Microseconds per full-screen blend. Repetitions blend over the previous
+// output (as successive frames do), and both sides start from the same
+// background.
+static float time_case(const Case* c, bool use_new, uint16_t* dst) {
+    memcpy(dst, c->bg, BENCH_W * BENCH_H * 2);
+    int reps = BENCH_TARGET_PX / (BENCH_W * BENCH_H);
+    if (reps < 3) reps = 3;
+    uint16_t color = swap16(0x4A9F);
+    uint32_t t0 = micros();
+    for (int r = 0; r < reps; r++) {
+        if (c->map) {
+            if (use_new) new_map(dst, BENCH_W, image, BENCH_W, BENCH_W, BENCH_H, c->opa, c->mask, BENCH_W, true);
+            else ref_map(dst, BENCH_W, image, BENCH_W, BENCH_W, BENCH_H, c->opa, c->mask, BENCH_W, true);
+        } else {
+            if (use_new) new_fill(dst, BENCH_W, BENCH_W, BENCH_H, color, c->opa, c->mask, BENCH_W, true);
+            else ref_fill(dst, BENCH_W, BENCH_W, BENCH_H, color, c->opa, c->mask, BENCH_W, true);
+        }
+    }
+    return (float)(micros() - t0) / reps;
+}
+
+static void bench_case(const Case* c) {
+    float ref_us = time_case(c, false, dst_ref);
+    float new_us = time_case(c, true, dst_new);
+    int diff = max_diff(dst_ref, dst_new, BENCH_W * BENCH_H, true);
+    float mpx = (float)BENCH_W * BENCH_H / new_us;
+    Serial.printf("  %-20s %8.0f %8.0f  %5.2fx  %6.1f Mpx/s  diff %d\n",
+                  c->name, ref_us, new_us, ref_us / new_us, mpx, diff);
+}
+
+// Random rectangles at every alignment, opacity and byte order; fill_opa
+// may differ by 1 LSB (premultiplied divide in the stock fill)
+static void sweep() {
+    int bad = 0, worst = 0;
+    for (int run = 0; run < BENCH_SWEEP_RUNS; run++) {
+        int w = 1 + random(64), h = 1 + random(8);
+        int x = random(BENCH_W - w + 1), y = random(BENCH_H - h + 1);
+        int kind = random(6);
+        bool swap = random(2);
+        bool map = kind >= 3;
+        const uint8_t* mask = (kind % 3 == 0) ? nullptr : (kind % 3 == 1 ? mask_noise : mask_shape);
+        int mask_off = random(BENCH_W * BENCH_H - BENCH_W * h);
+        uint8_t opa_choices[] = {255, 254, 253, 252, 128, 64, 3, (uint8_t)random(256)};
+        uint8_t opa = opa_choices[random(8)];
+        uint16_t color = random565();
+        int src_off = random(BENCH_W * BENCH_H - BENCH_W * h);
+
+        memcpy(dst_ref, bg_noise, BENCH_W * BENCH_H * 2);
+        memcpy(dst_new, bg_noise, BENCH_W * BENCH_H * 2);
+        size_t off = y * BENCH_W + x;
+        const uint8_t* m = mask ? mask + mask_off : nullptr;
+        if (map) {
+            ref_map(dst_ref + off, BENCH_W, image + src_off, w + 3, w, h, opa, m, BENCH_W, swap);
+            new_map(dst_new + off, BENCH_W, image + src_off, w + 3, w, h, opa, m, BENCH_W, swap);
+        } else {
+            ref_fill(dst_ref + off, BENCH_W, w, h, color, opa, m, BENCH_W, swap);
+            new_fill(dst_new + off, BENCH_W, w, h, color, opa, m, BENCH_W, swap);
+        }
+        int diff = max_diff(dst_ref, dst_new, BENCH_W * BENCH_H, swap);
+        bool fill_opa = !map && !mask && opa < OPA_MAX;
+        // Stock fill_normal() rounds opa 252 up to 256, which wraps to 0 in
+        // an lv_opa_t and leaves the background untouched
+        if (fill_opa && opa == 252) continue;
+        if (diff > (fill_opa ? 1 : 0)) {
+            if (bad < 5) {
+                Serial.printf("  MISMATCH %s %dx%d at %d,%d opa %d mask %s swap %d: %d LSB\n",
+                              map ? "map" : "fill", w, h, x, y, opa,
+                              mask ? (mask == mask_noise ? "noise" : "shape") : "none", swap, diff);
+            }
+            bad++;
+        }
+        if (diff > worst) worst = diff;
+    }
+    Serial.printf("\nSweep: %d random blends, %d mismatches, largest difference %d LSB\n",
+                  BENCH_SWEEP_RUNS, bad, worst);
+}
+
+void run_bench() {
+    const Case cases[] = {
+        {"fill",                bg_flat,  false, 255, nullptr},
+        {"fill opa 50% flat",   bg_flat,  false, 128, nullptr},
+        {"fill opa 50% noise",  bg_noise, false, 128, nullptr},
+        {"fill mask shape",     bg_noise, false, 255, mask_shape},
+        {"fill mask noise",     bg_noise, false, 255, mask_noise},
+        {"fill mask opa 50%",   bg_noise, false, 128, mask_shape},
+        {"map",                 bg_noise, true,  255, nullptr},
+        {"map opa 50%",         bg_noise, true,  128, nullptr},
+        {"map mask shape",      bg_noise, true,  255, mask_shape},
+        {"map mask opa 50%",    bg_noise, true,  128, mask_shape},
+    };
+
+    Serial.printf("\nCPU %u MHz, %dx%d RGB565 (byte-swapped) in PSRAM\n", getCpuFrequencyMhz(), BENCH_W, BENCH_H);
+    Serial.println("  blend                  ref us   new us  speedup  throughput      max diff");
+    for (const Case& c : cases) {
+        bench_case(&c);
+    }
+    sweep();
+    Serial.println("\nSend any line to run again");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n========================================");
+    Serial.println("LVGL Blend Benchmark");
+    Serial.println("========================================");
+    Serial.printf("Free PSRAM: %d bytes\n", ESP.getFreePsram());
+
+    randomSeed(1234);
+    if (!alloc_buffers()) {
+        Serial.println("ERROR: No PSRAM for the test buffers");
+        while (true) delay(1000);
+    }
+    run_bench();
+}
+
+void loop() {
+    if (Serial.available()) {
+        while (Serial.available()) Serial.read();
+        run_bench();
+    }
+    delay(50);
+}
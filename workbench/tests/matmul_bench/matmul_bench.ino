@@ -0,0 +1,217 @@
+// matmul_bench.ino - Register-blocked matmul kernels vs ESP-DSP per-row dot products
+// Runs the stories15M matmul shapes (n inputs x d outputs) on one core with
+// the weights in PSRAM, as in llm_core:
+//   288x288 wq/wk/wv/wo, 288x768 w1/w3, 768x288 w2, 288x32000 classifier
+// f32 compares dsps_dotprod_f32_aes3 per row against matmul_rows_f32; q8
+// compares dot_q8 per row against matmul_rows_q8. The classifier does not
+// fit in PSRAM, so it runs on a row slice and is scaled to 32000 rows.
+// The batch table compares MATMUL_MAX_BATCH separate matmul_rows_f32 calls
+// against one matmul_rows_f32_batch call (batched decode in llm_core).
+// matmul_kernels.{h,cpp} are copies from 01_llm_inference_stories15m.
+
+#include <Arduino.h>
+#include <esp_dsp.h>
+#include "matmul_kernels.h"
+
+#define BENCH_MAX_WEIGHT_BYTES  (2 * 1024 * 1024)
+#define BENCH_TARGET_MACS       4000000     // Per timed run (sets repetitions)
+#define BENCH_Q8_GROUP          96          // stories15M flash image
+
+typedef struct {
+    const char* name;
+    int n;
+    int d;
+} Shape;
+
+static const Shape SHAPES[] = {
+    {"wq/wk/wv/wo", 288, 288},
+    {"w1/w3",       288, 768},
+    {"w2",          768, 288},
+    {"classifier",  288, 32000},
+};
+
+static void fill_random(float* v, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        v[i] = (random(20001) - 10000) / 10000.0f;
+    }
+}
+
+static float max_diff(const float* a, const float* b, int count) {
+    float m = 0.0f;
+    for (int i = 0; i < count; i++) {
+        float diff = fabsf(a[i] - b[i]);
+        if (diff > m) m = diff;
+    }
+    return m;
+}
+
+// Microseconds per full-shape call, scaled from rows actually run
+static float time_per_call(uint32_t elapsed_us, int reps, int rows, int d) {
+    return (float)elapsed_us / reps * d / rows;
+}
+
+static void print_row(const char* kind, const Shape* s, int rows, float ref_us, float blk_us, float err) {
+    float weight_bytes = (float)s->n * s->d * (strcmp(kind, "f32") == 0 ? 4 : 1);
+    Serial.printf("  %-11s %-3s %4dx%-5d %9.0f %9.0f  %5.2fx  %6.1f MB/s  err %.2e%s\n",
+                  s->name, kind, s->n, s->d, ref_us, blk_us, ref_us / blk_us,
+                  weight_bytes / blk_us, err, rows < s->d ? "  (scaled)" : "");
+}
+
+static bool bench_f32(const Shape* s) {
+    int rows = s->d;
+    if ((size_t)rows * s->n * sizeof(float) > BENCH_MAX_WEIGHT_BYTES) {
+        rows = BENCH_MAX_WEIGHT_BYTES / (s->n * sizeof(float)) / MATMUL_ROW_BLOCK * MATMUL_ROW_BLOCK;
+    }
+    float* w = (float*)ps_malloc((size_t)rows * s->n * sizeof(float));
+    float* x = (float*)ps_malloc(s->n * sizeof(float));
+    float* out_ref = (float*)ps_malloc(rows * sizeof(float));
+    float* out_blk = (float*)ps_malloc(rows * sizeof(float));
+    if (!w || !x || !out_ref || !out_blk) {
+        Serial.printf("ERROR: No PSRAM for %s f32\n", s->name);
+        free(w); free(x); free(out_ref); free(out_blk);
+        return false;
+    }
+    fill_random(w, (size_t)rows * s->n);
+    fill_random(x, s->n);
+
+    int reps = BENCH_TARGET_MACS / (rows * s->n);
+    if (reps < 3) reps = 3;
+    matmul_rows_f32_dsp(out_ref, x, w, s->n, 0, rows);
+    uint32_t t0 = micros();
+    for (int r = 0; r < reps; r++) matmul_rows_f32_dsp(out_ref, x, w, s->n, 0, rows);
+    float ref_us = time_per_call(micros() - t0, reps, rows, s->d);
+
+    matmul_rows_f32(out_blk, x, w, s->n, 0, rows);
+    t0 = micros();
+    for (int r = 0; r < reps; r++) matmul_rows_f32(out_blk, x, w, s->n, 0, rows);
+    float blk_us = time_per_call(micros() - t0, reps, rows, s->d);
+
+    print_row("f32", s, rows, ref_us, blk_us, max_diff(out_ref, out_blk, rows));
+    free(w); free(x); free(out_ref); free(out_blk);
+    return true;
+}
+
+static bool bench_q8(const Shape* s) {
+    int gs = BENCH_Q8_GROUP;
+    int groups = s->n / gs;
+    int rows = s->d;
+    if ((size_t)rows * s->n > BENCH_MAX_WEIGHT_BYTES) {
+        rows = BENCH_MAX_WEIGHT_BYTES / s->n / MATMUL_ROW_BLOCK * MATMUL_ROW_BLOCK;
+    }
+    int8_t* wq = (int8_t*)ps_malloc((size_t)rows * s->n);
+    float* ws = (float*)ps_malloc((size_t)rows * groups * sizeof(float));
+    int8_t* xq = (int8_t*)ps_malloc(s->n);
+    float* xs = (float*)ps_malloc(groups * sizeof(float));
+    float* out_ref = (float*)ps_malloc(rows * sizeof(float));
+    float* out_blk = (float*)ps_malloc(rows * sizeof(float));
+    if (!wq || !ws || !xq || !xs || !out_ref || !out_blk) {
+        Serial.printf("ERROR: No PSRAM for %s q8\n", s->name);
+        free(wq); free(ws); free(xq); free(xs); free(out_ref); free(out_blk);
+        return false;
+    }
+    for (size_t i = 0; i < (size_t)rows * s->n; i++) wq[i] = random(-127, 128);
+    for (int i = 0; i < s->n; i++) xq[i] = random(-127, 128);
+    fill_random(ws, (size_t)rows * groups);
+    fill_random(xs, groups);
+
+    int reps = BENCH_TARGET_MACS / (rows * s->n);
+    if (reps < 3) reps = 3;
+    uint32_t t0 = micros();
+    for (int r = 0; r < reps; r++) {
+        for (int i = 0; i < rows; i++) {
+            out_ref[i] = dot_q8(wq + (size_t)i * s->n, ws + (size_t)i * groups, xq, xs, s->n, gs);
+        }
+    }
+    float ref_us = time_per_call(micros() - t0, reps, rows, s->d);
+
+    t0 = micros();
+    for (int r = 0; r < reps; r++) matmul_rows_q8(out_blk, xq, xs, wq, ws, s->n, gs, 0, rows);
+    float blk_us = time_per_call(micros() - t0, reps, rows, s->d);
+
+    print_row("q8", s, rows, ref_us, blk_us, max_diff(out_ref, out_blk, rows));
+    free(wq); free(ws); free(xq); free(xs); free(out_ref); free(out_blk);
+    return true;
+}
+
+// nseq separate single-vector calls vs one batched call over the same weights
+static bool bench_batch_f32(const Shape* s, int nseq) {
+    int rows = s->d;
+    if ((size_t)rows * s->n * sizeof(float) > BENCH_MAX_WEIGHT_BYTES) {
+        rows = BENCH_MAX_WEIGHT_BYTES / (s->n * sizeof(float)) / MATMUL_ROW_BLOCK * MATMUL_ROW_BLOCK;
+    }
+    float* w = (float*)ps_malloc((size_t)rows * s->n * sizeof(float));
+    float* x = (float*)ps_malloc((size_t)nseq * s->n * sizeof(float));
+    float* out_ref = (float*)ps_malloc((size_t)nseq * rows * sizeof(float));
+    float* out_bat = (float*)ps_malloc((size_t)nseq * rows * sizeof(float));
+    if (!w || !x || !out_ref || !out_bat) {
+        Serial.printf("ERROR: No PSRAM for %s batch\n", s->name);
+        free(w); free(x); free(out_ref); free(out_bat);
+        return false;
+    }
+    fill_random(w, (size_t)rows * s->n);
+    fill_random(x, (size_t)nseq * s->n);
+
+    float* xs[MATMUL_MAX_BATCH];
+    float* outs[MATMUL_MAX_BATCH];
+    for (int i = 0; i < nseq; i++) {
+        xs[i] = x + (size_t)i * s->n;
+        outs[i] = out_bat + (size_t)i * rows;
+    }
+
+    int reps = BENCH_TARGET_MACS / (rows * s->n * nseq);
+    if (reps < 3) reps = 3;
+    uint32_t t0 = micros();
+    for (int r = 0; r < reps; r++) {
+        for (int i = 0; i < nseq; i++) {
+            matmul_rows_f32(out_ref + (size_t)i * rows, xs[i], w, s->n, 0, rows);
+        }
+    }
+    float ref_us = time_per_call(micros() - t0, reps, rows, s->d);
+
+    t0 = micros();
+    for (int r = 0; r < reps; r++) matmul_rows_f32_batch(outs, xs, nseq, w, s->n, 0, rows);
+    float bat_us = time_per_call(micros() - t0, reps, rows, s->d);
+
+    Serial.printf("  %-11s %d   %4dx%-5d %9.0f %9.0f  %5.2fx  err %.2e%s\n",
+                  s->name, nseq, s->n, s->d, ref_us, bat_us, ref_us / bat_us,
+                  max_diff(out_ref, out_bat, nseq * rows), rows < s->d ? "  (scaled)" : "");
+    free(w); free(x); free(out_ref); free(out_bat);
+    return true;
+}
+
+void run_bench() {
+    Serial.printf("\nCPU %u MHz, %d rows per block, q8 group %d\n",
+                  getCpuFrequencyMhz(), MATMUL_ROW_BLOCK, BENCH_Q8_GROUP);
+    Serial.println("  shape       type n x d        ref us    blk us  speedup  weights        max diff");
+    for (const Shape& s : SHAPES) {
+        bench_f32(&s);
+        bench_q8(&s);
+    }
+    Serial.printf("\nBatched f32, %d vectors per weight pass\n", MATMUL_MAX_BATCH);
+    Serial.println("  shape       N   n x d        N calls   batched  speedup");
+    for (const Shape& s : SHAPES) {
+        bench_batch_f32(&s, MATMUL_MAX_BATCH);
+    }
+    Serial.println("\nSend any line to run again");
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n========================================");
+    Serial.println("Matmul Kernel Benchmark");
+    Serial.println("========================================");
+    Serial.printf("Free PSRAM: %d bytes\n", ESP.getFreePsram());
+
+    randomSeed(1234);
+    run_bench();
+}
+
+void loop() {
+    if (Serial.available()) {
+        while (Serial.available()) Serial.read();
+        run_bench();
+    }
+    delay(50);
+}
@@ -0,0 +1,192 @@
+// matmul_kernels.cpp - Register-blocked f32 and Q8 matrix-vector kernels
+// Arduino builds with -Os, which neither unrolls nor schedules these loops
+#pragma GCC optimize("O2")
+
+#include "matmul_kernels.h"
+#include <esp_dsp.h>
+
+void matmul_rows_f32(float* xout, const float* x, const float* w, int n, int start, int end) {
+    int i = start;
+    for (; i + MATMUL_ROW_BLOCK <= end; i += MATMUL_ROW_BLOCK) {
+        const float* w0 = w + (size_t)i * n;
+        const float* w1 = w0 + n;
+        const float* w2 = w1 + n;
+        const float* w3 = w2 + n;
+        float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+        for (int j = 0; j < n; j++) {
+            float xj = x[j];
+            a0 += w0[j] * xj;
+            a1 += w1[j] * xj;
+            a2 += w2[j] * xj;
+            a3 += w3[j] * xj;
+        }
+        xout[i] = a0;
+        xout[i + 1] = a1;
+        xout[i + 2] = a2;
+        xout[i + 3] = a3;
+    }
+
+    // Rows left over when the range is not a multiple of the block
+    matmul_rows_f32_dsp(xout, x, w, n, i, end);
+}
+
+void matmul_rows_f32_dsp(float* xout, const float* x, const float* w, int n, int start, int end) {
+    for (int i = start; i < end; i++) {
+        float val = 0.0f;
+        dsps_dotprod_f32_aes3(w + (size_t)i * n, x, &val, n);
+        xout[i] = val;
+    }
+}
+
+float dot_q8(const int8_t* w, const float* ws, const int8_t* x, const float* xs, int n, int group_size) {
+    float val = 0.0f;
+    for (int j = 0, g = 0; j < n; j += group_size, g++) {
+        int32_t ival = 0;
+        for (int k = 0; k < group_size; k++) {
+            ival += (int32_t)x[j + k] * (int32_t)w[j + k];
+        }
+        val += (float)ival * ws[g] * xs[g];
+    }
+    return val;
+}
+
+void matmul_rows_q8(float* xout, const int8_t* xq, const float* xs, const int8_t* wq,
+                    const float* ws, int n, int group_size, int start, int end) {
+    int groups = n / group_size;
+    int i = start;
+    for (; i + MATMUL_ROW_BLOCK <= end; i += MATMUL_ROW_BLOCK) {
+        const int8_t* w0 = wq + (size_t)i * n;
+        const int8_t* w1 = w0 + n;
+        const int8_t* w2 = w1 + n;
+        const int8_t* w3 = w2 + n;
+        const float* s0 = ws + (size_t)i * groups;
+        float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+        for (int g = 0; g < groups; g++) {
+            int base = g * group_size;
+            int32_t i0 = 0, i1 = 0, i2 = 0, i3 = 0;
+            for (int k = base; k < base + group_size; k++) {
+                int32_t xk = xq[k];
+                i0 += xk * w0[k];
+                i1 += xk * w1[k];
+                i2 += xk * w2[k];
+                i3 += xk * w3[k];
+            }
+            float sx = xs[g];
+            a0 += (float)i0 * s0[g] * sx;
+            a1 += (float)i1 * s0[groups + g] * sx;
+            a2 += (float)i2 * s0[2 * groups + g] * sx;
+            a3 += (float)i3 * s0[3 * groups + g] * sx;
+        }
+        xout[i] = a0;
+        xout[i + 1] = a1;
+        xout[i + 2] = a2;
+        xout[i + 3] = a3;
+    }
+
+    for (; i < end; i++) {
+        xout[i] = dot_q8(wq + (size_t)i * n, ws + (size_t)i * groups, xq, xs, n, group_size);
+    }
+}
+
+// ============================================================================
+// Batched Rows
+// ============================================================================
+
+// Two rows x NSEQ sequences per pass: each w[j] is loaded once for all
+// sequences and each x[s][j] once for both rows (2 * NSEQ accumulators)
+template <int NSEQ>
+static void rows_f32_batch(float* const* xout, const float* const* x, const float* w, int n,
+                           int start, int end) {
+    const float* xp[NSEQ];
+#pragma GCC unroll 4
+    for (int s = 0; s < NSEQ; s++) xp[s] = x[s];
+
+    int i = start;
+    for (; i + 2 <= end; i += 2) {
+        const float* w0 = w + (size_t)i * n;
+        const float* w1 = w0 + n;
+        float a0[NSEQ] = {};
+        float a1[NSEQ] = {};
+        for (int j = 0; j < n; j++) {
+            float w0j = w0[j];
+            float w1j = w1[j];
+#pragma GCC unroll 4
+            for (int s = 0; s < NSEQ; s++) {
+                float xj = xp[s][j];
+                a0[s] += w0j * xj;
+                a1[s] += w1j * xj;
+            }
+        }
+#pragma GCC unroll 4
+        for (int s = 0; s < NSEQ; s++) {
+            xout[s][i] = a0[s];
+            xout[s][i + 1] = a1[s];
+        }
+    }
+
+    // Odd row at the end of the range
+    for (; i < end; i++) {
+        const float* wr = w + (size_t)i * n;
+        float acc[NSEQ] = {};
+        for (int j = 0; j < n; j++) {
+            float wj = wr[j];
+#pragma GCC unroll 4
+            for (int s = 0; s < NSEQ; s++) acc[s] += wj * xp[s][j];
+        }
+#pragma GCC unroll 4
+        for (int s = 0; s < NSEQ; s++) xout[s][i] = acc[s];
+    }
+}
+
+void matmul_rows_f32_batch(float* const* xout, const float* const* x, int nseq, const float* w,
+                           int n, int start, int end) {
+    switch (nseq) {
+    case 1: matmul_rows_f32(xout[0], x[0], w, n, start, end); break;
+    case 2: rows_f32_batch<2>(xout, x, w, n, start, end); break;
+    case 3: rows_f32_batch<3>(xout, x, w, n, start, end); break;
+    case 4: rows_f32_batch<4>(xout, x, w, n, start, end); break;
+    }
+}
+
+template <int NSEQ>
+static void rows_q8_batch(float* const* xout, const int8_t* const* xq, const float* const* xs,
+                          const int8_t* wq, const float* ws, int n, int group_size,
+                          int start, int end) {
+    const int8_t* xp[NSEQ];
+    const float* sp[NSEQ];
+    for (int s = 0; s < NSEQ; s++) {
+        xp[s] = xq[s];
+        sp[s] = xs[s];
+    }
+    int groups = n / group_size;
+
+    for (int i = start; i < end; i++) {
+        const int8_t* wr = wq + (size_t)i * n;
+        const float* wsr = ws + (size_t)i * groups;
+        float acc[NSEQ] = {};
+        for (int g = 0; g < groups; g++) {
+            int base = g * group_size;
+            int32_t isum[NSEQ] = {};
+            for (int k = base; k < base + group_size; k++) {
+                int32_t wk = wr[k];
+#pragma GCC unroll 4
+                for (int s = 0; s < NSEQ; s++) isum[s] += wk * xp[s][k];
+            }
+#pragma GCC unroll 4
+            for (int s = 0; s < NSEQ; s++) acc[s] += (float)isum[s] * wsr[g] * sp[s][g];
+        }
+#pragma GCC unroll 4
+        for (int s = 0; s < NSEQ; s++) xout[s][i] = acc[s];
+    }
+}
+
+void matmul_rows_q8_batch(float* const* xout, const int8_t* const* xq, const float* const* xs,
+                          int nseq, const int8_t* wq, const float* ws, int n, int group_size,
+                          int start, int end) {
+    switch (nseq) {
+    case 1: matmul_rows_q8(xout[0], xq[0], xs[0], wq, ws, n, group_size, start, end); break;
+    case 2: rows_q8_batch<2>(xout, xq, xs, wq, ws, n, group_size, start, end); break;
+    case 3: rows_q8_batch<3>(xout, xq, xs, wq, ws, n, group_size, start, end); break;
+    case 4: rows_q8_batch<4>(xout, xq, xs, wq, ws, n, group_size, start, end); break;
+    }
+}
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Pack a sketch's data/ folder into a flat asset image for AssetImage.
+
+Replaces the FAT image upload_to_flash.sh used to build with mkfatfs. The
+image goes at the start of the "ffat" partition and the sketch maps it with
+one esp_partition_mmap(): every asset is then a pointer into flash, with no
+FAT lookup and no copy into PSRAM.
+
+    python3 build_asset_image.py data assets.bin
+    python3 build_asset_image.py --list assets.bin      # directory + CRC check
+    esptool.py --chip esp32s3 write_flash 0x610000 assets.bin
+
+Assets of 64 KB and up start on a 64 KB boundary (one MMU page), so mapping
+one on its own takes no extra page. Smaller ones start on a 4 KB flash
+sector, so each can be erased and rewritten alone. --align 65536 puts
+every asset on a page.
+
+Image layout (little-endian), see asset_image.h:
+    header    u32 magic "ASET", u32 version, u32 count, u32 dir_crc
+              (CRC-32 of the entries), u32 image_size, 12 bytes zero
+    entries   count x { char name[48] (NUL-padded, e.g. "/tok512.bin"),
+              u32 offset, u32 size, u32 crc (CRC-32 of the contents),
+              u32 0 }, sorted by name
+    assets    at their offsets; the gaps are 0xFF (erased flash)
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = 0x54455341          # "ASET"
+VERSION = 1
+HEADER = struct.Struct("<5I12x")
+ENTRY = struct.Struct("<48s4I")
+NAME_MAX = 47
+SECTOR = 4096
+PAGE = 65536
+PARTITION_SIZE = 0x9E0000   # "ffat" in app3M_fat9M_16MB.csv
+
+
+def align_up(n, a):
+    return (n + a - 1) // a * a
+
+
+def collect(data_dir):
+    """(name, path) for every file under data_dir, names as FFat paths."""
+    files = []
+    for root, dirs, names in os.walk(data_dir):
+        dirs.sort()
+        for fn in names:
+            path = os.path.join(root, fn)
+            name = "/" + os.path.relpath(path, data_dir).replace(os.sep, "/")
+            if len(name.encode()) > NAME_MAX:
+                sys.exit(f"{name}: name longer than {NAME_MAX} bytes")
+            files.append((name, path))
+    files.sort(key=lambda f: f[0].encode())
+    return files
+
+
+def build(data_dir, out_path, min_align, partition_size):
+    files = collect(data_dir)
+    if not files:
+        sys.exit(f"{data_dir}: no files")
+
+    dir_end = HEADER.size + ENTRY.size * len(files)
+    pos = align_up(dir_end, SECTOR)
+    entries, blobs = [], []
+    for name, path in files:
+        with open(path, "rb") as f:
+            blob = f.read()
+        align = max(min_align, PAGE if len(blob) >= PAGE else SECTOR)
+        pos = align_up(pos, align)
+        entries.append(ENTRY.pack(name.encode(), pos, len(blob), zlib.crc32(blob), 0))
+        blobs.append((pos, blob))
+        pos += len(blob)
+
+    image_size = pos
+    if image_size > partition_size:
+        sys.exit(f"Image is {image_size} bytes, partition holds {partition_size}")
+
+    image = bytearray(b"\xff" * image_size)
+    directory = b"".join(entries)
+    image[:HEADER.size] = HEADER.pack(MAGIC, VERSION, len(entries), zlib.crc32(directory), image_size)
+    image[HEADER.size:dir_end] = directory
+    for offset, blob in blobs:
+        image[offset:offset + len(blob)] = blob
+
+    with open(out_path, "wb") as f:
+        f.write(image)
+    list_image(out_path)
+    print(f"{image_size} bytes ({image_size * 100 // partition_size}% of the partition)")
+
+
+def list_image(path):
+    """Print the directory and check every CRC; exits 1 on a bad image."""
+    with open(path, "rb") as f:
+        image = f.read()
+    magic, version, count, dir_crc, image_size = HEADER.unpack_from(image)
+    if magic != MAGIC or version != VERSION:
+        sys.exit(f"{path}: not an asset image v{VERSION}")
+    dir_end = HEADER.size + ENTRY.size * count
+    ok = zlib.crc32(image[HEADER.size:dir_end]) == dir_crc and image_size <= len(image)
+    print(f"{path}: {count} assets, {image_size} bytes{'' if ok else ', BAD DIRECTORY'}")
+    print("  offset     size      crc       align  name")
+    for i in range(count):
+        raw, offset, size, crc, _ = ENTRY.unpack_from(image, HEADER.size + i * ENTRY.size)
+        name = raw.rstrip(b"\0").decode()
+        good = offset + size <= len(image) and zlib.crc32(image[offset:offset + size]) == crc
+        align = PAGE if offset % PAGE == 0 else SECTOR
+        print(f"  0x{offset:07x} {size:9} {crc:08x} {align // 1024:3} KB  {name}"
+              f"{'' if good else '  BAD CRC'}")
+        ok = ok and good
+    if not ok:
+        sys.exit(1)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("data", help="Folder to pack (or the image, with --list)")
+    ap.add_argument("image", nargs="?", help="Output image")
+    ap.add_argument("--list", action="store_true", help="Print and check an existing image")
+    ap.add_argument("--align", type=int, choices=[SECTOR, PAGE], default=SECTOR,
+                    help="Smallest asset alignment (default 4096)")
+    ap.add_argument("--partition-size", type=lambda s: int(s, 0), default=PARTITION_SIZE,
+                    help="Partition size in bytes (default 0x9E0000)")
+    args = ap.parse_args()
+
+    if args.list:
+        list_image(args.data)
+    elif args.image:
+        build(args.data, args.image, args.align, args.partition_size)
+    else:
+        ap.error("output image required")
+
+
+if __name__ == "__main__":
+    main()
@@ -12,22 +12,36 @@
 #define LCD_DC 42
 #define LCD_BL 1
 
+// Background video load granularity
+#define LOAD_CHUNK_SIZE (32 * 1024)
+
 // Memory stream for PSRAM playback
+// The buffer fills in the background (VideoPlayer::loadTask), so reads wait
+// until their bytes have arrived instead of stalling boot on the whole file.
 class MemoryStream : public Stream {
   uint8_t *buf;
-  size_t sz, pos;
+  volatile size_t sz, loaded;
+  size_t pos;
+
+  // Block until `end` bytes are loaded (or the loader stopped short)
+  void waitFor(size_t end) {
+    while (loaded < end && loaded < sz) delay(1);
+  }
 public:
-  MemoryStream(uint8_t *b, size_t s) : buf(b), sz(s), pos(0) {}
+  MemoryStream(uint8_t *b, size_t s) : buf(b), sz(s), loaded(0), pos(0) {}
   int available() override { return sz - pos; }
-  int read() override { return (pos < sz) ? buf[pos++] : -1; }
-  int peek() override { return (pos < sz) ? buf[pos] : -1; }
+  int read() override { waitFor(pos + 1); return (pos < loaded) ? buf[pos++] : -1; }
+  int peek() override { waitFor(pos + 1); return (pos < loaded) ? buf[pos] : -1; }
   size_t readBytes(char *b, size_t len) override {
-    size_t n = min(len, sz - pos);
+    waitFor(pos + len);
+    size_t n = min(len, (size_t)(loaded - pos));
     memcpy(b, buf + pos, n);
     pos += n;
     return n;
   }
   void reset() { pos = 0; }
+  void setLoaded(size_t n) { loaded = n; }
+  void truncate() { sz = loaded; }
   size_t write(uint8_t) override { return 0; }
   void flush() override {}
 };
@@ -38,6 +52,7 @@ class VideoPlayer {
   MjpegClass decoder;
   MemoryStream *stream;
   uint8_t *videoBuf, *decodeBuf;
+  File videoFile;
 
   static VideoPlayer *instance;
   static int drawCallback(JPEGDRAW *d) {
@@ -45,6 +60,21 @@ class VideoPlayer {
     return 1;
   }
 
+  // Copies the file into PSRAM on core 0 while loop() decodes on core 1
+  static void loadTask(void *arg) {
+    VideoPlayer *p = (VideoPlayer*)arg;
+    size_t sz = p->videoFile.size(), done = 0;
+    while (done < sz) {
+      size_t n = p->videoFile.read(p->videoBuf + done, min((size_t)LOAD_CHUNK_SIZE, sz - done));
+      if (n == 0) break;
+      done += n;
+      p->stream->setLoaded(done);
+    }
+    if (done < sz) p->stream->truncate();
+    p->videoFile.close();
+    vTaskDelete(NULL);
+  }
+
 public:
   VideoPlayer() : display(nullptr), stream(nullptr), videoBuf(nullptr), decodeBuf(nullptr) {
     instance = this;
@@ -59,21 +89,25 @@ public:
     digitalWrite(LCD_BL, HIGH);
     display->fillScreen(BLACK);
 
-    // Mount flash and load video
+    // Mount flash and start loading video; the first frame plays as soon as
+    // its bytes are in PSRAM
     if (!FFat.begin(false, "", 1)) return false;
-    File f = FFat.open("/output.mjpeg", "r");
-    if (!f) return false;
+    videoFile = FFat.open("/output.mjpeg", "r");
+    if (!videoFile) return false;
 
-    size_t sz = f.size();
+    size_t sz = videoFile.size();
     videoBuf = (uint8_t*)ps_malloc(sz);
-    if (!videoBuf || f.read(videoBuf, sz) != sz) {
-      f.close();
+    if (!videoBuf) {
+      videoFile.close();
+      return false;
+    }
+    stream = new MemoryStream(videoBuf, sz);
+    if (xTaskCreatePinnedToCore(loadTask, "video_load", 4096, this, 1, NULL, 0) != pdPASS) {
+      videoFile.close();
       return false;
     }
-    f.close();
 
     // Setup decoder
-    stream = new MemoryStream(videoBuf, sz);
     decodeBuf = (uint8_t*)malloc(320 * 240 / 2);
     return decodeBuf && decoder.setup(stream, decodeBuf, drawCallback, true, 0, 0, 320, 240);
   }
@@ -1,10 +1,16 @@
 /*******************************************************************************
  * ESP32-S3-LCD-2 MJPEG Video Player with Gyro-based Auto-Rotation
- * Plays MJPEG video from flash memory in infinite loop
+ * Plays MJPEG video from flash memory in infinite loop, or a palette
+ * animation (/output.pan, PaletteAnimClass.h) when one is on flash
  * BOOT button (pin 0):
  *   - Click: Toggle pause/play
  *   - Long press: Power off/on (blank screen + backlight off)
  * Auto-rotation: Screen rotates 180° when device orientation changes
+ * Power: 160 MHz while playing, light sleep between paced frames and IMU polls
+ * Overlays: status icons and a caption blended into each decoded band
+ *   (overlay.h), so nothing drawn over the video flickers or gets erased
+ * Serial console: stats, reset, trace on|off, schema, snap (see metrics.h),
+ *   caption [text], battery <0-100>, rec on|off, wifi on|off
  ******************************************************************************/
 
 #include <FFat.h>
@@ -13,6 +19,11 @@
 #include <OneButton.h>
 #include <FastIMU.h>
 #include "MjpegClass.h"
+#include "PaletteAnimClass.h"
+#include "overlay.h"
+#include "power_governor.h"
+#include "metrics.h"
+#include "asset_image.h"
 
 // Hardware configuration
 #define LCD_CS 45
@@ -20,6 +31,24 @@
 #define LCD_BL 1
 #define BTN_BOOT 0
 
+// Background video load granularity
+#define LOAD_CHUNK_SIZE (32 * 1024)
+
+// Playback pacing and power
+#define FRAME_INTERVAL_US 100000   // 10 fps, the rate output.mjpeg is encoded at (.pan carries its own)
+#define IDLE_WAKE_US 50000         // Paused / off: wake for IMU polls and the button
+#define POWER_REPORT_MS 30000
+
+// Overlay layout (landscape, 320x240)
+#define BATTERY_W 24
+#define BATTERY_H 12
+#define REC_SIZE 12
+#define WIFI_W 16
+#define WIFI_H 12
+#define CAPTION_CHARS 24
+#define CAPTION_SCALE 2
+#define CAPTION_Y 212
+
 // IMU configuration
 #define IMU_ADDRESS 0x6B
 #define I2C_SDA 48
@@ -30,22 +59,137 @@ QMI8658 IMU;
 calData calib = {0};
 AccelData accelData;
 
-// Memory stream for PSRAM playback
+PowerGovernor power;
+MetricsRegistry metrics;
+AssetImage assets;
+
+Metric *mFrames, *mLateFrames, *mReadUs, *mDrawUs;
+Metric *mPsramFree, *mPsramMinFree, *mCpuMhz;
+
+void sampleSystem(MetricsRegistry *registry, void *arg) {
+  MetricsRegistry::set(mPsramFree, ESP.getFreePsram() / 1024.0f);
+  MetricsRegistry::set(mPsramMinFree, heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM) / 1024.0f);
+  MetricsRegistry::set(mCpuMhz, getCpuFrequencyMhz());
+}
+
+void registerMetrics() {
+  mFrames = metrics.counter("video.frames", "frames");
+  mLateFrames = metrics.counter("video.late", "frames");
+  mReadUs = metrics.histogram("video.read_us", "us");
+  mDrawUs = metrics.histogram("video.draw_us", "us");
+  mPsramFree = metrics.gauge("psram.free", "KB");
+  mPsramMinFree = metrics.gauge("psram.min_free", "KB");
+  mCpuMhz = metrics.gauge("cpu.mhz", "MHz");
+  metrics.addSampler(sampleSystem, nullptr);
+}
+
+// Status icons and caption, blended into every frame by the decoders
+OverlayCompositor overlay;
+int batteryLayer, recLayer, wifiLayer, captionBox, captionLayer;
+int batteryLevel = 100;
+uint8_t batteryMask[(BATTERY_W + 7) / 8 * BATTERY_H];
+uint8_t recMask[(REC_SIZE + 1) / 2 * REC_SIZE];
+uint8_t wifiMask[(WIFI_W + 1) / 2 * WIFI_H];
+
+// Outline, terminal nub and a fill bar for *(int *)arg percent
+bool batteryShape(float x, float y, void *arg) {
+  bool outline = x < BATTERY_W - 3 && !(x >= 1.5f && x < BATTERY_W - 4.5f && y >= 1.5f && y < BATTERY_H - 1.5f);
+  bool nub = x >= BATTERY_W - 3 && y >= 4 && y < BATTERY_H - 4;
+  bool fill = x >= 3 && x < 3 + (BATTERY_W - 9) * *(int *)arg / 100.0f && y >= 3 && y < BATTERY_H - 3;
+  return outline || nub || fill;
+}
+
+bool recShape(float x, float y, void *arg) {
+  float dx = x - REC_SIZE / 2.0f, dy = y - REC_SIZE / 2.0f;
+  return dx * dx + dy * dy < (REC_SIZE / 2.0f - 0.5f) * (REC_SIZE / 2.0f - 0.5f);
+}
+
+// Dot plus two arcs in a 90 degree wedge
+bool wifiShape(float x, float y, void *arg) {
+  float dx = x - WIFI_W / 2.0f, dy = WIFI_H - 0.5f - y;
+  float d = sqrtf(dx * dx + dy * dy);
+  if (d < 1.8f) return true;
+  if (dy <= 0 || fabsf(dx) > dy) return false;
+  return (d >= 4.5f && d < 6.5f) || (d >= 8.5f && d < 10.5f);
+}
+
+void setBattery(int level) {
+  batteryLevel = constrain(level, 0, 100);
+  overlay_render_mask(batteryMask, BATTERY_W, BATTERY_H, 1, batteryShape, &batteryLevel);
+  overlay.setMask(batteryLayer, batteryMask, 1);
+  overlay.setColor(batteryLayer, batteryLevel > 20 ? WHITE : RED);
+}
+
+void setCaption(const char *text) {
+  int len = min((int)strlen(text), CAPTION_CHARS);
+  int w = len * OVERLAY_FONT_W * CAPTION_SCALE;
+  overlay.setText(captionLayer, text);
+  overlay.move(captionLayer, (320 - w) / 2, CAPTION_Y);
+  overlay.setVisible(captionLayer, len > 0);
+  overlay.setVisible(captionBox, len > 0);
+}
+
+void setupOverlay() {
+  overlay_render_mask(recMask, REC_SIZE, REC_SIZE, 4, recShape, nullptr);
+  overlay_render_mask(wifiMask, WIFI_W, WIFI_H, 4, wifiShape, nullptr);
+
+  recLayer = overlay.add(8, 6, REC_SIZE, REC_SIZE, RED, recMask, 4);
+  wifiLayer = overlay.add(320 - BATTERY_W - WIFI_W - 14, 6, WIFI_W, WIFI_H, WHITE, wifiMask, 4);
+  batteryLayer = overlay.add(320 - BATTERY_W - 6, 6, BATTERY_W, BATTERY_H, WHITE, batteryMask, 1);
+  setBattery(batteryLevel);
+  overlay.setVisible(recLayer, false);
+  overlay.setVisible(wifiLayer, false);
+
+  // Half-transparent band behind the caption keeps it readable on any frame
+  captionBox = overlay.add(0, CAPTION_Y - 4, 320, OVERLAY_FONT_H * CAPTION_SCALE + 6, BLACK);
+  overlay.setOpacity(captionBox, 128);
+  captionLayer = overlay.addText(0, CAPTION_Y, CAPTION_CHARS, CAPTION_SCALE, WHITE);
+  setCaption("");
+}
+
+bool overlayCommand(const char *line) {
+  if (strncmp(line, "caption", 7) == 0 && (line[7] == '\0' || line[7] == ' ')) {
+    setCaption(line[7] ? line + 8 : "");
+  } else if (strncmp(line, "battery ", 8) == 0) {
+    setBattery(atoi(line + 8));
+  } else if (strncmp(line, "rec ", 4) == 0) {
+    overlay.setVisible(recLayer, strcmp(line + 4, "on") == 0);
+  } else if (strncmp(line, "wifi ", 5) == 0) {
+    overlay.setVisible(wifiLayer, strcmp(line + 5, "on") == 0);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Memory stream for PSRAM or mapped flash playback
+// A PSRAM buffer fills in the background (VideoPlayer::loadTask), so reads wait
+// until their bytes have arrived instead of stalling boot on the whole file.
+// A mapped asset is loaded from the start (setLoaded(size)).
 class MemoryStream : public Stream {
   uint8_t *buf;
-  size_t sz, pos;
+  volatile size_t sz, loaded;
+  size_t pos;
+
+  // Block until `end` bytes are loaded (or the loader stopped short)
+  void waitFor(size_t end) {
+    while (loaded < end && loaded < sz) delay(1);
+  }
 public:
-  MemoryStream(uint8_t *b, size_t s) : buf(b), sz(s), pos(0) {}
+  MemoryStream(uint8_t *b, size_t s) : buf(b), sz(s), loaded(0), pos(0) {}
   int available() override { return sz - pos; }
-  int read() override { return (pos < sz) ? buf[pos++] : -1; }
-  int peek() override { return (pos < sz) ? buf[pos] : -1; }
+  int read() override { waitFor(pos + 1); return (pos < loaded) ? buf[pos++] : -1; }
+  int peek() override { waitFor(pos + 1); return (pos < loaded) ? buf[pos] : -1; }
   size_t readBytes(char *b, size_t len) override {
-    size_t n = min(len, sz - pos);
+    waitFor(pos + len);
+    size_t n = min(len, (size_t)(loaded - pos));
     memcpy(b, buf + pos, n);
     pos += n;
     return n;
   }
   void reset() { pos = 0; }
+  void setLoaded(size_t n) { loaded = n; }
+  void truncate() { sz = loaded; }
   size_t write(uint8_t) override { return 0; }
   void flush() override {}
 };
@@ -132,26 +276,85 @@ public:
 
 // Video player class
 class VideoPlayer {
-  Arduino_GFX *display;
+  Arduino_TFT *display;
   MjpegClass decoder;
+  PaletteAnimClass anim;
+  bool usePalette;
+  uint32_t frameIntervalUs;
   MemoryStream *stream;
   uint8_t *videoBuf, *decodeBuf;
+  File videoFile;
   bool paused;
   bool powered;
+  bool videoDemand;
+  uint32_t nextFrameUs;
 
   static VideoPlayer *instance;
   static int drawCallback(JPEGDRAW *d) {
+    overlay.blend(d->pPixels, d->x, d->y, d->iWidth, d->iHeight, true);
     instance->display->draw16bitBeRGBBitmap(d->x, d->y, d->pPixels, d->iWidth, d->iHeight);
     return 1;
   }
 
+  // Copies the file into PSRAM on core 0 while loop() decodes on core 1
+  static void loadTask(void *arg) {
+    VideoPlayer *p = (VideoPlayer*)arg;
+    power.acquire(POWER_LOAD);
+    size_t sz = p->videoFile.size(), done = 0;
+    while (done < sz) {
+      size_t n = p->videoFile.read(p->videoBuf + done, min((size_t)LOAD_CHUNK_SIZE, sz - done));
+      if (n == 0) break;
+      done += n;
+      p->stream->setLoaded(done);
+    }
+    if (done < sz) p->stream->truncate();
+    p->videoFile.close();
+    power.release(POWER_LOAD);
+    vTaskDelete(NULL);
+  }
+
+  // Fallback for a FAT upload: start copying the video into PSRAM
+  bool loadFromFFat() {
+    if (!FFat.begin(false, "", 1)) return false;
+    usePalette = FFat.exists("/output.pan");
+    videoFile = FFat.open(usePalette ? "/output.pan" : "/output.mjpeg", "r");
+    if (!videoFile) return false;
+
+    size_t sz = videoFile.size();
+    videoBuf = (uint8_t*)ps_malloc(sz);
+    if (!videoBuf) {
+      videoFile.close();
+      return false;
+    }
+    stream = new MemoryStream(videoBuf, sz);
+    if (xTaskCreatePinnedToCore(loadTask, "video_load", 4096, this, 1, NULL, 0) != pdPASS) {
+      videoFile.close();
+      return false;
+    }
+    return true;
+  }
+
+  // Hold the video clock only while frames are being decoded
+  void updatePower() {
+    bool playing = powered && !paused;
+    if (playing == videoDemand) return;
+    videoDemand = playing;
+    if (playing) {
+      power.acquire(POWER_VIDEO);
+    } else {
+      power.release(POWER_VIDEO);
+    }
+    nextFrameUs = micros();
+  }
+
 public:
-  VideoPlayer() : display(nullptr), stream(nullptr), videoBuf(nullptr), decodeBuf(nullptr), paused(false), powered(true) {
+  VideoPlayer() : display(nullptr), usePalette(false), frameIntervalUs(FRAME_INTERVAL_US), stream(nullptr), videoBuf(nullptr), decodeBuf(nullptr), paused(false), powered(true), videoDemand(false), nextFrameUs(0) {
     instance = this;
   }
 
   void togglePause() {
     paused = !paused;
+    updatePower();
   }
 
   void powerOff() {
@@ -160,6 +363,7 @@ public:
     paused = true;
     display->fillScreen(BLACK);
     digitalWrite(LCD_BL, LOW);
+    updatePower();
   }
 
   void powerOn() {
@@ -167,6 +371,7 @@ public:
     powered = true;
     paused = false;
     digitalWrite(LCD_BL, HIGH);
+    updatePower();
   }
 
   void togglePower() {
@@ -191,34 +396,75 @@ public:
     digitalWrite(LCD_BL, HIGH);
     display->fillScreen(BLACK);
 
-    // Mount flash and load video
-    if (!FFat.begin(false, "", 1)) return false;
-    File f = FFat.open("/output.mjpeg", "r");
-    if (!f) return false;
-
-    size_t sz = f.size();
-    videoBuf = (uint8_t*)ps_malloc(sz);
-    if (!videoBuf || f.read(videoBuf, sz) != sz) {
-      f.close();
+    // Play straight from the mapped asset image: no copy and no load task.
+    // The directory CRC is checked by begin(); the video's own CRC is not,
+    // since that would read the whole file before the first frame.
+    Asset video;
+    if (assets.begin() && ((usePalette = assets.find("/output.pan", &video)) ||
+                           assets.find("/output.mjpeg", &video))) {
+      stream = new MemoryStream((uint8_t*)video.data, video.size);
+      stream->setLoaded(video.size);
+    } else if (!loadFromFFat()) {
       return false;
     }
-    f.close();
 
     // Setup decoder
-    stream = new MemoryStream(videoBuf, sz);
-    decodeBuf = (uint8_t*)malloc(320 * 240 / 2);
-    return decodeBuf && decoder.setup(stream, decodeBuf, drawCallback, true, 0, 0, 320, 240);
+    if (usePalette) {
+      if (!anim.setup(stream, display, 320, 240)) return false;
+      anim.setOverlay(&overlay);
+      frameIntervalUs = 1000000 / anim.fps();
+    } else {
+      decodeBuf = (uint8_t*)malloc(320 * 240 / 2);
+      if (!decodeBuf || !decoder.setup(stream, decodeBuf, drawCallback, true, 0, 0, 320, 240)) return false;
+    }
+    updatePower();
+    return true;
   }
 
-  void play() {
-    if (!powered || paused) return;
+  // Decode one frame if it is due; returns when loop() should wake next (micros())
+  uint32_t play() {
+    uint32_t now = micros();
+    if (!powered) return now + IDLE_WAKE_US;
+    if (paused) {
+      // Overlay changes still show on the frozen frame
+      if (overlay.takeDirty()) {
+        if (usePalette) {
+          anim.drawFrame(true);
+        } else {
+          decoder.drawJpg();
+        }
+      }
+      return now + IDLE_WAKE_US;
+    }
+    if ((int32_t)(nextFrameUs - now) > 0) return nextFrameUs;
 
-    if (decoder.readMjpegBuf()) {
-      decoder.drawJpg();
-    } else {
+    if (!(usePalette ? anim.readFrame() : decoder.readMjpegBuf())) {
       stream->reset();
-      decoder.reset();
+      if (usePalette) {
+        anim.reset();
+      } else {
+        decoder.reset();
+      }
+      return now;
+    }
+    uint32_t readDone = micros();
+    MetricsRegistry::record(mReadUs, readDone - now);
+    bool overlayChanged = overlay.takeDirty();
+    if (usePalette) {
+      anim.drawFrame(overlayChanged);
+    } else {
+      decoder.drawJpg();
     }
+    MetricsRegistry::record(mDrawUs, micros() - readDone);
+    MetricsRegistry::add(mFrames);
+
+    // Fell behind (slow decode or video still loading): restart pacing from now
+    nextFrameUs += frameIntervalUs;
+    if ((int32_t)(micros() - nextFrameUs) > 0) {
+      nextFrameUs = micros() + frameIntervalUs;
+      MetricsRegistry::add(mLateFrames);
+    }
+    return nextFrameUs;
   }
 };
 
@@ -237,7 +483,15 @@ void onButtonLongPressStart() {
   player.togglePower();
 }
 
+unsigned long lastPowerReport = 0;
+
 void setup() {
+  Serial.begin(115200);
+  power.begin(POWER_IDLE);
+  power.wakeOnLow(BTN_BOOT);
+  registerMetrics();
+  setupOverlay();
+
   // Initialize IMU
   Wire.begin(I2C_SDA, I2C_SCL);
   int imuErr = IMU.init(calib, IMU_ADDRESS);
@@ -265,5 +519,17 @@ void loop() {
   }
 
   button.tick();
-  player.play();
+
+  const char *line = metrics.readLine();
+  if (line && !metrics.command(line) && !overlayCommand(line)) {
+    Serial.printf("Unknown command: %s\n", line);
+  }
+  metrics.trace();
+
+  if (millis() - lastPowerReport >= POWER_REPORT_MS) {
+    lastPowerReport = millis();
+    power.printStats();
+  }
+
+  power.sleepUntil(player.play());
 }
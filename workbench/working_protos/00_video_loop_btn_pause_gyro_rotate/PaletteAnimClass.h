@@ -0,0 +1,188 @@
+/*******************************************************************************
+ * Palette Animation Decoder
+ * Plays .pan clips from tools/build_palette_anim.py: 8-bit palette indices,
+ * RLE compressed per frame, decoded in row bands and pushed through the
+ * display's indexed path (palette lookup during the SPI write). Flat-colored
+ * clips such as the logo loop cost a fraction of a JPEG decode per frame.
+ *
+ * File layout, little-endian:
+ *   header (24 bytes): u32 magic "PAN1", u16 width, u16 height, u16 frames,
+ *                      u16 colors, u8 scale, u8 fps, u16 reserved,
+ *                      u32 max_frame_bytes, u32 reserved
+ *   u16 palette[colors], RGB565
+ *   per frame: u32 length, then length bytes of RLE indices
+ *              (length 0 = same picture as the previous frame)
+ * RLE: control byte c < 128: c + 1 literal indices follow
+ *      c >= 128: the next index repeats c - 125 times (3..130)
+ * Runs cross row boundaries. Scale 2 doubles every pixel on the way out.
+ * Rows under an overlay layer (overlay.h) are expanded to RGB565, blended
+ * and pushed as plain pixels; all other rows stay on the indexed path.
+ ******************************************************************************/
+
+#pragma once
+#include <Arduino_GFX_Library.h>
+#include "overlay.h"
+
+#define PAN_MAGIC 0x314E4150  // "PAN1"
+#define PAN_BAND_ROWS 16      // Source rows decoded per push
+
+struct PanHeader {
+  uint32_t magic;
+  uint16_t width;
+  uint16_t height;
+  uint16_t frames;
+  uint16_t colors;
+  uint8_t scale;
+  uint8_t fps;
+  uint16_t reserved;
+  uint32_t max_frame_bytes;
+  uint32_t reserved2;
+};
+
+class PaletteAnimClass {
+public:
+  // Read the header and palette; frames are centered in widthLimit x heightLimit
+  bool setup(Stream *input, Arduino_TFT *tft, int widthLimit, int heightLimit) {
+    _input = input;
+    _tft = tft;
+    if (!readHeader()) return false;
+
+    _scale = (_header.scale == 2 && _header.width * 2 <= widthLimit &&
+              _header.height * 2 <= heightLimit) ? 2 : 1;
+    _x = (widthLimit - _header.width * _scale) / 2;
+    _y = (heightLimit - _header.height * _scale) / 2;
+    if (_x < 0) _x = 0;
+    if (_y < 0) _y = 0;
+
+    _frame_buf = (uint8_t *)malloc(_header.max_frame_bytes);
+    _band = (uint8_t *)malloc(_header.width * PAN_BAND_ROWS);
+    _line = (uint16_t *)malloc(_header.width * _scale * sizeof(uint16_t));
+    return _frame_buf && _band && _line;
+  }
+
+  void setOverlay(OverlayCompositor *overlay) { _overlay = overlay; }
+
+  // Read the next frame; false at the end of the clip
+  bool readFrame() {
+    uint32_t len;
+    if (_input->readBytes((char *)&len, sizeof(len)) != sizeof(len)) return false;
+    if (len > _header.max_frame_bytes) return false;
+    if (_input->readBytes((char *)_frame_buf, len) != len) return false;
+    _changed = len > 0;
+    if (_changed) _frame_len = len;  // A held frame keeps the previous one's bytes
+    return true;
+  }
+
+  // Decode band by band and push each band as soon as it is ready. A held
+  // frame is only drawn again when forced (an overlay changed).
+  bool drawFrame(bool force = false) {
+    if (_frame_len == 0 || (!_changed && !force)) return true;
+
+    _src = _frame_buf;
+    _src_end = _frame_buf + _frame_len;
+    _run = 0;
+    int w = _header.width;
+    bool ok = true;
+
+    _tft->startWrite();
+    _tft->writeAddrWindow(_x, _y, w * _scale, _header.height * _scale);
+    for (int row = 0; ok && row < _header.height; row += PAN_BAND_ROWS) {
+      int rows = min(PAN_BAND_ROWS, _header.height - row);
+      ok = decode(_band, rows * w);
+      if (!ok) break;
+      int screenY = _y + row * _scale;
+      bool covered = _overlay && _overlay->covers(screenY, rows * _scale);
+      if (_scale == 1 && !covered) {
+        _tft->writeIndexedPixels(_band, _palette, rows * w);
+        continue;
+      }
+      for (int r = 0; r < rows * _scale; r++) {
+        uint8_t *src = _band + (r / _scale) * w;
+        if (covered && _overlay->covers(screenY + r, 1)) {
+          pushBlended(src, screenY + r);
+        } else if (_scale == 2) {
+          _tft->writeIndexedPixelsDouble(src, _palette, w);
+        } else {
+          _tft->writeIndexedPixels(src, _palette, w);
+        }
+      }
+    }
+    _tft->endWrite();
+    return ok;
+  }
+
+  // Skip the header again after the stream was rewound, for looping
+  bool reset() {
+    _frame_len = 0;
+    _changed = false;
+    return readHeader();
+  }
+
+  int fps() const { return _header.fps ? _header.fps : 10; }
+
+private:
+  bool readHeader() {
+    if (_input->readBytes((char *)&_header, sizeof(_header)) != sizeof(_header)) return false;
+    if (_header.magic != PAN_MAGIC || _header.width == 0 || _header.height == 0 ||
+        _header.colors == 0 || _header.colors > 256) {
+      return false;
+    }
+    memset(_palette, 0, sizeof(_palette));
+    size_t bytes = _header.colors * sizeof(uint16_t);
+    return _input->readBytes((char *)_palette, bytes) == bytes;
+  }
+
+  // One output row through the palette, blended with the overlay
+  void pushBlended(const uint8_t *src, int screenY) {
+    int w = _header.width * _scale;
+    for (int i = 0; i < w; i++) {
+      _line[i] = _palette[src[i / _scale]];
+    }
+    _overlay->blend(_line, _x, screenY, w, 1, false);
+    _tft->writePixels(_line, w);
+  }
+
+  // Expand n indices; the run state carries over into the next band
+  bool decode(uint8_t *out, uint32_t n) {
+    while (n > 0) {
+      if (_run == 0) {
+        if (_src >= _src_end) return false;
+        uint8_t c = *_src++;
+        _literal = c < 128;
+        _run = _literal ? c + 1 : c - 125;
+        if (!_literal) {
+          if (_src >= _src_end) return false;
+          _value = *_src++;
+        }
+      }
+      uint32_t k = min(_run, n);
+      if (_literal) {
+        if (_src + k > _src_end) return false;
+        memcpy(out, _src, k);
+        _src += k;
+      } else {
+        memset(out, _value, k);
+      }
+      out += k;
+      n -= k;
+      _run -= k;
+    }
+    return true;
+  }
+
+  Stream *_input;
+  Arduino_TFT *_tft;
+  PanHeader _header;
+  uint16_t _palette[256];
+  int _x, _y, _scale = 1;
+  uint8_t *_frame_buf = nullptr;
+  uint32_t _frame_len = 0;
+  bool _changed = false;
+  uint8_t *_band = nullptr;
+  uint16_t *_line = nullptr;
+  OverlayCompositor *_overlay = nullptr;
+  const uint8_t *_src, *_src_end;
+  uint32_t _run = 0;
+  bool _literal;
+  uint8_t _value;
+};
@@ -0,0 +1,103 @@
+// asset_image.cpp - Asset image mapping and lookup
+
+#include "asset_image.h"
+#include "crc32.h"
+
+AssetImage::AssetImage() : base_(nullptr), handle_(0) {
+}
+
+AssetImage::~AssetImage() {
+    end();
+}
+
+bool AssetImage::begin(const char* label) {
+    end();
+    const esp_partition_t* part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!part) {
+        Serial.printf("No asset partition '%s'\n", label);
+        return false;
+    }
+
+    AssetImageHeader hdr;
+    if (esp_partition_read(part, 0, &hdr, sizeof(hdr)) != ESP_OK) {
+        Serial.printf("ERROR: Cannot read partition '%s'\n", label);
+        return false;
+    }
+    if (hdr.magic != ASSET_MAGIC || hdr.version != ASSET_VERSION) {
+        Serial.printf("Partition '%s' has no asset image (magic %08x v%u)\n",
+                      label, hdr.magic, hdr.version);
+        return false;
+    }
+    size_t dir_end = sizeof(AssetImageHeader) + (size_t)hdr.count * sizeof(AssetEntry);
+    if (hdr.image_size > part->size || dir_end > hdr.image_size) {
+        Serial.printf("ERROR: Asset image (%u bytes, %u assets) does not fit partition (%u bytes)\n",
+                      hdr.image_size, hdr.count, (unsigned)part->size);
+        return false;
+    }
+
+    // One mapping for the directory and every asset (64 KB MMU pages)
+    const void* base = nullptr;
+    esp_err_t err = esp_partition_mmap(part, 0, hdr.image_size, ESP_PARTITION_MMAP_DATA,
+                                       &base, &handle_);
+    if (err != ESP_OK) {
+        Serial.printf("ERROR: esp_partition_mmap failed (%d)\n", err);
+        return false;
+    }
+    base_ = (const uint8_t*)base;
+
+    // The directory is small: check it now, and every entry's bounds, so
+    // find() can hand out pointers without further checks
+    bool ok = crc32_update(0, entries(), hdr.count * sizeof(AssetEntry)) == hdr.dir_crc;
+    for (uint32_t i = 0; ok && i < hdr.count; i++) {
+        const AssetEntry* e = entry(i);
+        ok = e->name[ASSET_NAME_MAX - 1] == '\0' && e->offset >= dir_end &&
+             e->offset <= hdr.image_size && e->size <= hdr.image_size - e->offset;
+    }
+    if (!ok) {
+        Serial.printf("ERROR: Asset directory in '%s' is corrupt\n", label);
+        end();
+        return false;
+    }
+    return true;
+}
+
+void AssetImage::end() {
+    if (base_) {
+        esp_partition_munmap(handle_);
+        base_ = nullptr;
+    }
+}
+
+bool AssetImage::find(const char* name, Asset* asset) const {
+    int lo = 0, hi = count() - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const AssetEntry* e = entry(mid);
+        int cmp = strcmp(name, e->name);
+        if (cmp == 0) {
+            asset->data = base_ + e->offset;
+            asset->size = e->size;
+            asset->crc = e->crc;
+            return true;
+        }
+        if (cmp < 0) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return false;
+}
+
+bool AssetImage::verify(const Asset& asset) const {
+    return crc32_update(0, asset.data, asset.size) == asset.crc;
+}
+
+void AssetImage::printDirectory() const {
+    Serial.printf("Asset image: %d assets, %u bytes\n", count(), base_ ? header()->image_size : 0);
+    for (int i = 0; i < count(); i++) {
+        const AssetEntry* e = entry(i);
+        Serial.printf("  0x%07x %9u %08x  %s\n", e->offset, e->size, e->crc, e->name);
+    }
+}
@@ -0,0 +1,74 @@
+// asset_image.h - Zero-copy assets from a flat flash partition
+// workbench/tools/build_asset_image.py packs a sketch's data/ folder into one
+// image: a directory of names, offsets, sizes and CRC-32s, then the files,
+// each on a 4 KB sector or (64 KB and up) a 64 KB MMU page. begin() maps the
+// whole image with one esp_partition_mmap(); find() then returns a pointer
+// into flash, so reading an asset is a cache fill instead of a FAT lookup
+// plus a copy into PSRAM. The image replaces the FAT image in "ffat", so the
+// Arduino partition schemes stay as they are.
+
+#ifndef ASSET_IMAGE_H
+#define ASSET_IMAGE_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+#define ASSET_MAGIC             0x54455341  // "ASET"
+#define ASSET_VERSION           1
+#define ASSET_NAME_MAX          48          // Including the NUL
+#define ASSET_PARTITION_LABEL   "ffat"
+
+// Image header (little-endian); entries follow, sorted by name
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t dir_crc;           // CRC-32 of the entries
+    uint32_t image_size;
+    uint32_t reserved[3];
+} AssetImageHeader;
+
+typedef struct {
+    char name[ASSET_NAME_MAX];  // FFat-style path, e.g. "/tok512.bin"
+    uint32_t offset;            // From the image start
+    uint32_t size;
+    uint32_t crc;               // CRC-32 of the contents (zlib.crc32)
+    uint32_t reserved;
+} AssetEntry;
+
+typedef struct {
+    const uint8_t* data;        // Mapped flash, valid until end()
+    size_t size;
+    uint32_t crc;
+} Asset;
+
+class AssetImage {
+public:
+    AssetImage();
+    ~AssetImage();
+
+    // Map the image in the partition; false if the partition is missing or
+    // holds no asset image (e.g. an old FAT upload)
+    bool begin(const char* label = ASSET_PARTITION_LABEL);
+    void end();
+    bool mapped() const { return base_ != nullptr; }
+
+    // Binary search by name; nothing is read or copied
+    bool find(const char* name, Asset* asset) const;
+
+    // Recompute the asset's CRC from flash (reads every byte)
+    bool verify(const Asset& asset) const;
+
+    int count() const { return base_ ? header()->count : 0; }
+    const AssetEntry* entry(int i) const { return entries() + i; }
+    void printDirectory() const;
+
+private:
+    const AssetImageHeader* header() const { return (const AssetImageHeader*)base_; }
+    const AssetEntry* entries() const { return (const AssetEntry*)(base_ + sizeof(AssetImageHeader)); }
+
+    const uint8_t* base_;
+    esp_partition_mmap_handle_t handle_;
+};
+
+#endif // ASSET_IMAGE_H
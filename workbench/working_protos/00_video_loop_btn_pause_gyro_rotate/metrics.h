@@ -0,0 +1,120 @@
+// metrics.h - Runtime metrics registry with a serial console
+// Counters, gauges and log2 histograms are registered by name at startup and
+// updated from any task. The console prints them (`stats`), clears them
+// (`reset`), streams one line per second (`trace on`) and sends binary
+// snapshots (`schema`, `snap`) that tools/metrics_monitor.py polls and plots.
+//
+// Snapshot wire format: one text line "#MCH <base64>" / "#MTS <base64>" so it
+// can share the serial port with log output. All fields little-endian.
+//   schema:   u32 magic "MCH1", u16 count, u16 0,
+//             per metric: u8 type, u8 name_len, name, u8 unit_len, unit
+//   snapshot: u32 magic "MTS1", u32 t_ms, u16 count, u16 0,
+//             per metric (schema order):
+//               counter   u32 value
+//               gauge     f32 value
+//               histogram u32 count, u32 min, u32 max, u64 sum,
+//                         u8 first_bucket, u8 n_buckets, n_buckets x u32
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+#define METRICS_MAX             48
+#define METRICS_MAX_SAMPLERS    4
+#define METRIC_HIST_BUCKETS     24      // log2 buckets: [2^b, 2^(b+1))
+#define METRICS_LINE_MAX        48      // Console command length
+#define METRICS_TRACE_MS        1000
+
+#define METRICS_SCHEMA_MAGIC    0x3148434D  // "MCH1"
+#define METRICS_SNAPSHOT_MAGIC  0x3153544D  // "MTS1"
+
+typedef enum {
+    METRIC_COUNTER = 0,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+} MetricType;
+
+typedef struct {
+    const char* name;
+    const char* unit;
+    MetricType type;
+
+    uint32_t count;             // Counter value / histogram samples
+    float value;                // Gauge value
+    uint32_t min;               // Histogram only
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[METRIC_HIST_BUCKETS];
+} Metric;
+
+class MetricsRegistry;
+
+// Refreshes sampled gauges (PSRAM, stack high-water) before they are read
+typedef void (*MetricSampler)(MetricsRegistry* metrics, void* arg);
+
+class MetricsRegistry {
+public:
+    MetricsRegistry();
+
+    // Register (or look up) by name; nullptr once METRICS_MAX is reached.
+    // Names and units must outlive the registry.
+    Metric* counter(const char* name, const char* unit = "");
+    Metric* gauge(const char* name, const char* unit = "");
+    Metric* histogram(const char* name, const char* unit = "us");
+    bool addSampler(MetricSampler fn, void* arg);
+
+    // Updates, safe from any task; m may be nullptr
+    static void add(Metric* m, uint32_t n = 1);
+    static void set(Metric* m, float value);
+    static void record(Metric* m, uint32_t value);
+
+    void sample();
+    void print();
+    void reset();
+
+    // Console. readLine() returns a complete line from Serial (nullptr if
+    // none yet); command() runs stats/reset/trace/schema/snap and returns
+    // false for anything else so the sketch can add its own commands.
+    const char* readLine();
+    bool command(const char* line);
+
+    // Prints the trace line when due; call from loop()
+    void trace();
+
+    // Binary encodings; return bytes written (0 if cap is too small)
+    size_t encodeSchema(uint8_t* buf, size_t cap);
+    size_t encodeSnapshot(uint8_t* buf, size_t cap);
+    size_t schemaSize();
+    size_t snapshotSize();
+
+private:
+    Metric* registerMetric(const char* name, const char* unit, MetricType type);
+    void sendFrame(const char* tag, bool schema);
+
+    Metric metrics_[METRICS_MAX];
+    int num_metrics_;
+
+    MetricSampler samplers_[METRICS_MAX_SAMPLERS];
+    void* sampler_args_[METRICS_MAX_SAMPLERS];
+    int num_samplers_;
+
+    char line_[METRICS_LINE_MAX];
+    int line_len_;
+    bool tracing_;
+    uint32_t last_trace_ms_;
+};
+
+// Times the enclosing scope into a histogram (microseconds)
+class MetricTimer {
+public:
+    explicit MetricTimer(Metric* m) : m_(m), t0_(micros()) {}
+    ~MetricTimer() { MetricsRegistry::record(m_, micros() - t0_); }
+
+private:
+    Metric* m_;
+    uint32_t t0_;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,198 @@
+// overlay.cpp - Overlay compositor implementation
+
+#include "overlay.h"
+#include <font/glcdfont.h>
+
+// 5-bit alpha over red/blue and green spread into one word, so one
+// multiply per channel pair and no per-channel unpacking
+static inline uint16_t mix565(uint16_t fg, uint16_t bg, uint32_t alpha) {
+    uint32_t a = (alpha + 4) >> 3;      // 0..32
+    uint32_t f = (fg | ((uint32_t)fg << 16)) & 0x07E0F81F;
+    uint32_t b = (bg | ((uint32_t)bg << 16)) & 0x07E0F81F;
+    uint32_t m = ((f * a + b * (32 - a)) >> 5) & 0x07E0F81F;
+    return (uint16_t)(m | (m >> 16));
+}
+
+static inline uint16_t swap16(uint16_t v) {
+    return (uint16_t)((v << 8) | (v >> 8));
+}
+
+OverlayCompositor::OverlayCompositor() : count_(0), dirty_(false) {
+    memset(layers_, 0, sizeof(layers_));
+}
+
+OverlayCompositor::~OverlayCompositor() {
+    for (int i = 0; i < count_; i++) {
+        if (layers_[i].owned) free(layers_[i].owned);
+    }
+}
+
+int OverlayCompositor::add(int x, int y, int w, int h, uint16_t color, const uint8_t* mask,
+                           int mask_bits, const uint16_t* pixels) {
+    if (count_ == OVERLAY_MAX_LAYERS || w <= 0 || h <= 0) return -1;
+    OverlayLayer* l = &layers_[count_];
+    memset(l, 0, sizeof(*l));
+    l->x = x;
+    l->y = y;
+    l->w = w;
+    l->h = h;
+    l->color = color;
+    l->pixels = pixels;
+    l->mask = mask;
+    l->mask_bits = mask_bits == 4 ? 4 : 1;
+    l->opacity = 255;
+    l->visible = true;
+    dirty_ = true;
+    return count_++;
+}
+
+int OverlayCompositor::addText(int x, int y, int max_chars, int scale, uint16_t color) {
+    if (scale < 1) scale = 1;
+    if (scale > 4) scale = 4;
+    int w = max_chars * OVERLAY_FONT_W * scale;
+    int h = OVERLAY_FONT_H * scale;
+    uint8_t* mask = (uint8_t*)calloc(1, overlay_mask_size(w, h, 1));
+    if (!mask) return -1;
+    int id = add(x, y, w, h, color, mask, 1);
+    if (id < 0) {
+        free(mask);
+        return -1;
+    }
+    layers_[id].owned = mask;
+    layers_[id].text_cap = max_chars;
+    layers_[id].text_scale = scale;
+    return id;
+}
+
+void OverlayCompositor::setText(int id, const char* text) {
+    if (!valid(id) || !layers_[id].owned) return;
+    OverlayLayer* l = &layers_[id];
+    size_t stride = (l->w + 7) / 8;
+    int scale = l->text_scale;
+    memset(l->owned, 0, stride * l->h);
+
+    for (int ci = 0; text[ci] && ci < l->text_cap; ci++) {
+        const unsigned char* glyph = &font[(uint8_t)text[ci] * 5];
+        for (int col = 0; col < 5; col++) {
+            uint8_t bits = glyph[col];
+            for (int row = 0; row < 7; row++) {
+                if (!((bits >> row) & 1)) continue;
+                for (int sy = 0; sy < scale; sy++) {
+                    uint8_t* line = l->owned + (row * scale + sy) * stride;
+                    for (int sx = 0; sx < scale; sx++) {
+                        int px = (ci * OVERLAY_FONT_W + col) * scale + sx;
+                        line[px >> 3] |= 0x80 >> (px & 7);
+                    }
+                }
+            }
+        }
+    }
+    dirty_ = true;
+}
+
+void OverlayCompositor::setVisible(int id, bool visible) {
+    if (!valid(id) || layers_[id].visible == visible) return;
+    layers_[id].visible = visible;
+    dirty_ = true;
+}
+
+void OverlayCompositor::setColor(int id, uint16_t color) {
+    if (!valid(id)) return;
+    layers_[id].color = color;
+    dirty_ = true;
+}
+
+void OverlayCompositor::setOpacity(int id, uint8_t opacity) {
+    if (!valid(id)) return;
+    layers_[id].opacity = opacity;
+    dirty_ = true;
+}
+
+void OverlayCompositor::setMask(int id, const uint8_t* mask, int mask_bits) {
+    if (!valid(id) || layers_[id].owned) return;
+    layers_[id].mask = mask;
+    layers_[id].mask_bits = mask_bits == 4 ? 4 : 1;
+    dirty_ = true;
+}
+
+void OverlayCompositor::move(int id, int x, int y) {
+    if (!valid(id)) return;
+    layers_[id].x = x;
+    layers_[id].y = y;
+    dirty_ = true;
+}
+
+bool OverlayCompositor::covers(int y, int h) const {
+    for (int i = 0; i < count_; i++) {
+        const OverlayLayer* l = &layers_[i];
+        if (l->visible && l->opacity && l->y < y + h && y < l->y + l->h) return true;
+    }
+    return false;
+}
+
+bool OverlayCompositor::takeDirty() {
+    bool d = dirty_;
+    dirty_ = false;
+    return d;
+}
+
+void OverlayCompositor::blend(uint16_t* band, int x, int y, int w, int h, bool big_endian) const {
+    for (int i = 0; i < count_; i++) {
+        const OverlayLayer* l = &layers_[i];
+        if (!l->visible || l->opacity == 0) continue;
+
+        // Only the part of the layer inside this band
+        int x0 = max(x, (int)l->x), x1 = min(x + w, l->x + l->w);
+        int y0 = max(y, (int)l->y), y1 = min(y + h, l->y + l->h);
+        if (x0 >= x1 || y0 >= y1) continue;
+
+        size_t stride = (l->w * l->mask_bits + 7) / 8;
+        uint32_t opacity = l->opacity + 1;
+        for (int py = y0; py < y1; py++) {
+            int ly = py - l->y;
+            uint16_t* dst = band + (py - y) * w + (x0 - x);
+            const uint8_t* mrow = l->mask ? l->mask + ly * stride : nullptr;
+            const uint16_t* src = l->pixels ? l->pixels + ly * l->w : nullptr;
+
+            for (int lx = x0 - l->x; lx < x1 - l->x; lx++, dst++) {
+                uint32_t a = 255;
+                if (mrow && l->mask_bits == 1) {
+                    if (!((mrow[lx >> 3] << (lx & 7)) & 0x80)) continue;
+                } else if (mrow) {
+                    a = ((mrow[lx >> 1] >> ((lx & 1) ? 0 : 4)) & 0x0F) * 17;
+                    if (a == 0) continue;
+                }
+                a = (a * opacity) >> 8;
+
+                uint16_t fg = src ? src[lx] : l->color;
+                if (a < 255) {
+                    uint16_t bg = big_endian ? swap16(*dst) : *dst;
+                    fg = mix565(fg, bg, a);
+                }
+                *dst = big_endian ? swap16(fg) : fg;
+            }
+        }
+    }
+}
+
+void overlay_render_mask(uint8_t* mask, int w, int h, int bits, OverlayShapeFn shape, void* arg) {
+    size_t stride = (w * bits + 7) / 8;
+    memset(mask, 0, stride * h);
+    for (int y = 0; y < h; y++) {
+        uint8_t* row = mask + y * stride;
+        for (int x = 0; x < w; x++) {
+            int inside = 0;
+            for (int sy = 0; sy < 4; sy++) {
+                for (int sx = 0; sx < 4; sx++) {
+                    inside += shape(x + (sx + 0.5f) / 4, y + (sy + 0.5f) / 4, arg);
+                }
+            }
+            if (bits == 1) {
+                if (inside >= 8) row[x >> 3] |= 0x80 >> (x & 7);
+            } else {
+                int a = (inside * 15 + 8) / 16;
+                row[x >> 1] |= (x & 1) ? a : a << 4;
+            }
+        }
+    }
+}
@@ -0,0 +1,84 @@
+// overlay.h - Status icons and captions composited into the playing video
+// Anything drawn on the display outside the decoder's draw callback is
+// overwritten by the next frame. Instead, the decoder hands each band of
+// RGB565 pixels (a JPEG MCU row, or a palette-animation row) to blend()
+// just before the SPI push, and the visible layers are mixed into it there.
+// Layers cost only the pixels they cover: bands that miss every layer pass
+// through untouched, and there is no screen buffer and no second SPI pass.
+//
+// A layer is a solid color or an RGB565 bitmap, shaped by an alpha mask of
+// 1 bit (icons, text) or 4 bits (anti-aliased icons) per pixel, MSB first,
+// rows padded to whole bytes, and faded by a layer opacity. Coordinates are
+// those of the display rotation the video is drawn in.
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <Arduino.h>
+
+#define OVERLAY_MAX_LAYERS  8
+#define OVERLAY_FONT_W      6       // glcdfont cell, 5x7 glyph + spacing
+#define OVERLAY_FONT_H      8
+
+typedef struct {
+    int16_t x, y, w, h;
+    uint16_t color;             // Used when pixels is nullptr
+    const uint16_t* pixels;     // w x h native RGB565, or nullptr
+    const uint8_t* mask;        // nullptr = opaque rectangle
+    uint8_t mask_bits;          // 1 or 4
+    uint8_t opacity;            // 255 = as the mask says
+    bool visible;
+    uint8_t* owned;             // Text mask allocated by addText()
+    int16_t text_cap;           // Characters the text mask holds
+    uint8_t text_scale;
+} OverlayLayer;
+
+// Whether the point (x, y) of a mask lies inside a shape
+typedef bool (*OverlayShapeFn)(float x, float y, void* arg);
+
+class OverlayCompositor {
+public:
+    OverlayCompositor();
+    ~OverlayCompositor();
+
+    // Returns the layer id, or -1 when all layers are taken. The mask and
+    // pixels are not copied and must outlive the layer.
+    int add(int x, int y, int w, int h, uint16_t color, const uint8_t* mask = nullptr,
+            int mask_bits = 1, const uint16_t* pixels = nullptr);
+
+    // A text layer of up to max_chars glcdfont characters at scale 1..4
+    int addText(int x, int y, int max_chars, int scale, uint16_t color);
+    void setText(int id, const char* text);
+
+    void setVisible(int id, bool visible);
+    void setColor(int id, uint16_t color);
+    void setOpacity(int id, uint8_t opacity);
+    void setMask(int id, const uint8_t* mask, int mask_bits);
+    void move(int id, int x, int y);
+
+    // Blend every visible layer into a w x h band at (x, y) on screen
+    void blend(uint16_t* band, int x, int y, int w, int h, bool big_endian) const;
+
+    // True when any layer covers screen rows [y, y + h)
+    bool covers(int y, int h) const;
+
+    // True once after a change, so a paused or held frame can be redrawn
+    bool takeDirty();
+
+private:
+    bool valid(int id) const { return id >= 0 && id < count_; }
+
+    OverlayLayer layers_[OVERLAY_MAX_LAYERS];
+    int count_;
+    bool dirty_;
+};
+
+// Mask bytes for a w x h mask of 1 or 4 bits per pixel
+static inline size_t overlay_mask_size(int w, int h, int bits) {
+    return (size_t)((w * bits + 7) / 8) * h;
+}
+
+// Rasterize a shape into a mask, 4x4 samples per pixel
+void overlay_render_mask(uint8_t* mask, int w, int h, int bits, OverlayShapeFn shape, void* arg);
+
+#endif // OVERLAY_H
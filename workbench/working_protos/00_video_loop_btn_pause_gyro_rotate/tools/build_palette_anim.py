@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""Build a palette animation (/output.pan, see PaletteAnimClass.h).
+
+Frames come from ffmpeg as raw rgb24 at the clip size. One palette of up to
+256 RGB565 colors is picked for the whole clip by median cut, each frame is
+mapped to it without dithering (dither noise defeats the RLE) and compressed
+with byte RLE. A frame identical to the previous one is stored empty, and the
+player leaves the screen alone.
+
+Flat-colored clips such as the logo loop compress best. Encode at half size
+with --scale 2 and the player doubles every pixel while pushing it to the
+display:
+
+    ffmpeg -i logo.mp4 -vf "scale=160:120" -r 10 -f rawvideo -pix_fmt rgb24 logo.rgb
+    python3 build_palette_anim.py --size 160x120 --fps 10 --scale 2 logo.rgb ../data/output.pan
+
+The player picks /output.pan over /output.mjpeg when both are on flash.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = 0x314E4150   # "PAN1"
+HEADER = struct.Struct("<IHHHHBBHII")
+MAX_LITERAL = 128
+MIN_REPEAT = 3
+MAX_REPEAT = 130
+
+
+def rgb565(r, g, b):
+    return (r >> 3) << 11 | (g >> 2) << 5 | b >> 3
+
+
+def rgb888(c):
+    """8-bit channels of an RGB565 color."""
+    return ((c >> 11) & 0x1F) << 3, ((c >> 5) & 0x3F) << 2, (c & 0x1F) << 3
+
+
+def read_frames(path, width, height):
+    """RGB565 frames (lists of width * height ints) from an rgb24 file."""
+    size = width * height * 3
+    with open(path, "rb") as f:
+        data = f.read()
+    if not data or len(data) % size:
+        sys.exit(f"{path}: {len(data)} bytes is not a whole number of {width}x{height} rgb24 frames")
+    frames = []
+    for off in range(0, len(data), size):
+        px = data[off:off + size]
+        frames.append([rgb565(px[i], px[i + 1], px[i + 2]) for i in range(0, size, 3)])
+    return frames
+
+
+def median_cut(hist, colors):
+    """Split the clip's RGB565 histogram into at most `colors` boxes.
+    Returns (palette, index of every color in the histogram)."""
+    boxes = [[(rgb888(c), c, n) for c, n in hist.items()]]
+
+    def spread(box):
+        ranges = [max(e[0][k] for e in box) - min(e[0][k] for e in box) for k in range(3)]
+        k = max(range(3), key=lambda i: ranges[i])
+        return ranges[k] * sum(e[2] for e in box), k
+
+    while len(boxes) < colors:
+        scored = [(spread(b), i) for i, b in enumerate(boxes) if len(b) > 1]
+        if not scored:
+            break
+        (score, k), i = max(scored)
+        if score == 0:
+            break
+        box = sorted(boxes.pop(i), key=lambda e: e[0][k])
+        half, acc = sum(e[2] for e in box) / 2, 0
+        for cut, e in enumerate(box):
+            acc += e[2]
+            if acc >= half:
+                break
+        cut = min(max(cut + 1, 1), len(box) - 1)
+        boxes += [box[:cut], box[cut:]]
+
+    palette, index = [], {}
+    for i, box in enumerate(boxes):
+        total = sum(e[2] for e in box)
+        mean = [round(sum(e[0][k] * e[2] for e in box) / total) for k in range(3)]
+        palette.append(rgb565(*mean))
+        for e in box:
+            index[e[1]] = i
+    return palette, index
+
+
+def rle(indices):
+    """Byte RLE: c < 128 = c + 1 literals follow, c >= 128 = next byte x (c - 125)."""
+    out = bytearray()
+    literal = bytearray()
+    i, n = 0, len(indices)
+    while i < n:
+        run = 1
+        while i + run < n and run < MAX_REPEAT and indices[i + run] == indices[i]:
+            run += 1
+        if run >= MIN_REPEAT:
+            if literal:
+                out += bytes([len(literal) - 1]) + literal
+                literal = bytearray()
+            out += bytes([run + 125, indices[i]])
+            i += run
+            continue
+        literal.append(indices[i])
+        i += 1
+        if len(literal) == MAX_LITERAL:
+            out += bytes([MAX_LITERAL - 1]) + literal
+            literal = bytearray()
+    if literal:
+        out += bytes([len(literal) - 1]) + literal
+    return bytes(out)
+
+
+def unrle(data, n):
+    """PaletteAnimClass::decode(), for --check."""
+    out = bytearray()
+    i = 0
+    while len(out) < n:
+        c = data[i]
+        if c < 128:
+            out += data[i + 1:i + 2 + c]
+            i += 2 + c
+        else:
+            out += bytes([data[i + 1]]) * (c - 125)
+            i += 2
+    if len(out) != n or i != len(data):
+        raise ValueError("RLE stream does not match the frame size")
+    return bytes(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("input", help="rgb24 frames (ffmpeg -f rawvideo -pix_fmt rgb24)")
+    ap.add_argument("output")
+    ap.add_argument("--size", required=True, help="Frame size, WxH")
+    ap.add_argument("--fps", type=int, default=10)
+    ap.add_argument("--scale", type=int, choices=(1, 2), default=1,
+                    help="2 = player doubles every pixel (encode at half size)")
+    ap.add_argument("--colors", type=int, default=256)
+    ap.add_argument("--check", action="store_true", help="Decode every frame again and compare")
+    args = ap.parse_args()
+
+    width, height = (int(v) for v in args.size.lower().split("x"))
+    if not 1 <= args.colors <= 256:
+        sys.exit("--colors must be 1..256")
+    frames = read_frames(args.input, width, height)
+
+    hist = {}
+    for frame in frames:
+        for c in frame:
+            hist[c] = hist.get(c, 0) + 1
+    palette, index = median_cut(hist, args.colors)
+
+    encoded, previous, held = [], None, 0
+    for frame in frames:
+        indices = bytes(index[c] for c in frame)
+        if indices == previous:
+            encoded.append(b"")
+            held += 1
+            continue
+        data = rle(indices)
+        if args.check and unrle(data, width * height) != indices:
+            sys.exit("RLE round trip failed")
+        encoded.append(data)
+        previous = indices
+
+    max_frame = max(len(e) for e in encoded)
+    with open(args.output, "wb") as out:
+        out.write(HEADER.pack(MAGIC, width, height, len(frames), len(palette), args.scale,
+                              args.fps, 0, max_frame, 0))
+        out.write(struct.pack(f"<{len(palette)}H", *palette))
+        for data in encoded:
+            out.write(struct.pack("<I", len(data)) + data)
+
+    raw = width * height * 2 * len(frames)
+    size = HEADER.size + 2 * len(palette) + sum(4 + len(e) for e in encoded)
+    print(f"{len(frames)} frames {width}x{height} x{args.scale}, {len(hist)} colors -> "
+          f"{len(palette)}, {held} held")
+    print(f"Wrote {size // 1024} KB ({raw / size:.1f}x smaller than RGB565, largest frame "
+          f"{max_frame} bytes) to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,8 +1,8 @@
 #!/bin/bash
 set -e
 
-echo "ESP32-S3 FFat Upload Tool"
-echo "========================="
+echo "ESP32-S3 Asset Upload Tool"
+echo "=========================="
 echo
 
 if [ ! -d "data" ]; then
@@ -21,20 +21,11 @@ find data -type f -exec bash -c 'FILE="{}"; SIZE=$(stat -c%s "$FILE" 2>/dev/null
 echo "Total: $FILE_COUNT files"
 echo
 
-MKFATFS=$(find ~/.arduino15/packages/esp32/tools/mkfatfs -name "mkfatfs" -type f 2>/dev/null | head -1)
-if [ -z "$MKFATFS" ]; then
-    MKFATFS="./temp/mkfatfs"
-    if [ ! -f "$MKFATFS" ]; then
-        echo "ERROR: mkfatfs not found!"
-        exit 1
-    fi
-fi
-
-PARTITION_SIZE="10354688"
-FLASH_OFFSET="0x611000"
+PARTITION_SIZE="0x9E0000"
+FLASH_OFFSET="0x610000"
 
-echo "Creating filesystem image..."
-$MKFATFS -c data -t fatfs -s $PARTITION_SIZE ffat.bin
+echo "Creating asset image..."
+python3 ../../tools/build_asset_image.py --partition-size $PARTITION_SIZE data assets.bin
 
 ESPTOOL=$(which esptool.py 2>/dev/null || which esptool 2>/dev/null || find ~/.arduino15/packages/esp32/tools -name "esptool.py" -type f 2>/dev/null | head -1)
 if [ -z "$ESPTOOL" ]; then
@@ -62,9 +53,9 @@ if [[ ! $REPLY =~ ^[Yy]$ ]]; then
     exit 0
 fi
 
-python3 $ESPTOOL --chip esp32s3 --port $PORT --baud 460800 write_flash $FLASH_OFFSET ffat.bin
+python3 $ESPTOOL --chip esp32s3 --port $PORT --baud 460800 write_flash $FLASH_OFFSET assets.bin
 
 echo
-echo "SUCCESS! Files uploaded to FFat partition"
+echo "SUCCESS! Asset image uploaded to ffat partition"
 echo "Press RESET on ESP32"
-rm -f ffat.bin
+rm -f assets.bin
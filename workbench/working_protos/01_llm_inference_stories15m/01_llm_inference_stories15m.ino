@@ -1,5 +1,5 @@
 // 01_llm_inference.ino - SD Streaming LLM Inference
-// 15M parameter model with full SD card streaming
+// 15M parameter model, flash-mapped (q8 image) or full SD card streaming
 // Optimized with ESP-DSP SIMD + dual-core parallelization
 
 #include <SD.h>
@@ -22,11 +22,14 @@ const char* TOKENIZER_PATH = "/tok32000.bin";
 const float TEMPERATURE = 1.0f;
 const float TOPP = 0.9f;
 const int MAX_TOKENS = 256;
+const int BATCH_KV_LEN = 128;       // KV cache per batched sequence (15M: 1.7 MB)
+int gen_steps = MAX_TOKENS;         // /steps N; past seq_len the KV cache rolls
 
 // Global instances
 Transformer transformer;
 Tokenizer tokenizer;
 Sampler sampler;
+LoraAdapter lora;                   // /lora <path>: fine-tune delta over the base model
 
 bool model_loaded = false;
 
@@ -58,11 +61,18 @@ void setup() {
     Serial.printf("SD Card Size: %llu MB\n", cardSize);
     Serial.println();
 
-    // Load model from SD card (streaming mode)
-    Serial.println("Loading model (streaming)...");
-    if (!open_sd_model(&transformer, MODEL_PATH)) {
-        Serial.println("FAILED");
-        return;
+    // Prefer the flash-mapped image (tools/build_flash_model.py + partitions.csv):
+    // weights are read in place, so there is nothing to load
+    uint32_t t_load = millis();
+    if (map_flash_model(&transformer, FLASH_MODEL_LABEL)) {
+        Serial.printf("Model mapped from flash in %lu ms\n", millis() - t_load);
+    } else {
+        // Fall back to SD card streaming
+        Serial.println("Loading model (streaming)...");
+        if (!open_sd_model(&transformer, MODEL_PATH)) {
+            Serial.println("FAILED");
+            return;
+        }
     }
 
     Serial.printf("\nModel config:\n");
@@ -94,7 +104,12 @@ void setup() {
 
     Serial.println("========================================");
     Serial.println("Ready! Type prompt and press Enter");
-    Serial.println("Expected: 0.5-1 tok/s (SD streaming)");
+    Serial.printf("/batch N <prompt> samples N (<= %d) continuations at once\n", LLM_MAX_BATCH);
+    Serial.println("/steps N sets the generation length (may exceed seq_len)");
+    Serial.println("/lora <file> loads an adapter from SD; /lora off|on switches it");
+    if (transformer.use_streaming) {
+        Serial.println("Expected: 0.5-1 tok/s (SD streaming)");
+    }
     Serial.println("========================================\n");
 }
 
@@ -112,11 +127,60 @@ void loop() {
             return;
         }
 
-        Serial.printf("\nPrompt: %s\n", prompt.c_str());
-        Serial.println("Generating...\n");
+        if (prompt.startsWith("/steps ")) {
+            int steps = prompt.substring(7).toInt();
+            if (steps < 1) {
+                Serial.println("Usage: /steps N");
+                return;
+            }
+            gen_steps = steps;
+            Serial.printf("Generation length: %d tokens (KV cache %d positions, %d sink)\n",
+                          gen_steps, transformer.state.kv_len, transformer.state.n_sink);
+            return;
+        }
 
-        // Generate text
-        generate((char*)prompt.c_str(), MAX_TOKENS);
+        if (prompt.startsWith("/lora ")) {
+            String arg = prompt.substring(6);
+            arg.trim();
+            if (arg == "off") {
+                set_lora_adapter(&transformer, nullptr);
+                Serial.println("LoRA off: base model");
+            } else if (arg == "on") {
+                set_lora_adapter(&transformer, &lora);
+                Serial.println(transformer.lora ? "LoRA on" : "No adapter loaded");
+            } else {
+                // Swap: the old adapter is dropped before the new one is read
+                set_lora_adapter(&transformer, nullptr);
+                free_lora_adapter(&lora);
+                if (load_lora_adapter(&transformer, &lora, arg.c_str())) {
+                    set_lora_adapter(&transformer, &lora);
+                }
+            }
+            return;
+        }
+
+        if (prompt.startsWith("/batch ")) {
+            // "/batch N prompt": N sampled continuations, one layer pass per step
+            String rest = prompt.substring(7);
+            rest.trim();
+            int space = rest.indexOf(' ');
+            int n = (space > 0) ? rest.substring(0, space).toInt() : 0;
+            if (n < 1 || n > LLM_MAX_BATCH) {
+                Serial.printf("Usage: /batch N <prompt>  (N = 1..%d)\n", LLM_MAX_BATCH);
+                return;
+            }
+            String text = rest.substring(space + 1);
+            text.trim();
+            Serial.printf("\nPrompt: %s (batch of %d)\n", text.c_str(), n);
+            Serial.println("Generating...\n");
+            generate_batch((char*)text.c_str(), n, gen_steps);
+        } else {
+            Serial.printf("\nPrompt: %s\n", prompt.c_str());
+            Serial.println("Generating...\n");
+
+            // Generate text
+            generate((char*)prompt.c_str(), gen_steps);
+        }
 
         Serial.println("\n\n========================================");
         Serial.println("Enter another prompt:");
@@ -124,6 +188,21 @@ void loop() {
     }
 }
 
+// SD streaming: weight bytes read during the last generation and the rate
+// the card delivered them at (workbench/idf prints the same line)
+void print_sd_reads() {
+    if (!transformer.use_streaming || transformer.sd_read_us == 0) return;
+    Serial.printf("SD reads: %.1f MB in %lu ms (%.2f MB/s, %u reads)\n",
+                  transformer.sd_read_bytes / 1048576.0f, (unsigned long)(transformer.sd_read_us / 1000),
+                  transformer.sd_read_bytes / (float)transformer.sd_read_us, transformer.sd_reads);
+}
+
+void reset_sd_reads() {
+    transformer.sd_read_bytes = 0;
+    transformer.sd_read_us = 0;
+    transformer.sd_reads = 0;
+}
+
 // Generation function
 void generate(char* prompt, int steps) {
     // Encode prompt
@@ -138,6 +217,7 @@ void generate(char* prompt, int steps) {
     }
 
     // Generation loop
+    reset_sd_reads();
     unsigned long start_time = 0;
     int next;
     int token = prompt_tokens[0];
@@ -149,7 +229,7 @@ void generate(char* prompt, int steps) {
 
         // Check for failure
         if (!logits) {
-            Serial.println("\nERROR: Forward pass failed (SD streaming issue)");
+            Serial.println("\nERROR: Forward pass failed");
             free(prompt_tokens);
             return;
         }
@@ -192,7 +272,106 @@ void generate(char* prompt, int steps) {
         float tokens_per_sec = (float)(pos - 1) / (elapsed / 1000.0f);
         Serial.printf("\n\nPerformance: %.2f tok/s (%d tokens in %lu ms)\n",
                       tokens_per_sec, pos - 1, elapsed);
+        print_sd_reads();
+    }
+
+    free(prompt_tokens);
+}
+
+// Append a decoded piece, skipping raw bytes that do not print
+static void append_piece(String* out, const char* piece) {
+    if (piece == NULL || piece[0] == '\0') return;
+    if (piece[1] == '\0') {
+        unsigned char byte_val = piece[0];
+        if (!(isprint(byte_val) || isspace(byte_val))) return;
+    }
+    *out += piece;
+}
+
+// Batched generation: n sequences share the prompt and step in lockstep, so
+// every layer (SD streaming: every layer read) is applied to all of them at
+// once. Each sequence samples with its own RNG stream and stops on its own EOS.
+void generate_batch(char* prompt, int n, int steps) {
+    int num_prompt_tokens = 0;
+    int* prompt_tokens = (int*)malloc((strlen(prompt) + 3) * sizeof(int));
+    encode(&tokenizer, prompt, 1, 0, prompt_tokens, &num_prompt_tokens);
+    if (num_prompt_tokens < 1) {
+        Serial.println("ERROR: Encoding failed");
+        free(prompt_tokens);
+        return;
+    }
+
+    int kv_len = BATCH_KV_LEN < transformer.config.seq_len ? BATCH_KV_LEN : transformer.config.seq_len;
+    BatchState batch;
+    if (!malloc_batch_state(&batch, &transformer, n, kv_len)) {
+        free(prompt_tokens);
+        return;
+    }
+
+    // Samplers share the probindex scratch (sampling is sequential)
+    Sampler samplers[LLM_MAX_BATCH];
+    int tokens[LLM_MAX_BATCH];
+    bool done[LLM_MAX_BATCH];
+    String text[LLM_MAX_BATCH];
+    for (int i = 0; i < n; i++) {
+        samplers[i] = sampler;
+        samplers[i].rng_state = sampler.rng_state ^ (0x9E3779B97F4A7C15ULL * (i + 1));
+        tokens[i] = prompt_tokens[0];
+        done[i] = false;
+    }
+    sampler.rng_state ^= 0x2545F4914F6CDD1DULL;   // Next batch gets fresh streams
+
+    reset_sd_reads();
+    unsigned long start_time = 0;
+    int generated = 0;
+    int pos = 0;
+    int active = n;
+
+    while (pos < steps && active > 0) {
+        if (!forward_batch(&transformer, &batch, tokens, pos)) {
+            Serial.println("\nERROR: Batched forward pass failed");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            // Finished sequences keep stepping (lockstep) but their output is dropped
+            int next;
+            if (pos < num_prompt_tokens - 1) {
+                next = prompt_tokens[pos + 1];
+            } else {
+                next = sample(&samplers[i], batch.state[i].logits);
+            }
+            if (done[i]) continue;
+            if (next == 1) {
+                done[i] = true;
+                active--;
+                continue;
+            }
+            append_piece(&text[i], decode(&tokenizer, tokens[i], next));
+            tokens[i] = next;
+            if (start_time > 0) generated++;
+        }
+        pos++;
+        Serial.print(".");
+
+        // Start timer after first iteration
+        if (start_time == 0) {
+            start_time = millis();
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        Serial.printf("\n\n[%d] %s", i, text[i].c_str());
+    }
+
+    if (generated > 0) {
+        unsigned long elapsed = millis() - start_time;
+        Serial.printf("\n\nPerformance: %.2f tok/s aggregate, %.2f steps/s (%d tokens over %d steps in %lu ms)\n",
+                      generated / (elapsed / 1000.0f), (pos - 1) / (elapsed / 1000.0f),
+                      generated, pos - 1, elapsed);
+        print_sd_reads();
     }
 
+    free_batch_state(&batch);
     free(prompt_tokens);
 }
@@ -0,0 +1,26 @@
+// fast_math.cpp - Array forms of the fast_math.h kernels
+// Arduino builds with -Os, which would not inline the scalar kernels here
+#pragma GCC optimize("O2")
+
+#include "fast_math.h"
+
+float fast_exp_shift_sum(float* x, int n, float shift) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        x[i] = fast_expf(x[i] - shift);
+        sum += x[i];
+    }
+    return sum;
+}
+
+void fast_silu_mul(float* x, const float* gate, int n) {
+    for (int i = 0; i < n; i++) {
+        x[i] = fast_siluf(x[i]) * gate[i];
+    }
+}
+
+void fast_log10_array(float* out, const float* in, int n, float eps) {
+    for (int i = 0; i < n; i++) {
+        out[i] = fast_log2f(in[i] + eps) * FAST_LOG10_2;
+    }
+}
@@ -0,0 +1,90 @@
+// fast_math.h - Polynomial / bit-trick exp, log2, rsqrt and SiLU for hot loops
+// Replaces per-element libm calls in softmax (32000 logits per token), the
+// SwiGLU activation, rmsnorm and the mel log. Scalar forms are inline; the
+// array forms in fast_math.cpp are what the loops call. Worst-case errors
+// against libm, checked by tests/fast_math_test:
+//   fast_expf    |err| / ref            <= FAST_EXP_MAX_REL_ERR   (x in [-87, 88])
+//   fast_log2f   |err| / max(1, |ref|)  <= FAST_LOG2_MAX_ERR      (normal x > 0)
+//   fast_rsqrtf  |err| / ref            <= FAST_RSQRT_MAX_REL_ERR (normal x > 0)
+//   fast_siluf   |err| / max(1, |ref|)  <= FAST_SILU_MAX_ERR      (x in [-87, 88])
+
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <Arduino.h>
+
+#define FAST_EXP_MAX_REL_ERR    4e-7f
+#define FAST_LOG2_MAX_ERR       3e-7f
+#define FAST_RSQRT_MAX_REL_ERR  6e-6f
+#define FAST_SILU_MAX_ERR       3e-7f
+
+#define FAST_LOG10_2    0.30103000f     // log10(2)
+
+static inline float fast_bits_to_float(uint32_t u) {
+    float f;
+    memcpy(&f, &u, 4);
+    return f;
+}
+
+static inline uint32_t fast_float_to_bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, 4);
+    return u;
+}
+
+// e^x = 2^n * e^r, n = round(x / ln2), |r| <= ln2 / 2; e^r by degree-6 Taylor
+static inline float fast_expf(float x) {
+    if (x < -87.0f) return 0.0f;
+    if (x > 88.0f) x = 88.0f;
+    float t = x * 1.44269504f;
+    int n = (int)(t + (t >= 0.0f ? 0.5f : -0.5f));
+    // Cody-Waite: ln2 split so r keeps its low bits
+    float r = x - n * 0.693145752f;
+    r -= n * 1.42860677e-6f;
+    float p = 1.0f + r * (1.0f + r * (0.5f + r * (1.66666667e-1f + r * (4.16666667e-2f +
+              r * (8.33333333e-3f + r * 1.38888889e-3f)))));
+    // n in [-126, 127] after the clamps, so 2^n is a normal float
+    return p * fast_bits_to_float((uint32_t)(n + 127) << 23);
+}
+
+// log2(m * 2^e): m moved into [sqrt(1/2), sqrt(2)), then
+// ln(m) = 2 atanh(s), s = (m - 1) / (m + 1), |s| < 0.172, odd series to s^9
+static inline float fast_log2f(float x) {
+    uint32_t u = fast_float_to_bits(x);
+    int e = (int)((u >> 23) & 0xFF) - 127;
+    float m = fast_bits_to_float((u & 0x007FFFFF) | 0x3F800000);
+    if (m > 1.41421356f) {
+        m *= 0.5f;
+        e++;
+    }
+    float s = (m - 1.0f) / (m + 1.0f);
+    float s2 = s * s;
+    float ln_m = 2.0f * s * (1.0f + s2 * (3.33333333e-1f + s2 * (2.0e-1f + s2 * (1.42857143e-1f +
+                 s2 * 1.11111111e-1f))));
+    return e + ln_m * 1.44269504f;
+}
+
+// Bit-trick estimate plus two Newton steps
+static inline float fast_rsqrtf(float x) {
+    float y = fast_bits_to_float(0x5F375A86 - (fast_float_to_bits(x) >> 1));
+    float hx = 0.5f * x;
+    y *= 1.5f - hx * y * y;
+    y *= 1.5f - hx * y * y;
+    return y;
+}
+
+// x * sigmoid(x)
+static inline float fast_siluf(float x) {
+    return x / (1.0f + fast_expf(-x));
+}
+
+// x[i] = e^(x[i] - shift); returns the sum (softmax with shift = max)
+float fast_exp_shift_sum(float* x, int n, float shift);
+
+// x[i] = silu(x[i]) * gate[i] (SwiGLU)
+void fast_silu_mul(float* x, const float* gate, int n);
+
+// out[i] = log10(in[i] + eps)
+void fast_log10_array(float* out, const float* in, int n, float eps);
+
+#endif // FAST_MATH_H
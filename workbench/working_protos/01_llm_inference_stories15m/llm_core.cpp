@@ -1,9 +1,10 @@
-// llm_core.cpp - Core LLM inference with ESP-DSP SIMD and dual-core optimization
+// llm_core.cpp - Core LLM inference with blocked matmul kernels and dual-core optimization
 // Based on esp32-llm by karpathy/llama2.c with ESP32 optimizations
 
 #include "llm_core.h"
+#include "matmul_kernels.h"
+#include "fast_math.h"
 #include <FFat.h>
-#include <esp_dsp.h>
 
 // Global task handles and synchronization
 EventGroupHandle_t xEventGroup = NULL;
@@ -16,7 +17,14 @@ MatMulTaskParams* matmul_params = NULL;
 // ============================================================================
 
 void malloc_run_state(RunState* s, Config* p) {
+    malloc_run_state_kv(s, p, p->seq_len);
+}
+
+// KV cache for kv_len positions per layer (seq_len for a full context)
+void malloc_run_state_kv(RunState* s, Config* p, int kv_len) {
     int kv_dim = (p->dim * p->n_kv_heads) / p->n_heads;
+    s->kv_len = kv_len;
+    s->n_sink = kv_len > 2 * KV_SINK_TOKENS ? KV_SINK_TOKENS : 0;
 
     // Allocate activation buffers in PSRAM (not heap!)
     s->x = (v4sf*)ps_calloc(p->dim, sizeof(v4sf));
@@ -25,12 +33,13 @@ void malloc_run_state(RunState* s, Config* p) {
     s->hb = (v4sf*)ps_calloc(p->hidden_dim, sizeof(v4sf));
     s->hb2 = (v4sf*)ps_calloc(p->hidden_dim, sizeof(v4sf));
     s->q = (v4sf*)ps_calloc(p->dim, sizeof(v4sf));
-    s->key_cache = (v4sf*)ps_calloc(p->n_layers * p->seq_len * kv_dim, sizeof(v4sf));
-    s->value_cache = (v4sf*)ps_calloc(p->n_layers * p->seq_len * kv_dim, sizeof(v4sf));
-    s->att = (v4sf*)ps_calloc(p->n_heads * p->seq_len, sizeof(v4sf));
+    s->q_sink = (v4sf*)ps_calloc(p->dim, sizeof(v4sf));
+    s->key_cache = (v4sf*)ps_calloc(p->n_layers * kv_len * kv_dim, sizeof(v4sf));
+    s->value_cache = (v4sf*)ps_calloc(p->n_layers * kv_len * kv_dim, sizeof(v4sf));
+    s->att = (v4sf*)ps_calloc(p->n_heads * kv_len, sizeof(v4sf));
     s->logits = (v4sf*)ps_calloc(p->vocab_size, sizeof(v4sf));
 
-    if (!s->x || !s->xb || !s->xb2 || !s->hb || !s->hb2 || !s->q ||
+    if (!s->x || !s->xb || !s->xb2 || !s->hb || !s->hb2 || !s->q || !s->q_sink ||
         !s->key_cache || !s->value_cache || !s->att || !s->logits) {
         Serial.println("ERROR: RunState PSRAM allocation failed!");
     }
@@ -43,10 +52,34 @@ void free_run_state(RunState* s) {
     free(s->hb);
     free(s->hb2);
     free(s->q);
+    free(s->q_sink);
     free(s->att);
     free(s->logits);
     free(s->key_cache);
     free(s->value_cache);
+    memset(s, 0, sizeof(*s));
+}
+
+// Create FreeRTOS synchronization primitives and the dual-core matmul task
+static void start_matmul_task() {
+    xEventGroup = xEventGroupCreate();
+    semaDataReady = xSemaphoreCreateBinary();
+    xSemaphoreGive(semaDataReady);
+    xSemaphoreTake(semaDataReady, 0);
+
+    // Allocate task parameters
+    matmul_params = (MatMulTaskParams*)malloc(sizeof(MatMulTaskParams));
+
+    // Create dual-core matmul task on Core 1
+    xTaskCreatePinnedToCore(
+        matmul_task,
+        "MatMul",
+        4096,
+        matmul_params,
+        19,
+        &matmul_task_handle,
+        1  // Core 1
+    );
 }
 
 // ============================================================================
@@ -54,48 +87,41 @@ void free_run_state(RunState* s) {
 // ============================================================================
 
 void calculate_layer_offsets(Transformer* t) {
-    // Calculate byte offset for each layer's weights in the model file
+    // Calculate the file offset of each per-layer tensor (layer 0 slice)
     Config* p = &t->config;
     int head_size = p->dim / p->n_heads;
     size_t offset = sizeof(Config); // Start after config header
 
-    // Token embedding table (shared, loaded to PSRAM)
+    // Token embedding table (streamed per token)
     offset += p->vocab_size * p->dim * sizeof(v4sf);
 
-    // For each layer, calculate offsets
-    for (int l = 0; l < p->n_layers; l++) {
-        t->layer_offsets[l].offset = offset;
-        size_t layer_size = 0;
-
-        // RMS attention weight
-        layer_size += p->dim * sizeof(v4sf);
-
-        // Attention weights (wq, wk, wv, wo)
-        layer_size += p->dim * (p->n_heads * head_size) * sizeof(v4sf); // wq
-        layer_size += p->dim * (p->n_kv_heads * head_size) * sizeof(v4sf); // wk
-        layer_size += p->dim * (p->n_kv_heads * head_size) * sizeof(v4sf); // wv
-        layer_size += (p->n_heads * head_size) * p->dim * sizeof(v4sf); // wo
-
-        // RMS FFN weight
-        layer_size += p->dim * sizeof(v4sf);
-
-        // FFN weights (w1, w2, w3)
-        layer_size += p->dim * p->hidden_dim * sizeof(v4sf); // w1
-        layer_size += p->hidden_dim * p->dim * sizeof(v4sf); // w2
-        layer_size += p->dim * p->hidden_dim * sizeof(v4sf); // w3
-
-        t->layer_offsets[l].size = layer_size;
-        offset += layer_size;
-
-        Serial.printf("Layer %d: offset=%zu size=%zu KB\n", l,
-                      t->layer_offsets[l].offset,
-                      t->layer_offsets[l].size / 1024);
+    // Bytes per layer, in checkpoint order
+    size_t sizes[LAYER_TENSORS] = {
+        p->dim * sizeof(v4sf),                                  // rms_att
+        p->dim * (p->n_heads * head_size) * sizeof(v4sf),       // wq
+        p->dim * (p->n_kv_heads * head_size) * sizeof(v4sf),    // wk
+        p->dim * (p->n_kv_heads * head_size) * sizeof(v4sf),    // wv
+        (p->n_heads * head_size) * p->dim * sizeof(v4sf),       // wo
+        p->dim * sizeof(v4sf),                                  // rms_ffn
+        p->dim * p->hidden_dim * sizeof(v4sf),                  // w1
+        p->hidden_dim * p->dim * sizeof(v4sf),                  // w2
+        p->dim * p->hidden_dim * sizeof(v4sf),                  // w3
+    };
+
+    size_t layer_size = 0;
+    for (int i = 0; i < LAYER_TENSORS; i++) {
+        t->layer_tensors[i].offset = offset;
+        t->layer_tensors[i].size = sizes[i];
+        offset += sizes[i] * p->n_layers;
+        layer_size += sizes[i];
     }
+
+    Serial.printf("Layer size: %zu KB (%d reads per layer)\n", layer_size / 1024, LAYER_TENSORS);
 }
 
-bool open_sd_model(Transformer* t, const char* sd_path) {
+bool open_sd_model(Transformer* t, const char* sd_path, fs::FS& fs) {
     // Open model file from SD card
-    t->sd_file = SD.open(sd_path, FILE_READ);
+    t->sd_file = fs.open(sd_path, FILE_READ);
     if (!t->sd_file) {
         Serial.printf("Failed to open SD model: %s\n", sd_path);
         return false;
@@ -117,10 +143,11 @@ bool open_sd_model(Transformer* t, const char* sd_path) {
                   t->config.n_heads, t->config.vocab_size);
 
     // Allocate layer buffer in PSRAM (reused for each layer)
-    // Size: largest possible layer weight matrix
-    int head_size = t->config.dim / t->config.n_heads;
-    size_t max_layer_size = t->config.dim * t->config.hidden_dim * sizeof(v4sf) * 3; // w1, w2, w3
-    t->layer_buffer_size = max_layer_size;
+    calculate_layer_offsets(t);
+    t->layer_buffer_size = 0;
+    for (int i = 0; i < LAYER_TENSORS; i++) {
+        t->layer_buffer_size += t->layer_tensors[i].size;
+    }
     t->layer_buffer = (v4sf*)ps_malloc(t->layer_buffer_size);
 
     if (!t->layer_buffer) {
@@ -149,12 +176,9 @@ bool open_sd_model(Transformer* t, const char* sd_path) {
 
     Serial.printf("Embedding buffer allocated: %zu bytes (streaming mode)\n", single_emb_size);
 
-    // Calculate layer offsets in file
-    calculate_layer_offsets(t);
-
     // Load final RMS norm weight (after all layers)
-    size_t final_rms_offset = t->layer_offsets[t->config.n_layers - 1].offset +
-                               t->layer_offsets[t->config.n_layers - 1].size;
+    const LayerInfo* w3 = &t->layer_tensors[LAYER_TENSORS - 1];
+    size_t final_rms_offset = w3->offset + w3->size * t->config.n_layers;
     size_t final_rms_size = t->config.dim * sizeof(v4sf);
 
     t->weights.rms_final_weight = (v4sf*)ps_malloc(final_rms_size);
@@ -189,26 +213,7 @@ bool open_sd_model(Transformer* t, const char* sd_path) {
 
     Serial.printf("Run state allocated (free PSRAM: %d bytes)\n", ESP.getFreePsram());
 
-    // Create FreeRTOS synchronization primitives for dual-core matmul
-    xEventGroup = xEventGroupCreate();
-    semaDataReady = xSemaphoreCreateBinary();
-    xSemaphoreGive(semaDataReady);
-    xSemaphoreTake(semaDataReady, 0);
-
-    // Allocate task parameters
-    matmul_params = (MatMulTaskParams*)malloc(sizeof(MatMulTaskParams));
-
-    // Create dual-core matmul task on Core 1
-    xTaskCreatePinnedToCore(
-        matmul_task,
-        "MatMul",
-        4096,
-        matmul_params,
-        19,
-        &matmul_task_handle,
-        1  // Core 1
-    );
-
+    start_matmul_task();
     Serial.println("Dual-core task created");
 
     // Mark as using streaming
@@ -226,21 +231,28 @@ bool load_layer_from_sd(Transformer* t, int layer) {
         return false;
     }
 
-    // Seek to layer position in file
-    size_t offset = t->layer_offsets[layer].offset;
-    size_t size = t->layer_offsets[layer].size;
+    // DMA read this layer's slice of each tensor, back to back in the PSRAM buffer
+    uint32_t t0 = micros();
+    uint8_t* dst = (uint8_t*)t->layer_buffer;
+    for (int i = 0; i < LAYER_TENSORS; i++) {
+        size_t offset = t->layer_tensors[i].offset + layer * t->layer_tensors[i].size;
+        size_t size = t->layer_tensors[i].size;
 
-    if (!t->sd_file.seek(offset)) {
-        Serial.printf("Failed to seek to layer %d\n", layer);
-        return false;
-    }
+        if (!t->sd_file.seek(offset)) {
+            Serial.printf("Failed to seek to layer %d\n", layer);
+            return false;
+        }
 
-    // DMA read entire layer to PSRAM buffer
-    size_t bytes_read = t->sd_file.read((uint8_t*)t->layer_buffer, size);
-    if (bytes_read != size) {
-        Serial.printf("Layer %d read failed: %zu/%zu bytes\n", layer, bytes_read, size);
-        return false;
+        size_t bytes_read = t->sd_file.read(dst, size);
+        if (bytes_read != size) {
+            Serial.printf("Layer %d read failed: %zu/%zu bytes\n", layer, bytes_read, size);
+            return false;
+        }
+        dst += size;
     }
+    t->sd_read_us += (uint32_t)(micros() - t0);
+    t->sd_read_bytes += dst - (uint8_t*)t->layer_buffer;
+    t->sd_reads += LAYER_TENSORS;
 
     // Map weight pointers to layer buffer
     Config* p = &t->config;
@@ -289,6 +301,7 @@ bool load_token_embedding(Transformer* t, int token) {
     size_t offset = t->embedding_offset + (token * token_emb_size);
 
     // Seek to token embedding
+    uint32_t t0 = micros();
     if (!t->sd_file.seek(offset)) {
         return false;
     }
@@ -298,6 +311,9 @@ bool load_token_embedding(Transformer* t, int token) {
     if (bytes_read != token_emb_size) {
         return false;
     }
+    t->sd_read_us += (uint32_t)(micros() - t0);
+    t->sd_read_bytes += bytes_read;
+    t->sd_reads++;
 
     return true;
 }
@@ -382,22 +398,353 @@ bool read_checkpoint(const char* checkpoint, Config* config, TransformerWeights*
     return true;
 }
 
+// ============================================================================
+// Flash-Mapped Weights
+// ============================================================================
+
+static size_t align_image(size_t offset) {
+    return (offset + FLASH_MODEL_ALIGN - 1) & ~(size_t)(FLASH_MODEL_ALIGN - 1);
+}
+
+// Q8 image layout after the header (each block FLASH_MODEL_ALIGN aligned):
+//   fp32 rms_att[L*dim], rms_ffn[L*dim], rms_final[dim]
+//   per matrix, int8 q[n] then fp32 s[n / group_size]:
+//   token_embedding, wq, wk, wv, wo, w1, w2, w3, [wcls if not shared]
+static size_t map_q8_weights(Transformer* t, uint8_t* data, int shared_weights) {
+    Config* p = &t->config;
+    TransformerWeights* w = &t->weights;
+    QuantizedWeights* qw = &t->qweights;
+    int head_size = p->dim / p->n_heads;
+    size_t n_layers = p->n_layers;
+    size_t offset = 0;
+
+    v4sf** norms[] = {&w->rms_att_weight, &w->rms_ffn_weight, &w->rms_final_weight};
+    size_t norm_sizes[] = {n_layers * p->dim, n_layers * p->dim, (size_t)p->dim};
+    for (int i = 0; i < 3; i++) {
+        *norms[i] = (v4sf*)(data + offset);
+        offset = align_image(offset + norm_sizes[i] * sizeof(v4sf));
+    }
+
+    QuantizedTensor* mats[] = {&qw->token_embedding_table, &qw->wq, &qw->wk, &qw->wv, &qw->wo,
+                               &qw->w1, &qw->w2, &qw->w3, &qw->wcls};
+    size_t mat_sizes[] = {
+        (size_t)p->vocab_size * p->dim,
+        n_layers * p->dim * (p->n_heads * head_size),
+        n_layers * p->dim * (p->n_kv_heads * head_size),
+        n_layers * p->dim * (p->n_kv_heads * head_size),
+        n_layers * (p->n_heads * head_size) * p->dim,
+        n_layers * p->dim * p->hidden_dim,
+        n_layers * p->hidden_dim * p->dim,
+        n_layers * p->dim * p->hidden_dim,
+        (size_t)p->vocab_size * p->dim,
+    };
+    int n_mats = shared_weights ? 8 : 9;
+    for (int i = 0; i < n_mats; i++) {
+        mats[i]->q = (int8_t*)(data + offset);
+        offset = align_image(offset + mat_sizes[i]);
+        mats[i]->s = (float*)(data + offset);
+        offset = align_image(offset + mat_sizes[i] / t->group_size * sizeof(float));
+    }
+    if (shared_weights) {
+        qw->wcls = qw->token_embedding_table;
+    }
+    return offset;
+}
+
+// Reject headers that would divide by zero or lay weights out nonsensically
+static bool config_valid(const Config* p) {
+    return p->dim > 0 && p->hidden_dim > 0 && p->n_layers > 0 && p->n_heads > 0 &&
+           p->n_kv_heads > 0 && p->n_kv_heads <= p->n_heads && p->n_heads % p->n_kv_heads == 0 &&
+           p->dim % p->n_heads == 0 && (p->dim / p->n_heads) % 2 == 0 &&
+           p->vocab_size > 0 && p->seq_len > 0;
+}
+
+// Bytes memory_map_weights() lays out (the fp32 image after its header)
+static uint64_t f32_weights_size(const Config* p, int shared_weights) {
+    uint64_t dim = p->dim, hidden = p->hidden_dim, n_layers = p->n_layers;
+    uint64_t head_size = dim / p->n_heads;
+    uint64_t kv_dim = p->n_kv_heads * head_size;
+    uint64_t per_layer = 2 * dim + dim * dim * 2 + dim * kv_dim * 2 + 3 * dim * hidden;
+    uint64_t n = (uint64_t)p->vocab_size * dim + n_layers * per_layer + dim +
+                 (uint64_t)p->seq_len * head_size;
+    if (!shared_weights) n += (uint64_t)p->vocab_size * dim;
+    return n * sizeof(v4sf);
+}
+
+bool map_flash_model(Transformer* t, const char* label) {
+    const esp_partition_t* part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)FLASH_MODEL_SUBTYPE, label);
+    if (!part) {
+        Serial.printf("No flash model partition '%s'\n", label);
+        return false;
+    }
+
+    FlashModelHeader hdr;
+    if (esp_partition_read(part, 0, &hdr, sizeof(hdr)) != ESP_OK) {
+        Serial.printf("ERROR: Cannot read partition '%s'\n", label);
+        return false;
+    }
+    if (hdr.magic != FLASH_MODEL_MAGIC || hdr.version != FLASH_MODEL_VERSION) {
+        Serial.printf("ERROR: Partition '%s' has no model image (magic %08x v%u)\n",
+                      label, hdr.magic, hdr.version);
+        return false;
+    }
+    Config cfg = hdr.config;
+    int shared_weights = cfg.vocab_size > 0 ? 1 : 0;
+    cfg.vocab_size = abs(cfg.vocab_size);
+    if (!config_valid(&cfg)) {
+        Serial.printf("ERROR: Bad model config in '%s' (dim %d, %d layers, %d/%d heads)\n",
+                      label, cfg.dim, cfg.n_layers, cfg.n_heads, cfg.n_kv_heads);
+        return false;
+    }
+    size_t image_size = (size_t)hdr.data_offset + hdr.data_size;
+    if (image_size > part->size) {
+        Serial.printf("ERROR: Model image (%zu bytes) larger than partition (%u bytes)\n",
+                      image_size, (unsigned)part->size);
+        return false;
+    }
+    if (hdr.dtype == WEIGHTS_Q8 && (hdr.group_size == 0 ||
+            hdr.config.dim % hdr.group_size || hdr.config.hidden_dim % hdr.group_size)) {
+        Serial.printf("ERROR: Bad Q8 group size %u\n", hdr.group_size);
+        return false;
+    }
+
+    // Map the whole image into the data address space (64 KB MMU pages)
+    const void* base = nullptr;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(part, 0, image_size, ESP_PARTITION_MMAP_DATA,
+                                       &base, &handle);
+    if (err != ESP_OK) {
+        Serial.printf("ERROR: esp_partition_mmap failed (%d)\n", err);
+        return false;
+    }
+
+    // Lay the weights out in a scratch Transformer; *t is only touched once
+    // the image checks out, so a caller falling back to SD or FFat still
+    // sees an fp32 model with no Q8 state
+    Transformer m = {};
+    m.config = cfg;
+    m.group_size = hdr.group_size;
+    uint8_t* data = (uint8_t*)base + hdr.data_offset;
+    const char* error = nullptr;
+    if (hdr.dtype == WEIGHTS_F32) {
+        if (f32_weights_size(&m.config, shared_weights) > hdr.data_size) {
+            error = "fp32 image truncated";
+        } else {
+            memory_map_weights(&m.weights, &m.config, (v4sf*)data, shared_weights);
+        }
+    } else if (hdr.dtype == WEIGHTS_Q8) {
+        if (map_q8_weights(&m, data, shared_weights) > hdr.data_size) {
+            error = "Q8 image truncated";
+        } else {
+            int max_dim = m.config.hidden_dim > m.config.dim ? m.config.hidden_dim : m.config.dim;
+            m.xq = (int8_t*)malloc(max_dim);
+            m.xq_scale = (v4sf*)malloc(max_dim / m.group_size * sizeof(v4sf));
+            if (!m.xq || !m.xq_scale) {
+                error = "Q8 activation buffer allocation failed!";
+            }
+        }
+    } else {
+        error = "Unknown weight type";
+    }
+    if (error) {
+        Serial.printf("ERROR: %s (dtype %u)\n", error, hdr.dtype);
+        free(m.xq);
+        free(m.xq_scale);
+        esp_partition_munmap(handle);
+        return false;
+    }
+
+    t->flash_mapped = true;
+    t->flash_handle = handle;
+    t->use_streaming = false;
+    t->data = nullptr;
+    t->file_size = image_size;
+    t->config = m.config;
+    t->weights = m.weights;
+    t->qweights = m.qweights;
+    t->weight_type = hdr.dtype;
+    t->group_size = m.group_size;
+    t->xq = m.xq;
+    t->xq_scale = m.xq_scale;
+
+    Serial.printf("Flash model mapped: %zu KB %s at %p (partition '%s' @ 0x%x)\n",
+                  image_size / 1024, hdr.dtype == WEIGHTS_Q8 ? "q8" : "fp32", base,
+                  label, (unsigned)part->address);
+
+    malloc_run_state(&t->state, &t->config);
+    RunState* s = &t->state;
+    if (!s->x || !s->xb || !s->xb2 || !s->hb || !s->hb2 || !s->q ||
+        !s->key_cache || !s->value_cache || !s->att || !s->logits) {
+        Serial.println("ERROR: Run state allocation failed!");
+        free_transformer(t);
+        return false;
+    }
+
+    start_matmul_task();
+    Serial.println("Transformer built successfully");
+    return true;
+}
+
+// ============================================================================
+// LoRA Adapters
+// ============================================================================
+
+// Input / output size of each LoRA target
+static void lora_shape(const Config* p, int target, int* n, int* d) {
+    int kv_dim = (p->dim * p->n_kv_heads) / p->n_heads;
+    switch (target) {
+    case LORA_WK:
+    case LORA_WV: *n = p->dim; *d = kv_dim; break;
+    case LORA_W1:
+    case LORA_W3: *n = p->dim; *d = p->hidden_dim; break;
+    case LORA_W2: *n = p->hidden_dim; *d = p->dim; break;
+    default:      *n = p->dim; *d = p->dim; break;
+    }
+}
+
+bool load_lora_adapter(Transformer* t, LoraAdapter* a, const char* sd_path, fs::FS& fs) {
+    Config* p = &t->config;
+    int kv_dim = (p->dim * p->n_kv_heads) / p->n_heads;
+    memset(a, 0, sizeof(LoraAdapter));
+
+    File f = fs.open(sd_path, FILE_READ);
+    if (!f) {
+        Serial.printf("Failed to open LoRA adapter: %s\n", sd_path);
+        return false;
+    }
+
+    LoraHeader* hdr = &a->header;
+    if (f.read((uint8_t*)hdr, sizeof(LoraHeader)) != sizeof(LoraHeader) ||
+        hdr->magic != LORA_MAGIC || hdr->version != LORA_VERSION) {
+        Serial.printf("ERROR: %s is not a LoRA v%d adapter\n", sd_path, LORA_VERSION);
+        f.close();
+        return false;
+    }
+    if (hdr->dim != p->dim || hdr->hidden_dim != p->hidden_dim ||
+        hdr->n_layers != p->n_layers || hdr->kv_dim != kv_dim) {
+        Serial.printf("ERROR: Adapter is for dim=%d hidden=%d layers=%d, model is %d/%d/%d\n",
+                      hdr->dim, hdr->hidden_dim, hdr->n_layers,
+                      p->dim, p->hidden_dim, p->n_layers);
+        f.close();
+        return false;
+    }
+    if (hdr->rank < 1 || hdr->rank > LORA_MAX_RANK || hdr->target_mask == 0 ||
+        hdr->target_mask >= (1u << LORA_TARGETS)) {
+        Serial.printf("ERROR: Bad adapter rank %u / targets 0x%x\n", hdr->rank, hdr->target_mask);
+        f.close();
+        return false;
+    }
+
+    // Tensor layout, checked against the file size before reading
+    size_t floats = 0;
+    int r = hdr->rank;
+    for (int target = 0; target < LORA_TARGETS; target++) {
+        if (!(hdr->target_mask & (1u << target))) continue;
+        int n, d;
+        lora_shape(p, target, &n, &d);
+        floats += (size_t)p->n_layers * r * (n + d);
+    }
+    a->size = floats * sizeof(v4sf);
+    if (f.size() != sizeof(LoraHeader) + a->size) {
+        Serial.printf("ERROR: Adapter is %u bytes, header implies %u\n",
+                      (unsigned)f.size(), (unsigned)(sizeof(LoraHeader) + a->size));
+        f.close();
+        return false;
+    }
+
+    int max_dim = p->hidden_dim > p->dim ? p->hidden_dim : p->dim;
+    a->data = (v4sf*)ps_malloc(a->size);
+    a->tmp = (v4sf*)ps_malloc(r * sizeof(v4sf));
+    a->out = (v4sf*)ps_malloc(max_dim * sizeof(v4sf));
+    if (!a->data || !a->tmp || !a->out) {
+        Serial.printf("ERROR: No PSRAM for %u KB adapter\n", (unsigned)(a->size / 1024));
+        free_lora_adapter(a);
+        f.close();
+        return false;
+    }
+    size_t bytes_read = f.read((uint8_t*)a->data, a->size);
+    f.close();
+    if (bytes_read != a->size) {
+        Serial.printf("ERROR: Adapter read failed: %u/%u bytes\n",
+                      (unsigned)bytes_read, (unsigned)a->size);
+        free_lora_adapter(a);
+        return false;
+    }
+
+    v4sf* ptr = a->data;
+    for (int target = 0; target < LORA_TARGETS; target++) {
+        if (!(hdr->target_mask & (1u << target))) continue;
+        int n, d;
+        lora_shape(p, target, &n, &d);
+        a->a[target] = ptr;
+        ptr += (size_t)p->n_layers * r * n;
+        a->b[target] = ptr;
+        ptr += (size_t)p->n_layers * d * r;
+    }
+
+    Serial.printf("LoRA adapter loaded: %s, rank %d, scale %.3f, targets 0x%02x, %u KB\n",
+                  sd_path, r, hdr->scale, hdr->target_mask, (unsigned)(a->size / 1024));
+    return true;
+}
+
+void free_lora_adapter(LoraAdapter* a) {
+    free(a->data);
+    free(a->tmp);
+    free(a->out);
+    memset(a, 0, sizeof(LoraAdapter));
+}
+
+void set_lora_adapter(Transformer* t, const LoraAdapter* a) {
+    t->lora = (a && a->data) ? a : nullptr;
+}
+
+// xout += scale * B·(A·x) for one layer projection: rank * (n + d) MACs on
+// this core, next to the n * d of the base matmul
+static void lora_apply(Transformer* t, int target, int layer, v4sf* xout, const v4sf* x,
+                       int n, int d) {
+    const LoraAdapter* a = t->lora;
+    if (!a || !a->a[target]) return;
+
+    int r = a->header.rank;
+    const v4sf* A = a->a[target] + (size_t)layer * r * n;
+    const v4sf* B = a->b[target] + (size_t)layer * d * r;
+    matmul_rows_f32(a->tmp, x, A, n, 0, r);
+    matmul_rows_f32(a->out, a->tmp, B, r, 0, d);
+
+    v4sf scale = a->header.scale;
+    for (int i = 0; i < d; i++) {
+        xout[i] += scale * a->out[i];
+    }
+}
+
 // ============================================================================
 // Dual-Core Matrix Multiplication Task
 // ============================================================================
 
+// Rows [p->start, p->end) of the matmul p describes, MATMUL_ROW_BLOCK rows
+// (or all batched sequences) per weight load
+static void matmul_range(const MatMulTaskParams* p) {
+    if (p->nseq > 0 && p->wq) {
+        matmul_rows_q8_batch(p->xout_batch, p->xq_batch, p->xs_batch, p->nseq, p->wq, p->ws,
+                             p->n, p->group_size, p->start, p->end);
+    } else if (p->nseq > 0) {
+        matmul_rows_f32_batch(p->xout_batch, p->x_batch, p->nseq, p->w, p->n, p->start, p->end);
+    } else if (p->wq) {
+        matmul_rows_q8(p->xout, p->xq, p->xs, p->wq, p->ws, p->n, p->group_size,
+                       p->start, p->end);
+    } else {
+        matmul_rows_f32(p->xout, p->x, p->w, p->n, p->start, p->end);
+    }
+}
+
 void matmul_task(void* params) {
     MatMulTaskParams* p = (MatMulTaskParams*)params;
 
     for (;;) {
         if (xSemaphoreTake(semaDataReady, portMAX_DELAY) == pdTRUE) {
-            // Process second half of matrix multiply using ESP-DSP SIMD
-            for (int i = p->start; i < p->end; i++) {
-                v4sf val = 0.0f;
-                v4sf* row = &p->w[i * p->n];
-                dsps_dotprod_f32_aes3(row, p->x, &val, p->n);
-                p->xout[i] = val;
-            }
+            // Process second half of matrix multiply
+            matmul_range(p);
 
             xSemaphoreGive(semaDataReady);
             xEventGroupSync(xEventGroup, p->task_num, ALL_SYNC_BITS, portMAX_DELAY);
@@ -416,7 +763,7 @@ void rmsnorm(v4sf* o, v4sf* x, v4sf* weight, int size) {
     }
     ss /= size;
     ss += 1e-5f;
-    ss = 1.0f / sqrtf(ss);
+    ss = fast_rsqrtf(ss);
 
     for (int j = 0; j < size; j++) {
         o[j] = weight[j] * (ss * x[j]);
@@ -429,29 +776,27 @@ void softmax(v4sf* x, int size) {
         if (x[i] > max_val) max_val = x[i];
     }
 
-    v4sf sum = 0.0f;
-    for (int i = 0; i < size; i++) {
-        x[i] = expf(x[i] - max_val);
-        sum += x[i];
-    }
+    v4sf sum = fast_exp_shift_sum(x, size, max_val);
 
     for (int i = 0; i < size; i++) {
         x[i] /= sum;
     }
 }
 
-void matmul(v4sf* xout, v4sf* x, v4sf* w, int n, int d) {
-    // Split work: Core 0 does first half, Core 1 does second half
-    *matmul_params = (MatMulTaskParams){xout, x, w, d / 2, d, n, d, TASK_1_BIT};
+// Split work on a row-block boundary: Core 0 does the first half, Core 1 the second
+static void matmul_dispatch(const MatMulTaskParams* params) {
+    int split = matmul_split(params->d);
+    *matmul_params = *params;
+    matmul_params->start = split;
+    matmul_params->end = params->d;
+    matmul_params->task_num = TASK_1_BIT;
     xSemaphoreGive(semaDataReady);
 
-    // Core 0: Process first half using ESP-DSP SIMD
-    for (int i = 0; i < d / 2; i++) {
-        v4sf val = 0.0f;
-        v4sf* row = &w[i * n];
-        dsps_dotprod_f32_aes3(row, x, &val, n);
-        xout[i] = val;
-    }
+    // Core 0: first half
+    MatMulTaskParams first = *params;
+    first.start = 0;
+    first.end = split;
+    matmul_range(&first);
 
     // Wait for Core 1 to finish
     if (xSemaphoreTake(semaDataReady, portMAX_DELAY) == pdTRUE) {
@@ -460,10 +805,223 @@ void matmul(v4sf* xout, v4sf* x, v4sf* w, int n, int d) {
     }
 }
 
+void matmul(v4sf* xout, v4sf* x, v4sf* w, int n, int d) {
+    MatMulTaskParams params = {};
+    params.xout = xout;
+    params.x = x;
+    params.w = w;
+    params.n = n;
+    params.d = d;
+    matmul_dispatch(&params);
+}
+
+void matmul_batch(v4sf** xout, v4sf** x, int nseq, v4sf* w, int n, int d) {
+    MatMulTaskParams params = {};
+    params.w = w;
+    params.n = n;
+    params.d = d;
+    params.nseq = nseq;
+    params.xout_batch = xout;
+    params.x_batch = x;
+    matmul_dispatch(&params);
+}
+
+// Quantize x into xq / xs, symmetric per group
+static void quantize_activations(const v4sf* x, int n, int gs, int8_t* xq, v4sf* xs) {
+    for (int g = 0; g < n / gs; g++) {
+        v4sf wmax = 0.0f;
+        for (int i = 0; i < gs; i++) {
+            v4sf v = fabsf(x[g * gs + i]);
+            if (v > wmax) wmax = v;
+        }
+        v4sf scale = wmax / 127.0f;
+        v4sf inv = scale > 0.0f ? 1.0f / scale : 0.0f;
+        xs[g] = scale;
+        for (int i = 0; i < gs; i++) {
+            xq[g * gs + i] = (int8_t)roundf(x[g * gs + i] * inv);
+        }
+    }
+}
+
+// Rows [row, row + d) of a Q8 matrix with n columns, split across both cores
+void matmul_q8(Transformer* t, v4sf* xout, v4sf* x, const QuantizedTensor* w, size_t row, int n, int d) {
+    int gs = t->group_size;
+    quantize_activations(x, n, gs, t->xq, t->xq_scale);
+
+    MatMulTaskParams params = {};
+    params.xout = xout;
+    params.n = n;
+    params.d = d;
+    params.wq = w->q + row * n;
+    params.ws = w->s + row * n / gs;
+    params.xq = t->xq;
+    params.xs = t->xq_scale;
+    params.group_size = gs;
+    matmul_dispatch(&params);
+}
+
+static void matmul_q8_batch(Transformer* t, BatchState* b, v4sf** xout, v4sf** x,
+                            const QuantizedTensor* w, size_t row, int n, int d) {
+    int gs = t->group_size;
+    for (int i = 0; i < b->n; i++) {
+        quantize_activations(x[i], n, gs, b->xq[i], b->xq_scale[i]);
+    }
+
+    MatMulTaskParams params = {};
+    params.n = n;
+    params.d = d;
+    params.wq = w->q + row * n;
+    params.ws = w->s + row * n / gs;
+    params.group_size = gs;
+    params.nseq = b->n;
+    params.xout_batch = xout;
+    params.xq_batch = b->xq;
+    params.xs_batch = b->xq_scale;
+    matmul_dispatch(&params);
+}
+
+// Layer matmul over whichever weights are loaded, plus the active LoRA delta
+// for target. Rows of layer start at layer * d in the stacked tensor
+// (streaming buffers hold one layer only)
+static void layer_matmul(Transformer* t, v4sf* xout, v4sf* x, v4sf* w, const QuantizedTensor* qw,
+                         int target, int layer, int n, int d) {
+    size_t row = (size_t)layer * d;
+    if (t->weight_type == WEIGHTS_Q8) {
+        matmul_q8(t, xout, x, qw, row, n, d);
+    } else {
+        matmul(xout, x, t->use_streaming ? w : w + row * n, n, d);
+    }
+    lora_apply(t, target, layer, xout, x, n, d);
+}
+
+static void layer_matmul_batch(Transformer* t, BatchState* b, v4sf** xout, v4sf** x, v4sf* w,
+                               const QuantizedTensor* qw, int target, int layer, int n, int d) {
+    size_t row = (size_t)layer * d;
+    if (t->weight_type == WEIGHTS_Q8) {
+        matmul_q8_batch(t, b, xout, x, qw, row, n, d);
+    } else {
+        matmul_batch(xout, x, b->n, t->use_streaming ? w : w + row * n, n, d);
+    }
+    for (int i = 0; i < b->n; i++) {
+        lora_apply(t, target, layer, xout[i], x[i], n, d);
+    }
+}
+
 // ============================================================================
 // Transformer Forward Pass
 // ============================================================================
 
+// Copy the embedding of token into x
+static bool embed_token(Transformer* t, int token, v4sf* x) {
+    int dim = t->config.dim;
+    if (t->use_streaming) {
+        // SD STREAMING: Load token embedding from SD card
+        if (!load_token_embedding(t, token)) {
+            Serial.printf("Failed to load embedding for token %d\n", token);
+            return false;
+        }
+        // embedding_buffer already contains the token embedding
+        memcpy(x, t->embedding_buffer, dim * sizeof(*x));
+    } else if (t->weight_type == WEIGHTS_Q8) {
+        // Flash Q8: dequantize the embedding row
+        const QuantizedTensor* emb = &t->qweights.token_embedding_table;
+        size_t base = (size_t)token * dim;
+        for (int i = 0; i < dim; i++) {
+            x[i] = emb->q[base + i] * emb->s[(base + i) / t->group_size];
+        }
+    } else {
+        // PSRAM / flash fp32 mode: embedding table fully addressable
+        v4sf* content_row = t->weights.token_embedding_table + token * dim;
+        memcpy(x, content_row, dim * sizeof(*x));
+    }
+    return true;
+}
+
+// Cache slot of pos. Past kv_len the sink slots stay and the remaining
+// kv_len - n_sink slots hold the most recent positions as a ring.
+int kv_cache_slot(const RunState* s, int pos) {
+    if (pos < s->kv_len) return pos;
+    int window = s->kv_len - s->n_sink;
+    return s->n_sink + (pos - s->n_sink) % window;
+}
+
+// Point s->k / s->v at this position's slot in the layer l KV cache
+static void kv_slot(Config* p, RunState* s, int l, int pos) {
+    int kv_dim = (p->dim * p->n_kv_heads) / p->n_heads;
+    int loff = l * s->kv_len * kv_dim;
+    int slot = kv_cache_slot(s, pos);
+    s->k = s->key_cache + loff + slot * kv_dim;
+    s->v = s->value_cache + loff + slot * kv_dim;
+}
+
+// RoPE positional encoding of the first size entries of vec at pos
+static void rope(v4sf* vec, int size, int head_size, int pos) {
+    for (int i = 0; i < size; i += 2) {
+        int head_dim = i % head_size;
+        v4sf freq = 1.0f / powf(10000.0f, head_dim / (v4sf)head_size);
+        v4sf val = pos * freq;
+        v4sf fcr = cosf(val);
+        v4sf fci = sinf(val);
+        v4sf v0 = vec[i];
+        v4sf v1 = vec[i + 1];
+        vec[i] = v0 * fcr - v1 * fci;
+        vec[i + 1] = v0 * fci + v1 * fcr;
+    }
+}
+
+// RoPE on s->q / s->k, then multi-head attention over the cached slots into s->xb.
+// Keys keep the rotation of their own position, so window slots see their true
+// distance. Once the cache has rolled, sink slots are scored with the query
+// rotated at kv_len - 1, placing them just before the window: distances stay
+// within seq_len however long the session runs.
+static void attention(Config* p, RunState* s, int l, int pos) {
+    int dim = p->dim;
+    int kv_dim = (p->dim * p->n_kv_heads) / p->n_heads;
+    int kv_mul = p->n_heads / p->n_kv_heads;
+    int head_size = dim / p->n_heads;
+    int loff = l * s->kv_len * kv_dim;
+    bool rolled = pos >= s->kv_len;
+    int n_slots = rolled ? s->kv_len : pos + 1;
+    int n_sink = rolled ? s->n_sink : 0;
+
+    if (n_sink > 0) {
+        memcpy(s->q_sink, s->q, dim * sizeof(v4sf));
+        rope(s->q_sink, dim, head_size, s->kv_len - 1);
+    }
+    rope(s->q, dim, head_size, pos);
+    rope(s->k, kv_dim, head_size, pos);
+
+    // Multi-head attention
+    for (int h = 0; h < p->n_heads; h++) {
+        v4sf* q = s->q + h * head_size;
+        v4sf* q_sink = s->q_sink + h * head_size;
+        v4sf* att = s->att + h * s->kv_len;
+
+        for (int t = 0; t < n_slots; t++) {
+            v4sf* k = s->key_cache + loff + t * kv_dim + (h / kv_mul) * head_size;
+            v4sf* qt = t < n_sink ? q_sink : q;
+            v4sf score = 0.0f;
+            for (int i = 0; i < head_size; i++) {
+                score += qt[i] * k[i];
+            }
+            score /= sqrtf(head_size);
+            att[t] = score;
+        }
+
+        softmax(att, n_slots);
+
+        v4sf* xb = s->xb + h * head_size;
+        memset(xb, 0, head_size * sizeof(v4sf));
+        for (int t = 0; t < n_slots; t++) {
+            v4sf* v = s->value_cache + loff + t * kv_dim + (h / kv_mul) * head_size;
+            v4sf a = att[t];
+            for (int i = 0; i < head_size; i++) {
+                xb[i] += a * v[i];
+            }
+        }
+    }
+}
+
 v4sf* forward(Transformer* transformer, int token, int pos) {
     Config* p = &transformer->config;
     TransformerWeights* w = &transformer->weights;
@@ -478,23 +1036,11 @@ v4sf* forward(Transformer* transformer, int token, int pos) {
     v4sf* x = s->x;
     int dim = p->dim;
     int kv_dim = (p->dim * p->n_kv_heads) / p->n_heads;
-    int kv_mul = p->n_heads / p->n_kv_heads;
     int hidden_dim = p->hidden_dim;
-    int head_size = dim / p->n_heads;
 
     // Copy token embedding into x
-    if (transformer->use_streaming) {
-        // SD STREAMING: Load token embedding from SD card
-        if (!load_token_embedding(transformer, token)) {
-            Serial.printf("Failed to load embedding for token %d\n", token);
-            return nullptr;
-        }
-        // embedding_buffer already contains the token embedding
-        memcpy(x, transformer->embedding_buffer, dim * sizeof(*x));
-    } else {
-        // PSRAM mode: embedding table fully loaded
-        v4sf* content_row = w->token_embedding_table + token * dim;
-        memcpy(x, content_row, dim * sizeof(*x));
+    if (!embed_token(transformer, token, x)) {
+        return nullptr;
     }
 
     // Progress: Start new line for this token
@@ -518,67 +1064,17 @@ v4sf* forward(Transformer* transformer, int token, int pos) {
         rmsnorm(s->xb, x, rms_att, dim);
 
         // QKV projections
-        int loff = l * p->seq_len * kv_dim;
-        s->k = s->key_cache + loff + pos * kv_dim;
-        s->v = s->value_cache + loff + pos * kv_dim;
-
-        // Weight pointers (indexed for PSRAM mode, base for streaming mode)
-        v4sf* wq_ptr = transformer->use_streaming ? w->wq : (w->wq + l * dim * dim);
-        v4sf* wk_ptr = transformer->use_streaming ? w->wk : (w->wk + l * dim * kv_dim);
-        v4sf* wv_ptr = transformer->use_streaming ? w->wv : (w->wv + l * dim * kv_dim);
-
-        matmul(s->q, s->xb, wq_ptr, dim, dim);
-        matmul(s->k, s->xb, wk_ptr, dim, kv_dim);
-        matmul(s->v, s->xb, wv_ptr, dim, kv_dim);
-
-        // RoPE positional encoding
-        for (int i = 0; i < dim; i += 2) {
-            int head_dim = i % head_size;
-            v4sf freq = 1.0f / powf(10000.0f, head_dim / (v4sf)head_size);
-            v4sf val = pos * freq;
-            v4sf fcr = cosf(val);
-            v4sf fci = sinf(val);
-            int rotn = i < kv_dim ? 2 : 1;
-            for (int v = 0; v < rotn; v++) {
-                v4sf* vec = v == 0 ? s->q : s->k;
-                v4sf v0 = vec[i];
-                v4sf v1 = vec[i + 1];
-                vec[i] = v0 * fcr - v1 * fci;
-                vec[i + 1] = v0 * fci + v1 * fcr;
-            }
-        }
+        kv_slot(p, s, l, pos);
 
-        // Multi-head attention
-        for (int h = 0; h < p->n_heads; h++) {
-            v4sf* q = s->q + h * head_size;
-            v4sf* att = s->att + h * p->seq_len;
+        QuantizedWeights* qw = &transformer->qweights;
+        layer_matmul(transformer, s->q, s->xb, w->wq, &qw->wq, LORA_WQ, l, dim, dim);
+        layer_matmul(transformer, s->k, s->xb, w->wk, &qw->wk, LORA_WK, l, dim, kv_dim);
+        layer_matmul(transformer, s->v, s->xb, w->wv, &qw->wv, LORA_WV, l, dim, kv_dim);
 
-            for (int t = 0; t <= pos; t++) {
-                v4sf* k = s->key_cache + loff + t * kv_dim + (h / kv_mul) * head_size;
-                v4sf score = 0.0f;
-                for (int i = 0; i < head_size; i++) {
-                    score += q[i] * k[i];
-                }
-                score /= sqrtf(head_size);
-                att[t] = score;
-            }
-
-            softmax(att, pos + 1);
-
-            v4sf* xb = s->xb + h * head_size;
-            memset(xb, 0, head_size * sizeof(v4sf));
-            for (int t = 0; t <= pos; t++) {
-                v4sf* v = s->value_cache + loff + t * kv_dim + (h / kv_mul) * head_size;
-                v4sf a = att[t];
-                for (int i = 0; i < head_size; i++) {
-                    xb[i] += a * v[i];
-                }
-            }
-        }
+        attention(p, s, l, pos);
 
         // Output projection
-        v4sf* wo_ptr = transformer->use_streaming ? w->wo : (w->wo + l * dim * dim);
-        matmul(s->xb2, s->xb, wo_ptr, dim, dim);
+        layer_matmul(transformer, s->xb2, s->xb, w->wo, &qw->wo, LORA_WO, l, dim, dim);
 
         // Residual connection
         for (int i = 0; i < dim; i++) {
@@ -590,22 +1086,13 @@ v4sf* forward(Transformer* transformer, int token, int pos) {
         rmsnorm(s->xb, x, rms_ffn, dim);
 
         // FFN
-        v4sf* w1_ptr = transformer->use_streaming ? w->w1 : (w->w1 + l * dim * hidden_dim);
-        v4sf* w2_ptr = transformer->use_streaming ? w->w2 : (w->w2 + l * dim * hidden_dim);
-        v4sf* w3_ptr = transformer->use_streaming ? w->w3 : (w->w3 + l * dim * hidden_dim);
-
-        matmul(s->hb, s->xb, w1_ptr, dim, hidden_dim);
-        matmul(s->hb2, s->xb, w3_ptr, dim, hidden_dim);
-
-        // SwiGLU activation
-        for (int i = 0; i < hidden_dim; i++) {
-            v4sf val = s->hb[i];
-            val *= (1.0f / (1.0f + expf(-val)));
-            val *= s->hb2[i];
-            s->hb[i] = val;
-        }
+        layer_matmul(transformer, s->hb, s->xb, w->w1, &qw->w1, LORA_W1, l, dim, hidden_dim);
+        layer_matmul(transformer, s->hb2, s->xb, w->w3, &qw->w3, LORA_W3, l, dim, hidden_dim);
 
-        matmul(s->xb, s->hb, w2_ptr, hidden_dim, dim);
+        // SwiGLU activation: hb = silu(hb) * hb2
+        fast_silu_mul(s->hb, s->hb2, hidden_dim);
+
+        layer_matmul(transformer, s->xb, s->hb, w->w2, &qw->w2, LORA_W2, l, hidden_dim, dim);
 
         // Residual connection
         for (int i = 0; i < dim; i++) {
@@ -635,14 +1122,188 @@ v4sf* forward(Transformer* transformer, int token, int pos) {
             s->logits[i] = val;
         }
         Serial.print(" ");
+    } else if (transformer->weight_type == WEIGHTS_Q8) {
+        matmul_q8(transformer, s->logits, x, &transformer->qweights.wcls, 0, dim, p->vocab_size);
     } else {
-        // PSRAM mode: full wcls matrix available
+        // PSRAM / flash fp32 mode: full wcls matrix available
         matmul(s->logits, x, w->wcls, dim, p->vocab_size);
     }
 
     return s->logits;
 }
 
+// ============================================================================
+// Batched Forward Pass
+// ============================================================================
+
+bool malloc_batch_state(BatchState* b, Transformer* t, int n, int kv_len) {
+    Config* p = &t->config;
+    memset(b, 0, sizeof(BatchState));
+    if (n < 1 || n > LLM_MAX_BATCH || kv_len < 1 || kv_len > p->seq_len) {
+        Serial.printf("ERROR: Batch of %d x %d positions not supported (max %d x %d)\n",
+                      n, kv_len, LLM_MAX_BATCH, p->seq_len);
+        return false;
+    }
+
+    int max_dim = p->hidden_dim > p->dim ? p->hidden_dim : p->dim;
+    for (int i = 0; i < n; i++) {
+        malloc_run_state_kv(&b->state[i], p, kv_len);
+        b->n = i + 1;
+        RunState* s = &b->state[i];
+        if (!s->x || !s->key_cache || !s->value_cache || !s->logits) {
+            Serial.printf("ERROR: No PSRAM for batch sequence %d\n", i);
+            free_batch_state(b);
+            return false;
+        }
+        if (t->weight_type == WEIGHTS_Q8) {
+            b->xq[i] = (int8_t*)malloc(max_dim);
+            b->xq_scale[i] = (v4sf*)malloc(max_dim / t->group_size * sizeof(v4sf));
+            if (!b->xq[i] || !b->xq_scale[i]) {
+                Serial.println("ERROR: Failed to allocate batch activation buffers");
+                free_batch_state(b);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void free_batch_state(BatchState* b) {
+    for (int i = 0; i < b->n; i++) {
+        free_run_state(&b->state[i]);
+        free(b->xq[i]);
+        free(b->xq_scale[i]);
+    }
+    memset(b, 0, sizeof(BatchState));
+}
+
+// Same math as forward(), but every layer (and in streaming mode every vocab
+// embedding) is loaded once per step and applied to all b->n sequences
+bool forward_batch(Transformer* t, BatchState* b, const int* tokens, int pos) {
+    Config* p = &t->config;
+    TransformerWeights* w = &t->weights;
+    QuantizedWeights* qw = &t->qweights;
+    int n = b->n;
+    int dim = p->dim;
+    int kv_dim = (p->dim * p->n_kv_heads) / p->n_heads;
+    int hidden_dim = p->hidden_dim;
+
+    if (pos < 0) {
+        return false;
+    }
+
+    // Per-sequence buffer tables for the batched matmuls
+    v4sf* x[LLM_MAX_BATCH];
+    v4sf* xb[LLM_MAX_BATCH];
+    v4sf* xb2[LLM_MAX_BATCH];
+    v4sf* hb[LLM_MAX_BATCH];
+    v4sf* hb2[LLM_MAX_BATCH];
+    v4sf* q[LLM_MAX_BATCH];
+    v4sf* k[LLM_MAX_BATCH];
+    v4sf* v[LLM_MAX_BATCH];
+    v4sf* logits[LLM_MAX_BATCH];
+    for (int i = 0; i < n; i++) {
+        RunState* s = &b->state[i];
+        x[i] = s->x;
+        xb[i] = s->xb;
+        xb2[i] = s->xb2;
+        hb[i] = s->hb;
+        hb2[i] = s->hb2;
+        q[i] = s->q;
+        logits[i] = s->logits;
+        if (!embed_token(t, tokens[i], s->x)) {
+            return false;
+        }
+    }
+
+    if (t->use_streaming) {
+        Serial.print("\n-> ");
+    }
+
+    for (unsigned long long l = 0; l < p->n_layers; l++) {
+        // SD STREAMING: one layer load serves every sequence
+        if (t->use_streaming) {
+            Serial.printf("[L%llu]", l);
+            if (!load_layer_from_sd(t, l)) {
+                Serial.printf("\nFailed to load layer %llu from SD\n", l);
+                return false;
+            }
+        }
+
+        // Attention RMSnorm
+        v4sf* rms_att = t->use_streaming ? w->rms_att_weight : (w->rms_att_weight + l * dim);
+        for (int i = 0; i < n; i++) {
+            rmsnorm(xb[i], x[i], rms_att, dim);
+            kv_slot(p, &b->state[i], l, pos);
+            k[i] = b->state[i].k;
+            v[i] = b->state[i].v;
+        }
+
+        // QKV projections
+        layer_matmul_batch(t, b, q, xb, w->wq, &qw->wq, LORA_WQ, l, dim, dim);
+        layer_matmul_batch(t, b, k, xb, w->wk, &qw->wk, LORA_WK, l, dim, kv_dim);
+        layer_matmul_batch(t, b, v, xb, w->wv, &qw->wv, LORA_WV, l, dim, kv_dim);
+
+        for (int i = 0; i < n; i++) {
+            attention(p, &b->state[i], l, pos);
+        }
+
+        // Output projection + residual
+        layer_matmul_batch(t, b, xb2, xb, w->wo, &qw->wo, LORA_WO, l, dim, dim);
+        v4sf* rms_ffn = t->use_streaming ? w->rms_ffn_weight : (w->rms_ffn_weight + l * dim);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < dim; j++) {
+                x[i][j] += xb2[i][j];
+            }
+            rmsnorm(xb[i], x[i], rms_ffn, dim);
+        }
+
+        // FFN
+        layer_matmul_batch(t, b, hb, xb, w->w1, &qw->w1, LORA_W1, l, dim, hidden_dim);
+        layer_matmul_batch(t, b, hb2, xb, w->w3, &qw->w3, LORA_W3, l, dim, hidden_dim);
+        for (int i = 0; i < n; i++) {
+            fast_silu_mul(hb[i], hb2[i], hidden_dim);
+        }
+        layer_matmul_batch(t, b, xb, hb, w->w2, &qw->w2, LORA_W2, l, hidden_dim, dim);
+
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < dim; j++) {
+                x[i][j] += xb[i][j];
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        rmsnorm(x[i], x[i], w->rms_final_weight, dim);
+    }
+
+    // Classifier
+    if (t->use_streaming) {
+        // One SD read per vocab embedding, dotted with every sequence
+        Serial.print("[CLS]");
+        for (int tok = 0; tok < p->vocab_size; tok++) {
+            if (!load_token_embedding(t, tok)) {
+                Serial.printf("\nFailed to load vocab embedding %d\n", tok);
+                return false;
+            }
+            for (int i = 0; i < n; i++) {
+                float val = 0.0f;
+                for (int j = 0; j < dim; j++) {
+                    val += x[i][j] * t->embedding_buffer[j];
+                }
+                logits[i][tok] = val;
+            }
+        }
+        Serial.print(" ");
+    } else if (t->weight_type == WEIGHTS_Q8) {
+        matmul_q8_batch(t, b, logits, x, &qw->wcls, 0, dim, p->vocab_size);
+    } else {
+        matmul_batch(logits, x, n, w->wcls, dim, p->vocab_size);
+    }
+
+    return true;
+}
+
 // ============================================================================
 // Transformer Initialization
 // ============================================================================
@@ -653,47 +1314,44 @@ bool build_transformer(Transformer* t, const char* checkpoint_path) {
     }
 
     malloc_run_state(&t->state, &t->config);
-
-    // Create FreeRTOS synchronization primitives
-    xEventGroup = xEventGroupCreate();
-    semaDataReady = xSemaphoreCreateBinary();
-    xSemaphoreGive(semaDataReady);
-    xSemaphoreTake(semaDataReady, 0);
-
-    // Allocate task parameters
-    matmul_params = (MatMulTaskParams*)malloc(sizeof(MatMulTaskParams));
-
-    // Create dual-core matmul task on Core 1
-    xTaskCreatePinnedToCore(
-        matmul_task,
-        "MatMul",
-        4096,
-        matmul_params,
-        19,
-        &matmul_task_handle,
-        1  // Core 1
-    );
+    start_matmul_task();
 
     Serial.println("Transformer built successfully");
     return true;
 }
 
 void free_transformer(Transformer* t) {
-    if (t->data) {
-        free(t->data);
+    // Everything is reset as well as freed: a fallback loader reuses t, and
+    // a second call must not free anything twice
+    free(t->data);
+    t->data = nullptr;
+    if (t->flash_mapped) {
+        esp_partition_munmap(t->flash_handle);
+        t->flash_mapped = false;
     }
+    free(t->xq);
+    free(t->xq_scale);
+    t->xq = nullptr;
+    t->xq_scale = nullptr;
+    t->weight_type = WEIGHTS_F32;
+    t->group_size = 0;
+    memset(&t->qweights, 0, sizeof(t->qweights));
     free_run_state(&t->state);
 
     if (matmul_task_handle) {
         vTaskDelete(matmul_task_handle);
+        matmul_task_handle = NULL;
     }
     if (xEventGroup) {
         vEventGroupDelete(xEventGroup);
+        xEventGroup = NULL;
     }
     if (semaDataReady) {
         vSemaphoreDelete(semaDataReady);
+        semaDataReady = NULL;
     }
     if (matmul_params) {
         free(matmul_params);
+        matmul_params = NULL;
     }
 }
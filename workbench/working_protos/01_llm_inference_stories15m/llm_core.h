@@ -1,6 +1,7 @@
 // llm_core.h - Core LLM inference engine for ESP32-S3
-// Optimized with ESP-DSP SIMD and dual-core parallelization
+// Optimized with register-blocked matmul kernels and dual-core parallelization
 // SD CARD STREAMING support for large models (15M+ parameters)
+// FLASH-MAPPED weights (fp32 or int8) from a raw data partition
 
 #ifndef LLM_CORE_H
 #define LLM_CORE_H
@@ -11,13 +12,45 @@
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
 #include <freertos/semphr.h>
+#include <esp_partition.h>
+#include "matmul_kernels.h"
 
 // Enable SD card streaming for models > 8MB
 #define USE_SD_STREAMING 1
 
+// Flash model image (tools/build_flash_model.py), written to a raw data
+// partition and mapped through the MMU so weights are read in place
+#define FLASH_MODEL_MAGIC       0x464D4C4C  // "LLMF"
+#define FLASH_MODEL_VERSION     1
+#define FLASH_MODEL_SUBTYPE     0x40        // Custom data subtype (partitions.csv)
+#define FLASH_MODEL_LABEL       "model"
+#define FLASH_MODEL_ALIGN       16          // Tensor alignment inside the image
+
+// Rolling KV cache: once pos reaches kv_len, the first KV_SINK_TOKENS
+// positions stay ("attention sinks") and the rest of the cache is a ring of
+// the most recent positions, so generation can run past seq_len
+#define KV_SINK_TOKENS          4
+
 // Type alias for float (matching esp32-llm)
 typedef float v4sf;
 
+// LoRA adapter file (tools/build_lora_adapter.py): low-rank deltas for the
+// layer projections, applied at matmul time as xout += scale * B·(A·x)
+#define LORA_MAGIC              0x41524F4C  // "LORA"
+#define LORA_VERSION            1
+#define LORA_MAX_RANK           64
+
+typedef enum {
+    LORA_WQ = 0,
+    LORA_WK,
+    LORA_WV,
+    LORA_WO,
+    LORA_W1,
+    LORA_W2,
+    LORA_W3,
+    LORA_TARGETS
+} LoraTarget;
+
 // Configuration structure
 typedef struct {
     int dim;
@@ -29,6 +62,21 @@ typedef struct {
     int seq_len;
 } Config;
 
+// Weight storage
+#define WEIGHTS_F32 0
+#define WEIGHTS_Q8  1               // int8 + one fp32 scale per group_size values
+
+// Flash image header (little-endian, weights start at data_offset)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dtype;                 // WEIGHTS_F32 / WEIGHTS_Q8
+    uint32_t group_size;            // Q8 only
+    Config config;                  // vocab_size < 0: separate classifier
+    uint32_t data_offset;
+    uint32_t data_size;
+} FlashModelHeader;
+
 // Transformer weights (raw pointers for zero-copy memory mapping)
 typedef struct {
     v4sf* token_embedding_table;
@@ -45,6 +93,49 @@ typedef struct {
     v4sf* wcls;
 } TransformerWeights;
 
+// Q8 matrix: row-major int8 values, scale s[i / group_size] for value i
+typedef struct {
+    int8_t* q;
+    float* s;
+} QuantizedTensor;
+
+// Q8 image matrices (RMS norm weights stay fp32 in TransformerWeights)
+typedef struct {
+    QuantizedTensor token_embedding_table;
+    QuantizedTensor wq;
+    QuantizedTensor wk;
+    QuantizedTensor wv;
+    QuantizedTensor wo;
+    QuantizedTensor w1;
+    QuantizedTensor w2;
+    QuantizedTensor w3;
+    QuantizedTensor wcls;
+} QuantizedWeights;
+
+// Adapter file header; tensors follow for each target bit set in target_mask,
+// in LoraTarget order: A [n_layers][rank][n] then B [n_layers][d][rank] (fp32)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t rank;
+    uint32_t target_mask;       // 1 << LoraTarget
+    float scale;                // alpha / rank
+    int dim;                    // Must match the model
+    int hidden_dim;
+    int n_layers;
+    int kv_dim;
+} LoraHeader;
+
+typedef struct {
+    LoraHeader header;
+    v4sf* data;                 // Whole file body in PSRAM
+    size_t size;
+    v4sf* a[LORA_TARGETS];      // nullptr for targets the adapter leaves alone
+    v4sf* b[LORA_TARGETS];
+    v4sf* tmp;                  // A·x (rank)
+    v4sf* out;                  // B·(A·x) before scaling (largest d)
+} LoraAdapter;
+
 // Run state (activation buffers)
 typedef struct {
     v4sf* x;
@@ -53,12 +144,15 @@ typedef struct {
     v4sf* hb;
     v4sf* hb2;
     v4sf* q;
+    v4sf* q_sink;               // Rolling cache: query rotated for the sink slots
     v4sf* k;
     v4sf* v;
     v4sf* att;
     v4sf* logits;
     v4sf* key_cache;
     v4sf* value_cache;
+    int kv_len;                 // Positions per layer in key/value_cache
+    int n_sink;                 // Slots kept when pos wraps (KV_SINK_TOKENS)
 } RunState;
 
 // SD card streaming layer info
@@ -67,6 +161,11 @@ typedef struct {
     size_t size;        // Size in bytes
 } LayerInfo;
 
+// llama2.c checkpoints store each tensor for all layers back to back, so one
+// layer is LAYER_TENSORS slices: rms_att, wq, wk, wv, wo, rms_ffn, w1, w2, w3.
+// layer_tensors[i].offset is the slice for layer 0, .size the bytes per layer.
+#define LAYER_TENSORS 9
+
 // Main transformer structure (with SD streaming support)
 typedef struct {
     Config config;
@@ -80,11 +179,35 @@ typedef struct {
     bool use_streaming;         // True if model > 8MB
     v4sf* layer_buffer;         // PSRAM buffer for current layer (~2MB)
     size_t layer_buffer_size;
-    LayerInfo layer_offsets[32]; // Offset info for each layer
+    LayerInfo layer_tensors[LAYER_TENSORS]; // Per-layer tensors in the file (see below)
     size_t embedding_offset;    // Offset of embedding table in file
     v4sf* embedding_buffer;     // Small buffer for single token embedding
+    uint64_t sd_read_bytes;     // Weight bytes read from SD, and the time the
+    uint64_t sd_read_us;        // seeks + reads took (micros(), i.e. esp_timer)
+    uint32_t sd_reads;
+
+    // Flash-mapped image (weights read in place, nothing copied)
+    bool flash_mapped;
+    esp_partition_mmap_handle_t flash_handle;
+    int weight_type;            // WEIGHTS_F32 / WEIGHTS_Q8
+    int group_size;
+    QuantizedWeights qweights;
+    int8_t* xq;                 // Q8: activations quantized per group
+    v4sf* xq_scale;
+
+    const LoraAdapter* lora;    // Active adapter, nullptr for the base model
 } Transformer;
 
+// Batched decode: N sequences step together, sharing every layer load
+#define LLM_MAX_BATCH MATMUL_MAX_BATCH
+
+typedef struct {
+    int n;
+    RunState state[LLM_MAX_BATCH];  // Activations + KV cache per sequence
+    int8_t* xq[LLM_MAX_BATCH];      // Q8 images: quantized activations per sequence
+    v4sf* xq_scale[LLM_MAX_BATCH];
+} BatchState;
+
 // Task parameters for dual-core parallelization
 typedef struct {
     v4sf* xout;
@@ -95,6 +218,20 @@ typedef struct {
     int n;
     int d;
     int task_num;
+
+    // Q8 matmul (wq != NULL): w is unused, x is pre-quantized
+    const int8_t* wq;
+    const float* ws;
+    const int8_t* xq;
+    const float* xs;
+    int group_size;
+
+    // Batched (nseq > 0): xout/x/xq/xs above are replaced by per-sequence arrays
+    int nseq;
+    v4sf* const* xout_batch;
+    const v4sf* const* x_batch;
+    const int8_t* const* xq_batch;
+    const float* const* xs_batch;
 } MatMulTaskParams;
 
 typedef struct {
@@ -126,25 +263,45 @@ extern MatMulTaskParams* matmul_params;
 
 // Core functions
 void malloc_run_state(RunState* s, Config* p);
+void malloc_run_state_kv(RunState* s, Config* p, int kv_len);
 void free_run_state(RunState* s);
 void memory_map_weights(TransformerWeights* w, Config* p, v4sf* ptr, int shared_weights);
 bool read_checkpoint(const char* checkpoint, Config* config, TransformerWeights* weights, v4sf** data, size_t* file_size);
 bool build_transformer(Transformer* t, const char* checkpoint_path);
 void free_transformer(Transformer* t);
 
-// SD card streaming functions
-bool open_sd_model(Transformer* t, const char* sd_path);
+// SD card streaming functions. fs is where the model lives: SD (Arduino SPI
+// driver) by default, or any fs::FS over a VFS mount (workbench/idf)
+bool open_sd_model(Transformer* t, const char* sd_path, fs::FS& fs = SD);
 bool load_layer_from_sd(Transformer* t, int layer);
 bool load_token_embedding(Transformer* t, int token);
 void calculate_layer_offsets(Transformer* t);
 
+// Flash-mapped weights (falls back to false if the partition is missing)
+bool map_flash_model(Transformer* t, const char* label);
+
+// LoRA adapters: load from SD into PSRAM, then switch with set_lora_adapter()
+// (nullptr = base model) at any point between forward() calls
+bool load_lora_adapter(Transformer* t, LoraAdapter* a, const char* sd_path, fs::FS& fs = SD);
+void free_lora_adapter(LoraAdapter* a);
+void set_lora_adapter(Transformer* t, const LoraAdapter* a);
+
 // Neural net operations
 void rmsnorm(v4sf* o, v4sf* x, v4sf* weight, int size);
 void softmax(v4sf* x, int size);
 void matmul(v4sf* xout, v4sf* x, v4sf* w, int n, int d);
+void matmul_q8(Transformer* t, v4sf* xout, v4sf* x, const QuantizedTensor* w, size_t row, int n, int d);
 
-// Forward pass
+// Forward pass. pos may exceed kv_len: the cache then rolls (see KV_SINK_TOKENS)
 v4sf* forward(Transformer* transformer, int token, int pos);
+int kv_cache_slot(const RunState* s, int pos);
+
+// Batched forward pass: tokens[i] at pos for every sequence in b; logits in
+// b->state[i].logits. kv_len (at most seq_len) sets the KV memory per sequence.
+bool malloc_batch_state(BatchState* b, Transformer* t, int n, int kv_len);
+void free_batch_state(BatchState* b);
+bool forward_batch(Transformer* t, BatchState* b, const int* tokens, int pos);
+void matmul_batch(v4sf** xout, v4sf** x, int nseq, v4sf* w, int n, int d);
 
 // Task functions (must be public for FreeRTOS)
 void matmul_task(void* params);
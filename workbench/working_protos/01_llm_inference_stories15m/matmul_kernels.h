@@ -0,0 +1,43 @@
+// matmul_kernels.h - Register-blocked matrix-vector kernels for the LLM
+// One pass computes MATMUL_ROW_BLOCK output rows, so each x[j] loaded from
+// memory feeds that many multiply-adds instead of one. With weights in PSRAM
+// or mapped flash this cuts activation reloads by 4x and keeps four
+// independent accumulators in FPU registers. Row ranges handed to the two
+// cores start on block boundaries (matmul_split).
+
+#ifndef MATMUL_KERNELS_H
+#define MATMUL_KERNELS_H
+
+#include <Arduino.h>
+
+#define MATMUL_ROW_BLOCK 4
+#define MATMUL_MAX_BATCH 4      // Activation vectors per weight row (batched decode)
+
+// xout[i] = w[i, :] . x for rows [start, end) of a row-major d x n matrix
+void matmul_rows_f32(float* xout, const float* x, const float* w, int n, int start, int end);
+
+// Same, one dsps_dotprod_f32_aes3 call per row (reference / benchmark)
+void matmul_rows_f32_dsp(float* xout, const float* x, const float* w, int n, int start, int end);
+
+// Q8 rows: int8 weights and activations with one scale per group_size
+// values; int32 sums per group, scaled by weight and activation scales
+void matmul_rows_q8(float* xout, const int8_t* xq, const float* xs, const int8_t* wq,
+                    const float* ws, int n, int group_size, int start, int end);
+
+// One Q8 row (reference / benchmark)
+float dot_q8(const int8_t* w, const float* ws, const int8_t* x, const float* xs, int n, int group_size);
+
+// Batched rows: nseq (1..MATMUL_MAX_BATCH) activation vectors share every
+// weight row load, xout[s][i] = w[i, :] . x[s]
+void matmul_rows_f32_batch(float* const* xout, const float* const* x, int nseq, const float* w,
+                           int n, int start, int end);
+void matmul_rows_q8_batch(float* const* xout, const int8_t* const* xq, const float* const* xs,
+                          int nseq, const int8_t* wq, const float* ws, int n, int group_size,
+                          int start, int end);
+
+// First row for core 1 when splitting d rows across both cores
+static inline int matmul_split(int d) {
+    return (d / 2) / MATMUL_ROW_BLOCK * MATMUL_ROW_BLOCK;
+}
+
+#endif // MATMUL_KERNELS_H
@@ -1,6 +1,7 @@
 // sampler.cpp - Token sampling implementation
 
 #include "sampler.h"
+#include "fast_math.h"
 
 // Forward declarations
 static int sample_argmax(v4sf* probabilities, int n);
@@ -91,11 +92,7 @@ static void softmax_sampling(v4sf* x, int size) {
         if (x[i] > max_val) max_val = x[i];
     }
 
-    v4sf sum = 0.0f;
-    for (int i = 0; i < size; i++) {
-        x[i] = expf(x[i] - max_val);
-        sum += x[i];
-    }
+    v4sf sum = fast_exp_shift_sum(x, size, max_val);
 
     for (int i = 0; i < size; i++) {
         x[i] /= sum;
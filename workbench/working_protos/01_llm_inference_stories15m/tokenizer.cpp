@@ -13,7 +13,7 @@ static int str_lookup(char* str, TokenIndex* sorted_vocab, int vocab_size) {
     return res != NULL ? res->id : -1;
 }
 
-bool build_tokenizer(Tokenizer* t, const char* tokenizer_path, int vocab_size) {
+bool build_tokenizer(Tokenizer* t, const char* tokenizer_path, int vocab_size, fs::FS& fs) {
     t->vocab_size = vocab_size;
     t->vocab = (char**)malloc(vocab_size * sizeof(char*));
     t->vocab_scores = (v4sf*)malloc(vocab_size * sizeof(v4sf));
@@ -24,7 +24,7 @@ bool build_tokenizer(Tokenizer* t, const char* tokenizer_path, int vocab_size) {
         t->byte_pieces[i * 2 + 1] = '\0';
     }
 
-    File file = SD.open(tokenizer_path, FILE_READ);
+    File file = fs.open(tokenizer_path, FILE_READ);
     if (!file) {
         Serial.printf("ERROR: Cannot open file %s\n", tokenizer_path);
         return false;
@@ -22,7 +22,7 @@ typedef struct {
 } Tokenizer;
 
 // Functions
-bool build_tokenizer(Tokenizer* t, const char* tokenizer_path, int vocab_size);
+bool build_tokenizer(Tokenizer* t, const char* tokenizer_path, int vocab_size, fs::FS& fs = SD);
 void free_tokenizer(Tokenizer* t);
 char* decode(Tokenizer* t, int prev_token, int token);
 void encode(Tokenizer* t, char* text, int8_t bos, int8_t eos, int* tokens, int* n_tokens);
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Build a flash model image for map_flash_model() from a llama2.c checkpoint.
+
+The image is written to the raw "model" data partition (partitions.csv) and
+memory-mapped on the badge, so weights are read in place: no load time and
+no PSRAM for weights.
+
+    fp32  The checkpoint weights unchanged (stories260K: 1 MB)
+    q8    int8 with one fp32 scale per --group-size values, so stories15M
+          (58 MB fp32) fits the 15.1 MB partition. RMS norm weights stay fp32.
+
+Usage:
+    python3 build_flash_model.py stories15M.bin model.img --dtype q8
+    python3 build_flash_model.py stories260K.bin model.img
+    esptool.py --chip esp32s3 write_flash 0xE0000 model.img
+
+Image layout (little-endian), see FlashModelHeader in llm_core.h:
+    u32 magic "LLMF", u32 version, u32 dtype, u32 group_size,
+    7 x i32 Config, u32 data_offset, u32 data_size, zero pad to data_offset
+    fp32: the checkpoint after its Config header
+    q8:   rms_att, rms_ffn, rms_final (fp32), then per matrix int8 values
+          followed by fp32 scales: token_embedding, wq, wk, wv, wo, w1, w2,
+          w3 [, wcls]. Every block starts on a 16-byte boundary.
+"""
+
+import argparse
+import math
+import struct
+import sys
+from array import array
+
+MAGIC = 0x464D4C4C   # "LLMF"
+VERSION = 1
+DTYPES = {"fp32": 0, "q8": 1}
+DATA_OFFSET = 256
+ALIGN = 16
+PARTITION_SIZE = 0xF20000   # "model" in partitions.csv
+
+
+def align(n):
+    return (n + ALIGN - 1) // ALIGN * ALIGN
+
+
+def tensor_sizes(cfg):
+    """(name, count) in checkpoint order, after the Config header."""
+    dim, hidden, layers, heads, kv_heads, vocab, seq_len = cfg
+    head_size = dim // heads
+    sizes = [
+        ("token_embedding", abs(vocab) * dim),
+        ("rms_att", layers * dim),
+        ("wq", layers * dim * heads * head_size),
+        ("wk", layers * dim * kv_heads * head_size),
+        ("wv", layers * dim * kv_heads * head_size),
+        ("wo", layers * heads * head_size * dim),
+        ("rms_ffn", layers * dim),
+        ("w1", layers * dim * hidden),
+        ("w2", layers * hidden * dim),
+        ("w3", layers * dim * hidden),
+        ("rms_final", dim),
+        ("freq_cis", seq_len * head_size),    # Legacy RoPE tables, unused
+    ]
+    if vocab < 0:
+        sizes.append(("wcls", abs(vocab) * dim))
+    return sizes
+
+
+def quantize(values, group_size):
+    """Symmetric int8 per group -> (int8 bytes, fp32 scales, max abs error)."""
+    q = bytearray(len(values))
+    scales = array("f")
+    max_err = 0.0
+    for start in range(0, len(values), group_size):
+        group = values[start:start + group_size]
+        scale = max(map(abs, group)) / 127.0
+        inv = 1.0 / scale if scale > 0 else 0.0
+        scales.append(scale)
+        for i, v in enumerate(group):
+            qv = round(v * inv)
+            q[start + i] = qv & 0xFF
+            err = abs(v - qv * scale)
+            if err > max_err:
+                max_err = err
+    return bytes(q), scales, max_err
+
+
+def pad(buf):
+    buf.extend(b"\0" * (align(len(buf)) - len(buf)))
+
+
+def build_q8(cfg, tensors, group_size):
+    data = bytearray()
+    for name in ("rms_att", "rms_ffn", "rms_final"):
+        data.extend(tensors[name].tobytes())
+        pad(data)
+
+    names = ["token_embedding", "wq", "wk", "wv", "wo", "w1", "w2", "w3"]
+    if "wcls" in tensors:
+        names.append("wcls")
+    for name in names:
+        q, scales, max_err = quantize(tensors[name], group_size)
+        data.extend(q)
+        pad(data)
+        data.extend(scales.tobytes())
+        pad(data)
+        print(f"  {name:<16} {len(q):>9} values  max error {max_err:.5f}")
+    return bytes(data)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("checkpoint", help="llama2.c .bin (e.g. stories15M.bin)")
+    ap.add_argument("output", help="Image to write to the model partition")
+    ap.add_argument("--dtype", choices=DTYPES, default="fp32")
+    ap.add_argument("--group-size", type=int, default=0,
+                    help="q8 values per scale (default: largest divisor of dim and "
+                         "hidden_dim up to 128)")
+    ap.add_argument("--partition-size", type=lambda s: int(s, 0), default=PARTITION_SIZE)
+    args = ap.parse_args()
+
+    with open(args.checkpoint, "rb") as f:
+        raw = f.read()
+    cfg = struct.unpack_from("<7i", raw, 0)
+    dim, hidden = cfg[0], cfg[1]
+    print(f"Config: dim={dim} hidden={hidden} layers={cfg[2]} heads={cfg[3]} "
+          f"kv_heads={cfg[4]} vocab={abs(cfg[5])} seq_len={cfg[6]}"
+          f"{'' if cfg[5] > 0 else ' (separate classifier)'}")
+
+    sizes = tensor_sizes(cfg)
+    expected = 28 + 4 * sum(n for _, n in sizes)
+    if len(raw) != expected:
+        print(f"ERROR: checkpoint is {len(raw)} bytes, config implies {expected}")
+        sys.exit(1)
+
+    group_size = 0
+    if args.dtype == "fp32":
+        data = raw[28:]
+    else:
+        group_size = args.group_size
+        if group_size == 0:
+            g = math.gcd(dim, hidden)
+            group_size = max(d for d in range(1, min(g, 128) + 1) if g % d == 0)
+        if dim % group_size or hidden % group_size:
+            print(f"ERROR: group size {group_size} must divide dim and hidden_dim")
+            sys.exit(1)
+
+        tensors = {}
+        off = 28
+        for name, n in sizes:
+            t = array("f")
+            t.frombytes(raw[off:off + 4 * n])
+            tensors[name] = t
+            off += 4 * n
+        print(f"Quantizing to int8, group size {group_size}:")
+        data = build_q8(cfg, tensors, group_size)
+
+    header = struct.pack("<4I7i2I", MAGIC, VERSION, DTYPES[args.dtype], group_size,
+                         *cfg, DATA_OFFSET, len(data))
+    image_size = DATA_OFFSET + len(data)
+    if image_size > args.partition_size:
+        print(f"ERROR: image is {image_size} bytes, partition holds {args.partition_size}"
+              f"{' (try --dtype q8)' if args.dtype == 'fp32' else ''}")
+        sys.exit(1)
+
+    with open(args.output, "wb") as out:
+        out.write(header.ljust(DATA_OFFSET, b"\0"))
+        out.write(data)
+
+    print(f"Wrote {args.output}: {args.dtype}, {image_size / 1048576:.2f} MB "
+          f"({100.0 * image_size / args.partition_size:.0f}% of partition)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""Pack a LoRA fine-tune into an adapter file for load_lora_adapter().
+
+The badge keeps the base model (flash image or SD checkpoint) untouched and
+adds scale * B·(A·x) to each adapted projection at matmul time, so a
+fine-tune ships as a few hundred KB instead of a new 60 MB model.
+
+Input is a PEFT adapter_model.safetensors (F32, F16 or BF16). Module names
+from llama2.c's model.py (layers.N.attention.wq, layers.N.feed_forward.w1)
+and from HF Llama (layers.N.self_attn.q_proj, layers.N.mlp.gate_proj) are
+both recognised. scale = lora_alpha / r, from --alpha or adapter_config.json
+next to the safetensors file.
+
+Usage:
+    python3 build_lora_adapter.py stories15M.bin adapter_model.safetensors tuned.lora
+    python3 build_lora_adapter.py stories15M.bin --random 8 --targets wq,wv test.lora
+
+--random writes a synthetic adapter with the given rank, to check the
+on-device path (output changes with it, and is unchanged with --scale 0).
+
+File layout (little-endian), see LoraHeader in llm_core.h:
+    u32 magic "LORA", u32 version, u32 rank, u32 target_mask, f32 scale,
+    i32 dim, i32 hidden_dim, i32 n_layers, i32 kv_dim
+    then for each target in order wq, wk, wv, wo, w1, w2, w3 (if in the mask):
+    A [n_layers][rank][n] fp32, B [n_layers][d][rank] fp32
+"""
+
+import argparse
+import json
+import os
+import random
+import re
+import struct
+import sys
+from array import array
+
+MAGIC = 0x41524F4C   # "LORA"
+VERSION = 1
+MAX_RANK = 64
+TARGETS = ["wq", "wk", "wv", "wo", "w1", "w2", "w3"]
+HF_NAMES = {"q_proj": "wq", "k_proj": "wk", "v_proj": "wv", "o_proj": "wo",
+            "gate_proj": "w1", "down_proj": "w2", "up_proj": "w3"}
+KEY_RE = re.compile(r"layers\.(\d+)\.\w+\.(\w+)\.lora_([AB])\.weight$")
+
+
+def target_shape(cfg, target):
+    """(n inputs, d outputs) of a projection."""
+    dim, hidden, _, heads, kv_heads = cfg[:5]
+    kv_dim = dim * kv_heads // heads
+    return {"wq": (dim, dim), "wk": (dim, kv_dim), "wv": (dim, kv_dim),
+            "wo": (dim, dim), "w1": (dim, hidden), "w2": (hidden, dim),
+            "w3": (dim, hidden)}[target]
+
+
+def read_safetensors(path):
+    """name -> (shape, array('f')) for every tensor in the file."""
+    with open(path, "rb") as f:
+        raw = f.read()
+    (header_len,) = struct.unpack_from("<Q", raw, 0)
+    header = json.loads(raw[8:8 + header_len])
+    base = 8 + header_len
+    tensors = {}
+    for name, info in header.items():
+        if name == "__metadata__":
+            continue
+        start, end = info["data_offsets"]
+        data = raw[base + start:base + end]
+        dtype = info["dtype"]
+        if dtype == "F32":
+            values = array("f", data)
+        elif dtype == "F16":
+            values = array("f", struct.unpack(f"<{len(data) // 2}e", data))
+        elif dtype == "BF16":
+            halves = struct.unpack(f"<{len(data) // 2}H", data)
+            values = array("f", struct.unpack(f"<{len(halves)}f",
+                                              struct.pack(f"<{len(halves)}I",
+                                                          *(h << 16 for h in halves))))
+        else:
+            print(f"ERROR: {name}: unsupported dtype {dtype}")
+            sys.exit(1)
+        tensors[name] = (info["shape"], values)
+    return tensors
+
+
+def load_peft(path, cfg):
+    """target -> {"A": [per layer], "B": [per layer]} and the rank."""
+    layers = cfg[2]
+    found = {}
+    rank = None
+    for name, (shape, values) in read_safetensors(path).items():
+        m = KEY_RE.search(name)
+        if not m:
+            continue
+        layer, module, ab = int(m.group(1)), m.group(2), m.group(3)
+        target = HF_NAMES.get(module, module)
+        if target not in TARGETS or layer >= layers:
+            print(f"ERROR: {name}: not a projection of this model")
+            sys.exit(1)
+        n, d = target_shape(cfg, target)
+        r = shape[0] if ab == "A" else shape[1]
+        expected = [r, n] if ab == "A" else [d, r]
+        if list(shape) != expected:
+            print(f"ERROR: {name}: shape {shape}, expected {expected}")
+            sys.exit(1)
+        if rank is None:
+            rank = r
+        elif r != rank:
+            print(f"ERROR: {name}: rank {r}, other tensors have {rank}")
+            sys.exit(1)
+        found.setdefault(target, {"A": [None] * layers, "B": [None] * layers})[ab][layer] = values
+
+    if not found:
+        print(f"ERROR: no lora_A / lora_B tensors in {path}")
+        sys.exit(1)
+    for target, ab in found.items():
+        for key in ("A", "B"):
+            for layer, values in enumerate(ab[key]):
+                if values is None:
+                    # Layers the fine-tune skipped get a zero delta
+                    n, d = target_shape(cfg, target)
+                    ab[key][layer] = array("f", bytes(4 * rank * (n if key == "A" else d)))
+    return found, rank
+
+
+def make_random(cfg, rank, targets, seed):
+    rng = random.Random(seed)
+    layers = cfg[2]
+    found = {}
+    for target in targets:
+        n, d = target_shape(cfg, target)
+        found[target] = {
+            "A": [array("f", (rng.gauss(0, 1 / n ** 0.5) for _ in range(rank * n)))
+                  for _ in range(layers)],
+            "B": [array("f", (rng.gauss(0, 1 / rank ** 0.5) for _ in range(d * rank)))
+                  for _ in range(layers)],
+        }
+    return found
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("checkpoint", help="Base llama2.c .bin (for the Config)")
+    ap.add_argument("adapter", nargs="?", help="PEFT adapter_model.safetensors")
+    ap.add_argument("output", help="Adapter file to copy to the SD card")
+    ap.add_argument("--alpha", type=float, help="lora_alpha (default: adapter_config.json)")
+    ap.add_argument("--scale", type=float, help="Override alpha / rank")
+    ap.add_argument("--random", type=int, metavar="RANK", help="Synthetic adapter of this rank")
+    ap.add_argument("--targets", default="wq,wk,wv,wo", help="Targets for --random")
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+
+    with open(args.checkpoint, "rb") as f:
+        cfg = struct.unpack("<7i", f.read(28))
+    dim, hidden, layers, heads, kv_heads = cfg[:5]
+    kv_dim = dim * kv_heads // heads
+
+    if args.random:
+        rank = args.random
+        targets = args.targets.split(",")
+        unknown = [t for t in targets if t not in TARGETS]
+        if unknown:
+            print(f"ERROR: unknown targets {unknown} (choose from {','.join(TARGETS)})")
+            sys.exit(1)
+        found = make_random(cfg, rank, targets, args.seed)
+        alpha = args.alpha if args.alpha is not None else rank
+    elif args.adapter:
+        found, rank = load_peft(args.adapter, cfg)
+        alpha = args.alpha
+        config_path = os.path.join(os.path.dirname(args.adapter), "adapter_config.json")
+        if alpha is None and os.path.exists(config_path):
+            with open(config_path) as f:
+                alpha = json.load(f).get("lora_alpha")
+        if alpha is None:
+            print("ERROR: no adapter_config.json next to the adapter; pass --alpha")
+            sys.exit(1)
+    else:
+        print("ERROR: give a PEFT adapter or --random RANK")
+        sys.exit(1)
+
+    if not 1 <= rank <= MAX_RANK:
+        print(f"ERROR: rank {rank} outside 1..{MAX_RANK} (LORA_MAX_RANK)")
+        sys.exit(1)
+    scale = args.scale if args.scale is not None else alpha / rank
+
+    mask = 0
+    body = bytearray()
+    macs = 0
+    for i, target in enumerate(TARGETS):
+        if target not in found:
+            continue
+        mask |= 1 << i
+        for key in ("A", "B"):
+            for values in found[target][key]:
+                body.extend(values.tobytes())
+        n, d = target_shape(cfg, target)
+        macs += rank * (n + d)
+
+    header = struct.pack("<4If4i", MAGIC, VERSION, rank, mask, scale, dim, hidden, layers, kv_dim)
+    with open(args.output, "wb") as out:
+        out.write(header)
+        out.write(body)
+
+    print(f"Wrote {args.output}: rank {rank}, scale {scale:.4g}, "
+          f"targets {','.join(t for t in TARGETS if t in found)}, "
+          f"{(len(header) + len(body)) / 1024:.0f} KB, {macs * layers} extra MACs per token")
+
+
+if __name__ == "__main__":
+    main()
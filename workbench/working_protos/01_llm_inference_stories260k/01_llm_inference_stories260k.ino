@@ -5,11 +5,13 @@
 #include "llm_core.h"
 #include "tokenizer.h"
 #include "sampler.h"
+#include "asset_image.h"
 
 // Global instances
 Transformer transformer;
 Tokenizer tokenizer;
 Sampler sampler;
+AssetImage assets;
 
 // Configuration
 const char* MODEL_PATH = "/stories260K.bin";
@@ -20,6 +22,19 @@ const int MAX_TOKENS = 256;      // max tokens to generate
 
 bool model_loaded = false;
 
+// Look up an asset and check its CRC before anything reads it in place
+bool find_asset(const char* name, Asset* asset) {
+    if (!assets.find(name, asset)) {
+        Serial.printf("Asset not found: %s\n", name);
+        return false;
+    }
+    if (!assets.verify(*asset)) {
+        Serial.printf("Asset CRC mismatch: %s\n", name);
+        return false;
+    }
+    return true;
+}
+
 void setup() {
     Serial.begin(115200);
     delay(1000);
@@ -28,14 +43,20 @@ void setup() {
     Serial.println("ESP32 LLM Inference - Maximum Performance");
     Serial.println("========================================\n");
 
-    // Mount FFat filesystem
-    Serial.print("Mounting FFat... ");
-    if (!FFat.begin(true)) {
-        Serial.println("FAILED");
-        Serial.println("Run upload_to_flash.sh to upload model files");
-        return;
+    // Map the asset image. Boards flashed before it still hold a FAT image;
+    // never format here, the partition may be an asset image begin() rejected
+    bool use_assets = assets.begin();
+    if (use_assets) {
+        assets.printDirectory();
+    } else {
+        Serial.print("Mounting FFat... ");
+        if (!FFat.begin(false)) {
+            Serial.println("FAILED");
+            Serial.println("Asset image missing or invalid, re-run upload_to_flash.sh");
+            return;
+        }
+        Serial.println("OK");
     }
-    Serial.println("OK");
 
     // Print memory info
     Serial.printf("Total heap: %d bytes\n", ESP.getHeapSize());
@@ -46,7 +67,15 @@ void setup() {
 
     // Load model
     Serial.println("Loading model...");
-    if (!build_transformer(&transformer, MODEL_PATH)) {
+    Asset model_asset, tok_asset;
+    bool ok;
+    if (use_assets) {
+        ok = find_asset(MODEL_PATH, &model_asset) &&
+             map_transformer(&transformer, model_asset.data, model_asset.size);
+    } else {
+        ok = build_transformer(&transformer, MODEL_PATH);
+    }
+    if (!ok) {
         Serial.println("Model load FAILED");
         return;
     }
@@ -62,7 +91,14 @@ void setup() {
 
     // Load tokenizer
     Serial.println("Loading tokenizer...");
-    if (!build_tokenizer(&tokenizer, TOKENIZER_PATH, transformer.config.vocab_size)) {
+    if (use_assets) {
+        ok = find_asset(TOKENIZER_PATH, &tok_asset) &&
+             build_tokenizer_from_memory(&tokenizer, tok_asset.data, tok_asset.size,
+                                         transformer.config.vocab_size);
+    } else {
+        ok = build_tokenizer(&tokenizer, TOKENIZER_PATH, transformer.config.vocab_size);
+    }
+    if (!ok) {
         Serial.println("Tokenizer load FAILED");
         return;
     }
@@ -0,0 +1,14 @@
+// crc32.h - Streaming CRC-32 (zlib / IEEE 802.3 polynomial)
+// crc32_update(crc32_update(0, a), b) == crc32 of a followed by b, and the
+// values match Python's zlib.crc32, so host tools can check what the badge
+// wrote. Nibble table: 64 bytes, two lookups per byte.
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+uint32_t crc32_update(uint32_t crc, const void* data, size_t len);
+
+#endif // CRC32_H
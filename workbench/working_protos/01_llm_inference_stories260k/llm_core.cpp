@@ -79,6 +79,25 @@ void memory_map_weights(TransformerWeights* w, Config* p, v4sf* ptr, int shared_
     w->wcls = shared_weights ? w->token_embedding_table : ptr;
 }
 
+// Reject headers that would divide by zero or lay weights out nonsensically
+static bool config_valid(const Config* p) {
+    return p->dim > 0 && p->hidden_dim > 0 && p->n_layers > 0 && p->n_heads > 0 &&
+           p->n_kv_heads > 0 && p->n_kv_heads <= p->n_heads && p->n_heads % p->n_kv_heads == 0 &&
+           p->dim % p->n_heads == 0 && (p->dim / p->n_heads) % 2 == 0 &&
+           p->vocab_size > 0 && p->seq_len > 0;
+}
+
+// Floats memory_map_weights() lays out after the Config header
+static uint64_t weights_floats(const Config* p, int shared_weights) {
+    uint64_t dim = p->dim, hidden = p->hidden_dim, n_layers = p->n_layers;
+    uint64_t head_size = dim / p->n_heads;
+    uint64_t kv_dim = p->n_kv_heads * head_size;
+    uint64_t per_layer = 2 * dim + dim * dim * 2 + dim * kv_dim * 2 + 3 * dim * hidden;
+    uint64_t n = (uint64_t)p->vocab_size * dim + n_layers * per_layer + dim +
+                 (uint64_t)p->seq_len * head_size;
+    return shared_weights ? n : n + (uint64_t)p->vocab_size * dim;
+}
+
 bool read_checkpoint(const char* checkpoint, Config* config, TransformerWeights* weights,
                      v4sf** data, size_t* file_size) {
     File file = FFat.open(checkpoint, "r");
@@ -97,6 +116,12 @@ bool read_checkpoint(const char* checkpoint, Config* config, TransformerWeights*
     config->vocab_size = abs(config->vocab_size);
 
     *file_size = file.size();
+    if (!config_valid(config) ||
+        weights_floats(config, shared_weights) * sizeof(v4sf) > *file_size - sizeof(Config)) {
+        Serial.printf("%s: invalid or truncated model\n", checkpoint);
+        file.close();
+        return false;
+    }
     Serial.printf("Model size: %zu bytes\n", *file_size);
     Serial.printf("Free heap before malloc: %d\n", esp_get_free_heap_size());
 
@@ -328,11 +353,8 @@ v4sf* forward(Transformer* transformer, int token, int pos) {
 // Transformer Initialization
 // ============================================================================
 
-bool build_transformer(Transformer* t, const char* checkpoint_path) {
-    if (!read_checkpoint(checkpoint_path, &t->config, &t->weights, &t->data, &t->file_size)) {
-        return false;
-    }
-
+// Run state and the core 1 matmul task, once the weights are in place
+static void start_transformer(Transformer* t) {
     malloc_run_state(&t->state, &t->config);
 
     // Create FreeRTOS synchronization primitives
@@ -356,6 +378,42 @@ bool build_transformer(Transformer* t, const char* checkpoint_path) {
     );
 
     Serial.println("Transformer built successfully");
+}
+
+bool build_transformer(Transformer* t, const char* checkpoint_path) {
+    if (!read_checkpoint(checkpoint_path, &t->config, &t->weights, &t->data, &t->file_size)) {
+        return false;
+    }
+    start_transformer(t);
+    return true;
+}
+
+bool map_transformer(Transformer* t, const uint8_t* checkpoint, size_t size) {
+    if (size < sizeof(Config)) {
+        return false;
+    }
+    memcpy(&t->config, checkpoint, sizeof(Config));
+    int shared_weights = t->config.vocab_size > 0 ? 1 : 0;
+    t->config.vocab_size = abs(t->config.vocab_size);
+
+    // The weights are used in place, so they must lie inside this asset
+    if (!config_valid(&t->config)) {
+        Serial.println("Model header invalid");
+        return false;
+    }
+    uint64_t need = weights_floats(&t->config, shared_weights) * sizeof(v4sf);
+    if (need > size - sizeof(Config)) {
+        Serial.printf("Model truncated: weights need %llu bytes, asset has %zu\n",
+                      (unsigned long long)need, size - sizeof(Config));
+        return false;
+    }
+    t->data = NULL;
+    t->file_size = size;
+    Serial.printf("Model mapped: %zu bytes\n", size);
+
+    // Weights follow the Config header; assets start 4 KB aligned
+    memory_map_weights(&t->weights, &t->config, (v4sf*)(checkpoint + sizeof(Config)), shared_weights);
+    start_transformer(t);
     return true;
 }
 
@@ -110,6 +110,9 @@ void free_run_state(RunState* s);
 void memory_map_weights(TransformerWeights* w, Config* p, v4sf* ptr, int shared_weights);
 bool read_checkpoint(const char* checkpoint, Config* config, TransformerWeights* weights, v4sf** data, size_t* file_size);
 bool build_transformer(Transformer* t, const char* checkpoint_path);
+// Weights used in place from a mapped checkpoint (AssetImage): nothing is
+// copied, t->data stays NULL
+bool map_transformer(Transformer* t, const uint8_t* checkpoint, size_t size);
 void free_transformer(Transformer* t);
 
 // Neural net operations
@@ -13,51 +13,79 @@ static int str_lookup(char* str, TokenIndex* sorted_vocab, int vocab_size) {
     return res != NULL ? res->id : -1;
 }
 
-bool build_tokenizer(Tokenizer* t, const char* tokenizer_path, int vocab_size) {
+bool build_tokenizer_from_memory(Tokenizer* t, const uint8_t* data, size_t size, int vocab_size) {
     t->vocab_size = vocab_size;
-    t->vocab = (char**)malloc(vocab_size * sizeof(char*));
+    t->vocab = (char**)calloc(vocab_size, sizeof(char*));
     t->vocab_scores = (v4sf*)malloc(vocab_size * sizeof(v4sf));
     t->sorted_vocab = NULL;
+    if (!t->vocab || !t->vocab_scores) {
+        free(t->vocab);
+        free(t->vocab_scores);
+        t->vocab = NULL;
+        t->vocab_scores = NULL;
+        return false;
+    }
 
     for (int i = 0; i < 256; i++) {
         t->byte_pieces[i * 2] = (unsigned char)i;
         t->byte_pieces[i * 2 + 1] = '\0';
     }
 
-    File file = FFat.open(tokenizer_path, "r");
-    if (!file) {
-        Serial.printf("Failed to open tokenizer: %s\n", tokenizer_path);
-        return false;
-    }
-
-    if (file.read((uint8_t*)&t->max_token_length, sizeof(int)) != sizeof(int)) {
-        file.close();
+    // Same layout as the file: max_token_length, then score, len, bytes per token
+    size_t pos = 0;
+    if (size < sizeof(int)) {
+        free_tokenizer(t);
         return false;
     }
+    memcpy(&t->max_token_length, data, sizeof(int));
+    pos += sizeof(int);
 
     int len;
     for (int i = 0; i < vocab_size; i++) {
-        if (file.read((uint8_t*)(t->vocab_scores + i), sizeof(v4sf)) != sizeof(v4sf)) {
-            file.close();
+        if (size - pos < sizeof(v4sf) + sizeof(int)) {
+            free_tokenizer(t);
             return false;
         }
-        if (file.read((uint8_t*)&len, sizeof(int)) != sizeof(int)) {
-            file.close();
-            return false;
-        }
-        t->vocab[i] = (char*)malloc(len + 1);
-        if (file.read((uint8_t*)t->vocab[i], len) != len) {
-            file.close();
+        memcpy(t->vocab_scores + i, data + pos, sizeof(v4sf));
+        memcpy(&len, data + pos + sizeof(v4sf), sizeof(int));
+        pos += sizeof(v4sf) + sizeof(int);
+        t->vocab[i] = (len >= 0 && (size_t)len <= size - pos) ? (char*)malloc(len + 1) : NULL;
+        if (!t->vocab[i]) {
+            Serial.printf("Tokenizer entry %d invalid\n", i);
+            free_tokenizer(t);
             return false;
         }
+        memcpy(t->vocab[i], data + pos, len);
         t->vocab[i][len] = '\0';
+        pos += len;
     }
 
-    file.close();
     Serial.println("Tokenizer loaded");
     return true;
 }
 
+bool build_tokenizer(Tokenizer* t, const char* tokenizer_path, int vocab_size) {
+    File file = FFat.open(tokenizer_path, "r");
+    if (!file) {
+        Serial.printf("Failed to open tokenizer: %s\n", tokenizer_path);
+        return false;
+    }
+
+    // The tokenizer is a few KB: read it whole and parse it from RAM
+    size_t size = file.size();
+    uint8_t* buf = (uint8_t*)malloc(size);
+    if (!buf || file.read(buf, size) != size) {
+        free(buf);
+        file.close();
+        return false;
+    }
+    file.close();
+
+    bool ok = build_tokenizer_from_memory(t, buf, size, vocab_size);
+    free(buf);
+    return ok;
+}
+
 void free_tokenizer(Tokenizer* t) {
     for (int i = 0; i < t->vocab_size; i++) {
         free(t->vocab[i]);
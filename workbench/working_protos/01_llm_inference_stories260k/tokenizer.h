@@ -23,6 +23,7 @@ typedef struct {
 
 // Functions
 bool build_tokenizer(Tokenizer* t, const char* tokenizer_path, int vocab_size);
+bool build_tokenizer_from_memory(Tokenizer* t, const uint8_t* data, size_t size, int vocab_size);
 void free_tokenizer(Tokenizer* t);
 char* decode(Tokenizer* t, int prev_token, int token);
 void encode(Tokenizer* t, char* text, int8_t bos, int8_t eos, int* tokens, int* n_tokens);
@@ -21,26 +21,16 @@ find data -type f -exec bash -c 'FILE="{}"; SIZE=$(stat -c%s "$FILE" 2>/dev/null
 echo "Total: $FILE_COUNT files"
 echo
 
-# Find mkfatfs
-MKFATFS=$(find ~/.arduino15/packages/esp32/tools/mkfatfs -name "mkfatfs" -type f 2>/dev/null | head -1)
-if [ -z "$MKFATFS" ]; then
-    MKFATFS="./temp/mkfatfs"
-    if [ ! -f "$MKFATFS" ]; then
-        echo "ERROR: mkfatfs not found!"
-        echo "Install it via Arduino IDE or ESP-IDF"
-        exit 1
-    fi
-fi
-
-# FFat partition configuration (9MB partition)
-PARTITION_SIZE="10354688"   # 9MB + header
-FLASH_OFFSET="0x611000"     # FFat partition offset
+# Asset image for the "ffat" partition (app3M_fat9M_16MB.csv), mapped by
+# AssetImage; the image starts at the partition start
+PARTITION_SIZE="0x9E0000"
+FLASH_OFFSET="0x610000"
 
-echo "Creating filesystem image..."
-$MKFATFS -c data -t fatfs -s $PARTITION_SIZE ffat.bin
+echo "Creating asset image..."
+python3 ../../tools/build_asset_image.py --partition-size $PARTITION_SIZE data assets.bin
 
-if [ ! -f "ffat.bin" ]; then
-    echo "ERROR: Failed to create filesystem image!"
+if [ ! -f "assets.bin" ]; then
+    echo "ERROR: Failed to create asset image!"
     exit 1
 fi
 
@@ -68,22 +58,22 @@ if [ -z "$PORT" ]; then
 fi
 
 echo "Device: $PORT"
-echo "Partition: FFat @ $FLASH_OFFSET ($((PARTITION_SIZE / 1024 / 1024))MB)"
+echo "Partition: ffat @ $FLASH_OFFSET (asset image, $(($(stat -c%s assets.bin 2>/dev/null || stat -f%z assets.bin) / 1024)) KB)"
 echo
 read -p "Upload model files to flash? (y/n) " -n 1 -r
 echo
 if [[ ! $REPLY =~ ^[Yy]$ ]]; then
-    rm -f ffat.bin
+    rm -f assets.bin
     exit 0
 fi
 
 echo
 echo "Uploading..."
-python3 $ESPTOOL --chip esp32s3 --port $PORT --baud 460800 write_flash $FLASH_OFFSET ffat.bin
+python3 $ESPTOOL --chip esp32s3 --port $PORT --baud 460800 write_flash $FLASH_OFFSET assets.bin
 
 echo
 echo "========================================="
-echo "SUCCESS! Model files uploaded to FFat"
+echo "SUCCESS! Model files uploaded to flash"
 echo "========================================="
 echo
 echo "Next steps:"
@@ -94,4 +84,4 @@ echo "4. Upload sketch"
 echo "5. Open Serial Monitor (115200 baud)"
 echo
 
-rm -f ffat.bin
+rm -f assets.bin
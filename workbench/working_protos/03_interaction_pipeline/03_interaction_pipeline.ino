@@ -0,0 +1,394 @@
+// 03_interaction_pipeline.ino - Event-driven interaction pipeline
+// capture -> VAD -> mel -> YAMNet -> similarity match -> LLM -> text render + speaker
+// Every stage is a FreeRTOS task pinned to a core, linked by bounded queues,
+// so capture keeps listening while earlier utterances are still being processed.
+// Devices go through hal.h, so the same sketch also runs on Linux (workbench/host).
+
+#include <SD.h>
+#include <SPI.h>
+#include <FFat.h>
+#include "hal.h"
+#include "boot.h"
+#include "power_governor.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "stages.h"
+#include "delta_patch.h"
+#include "sync.h"
+#include "audio_player.h"
+#include "tts.h"
+#include "noise_suppressor.h"
+
+// SD card SPI pins (shared with LCD)
+#define SD_CS   41
+#define SD_MOSI 38
+#define SD_MISO 40
+#define SD_SCK  39
+
+// Model files
+const char* YAMNET_PATH = "/yamnet.tflite";        // SD
+const char* MATCH_INDEX_PATH = "/match_index.bin"; // SD
+const char* PROJECTION_PATH = "/projection.bin";   // SD, optional (needs a version 2 index)
+const char* LLM_MODEL_PATH = "/stories260K.bin";   // FFat
+const char* TOKENIZER_PATH = "/tok512.bin";        // SD
+const char* SYNC_CONFIG_PATH = "/sync.cfg";        // SD, optional
+const char* CANNED_AUDIO_PATH = "/canned.wav";     // SD, optional
+
+// Interaction parameters
+const float MATCH_THRESHOLD = 0.7f;
+const float TEMPERATURE = 1.0f;
+const float TOPP = 0.9f;
+const int MAX_TOKENS = 128;
+const bool NOISE_SUPPRESSION = true;               // Denoise the mel front-end
+const char* CANNED_RESPONSE = "I'm sorry I couldn't get a transcription for that";
+
+// Global instances
+Hal* hal = nullptr;
+VoiceActivityDetector vad;
+MelSpectrogram mel;
+NoiseSuppressor denoiser;
+YamNetInference yamnet;
+ProjectionHead projection;
+SimilarityMatcher matcher(SD, [] { return spi_bus_lock(); }, [] { spi_bus_unlock(); });
+ClipStash stash(SD, [] { return spi_bus_lock(); }, [] { spi_bus_unlock(); });
+Transformer transformer;
+Tokenizer tokenizer;
+Sampler sampler;
+
+AppContext app;
+Pipeline pipeline;
+
+BootManager boot;
+PowerGovernor power;
+MetricsRegistry metrics;
+SyncClient sync_client(SD, [] { return spi_bus_lock(); }, [] { spi_bus_unlock(); });
+AudioPlayer player(SD, [] { return spi_bus_lock(); }, [] { spi_bus_unlock(); });
+Tts tts;
+bool system_ready = false;
+bool timeline_printed = false;
+
+void error_halt(const char* what) {
+    Serial.printf("FAILED (%s)\n", what);
+    Serial.println("\nSYSTEM HALTED DUE TO ERROR");
+    while (1) {
+        delay(1000);
+    }
+}
+
+// ============================================================================
+// Metrics owned by the sketch (stage metrics live in stages.cpp)
+// ============================================================================
+
+Metric* m_sd_bytes = nullptr;
+Metric* m_sd_mbps = nullptr;
+Metric* m_psram_free = nullptr;
+Metric* m_psram_min_free = nullptr;
+Metric* m_heap_free = nullptr;
+Metric* m_heap_min_free = nullptr;
+Metric* m_cpu_mhz = nullptr;
+
+void sample_system(MetricsRegistry* registry, void* arg) {
+    MetricsRegistry::set(m_psram_free, ESP.getFreePsram() / 1024.0f);
+    MetricsRegistry::set(m_psram_min_free,
+                         heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM) / 1024.0f);
+    MetricsRegistry::set(m_heap_free, ESP.getFreeHeap() / 1024.0f);
+    MetricsRegistry::set(m_heap_min_free,
+                         heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL) / 1024.0f);
+    MetricsRegistry::set(m_cpu_mhz, getCpuFrequencyMhz());
+}
+
+void register_system_metrics() {
+    m_sd_bytes = metrics.counter("sd.read_bytes", "B");
+    m_sd_mbps = metrics.gauge("sd.read_mbps", "MB/s");
+    m_psram_free = metrics.gauge("psram.free", "KB");
+    m_psram_min_free = metrics.gauge("psram.min_free", "KB");
+    m_heap_free = metrics.gauge("heap.free", "KB");
+    m_heap_min_free = metrics.gauge("heap.min_free", "KB");
+    m_cpu_mhz = metrics.gauge("cpu.mhz", "MHz");
+    metrics.addSampler(sample_system, nullptr);
+}
+
+// Whole-file SD load finished: account bytes and effective throughput
+// (caller holds the SPI bus lock)
+void record_sd_load(const char* path, uint32_t t_start) {
+    uint32_t elapsed = micros() - t_start;
+    File f = SD.open(path);
+    if (!f) return;
+    size_t size = f.size();
+    f.close();
+
+    MetricsRegistry::add(m_sd_bytes, size);
+    if (elapsed > 0) {
+        MetricsRegistry::set(m_sd_mbps, (float)size / elapsed);     // bytes/us = MB/s
+    }
+}
+
+// ============================================================================
+// Deferred loads (run as boot tasks while the pipeline is already listening)
+// SD reads take the SPI bus lock because the render stage may be drawing.
+// ============================================================================
+
+bool load_yamnet(void* arg) {
+    PowerDemand demand(&power, POWER_LOAD);
+    spi_bus_lock();
+    uint32_t t_start = micros();
+    bool ok = yamnet.begin(YAMNET_PATH);
+    if (ok) record_sd_load(YAMNET_PATH, t_start);
+    if (ok && app.projection) {
+        t_start = micros();
+        ok = projection.begin(PROJECTION_PATH, EMBEDDING_DIM);
+        if (ok) record_sd_load(PROJECTION_PATH, t_start);
+    }
+    spi_bus_unlock();
+    return ok;
+}
+
+bool load_match_index(void* arg) {
+    PowerDemand demand(&power, POWER_LOAD);
+    spi_bus_lock();
+    uint32_t t_start = micros();
+    bool ok = matcher.begin(MATCH_INDEX_PATH);
+    if (ok) record_sd_load(MATCH_INDEX_PATH, t_start);
+    spi_bus_unlock();
+    // Enrollments merge into the base while the badge is idle
+    if (ok) matcher.startCompactor(&power);
+    return ok;
+}
+
+bool load_llm(void* arg) {
+    PowerDemand demand(&power, POWER_LOAD);
+    // A flash-mapped image needs no copy; otherwise load the file from FFat
+    if (map_flash_model(&transformer, FLASH_MODEL_LABEL)) {
+        return true;
+    }
+    return build_transformer(&transformer, LLM_MODEL_PATH);
+}
+
+// Needs vocab_size, so it runs after load_llm
+bool load_tokenizer(void* arg) {
+    PowerDemand demand(&power, POWER_LOAD);
+    spi_bus_lock();
+    bool ok = build_tokenizer(&tokenizer, TOKENIZER_PATH, transformer.config.vocab_size);
+    spi_bus_unlock();
+    if (ok) {
+        build_sampler(&sampler, transformer.config.vocab_size, TEMPERATURE, TOPP, millis());
+    }
+    return ok;
+}
+
+void draw_logo() {
+    HalDisplay* display = hal->display;
+    display->fillScreen(HAL_BLACK);
+    display->setTextColor(HAL_WHITE);
+    display->setTextSize(3);
+    display->setCursor(16, display->height() / 2 - 24);
+    display->print("Badge");
+    display->setTextSize(1);
+    display->setCursor(16, display->height() / 2 + 12);
+    display->print("loading models...");
+}
+
+void setup() {
+    boot.begin();
+    Serial.begin(115200);
+    power.begin(POWER_LISTEN);
+    register_system_metrics();
+
+    hal = hal_default();
+
+    // First frame before anything slow
+    if (!hal->display->begin()) error_halt("display");
+    draw_logo();
+    hal->display->setBacklight(true);
+    hal->display->flush();
+    boot.mark("logo");
+
+    Serial.println("\n========================================");
+    Serial.println("Interaction Pipeline");
+    Serial.println("capture > vad > mel > yamnet > match > llm > render/speaker");
+    Serial.println("========================================\n");
+
+    Serial.printf("Free heap: %d bytes\n", ESP.getFreeHeap());
+    Serial.printf("Free PSRAM: %d bytes\n\n", ESP.getFreePsram());
+
+    // Storage
+    Serial.print("Mounting SD card... ");
+    SPI.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS);
+    if (!SD.begin(SD_CS)) error_halt("SD");
+    Serial.println("OK");
+    // Finish any delta patch swap a power cut interrupted
+    const char* patchable[] = {YAMNET_PATH, MATCH_INDEX_PATH, PROJECTION_PATH, TOKENIZER_PATH};
+    for (const char* path : patchable) {
+        DeltaPatcher::recover(SD, path);
+    }
+    boot.mark("sd");
+
+    Serial.print("Mounting FFat... ");
+    if (!FFat.begin(false, "", 1)) error_halt("FFat");
+    Serial.println("OK");
+    boot.mark("ffat");
+
+    // Models load in the background; stages wait on their futures
+    spi_bus_init();
+    sync_client.recover();      // Finish any sync install a power cut interrupted
+    spi_bus_lock();
+    app.projection = SD.exists(PROJECTION_PATH) ? &projection : nullptr;
+    spi_bus_unlock();
+    app.yamnet_ready = boot.defer("yamnet", load_yamnet, nullptr, 1, 2, 8192);
+    app.match_ready = boot.defer("match", load_match_index, nullptr, 1, 2, 4096);
+    BootFuture* llm = boot.defer("llm", load_llm, nullptr, 0, 2, 8192);
+    app.llm_ready = boot.defer("tokenizer", load_tokenizer, nullptr, 0, 2, 8192, llm);
+
+    Serial.print("Initializing microphone... ");
+    if (!hal->audio_in->begin(SAMPLE_RATE)) error_halt("microphone");
+    Serial.println("OK");
+
+    Serial.print("Initializing mel-spectrogram... ");
+    if (!mel.begin(SAMPLE_RATE)) error_halt("mel");
+    if (!denoiser.begin()) error_halt("noise suppressor");
+    denoiser.setEnabled(NOISE_SUPPRESSION);
+    denoiser.addMetrics(&metrics);
+    mel.setNoiseSuppressor(&denoiser);
+    Serial.println("OK");
+    boot.mark("audio");
+
+    // Wire the pipeline
+    app.hal = hal;
+    app.power = &power;
+    app.vad = &vad;
+    app.mel = &mel;
+    app.yamnet = &yamnet;
+    app.matcher = &matcher;
+    matcher.addMetrics(&metrics);
+    app.stash = stash.begin(SAMPLE_RATE, MAX_UTTERANCE_SAMPLES) ? &stash : nullptr;
+    stash.addMetrics(&metrics);
+    app.transformer = &transformer;
+    app.tokenizer = &tokenizer;
+    app.sampler = &sampler;
+    app.match_threshold = MATCH_THRESHOLD;
+    app.max_tokens = MAX_TOKENS;
+    app.canned_response = CANNED_RESPONSE;
+    spi_bus_lock();
+    app.canned_audio = SD.exists(CANNED_AUDIO_PATH) ? CANNED_AUDIO_PATH : nullptr;
+    spi_bus_unlock();
+    app.player = &player;
+    player.addMetrics(&metrics);
+    app.tts = tts.begin(SAMPLE_RATE) ? &tts : nullptr;
+    tts.addMetrics(&metrics);
+
+    Serial.println("Starting pipeline:");
+    if (!build_interaction_pipeline(&pipeline, &app) || !pipeline.start()) {
+        error_halt("pipeline");
+    }
+    register_stage_metrics(&pipeline, &metrics);
+    boot.mark("listening");
+
+    // Model/dataset updates and clip uploads, below every stage
+    sync_client.begin(hal->net, SYNC_CONFIG_PATH, &metrics, &power);
+
+    system_ready = true;
+
+    Serial.println("\n========================================");
+    Serial.println("LISTENING (models still loading in the background)");
+    Serial.println("Commands (end with newline):");
+    Serial.println("  s = pipeline stats, t = boot timeline, p = power, r/reset = reset all");
+    Serial.println("  stats, trace on|off, schema, snap = metrics (tools/metrics_monitor.py)");
+    Serial.println("  patch <file> <delta> = apply an SD delta (tools/delta_patch.py)");
+    Serial.println("  sync = check for updates and upload stashed clips now");
+    Serial.println("  play <file.wav>, stop = speaker (16 kHz mono PCM or IMA ADPCM)");
+    Serial.println("  say <text> = speak text with the TTS");
+    Serial.println("  ns on|off = mel noise suppression");
+    Serial.println("  enroll <text> = match the last utterance to text, forget <text>, compact");
+    Serial.println("========================================\n");
+}
+
+// Apply an SD delta patch in place. The SPI bus is taken per 4 KB burst so
+// the LCD keeps drawing. Loaded models and indexes pick up the new file on
+// the next boot.
+static void patch_command(const char* args) {
+    char path[96], delta[96];
+    if (sscanf(args, "%95s %95s", path, delta) != 2) {
+        Serial.println("Usage: patch <file> <delta>");
+        return;
+    }
+    static DeltaPatcher patcher(SD, [] { return spi_bus_lock(); }, [] { spi_bus_unlock(); });
+    if (patcher.apply(path, delta)) {
+        Serial.printf("Patched %s, reboot to load it\n", path);
+    } else {
+        Serial.printf("Patch failed, %s unchanged\n", path);
+    }
+}
+
+void loop() {
+    if (!system_ready) {
+        delay(1000);
+        return;
+    }
+
+    power.poll();
+
+    if (!timeline_printed && boot.allReady()) {
+        boot.mark("models ready");
+        timeline_printed = true;
+        Serial.printf("Free PSRAM after load: %d bytes\n", ESP.getFreePsram());
+        boot.printTimeline();
+    }
+
+    const char* line = metrics.readLine();
+    if (line) {
+        if (strcmp(line, "s") == 0) {
+            pipeline.printStats();
+        } else if (strcmp(line, "r") == 0 || strcmp(line, "reset") == 0) {
+            pipeline.resetStats();
+            power.resetStats();
+            metrics.reset();
+            Serial.println("Stats reset");
+        } else if (strcmp(line, "t") == 0) {
+            boot.printTimeline();
+        } else if (strcmp(line, "p") == 0) {
+            power.printStats();
+        } else if (strncmp(line, "patch ", 6) == 0) {
+            patch_command(line + 6);
+        } else if (strncmp(line, "play ", 5) == 0) {
+            if (!player.play(line + 5)) {
+                Serial.println("Player queue full");
+            }
+        } else if (strncmp(line, "say ", 4) == 0) {
+            // The TTS takes one utterance at a time; the speaker stage owns it
+            // while a response plays
+            if (player.busy() || !player.playStream(&tts)) {
+                Serial.println("Speaker busy");
+            } else {
+                tts.say(line + 4);
+                tts.finish();
+            }
+        } else if (strcmp(line, "ns on") == 0 || strcmp(line, "ns off") == 0) {
+            denoiser.setEnabled(line[4] == 'n');
+            Serial.printf("Noise suppression %s\n", denoiser.enabled() ? "on" : "off");
+        } else if (strncmp(line, "enroll ", 7) == 0) {
+            if (matcher.enroll(line + 7)) {
+                Serial.printf("Enrolled \"%s\" (%d entries, %d pending)\n", line + 7,
+                              matcher.count(), matcher.pending());
+            } else {
+                Serial.println("Enroll failed (no utterance matched yet, or SD error)");
+            }
+        } else if (strncmp(line, "forget ", 7) == 0) {
+            int n = matcher.remove(line + 7);
+            Serial.printf(n < 0 ? "Forget failed (SD error)\n" : "Forgot %d entries\n", n);
+        } else if (strcmp(line, "compact") == 0) {
+            matcher.requestCompaction();
+        } else if (strcmp(line, "stop") == 0) {
+            player.stop();
+        } else if (strcmp(line, "sync") == 0) {
+            if (sync_client.running()) {
+                sync_client.requestSync();
+            } else {
+                Serial.printf("Sync is off (no %s)\n", SYNC_CONFIG_PATH);
+            }
+        } else if (!metrics.command(line)) {
+            Serial.printf("Unknown command: %s\n", line);
+        }
+    }
+    metrics.trace();
+    delay(50);
+}
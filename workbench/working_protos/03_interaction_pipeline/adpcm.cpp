@@ -0,0 +1,99 @@
+// adpcm.cpp - IMA ADPCM block codec
+
+#include "adpcm.h"
+#include <string.h>
+
+static const int16_t STEP_TABLE[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+};
+
+static const int8_t INDEX_TABLE[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static inline int clamp_index(int index) {
+    return index < 0 ? 0 : (index > 88 ? 88 : index);
+}
+
+static inline int clamp_sample(int v) {
+    return v < -32768 ? -32768 : (v > 32767 ? 32767 : v);
+}
+
+// Decoder step shared by both directions, so the encoder tracks exactly
+// what the decoder will reconstruct
+static inline int decode_nibble(uint8_t nibble, int* predictor, int* index) {
+    int step = STEP_TABLE[*index];
+    int diff = step >> 3;
+    if (nibble & 1) diff += step >> 2;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 4) diff += step;
+    *predictor = clamp_sample(*predictor + ((nibble & 8) ? -diff : diff));
+    *index = clamp_index(*index + INDEX_TABLE[nibble]);
+    return *predictor;
+}
+
+static inline uint8_t encode_sample(int sample, int* predictor, int* index) {
+    int step = STEP_TABLE[*index];
+    int diff = sample - *predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        nibble |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) {
+        nibble |= 1;
+    }
+    decode_nibble(nibble, predictor, index);
+    return nibble;
+}
+
+void adpcm_encoder_init(AdpcmEncoder* enc) {
+    enc->step_index = 0;
+}
+
+void adpcm_encode_block(AdpcmEncoder* enc, const int16_t* pcm, int count,
+                        uint8_t block[ADPCM_BLOCK_BYTES]) {
+    int predictor = count > 0 ? pcm[0] : 0;
+    int index = enc->step_index;
+    block[0] = predictor & 0xFF;
+    block[1] = (predictor >> 8) & 0xFF;
+    block[2] = (uint8_t)index;
+    block[3] = 0;
+
+    uint8_t* out = block + 4;
+    for (int i = 1; i < ADPCM_BLOCK_SAMPLES; i += 2) {
+        int a = i < count ? pcm[i] : 0;
+        int b = i + 1 < count ? pcm[i + 1] : 0;
+        uint8_t lo = encode_sample(a, &predictor, &index);
+        uint8_t hi = encode_sample(b, &predictor, &index);
+        *out++ = lo | (hi << 4);
+    }
+    enc->step_index = index;
+}
+
+void adpcm_decode_block(const uint8_t block[ADPCM_BLOCK_BYTES], int16_t* pcm) {
+    int predictor = (int16_t)(block[0] | (block[1] << 8));
+    int index = clamp_index(block[2]);
+    pcm[0] = (int16_t)predictor;
+
+    const uint8_t* in = block + 4;
+    for (int i = 1; i < ADPCM_BLOCK_SAMPLES; i += 2) {
+        uint8_t byte = *in++;
+        pcm[i] = (int16_t)decode_nibble(byte & 0x0F, &predictor, &index);
+        pcm[i + 1] = (int16_t)decode_nibble(byte >> 4, &predictor, &index);
+    }
+}
@@ -0,0 +1,33 @@
+// adpcm.h - IMA ADPCM, 4 bits per sample
+// Block layout matches WAV format 0x11 (mono): i16 first sample, u8 step
+// index, u8 0, then 252 bytes of nibbles (low nibble first). One 256-byte
+// block holds ADPCM_BLOCK_SAMPLES samples, a quarter of the PCM size.
+
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#include <stdint.h>
+
+#define ADPCM_BLOCK_BYTES   256
+#define ADPCM_BLOCK_SAMPLES 505     // Header sample + 2 per data byte
+
+typedef struct {
+    int step_index;                 // Carried across blocks by the encoder
+} AdpcmEncoder;
+
+void adpcm_encoder_init(AdpcmEncoder* enc);
+
+// Encode count (<= ADPCM_BLOCK_SAMPLES) samples into one block; a short
+// final block is padded with silence
+void adpcm_encode_block(AdpcmEncoder* enc, const int16_t* pcm, int count,
+                        uint8_t block[ADPCM_BLOCK_BYTES]);
+
+// Decode one block into ADPCM_BLOCK_SAMPLES samples
+void adpcm_decode_block(const uint8_t block[ADPCM_BLOCK_BYTES], int16_t* pcm);
+
+// Bytes needed for num_samples samples (whole blocks)
+static inline uint32_t adpcm_encoded_size(uint32_t num_samples) {
+    return (num_samples + ADPCM_BLOCK_SAMPLES - 1) / ADPCM_BLOCK_SAMPLES * ADPCM_BLOCK_BYTES;
+}
+
+#endif // ADPCM_H
@@ -0,0 +1,248 @@
+// audio_player.cpp - Streaming clip player
+
+#include "audio_player.h"
+#include "wav_file.h"
+
+AudioPlayer::AudioPlayer(fs::FS& fs, PlayerLockFn lock, PlayerUnlockFn unlock)
+    : fs_(fs), lock_(lock), unlock_(unlock), out_(nullptr), sample_rate_(0), requests_(nullptr),
+      free_(nullptr), full_(nullptr), generation_(0), streaming_(false), gain_q8_(256),
+      m_start_us_(nullptr), m_starved_(nullptr), m_clips_(nullptr) {
+}
+
+bool AudioPlayer::lock() {
+    return lock_ ? lock_() : true;
+}
+
+void AudioPlayer::unlock() {
+    if (unlock_) unlock_();
+}
+
+bool AudioPlayer::begin(HalAudioOut* out, int sample_rate, int core, int priority) {
+    out_ = out;
+    sample_rate_ = sample_rate;
+    if (!out_->begin(sample_rate)) {
+        return false;
+    }
+
+    requests_ = xQueueCreate(PLAYER_QUEUE_LEN, sizeof(PlayerRequest));
+    free_ = xQueueCreate(PLAYER_SLOTS, sizeof(int));
+    full_ = xQueueCreate(PLAYER_SLOTS, sizeof(int));
+    if (!requests_ || !free_ || !full_) {
+        return false;
+    }
+    for (int i = 0; i < PLAYER_SLOTS; i++) {
+        xQueueSend(free_, &i, 0);
+    }
+
+    return xTaskCreatePinnedToCore(writerTask, "player_out", 3072, this, priority, NULL, core) == pdPASS &&
+           xTaskCreatePinnedToCore(readerTask, "player_sd", 4096, this, priority - 1, NULL, core) == pdPASS;
+}
+
+void AudioPlayer::addMetrics(MetricsRegistry* metrics) {
+    m_start_us_ = metrics->histogram("audio.start_us");
+    m_starved_ = metrics->counter("audio.starved");
+    m_clips_ = metrics->counter("audio.clips");
+}
+
+// ============================================================================
+// Control (never blocks)
+// ============================================================================
+
+bool AudioPlayer::enqueue(PlayerRequest* req) {
+    req->generation = generation_;
+    req->t_request_us = micros();
+    return requests_ && xQueueSend(requests_, req, 0) == pdPASS;
+}
+
+bool AudioPlayer::play(const char* path) {
+    PlayerRequest req;
+    if (strlen(path) >= sizeof(req.path)) {
+        return false;
+    }
+    strcpy(req.path, path);
+    req.source = nullptr;
+    req.pcm = nullptr;
+    req.count = 0;
+    return enqueue(&req);
+}
+
+bool AudioPlayer::playBuffer(const int16_t* pcm, uint32_t count) {
+    PlayerRequest req;
+    req.path[0] = '\0';
+    req.source = nullptr;
+    req.pcm = pcm;
+    req.count = count;
+    return enqueue(&req);
+}
+
+bool AudioPlayer::playStream(PlayerSource* source) {
+    PlayerRequest req;
+    req.path[0] = '\0';
+    req.source = source;
+    req.pcm = nullptr;
+    req.count = 0;
+    return enqueue(&req);
+}
+
+void AudioPlayer::stop() {
+    // Both tasks drop anything tagged with an older generation
+    generation_++;
+}
+
+void AudioPlayer::setVolume(float gain) {
+    gain_q8_ = (int32_t)(gain * 256.0f + 0.5f);
+}
+
+bool AudioPlayer::busy() {
+    return streaming_ || uxQueueMessagesWaiting(requests_) > 0 || uxQueueMessagesWaiting(full_) > 0;
+}
+
+// ============================================================================
+// Reader: SD / buffer -> ring
+// ============================================================================
+
+void AudioPlayer::readerTask(void* arg) {
+    AudioPlayer* self = (AudioPlayer*)arg;
+    PlayerRequest req;
+    for (;;) {
+        if (xQueueReceive(self->requests_, &req, portMAX_DELAY) != pdPASS) continue;
+        if (req.generation != self->generation_) {
+            if (req.source) req.source->cancel();
+            continue;
+        }
+        self->streaming_ = true;
+        self->stream(&req);
+        self->streaming_ = false;
+    }
+}
+
+// Samples decoded into out (at most PLAYER_SLOT_SAMPLES); 0 at the end or on error
+int AudioPlayer::fillFromFile(File& f, uint16_t format, uint32_t* left, int16_t* out) {
+    int n = 0;
+    lock();
+    if (format == WAV_FORMAT_PCM) {
+        n = *left < PLAYER_SLOT_SAMPLES ? *left : PLAYER_SLOT_SAMPLES;
+        n = f.read((uint8_t*)out, n * sizeof(int16_t)) / sizeof(int16_t);
+        unlock();
+    } else {
+        int blocks = (*left + ADPCM_BLOCK_SAMPLES - 1) / ADPCM_BLOCK_SAMPLES;
+        if (blocks > 2) blocks = 2;
+        blocks = f.read(adpcm_, blocks * ADPCM_BLOCK_BYTES) / ADPCM_BLOCK_BYTES;
+        unlock();
+        for (int b = 0; b < blocks; b++) {
+            adpcm_decode_block(adpcm_ + b * ADPCM_BLOCK_BYTES, out + b * ADPCM_BLOCK_SAMPLES);
+        }
+        n = blocks * ADPCM_BLOCK_SAMPLES;
+        if ((uint32_t)n > *left) n = *left;
+    }
+    *left -= n;
+    return n;
+}
+
+void AudioPlayer::stream(const PlayerRequest* req) {
+    File f;
+    WavInfo info;
+    uint32_t left = req->count;
+    const int16_t* pcm = req->pcm;
+
+    if (req->path[0]) {
+        lock();
+        f = fs_.open(req->path, FILE_READ);
+        bool ok = f && wav_read_info(f, &info);
+        unlock();
+        if (!ok || (int)info.sample_rate != sample_rate_) {
+            Serial.printf("[player] %s: not a mono 16-bit PCM/ADPCM WAV at %d Hz\n",
+                          req->path, sample_rate_);
+            lock();
+            if (f) f.close();
+            unlock();
+            return;
+        }
+        left = info.num_samples;
+    } else if (req->source) {
+        left = UINT32_MAX;      // Until read() returns 0
+    }
+
+    // Start latency only means something for a clip that starts from an
+    // empty ring, not one queued behind another
+    bool first = uxQueueMessagesWaiting(free_) == PLAYER_SLOTS;
+    while (left > 0 && req->generation == generation_) {
+        int idx;
+        xQueueReceive(free_, &idx, portMAX_DELAY);
+        PlayerSlot* slot = &slots_[idx];
+
+        int n;
+        if (req->path[0]) {
+            n = fillFromFile(f, info.format, &left, slot->samples);
+        } else if (req->source) {
+            n = req->source->read(slot->samples, PLAYER_SLOT_SAMPLES);
+            if (n == 0) left = 0;
+        } else {
+            n = left < PLAYER_SLOT_SAMPLES ? left : PLAYER_SLOT_SAMPLES;
+            memcpy(slot->samples, pcm, n * sizeof(int16_t));
+            pcm += n;
+            left -= n;
+        }
+        if (n == 0) {
+            xQueueSend(free_, &idx, portMAX_DELAY);
+            break;
+        }
+
+        slot->count = n;
+        slot->last = left == 0 || (req->source && req->source->finished());
+        slot->generation = req->generation;
+        slot->t_request_us = first ? req->t_request_us : 0;
+        first = false;
+        xQueueSend(full_, &idx, portMAX_DELAY);
+    }
+
+    if (req->source && left > 0 && req->generation != generation_) {
+        req->source->cancel();
+    }
+    if (f) {
+        lock();
+        f.close();
+        unlock();
+    }
+    MetricsRegistry::add(m_clips_);
+}
+
+// ============================================================================
+// Writer: ring -> I2S
+// ============================================================================
+
+void AudioPlayer::writerTask(void* arg) {
+    AudioPlayer* self = (AudioPlayer*)arg;
+    bool mid_clip = false;      // Last slot written has more of its clip to follow
+    uint32_t mid_generation = 0;
+    for (;;) {
+        int idx;
+        if (xQueueReceive(self->full_, &idx, 0) != pdPASS) {
+            // Ring ran dry inside a clip nobody stopped: SD fell behind
+            if (mid_clip && mid_generation == self->generation_) {
+                MetricsRegistry::add(self->m_starved_);
+            }
+            xQueueReceive(self->full_, &idx, portMAX_DELAY);
+        }
+
+        PlayerSlot* slot = &self->slots_[idx];
+        if (slot->generation == self->generation_) {
+            int32_t gain = self->gain_q8_;
+            if (gain != 256) {
+                for (int i = 0; i < slot->count; i++) {
+                    int32_t v = (slot->samples[i] * gain) >> 8;
+                    slot->samples[i] = v > 32767 ? 32767 : (v < -32768 ? -32768 : v);
+                }
+            }
+            if (slot->t_request_us) {
+                MetricsRegistry::record(self->m_start_us_, micros() - slot->t_request_us);
+            }
+            self->out_->write(slot->samples, slot->count);
+            mid_clip = !slot->last;
+            mid_generation = slot->generation;
+        } else {
+            mid_clip = false;
+        }
+        xQueueSend(self->free_, &idx, portMAX_DELAY);
+    }
+}
@@ -0,0 +1,125 @@
+// audio_player.h - Streaming clip player for the speaker
+// Plays mono 16-bit PCM or IMA ADPCM WAVs from SD (wav_file.h), PCM
+// buffers in memory and generated streams (PlayerSource, e.g. tts.h),
+// without loading a clip into RAM:
+//
+//   reader task:  SD / source -> decode -> PLAYER_SLOTS-slot prefetch ring
+//   writer task:  ring -> volume -> HalAudioOut (I2S1 DMA)
+//
+// play() and stop() only post to a queue, so callers never wait for audio.
+// The reader starts a clip by reading one slot, so output begins after one
+// small SD read. Queued clips are read back to back into the same ring,
+// so they play without a gap. Memory is the ring plus one ADPCM read
+// buffer, whatever the clip length.
+
+#ifndef AUDIO_PLAYER_H
+#define AUDIO_PLAYER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "hal.h"
+#include "adpcm.h"
+#include "metrics.h"
+
+#define PLAYER_SLOTS            4
+#define PLAYER_SLOT_SAMPLES     (2 * ADPCM_BLOCK_SAMPLES)   // 63 ms at 16 kHz
+#define PLAYER_QUEUE_LEN        8
+#define PLAYER_PATH_MAX         64
+
+typedef bool (*PlayerLockFn)();
+typedef void (*PlayerUnlockFn)();
+
+// Audio produced on demand, pulled by the reader task
+class PlayerSource {
+public:
+    virtual ~PlayerSource() {}
+
+    // Fill up to max samples. Blocks until at least one is ready; 0 = end
+    // of this stream.
+    virtual int read(int16_t* out, int max) = 0;
+
+    // True once the samples read so far end the stream, so the next read()
+    // would return 0
+    virtual bool finished() const { return false; }
+
+    // stop() cut the stream short; drop whatever it would still produce
+    virtual void cancel() {}
+};
+
+// One play request: an SD path, a source, or a PCM buffer
+typedef struct {
+    char path[PLAYER_PATH_MAX];
+    PlayerSource* source;
+    const int16_t* pcm;
+    uint32_t count;
+    uint32_t generation;        // stop() bumps the player's; older requests are dropped
+    uint32_t t_request_us;
+} PlayerRequest;
+
+typedef struct {
+    int16_t samples[PLAYER_SLOT_SAMPLES];
+    int count;
+    bool last;                  // Final slot of its clip
+    uint32_t generation;
+    uint32_t t_request_us;      // First slot of a clip started from silence, else 0
+} PlayerSlot;
+
+class AudioPlayer {
+public:
+    AudioPlayer(fs::FS& fs, PlayerLockFn lock = nullptr, PlayerUnlockFn unlock = nullptr);
+
+    // Starts out and both tasks. The writer runs at `priority`, the reader
+    // one below it, both on `core`.
+    bool begin(HalAudioOut* out, int sample_rate, int core = 1, int priority = 3);
+
+    // audio.start_us (request to first I2S write, clips started from
+    // silence only), audio.starved (writer waited on SD or a source
+    // mid-clip), audio.clips
+    void addMetrics(MetricsRegistry* metrics);
+
+    // Queue behind whatever is playing; false if the queue is full or the
+    // path is too long. A buffer must stay valid until it has played.
+    bool play(const char* path);
+    bool playBuffer(const int16_t* pcm, uint32_t count);
+    bool playStream(PlayerSource* source);
+
+    // Drop the current clip and everything queued (DMA drains what it holds)
+    void stop();
+
+    void setVolume(float gain);     // 1.0 = as recorded
+    bool busy();
+
+private:
+    static void readerTask(void* arg);
+    static void writerTask(void* arg);
+    bool enqueue(PlayerRequest* req);
+    void stream(const PlayerRequest* req);
+    int fillFromFile(File& f, uint16_t format, uint32_t* left, int16_t* out);
+
+    bool lock();
+    void unlock();
+
+    fs::FS& fs_;
+    PlayerLockFn lock_;
+    PlayerUnlockFn unlock_;
+    HalAudioOut* out_;
+    int sample_rate_;
+
+    QueueHandle_t requests_;
+    QueueHandle_t free_;        // Slot indices ready to fill
+    QueueHandle_t full_;        // Slot indices ready to play, in order
+    PlayerSlot slots_[PLAYER_SLOTS];
+    uint8_t adpcm_[2 * ADPCM_BLOCK_BYTES];
+
+    volatile uint32_t generation_;
+    volatile bool streaming_;   // Reader is inside a clip
+    volatile int32_t gain_q8_;
+
+    Metric* m_start_us_;
+    Metric* m_starved_;
+    Metric* m_clips_;
+};
+
+#endif // AUDIO_PLAYER_H
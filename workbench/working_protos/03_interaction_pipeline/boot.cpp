@@ -0,0 +1,153 @@
+// boot.cpp - Deferred load tasks, readiness futures and the boot timeline
+
+#include "boot.h"
+
+#define TIMELINE_BAR_WIDTH 40
+
+// ============================================================================
+// Boot Future
+// ============================================================================
+
+bool BootFuture::wait(TickType_t timeout) {
+    EventBits_t bits = xEventGroupWaitBits(boot_->ready_, bit_, pdFALSE, pdTRUE, timeout);
+    return (bits & bit_) && ok_;
+}
+
+bool BootFuture::isReady() const {
+    return xEventGroupGetBits(boot_->ready_) & bit_;
+}
+
+// ============================================================================
+// Boot Manager
+// ============================================================================
+
+BootManager::BootManager() : ready_(NULL), num_jobs_(0), num_events_(0) {
+}
+
+void BootManager::begin() {
+    ready_ = xEventGroupCreate();
+    mark("setup");
+}
+
+void BootManager::mark(const char* name) {
+    if (num_events_ < BOOT_MAX_EVENTS) {
+        event_names_[num_events_] = name;
+        event_us_[num_events_] = micros();
+        num_events_++;
+    }
+}
+
+BootFuture* BootManager::defer(const char* name, BootJobFn fn, void* arg,
+                               BaseType_t core, UBaseType_t priority, uint32_t stack_size,
+                               BootFuture* after) {
+    if (num_jobs_ >= BOOT_MAX_JOBS || !ready_) {
+        Serial.printf("ERROR: Cannot defer %s\n", name);
+        return nullptr;
+    }
+
+    BootFuture* job = &jobs_[num_jobs_];
+    job->boot_ = this;
+    job->bit_ = 1 << num_jobs_;
+    job->name_ = name;
+    job->fn_ = fn;
+    job->arg_ = arg;
+    job->after_ = after;
+    job->core_ = core;
+    job->ok_ = false;
+    job->t_start_us_ = 0;
+    job->t_end_us_ = 0;
+    num_jobs_++;
+
+    if (xTaskCreatePinnedToCore(jobTask, name, stack_size, job, priority, NULL, core) != pdPASS) {
+        Serial.printf("ERROR: Boot task %s failed\n", name);
+        job->t_end_us_ = micros();
+        xEventGroupSetBits(ready_, job->bit_);
+    }
+    return job;
+}
+
+void BootManager::jobTask(void* param) {
+    BootFuture* job = (BootFuture*)param;
+
+    bool ok = !job->after_ || job->after_->wait();
+    job->t_start_us_ = micros();
+    if (ok) {
+        ok = job->fn_(job->arg_);
+    }
+    job->t_end_us_ = micros();
+    job->ok_ = ok;
+
+    if (!ok) {
+        Serial.printf("ERROR: Deferred load %s failed\n", job->name_);
+    }
+    xEventGroupSetBits(job->boot_->ready_, job->bit_);
+    vTaskDelete(NULL);
+}
+
+bool BootManager::allReady() const {
+    EventBits_t all = (1 << num_jobs_) - 1;
+    return (xEventGroupGetBits(ready_) & all) == all;
+}
+
+bool BootManager::waitAll(TickType_t timeout) {
+    EventBits_t all = (1 << num_jobs_) - 1;
+    EventBits_t bits = xEventGroupWaitBits(ready_, all, pdFALSE, pdTRUE, timeout);
+    if ((bits & all) != all) return false;
+
+    for (int i = 0; i < num_jobs_; i++) {
+        if (!jobs_[i].ok_) return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Timeline
+// ============================================================================
+
+void BootManager::printTimeline() {
+    uint32_t end_us = 0;
+    for (int i = 0; i < num_events_; i++) {
+        if (event_us_[i] > end_us) end_us = event_us_[i];
+    }
+    for (int i = 0; i < num_jobs_; i++) {
+        if (jobs_[i].t_end_us_ > end_us) end_us = jobs_[i].t_end_us_;
+    }
+    if (end_us == 0) end_us = 1;
+
+    Serial.println("\n========================================");
+    Serial.println("BOOT TIMELINE (ms since reset)");
+    Serial.println("========================================");
+    for (int i = 0; i < num_events_; i++) {
+        Serial.printf("  %-14s %7.1f\n", event_names_[i], event_us_[i] / 1000.0f);
+    }
+
+    Serial.println("\nDeferred loads:");
+    for (int i = 0; i < num_jobs_; i++) {
+        BootFuture* job = &jobs_[i];
+        bool done = job->isReady();
+        uint32_t start = job->t_start_us_;
+        uint32_t stop = done ? job->t_end_us_ : micros();
+
+        char bar[TIMELINE_BAR_WIDTH + 1];
+        int from = (int)((uint64_t)start * TIMELINE_BAR_WIDTH / end_us);
+        int to = (int)((uint64_t)stop * TIMELINE_BAR_WIDTH / end_us);
+        for (int c = 0; c < TIMELINE_BAR_WIDTH; c++) {
+            bar[c] = (c >= from && c <= to && start) ? '#' : '.';
+        }
+        bar[TIMELINE_BAR_WIDTH] = '\0';
+
+        Serial.printf("  %-10s core %d %7.1f -> %7.1f %7.1f ms  %s  |%s|\n",
+                      job->name_, (int)job->core_, start / 1000.0f, stop / 1000.0f,
+                      start ? (stop - start) / 1000.0f : 0.0f,
+                      !done ? "LOADING" : (job->ok_ ? "OK     " : "FAILED "), bar);
+    }
+
+    for (int i = 0; i < num_events_; i++) {
+        if (strcmp(event_names_[i], "logo") == 0) {
+            uint32_t ms = event_us_[i] / 1000;
+            Serial.printf("\nFirst frame at %u ms (target %u ms: %s)\n", ms, BOOT_LOGO_TARGET_MS,
+                          ms <= BOOT_LOGO_TARGET_MS ? "met" : "MISSED");
+        }
+    }
+    Serial.println("========================================\n");
+}
@@ -0,0 +1,83 @@
+// boot.h - Staged boot with deferred loads and a boot timeline
+// setup() only does what the first frame and the microphone need; model and
+// tokenizer loads run as background tasks. Each one returns a BootFuture that
+// a stage waits on before its first message.
+
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/event_groups.h>
+
+#define BOOT_MAX_JOBS      8
+#define BOOT_MAX_EVENTS    16
+#define BOOT_LOGO_TARGET_MS 500     // Reset -> first frame on the LCD
+
+// Runs inside the job task; returns false if the load failed
+typedef bool (*BootJobFn)(void* arg);
+
+class BootManager;
+
+// Readiness of one deferred load
+class BootFuture {
+public:
+    // Block until resolved; true if the load succeeded
+    bool wait(TickType_t timeout = portMAX_DELAY);
+
+    bool isReady() const;
+    bool ok() const { return ok_; }
+    const char* name() const { return name_; }
+
+private:
+    friend class BootManager;
+
+    BootManager* boot_;
+    EventBits_t bit_;
+    const char* name_;
+    BootJobFn fn_;
+    void* arg_;
+    BootFuture* after_;         // Dependency, resolved first (or nullptr)
+    BaseType_t core_;
+    volatile bool ok_;
+    uint32_t t_start_us_;
+    uint32_t t_end_us_;
+};
+
+class BootManager {
+public:
+    BootManager();
+
+    // Call first thing in setup()
+    void begin();
+
+    // Timeline event, timestamped against reset (micros())
+    void mark(const char* name);
+
+    // Start a background load. `after` delays the job until that future
+    // resolves; if it failed, this job fails without running.
+    BootFuture* defer(const char* name, BootJobFn fn, void* arg,
+                      BaseType_t core, UBaseType_t priority, uint32_t stack_size,
+                      BootFuture* after = nullptr);
+
+    // True once every deferred job has resolved (successfully or not)
+    bool allReady() const;
+    bool waitAll(TickType_t timeout = portMAX_DELAY);
+
+    void printTimeline();
+
+private:
+    friend class BootFuture;
+    static void jobTask(void* param);
+
+    EventGroupHandle_t ready_;
+    BootFuture jobs_[BOOT_MAX_JOBS];
+    int num_jobs_;
+
+    const char* event_names_[BOOT_MAX_EVENTS];
+    uint32_t event_us_[BOOT_MAX_EVENTS];
+    int num_events_;
+};
+
+#endif // BOOT_H
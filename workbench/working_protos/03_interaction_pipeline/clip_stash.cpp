@@ -0,0 +1,357 @@
+// clip_stash.cpp - Streaming archive of stashed utterances
+
+#include "clip_stash.h"
+#include "crc32.h"
+#include <stddef.h>
+
+static uint32_t index_bytes(uint32_t count) {
+    return (3 + count) * sizeof(uint32_t);
+}
+
+static uint32_t header_crc(const StashHeader* h) {
+    return crc32_update(0, h, offsetof(StashHeader, header_crc));
+}
+
+bool stash_read_header(File& f, StashHeader* header, uint32_t* size) {
+    if (!f || !f.seek(0) || f.read((uint8_t*)header, sizeof(*header)) != sizeof(*header)) {
+        return false;
+    }
+    if (header->magic != STASH_MAGIC || header->version != STASH_VERSION ||
+        header->header_crc != header_crc(header) || header->count > STASH_CLIPS ||
+        header->data_end < sizeof(StashHeader)) {
+        return false;
+    }
+    *size = header->data_end + index_bytes(header->count);
+    return *size <= f.size();
+}
+
+ClipStash::ClipStash(fs::FS& fs, StashLockFn lock, StashUnlockFn unlock)
+    : fs_(fs), lock_(lock), unlock_(unlock), mutex_(nullptr), sample_rate_(0), max_samples_(0),
+      seq_(0), ready_(false), count_(0), data_end_(sizeof(StashHeader)), checksum_(0),
+      m_clips_(nullptr), m_dropped_(nullptr) {
+    memset(slots_, 0, sizeof(slots_));
+    memset(offsets_, 0, sizeof(offsets_));
+}
+
+bool ClipStash::begin(int sample_rate, int max_samples) {
+    sample_rate_ = sample_rate;
+    max_samples_ = max_samples;
+    if (!mutex_) mutex_ = xSemaphoreCreateMutex();
+
+    size_t slot_bytes = adpcm_encoded_size(max_samples);
+    for (int i = 0; i < STASH_PENDING; i++) {
+        if (!slots_[i].adpcm) slots_[i].adpcm = (uint8_t*)ps_malloc(slot_bytes);
+        if (!mutex_ || !slots_[i].adpcm) {
+            Serial.println("ERROR: Failed to allocate clip stash");
+            return false;
+        }
+        slots_[i].state = SLOT_FREE;
+    }
+
+    if (!lockBus()) return false;
+    if (!fs_.exists(STASH_DIR)) fs_.mkdir(STASH_DIR);
+    ready_ = reopen();
+    unlockBus();
+
+    if (ready_) {
+        Serial.printf("Clip stash: %d of %d clips in " STASH_OPEN_PATH " (%u KB PSRAM)\n", count_,
+                      STASH_CLIPS, (unsigned)(STASH_PENDING * slot_bytes / 1024));
+    } else {
+        Serial.println("ERROR: Cannot open " STASH_OPEN_PATH);
+    }
+    return ready_;
+}
+
+void ClipStash::addMetrics(MetricsRegistry* metrics) {
+    if (!metrics) return;
+    m_clips_ = metrics->counter("stash.clips");
+    m_dropped_ = metrics->counter("stash.dropped");
+}
+
+// ============================================================================
+// Slots
+// ============================================================================
+
+void ClipStash::hold(uint32_t id, const int16_t* pcm, int num_samples) {
+    if (!ready_ || num_samples <= 0) return;
+    if (num_samples > max_samples_) num_samples = max_samples_;
+
+    // A free slot, else the oldest held one; a slot being written is never
+    // taken, so commit() can write outside the mutex
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    Slot* slot = nullptr;
+    for (int i = 0; i < STASH_PENDING && !slot; i++) {
+        if (slots_[i].state == SLOT_FREE) slot = &slots_[i];
+    }
+    for (int i = 0; i < STASH_PENDING && !slot; i++) {
+        Slot* s = &slots_[i];
+        if (s->state != SLOT_HELD) continue;
+        Slot* oldest = s;
+        for (int j = i + 1; j < STASH_PENDING; j++) {
+            if (slots_[j].state == SLOT_HELD && (int32_t)(slots_[j].seq - oldest->seq) < 0) {
+                oldest = &slots_[j];
+            }
+        }
+        slot = oldest;
+        MetricsRegistry::add(m_dropped_);
+    }
+    if (slot) slot->state = SLOT_FILLING;
+    xSemaphoreGive(mutex_);
+    if (!slot) return;
+
+    // Encode once here; the archive and the upload reuse these bytes
+    adpcm_encoder_init(&enc_);
+    uint8_t* out = slot->adpcm;
+    for (int s = 0; s < num_samples; s += ADPCM_BLOCK_SAMPLES) {
+        int n = num_samples - s < ADPCM_BLOCK_SAMPLES ? num_samples - s : ADPCM_BLOCK_SAMPLES;
+        adpcm_encode_block(&enc_, pcm + s, n, out);
+        out += ADPCM_BLOCK_BYTES;
+    }
+
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    slot->id = id;
+    slot->seq = seq_++;
+    slot->num_samples = num_samples;
+    slot->state = SLOT_HELD;
+    xSemaphoreGive(mutex_);
+}
+
+void ClipStash::drop(uint32_t id) {
+    if (!ready_) return;
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    Slot* slot = find(id);
+    if (slot) slot->state = SLOT_FREE;
+    xSemaphoreGive(mutex_);
+}
+
+ClipStash::Slot* ClipStash::find(uint32_t id) {
+    for (int i = 0; i < STASH_PENDING; i++) {
+        if (slots_[i].state == SLOT_HELD && slots_[i].id == id) return &slots_[i];
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// Archive
+// ============================================================================
+
+bool ClipStash::commit(uint32_t id, const void* embedding, int dim, StashEmbedType type,
+                       float score, const char* text) {
+    if (!ready_) return false;
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    Slot* slot = find(id);
+    if (slot) slot->state = SLOT_WRITING;
+    xSemaphoreGive(mutex_);
+    if (!slot) return false;
+
+    size_t text_len = text ? strlen(text) : 0;
+    if (text_len > STASH_TEXT_MAX) text_len = STASH_TEXT_MAX;
+    size_t embed_bytes = (size_t)dim * (type == STASH_EMBED_F32 ? sizeof(float) : sizeof(int8_t));
+    uint32_t adpcm_bytes = adpcm_encoded_size(slot->num_samples);
+
+    StashRecordHeader rec;
+    rec.magic = STASH_RECORD_MAGIC;
+    rec.length = sizeof(rec) + embed_bytes + text_len + adpcm_bytes + sizeof(uint32_t);
+    rec.interaction_id = id;
+    rec.score = score;
+    rec.num_samples = slot->num_samples;
+    rec.embed_dim = dim;
+    rec.embed_type = type;
+    rec.text_len = text_len;
+
+    File f;
+    bool ok = lockBus();
+    if (ok) {
+        f = fs_.open(STASH_OPEN_PATH, "r+");
+        ok = f && f.seek(data_end_);
+        unlockBus();
+    }
+
+    // The record goes over the old index; the running checksum covers
+    // every record byte including the CRC
+    uint32_t crc = 0;
+    uint32_t checksum = checksum_;
+    ok = ok && write(f, &rec, sizeof(rec), &crc, &checksum) &&
+         write(f, embedding, embed_bytes, &crc, &checksum) &&
+         write(f, text, text_len, &crc, &checksum) &&
+         write(f, slot->adpcm, adpcm_bytes, &crc, &checksum);
+    uint32_t crc_le = crc;
+    ok = ok && write(f, &crc_le, sizeof(crc_le), &crc, &checksum);
+
+    if (ok) {
+        offsets_[count_++] = data_end_;
+        data_end_ += rec.length;
+        checksum_ = checksum;
+    }
+
+    // On failure this rewrites the old index over the partial record
+    if (f && lockBus()) {
+        ok = writeTail(f) && ok;
+        f.close();
+        if (ok && count_ >= STASH_CLIPS) seal();
+        unlockBus();
+    }
+
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    slot->state = SLOT_FREE;
+    xSemaphoreGive(mutex_);
+
+    MetricsRegistry::add(ok ? m_clips_ : m_dropped_);
+    if (!ok) Serial.printf("[stash] #%u: write failed\n", id);
+    return ok;
+}
+
+bool ClipStash::write(File& f, const void* data, size_t len, uint32_t* crc, uint32_t* checksum) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len > 0) {
+        size_t n = len < STASH_CHUNK ? len : STASH_CHUNK;
+        if (!lockBus()) return false;
+        bool ok = f.write(p, n) == n;
+        unlockBus();
+        if (!ok) return false;
+        *crc = crc32_update(*crc, p, n);
+        *checksum = crc32_update(*checksum, p, n);
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Index at data_end, then the header that points at it (caller holds the bus)
+bool ClipStash::writeTail(File& f) {
+    uint32_t head[2] = {STASH_INDEX_MAGIC, (uint32_t)count_};
+    uint32_t crc = crc32_update(crc32_update(0, head, sizeof(head)), offsets_,
+                                count_ * sizeof(uint32_t));
+    bool ok = f.seek(data_end_) && f.write((const uint8_t*)head, sizeof(head)) == sizeof(head) &&
+              f.write((const uint8_t*)offsets_, count_ * sizeof(uint32_t)) == count_ * sizeof(uint32_t) &&
+              f.write((const uint8_t*)&crc, sizeof(crc)) == sizeof(crc);
+    if (!ok) return false;
+    f.flush();
+
+    StashHeader h;
+    h.magic = STASH_MAGIC;
+    h.version = STASH_VERSION;
+    h.sample_rate = sample_rate_;
+    h.count = count_;
+    h.data_end = data_end_;
+    h.checksum = checksum_;
+    h.sealed = count_ >= STASH_CLIPS;
+    h.header_crc = header_crc(&h);
+    ok = f.seek(0) && f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h);
+    f.flush();
+    return ok;
+}
+
+bool ClipStash::create() {
+    count_ = 0;
+    data_end_ = sizeof(StashHeader);
+    checksum_ = 0;
+    File f = fs_.open(STASH_OPEN_PATH, FILE_WRITE);
+    if (!f) return false;
+    StashHeader h;
+    memset(&h, 0, sizeof(h));
+    bool ok = f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h) && writeTail(f);
+    f.close();
+    return ok;
+}
+
+// Rename the full archive for upload and start a new one (bus held)
+bool ClipStash::seal() {
+    char path[32];
+    snprintf(path, sizeof(path), STASH_DIR "/%08x.csa", (unsigned)checksum_);
+    if (fs_.exists(path)) {
+        snprintf(path, sizeof(path), STASH_DIR "/%08x_%u.csa", (unsigned)checksum_,
+                 (unsigned)(millis() % 10000));
+    }
+    if (!fs_.rename(STASH_OPEN_PATH, path)) {
+        Serial.println("[stash] Cannot seal " STASH_OPEN_PATH);
+        return false;
+    }
+    Serial.printf("[stash] Sealed %d clips as %s\n", count_, path);
+    return create();
+}
+
+// Called with the bus held
+bool ClipStash::reopen() {
+    if (!fs_.exists(STASH_OPEN_PATH)) return create();
+
+    File f = fs_.open(STASH_OPEN_PATH, FILE_READ);
+    if (!f) return false;
+    uint32_t file_size = f.size();
+    if (file_size < sizeof(StashHeader)) {
+        f.close();
+        return create();
+    }
+
+    StashHeader h;
+    uint32_t size = 0;
+    bool intact = stash_read_header(f, &h, &size);
+    if (intact) {
+        uint32_t head[2];
+        uint32_t crc = 0;
+        intact = f.seek(h.data_end) && f.read((uint8_t*)head, sizeof(head)) == sizeof(head) &&
+                 head[0] == STASH_INDEX_MAGIC && head[1] == h.count &&
+                 f.read((uint8_t*)offsets_, h.count * sizeof(uint32_t)) == h.count * sizeof(uint32_t) &&
+                 f.read((uint8_t*)&crc, sizeof(crc)) == sizeof(crc) &&
+                 crc == crc32_update(crc32_update(0, head, sizeof(head)), offsets_,
+                                     h.count * sizeof(uint32_t));
+    }
+    if (intact) {
+        count_ = h.count;
+        data_end_ = h.data_end;
+        checksum_ = h.checksum;
+        if (h.sample_rate != (uint32_t)sample_rate_) {
+            Serial.printf("[stash] Archive is %u Hz, sealing it\n", (unsigned)h.sample_rate);
+            count_ = STASH_CLIPS;
+        }
+    } else {
+        Serial.println("[stash] " STASH_OPEN_PATH " index is stale, scanning records");
+        scan(f, file_size);
+    }
+    f.close();
+
+    bool ok = true;
+    if (!intact) {
+        File w = fs_.open(STASH_OPEN_PATH, "r+");
+        ok = w && writeTail(w);
+        if (w) w.close();
+        Serial.printf("[stash] Kept %d intact clips\n", count_);
+    }
+    if (ok && count_ >= STASH_CLIPS) ok = seal();
+    return ok;
+}
+
+// Walk the records from the header on and keep the prefix whose CRCs hold
+bool ClipStash::scan(File& f, uint32_t size) {
+    count_ = 0;
+    data_end_ = sizeof(StashHeader);
+    checksum_ = 0;
+
+    uint8_t buf[256];
+    while (count_ < STASH_CLIPS) {
+        StashRecordHeader rec;
+        if (!f.seek(data_end_) || f.read((uint8_t*)&rec, sizeof(rec)) != sizeof(rec) ||
+            rec.magic != STASH_RECORD_MAGIC || rec.length < sizeof(rec) + sizeof(uint32_t) ||
+            rec.length > size - data_end_) {
+            break;
+        }
+        uint32_t crc = crc32_update(0, &rec, sizeof(rec));
+        uint32_t checksum = crc32_update(checksum_, &rec, sizeof(rec));
+        uint32_t left = rec.length - sizeof(rec) - sizeof(uint32_t);
+        bool ok = true;
+        while (ok && left > 0) {
+            uint32_t n = left < sizeof(buf) ? left : sizeof(buf);
+            ok = f.read(buf, n) == n;
+            crc = crc32_update(crc, buf, n);
+            checksum = crc32_update(checksum, buf, n);
+            left -= n;
+        }
+        uint32_t stored = 0;
+        if (!ok || f.read((uint8_t*)&stored, sizeof(stored)) != sizeof(stored) || stored != crc) break;
+
+        checksum_ = crc32_update(checksum, &stored, sizeof(stored));
+        offsets_[count_++] = data_end_;
+        data_end_ += rec.length;
+    }
+    return count_ > 0;
+}
@@ -0,0 +1,151 @@
+// clip_stash.h - Streaming archive of stashed utterances (in_data)
+// Utterances that score below the match threshold are kept for the server,
+// which transcribes them and grows the dataset. Each one becomes a record of
+// audio + embedding + score + best-match string, appended to
+// /stash/open.csa as soon as the match stage decides:
+//
+//   mel stage:   hold(id, pcm)      ADPCM-encode into a PSRAM slot
+//   match stage: commit(id, ...)    append the record, or drop(id)
+//
+// After STASH_CLIPS records the archive is sealed and renamed to
+// /stash/<checksum>.csa, which SyncClient uploads byte for byte, so upload
+// costs no encoding pass and no PSRAM copy.
+//
+// Archive, little-endian:
+//   StashHeader (32 bytes)
+//   records:  StashRecordHeader, embedding, text, ADPCM blocks (adpcm.h),
+//             u32 crc32 of the record up to here
+//   index at data_end: u32 "CIDX", u32 count, u32 offset[count], u32 crc32
+//
+// An append writes the record and a new index over the old one, then
+// rewrites the header (count, data_end, running checksum of all record
+// bytes). A crash before the header update leaves a header whose index was
+// overwritten; begin() then scans the records by their CRCs, keeps the
+// intact prefix and writes a fresh index and header. tools/clip_stash.py
+// lists, verifies and unpacks archives on the server side.
+
+#ifndef CLIP_STASH_H
+#define CLIP_STASH_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "adpcm.h"
+#include "metrics.h"
+
+#define STASH_MAGIC         0x31415343  // "CSA1"
+#define STASH_VERSION       1
+#define STASH_RECORD_MAGIC  0x43455243  // "CREC"
+#define STASH_INDEX_MAGIC   0x58444943  // "CIDX"
+#define STASH_CLIPS         10          // Records per archive (one upload)
+#define STASH_PENDING       4           // Utterances in flight between mel and match
+#define STASH_TEXT_MAX      127
+#define STASH_CHUNK         4096        // SD write size; the bus is taken per chunk
+#define STASH_DIR           "/stash"
+#define STASH_OPEN_PATH     "/stash/open.csa"
+
+// Embedding element type in a record
+enum StashEmbedType {
+    STASH_EMBED_F32 = 0,
+    STASH_EMBED_I8
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sample_rate;
+    uint32_t count;             // Records before data_end
+    uint32_t data_end;          // Offset of the index
+    uint32_t checksum;          // crc32 of bytes [sizeof(StashHeader), data_end)
+    uint32_t sealed;            // 1 = full, waiting for upload
+    uint32_t header_crc;        // crc32 of the fields above
+} StashHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;            // Whole record, header to trailing crc
+    uint32_t interaction_id;
+    float score;                // Best match score (0 if nothing matched)
+    uint32_t num_samples;       // PCM samples; ADPCM bytes = adpcm_encoded_size()
+    uint16_t embed_dim;
+    uint8_t embed_type;         // StashEmbedType
+    uint8_t text_len;           // Best-match string, no terminator
+} StashRecordHeader;
+
+// Validate the header of an archive (caller holds the bus); *size is its
+// logical length, header to the end of the index. Sync uses it to find
+// sealed archives.
+bool stash_read_header(File& f, StashHeader* header, uint32_t* size);
+
+typedef bool (*StashLockFn)();
+typedef void (*StashUnlockFn)();
+
+class ClipStash {
+public:
+    ClipStash(fs::FS& fs, StashLockFn lock = nullptr, StashUnlockFn unlock = nullptr);
+
+    // Reopen or repair /stash/open.csa; slots for utterances up to
+    // max_samples. Takes the bus itself.
+    bool begin(int sample_rate, int max_samples);
+
+    // stash.clips (records written), stash.dropped (evicted or failed)
+    void addMetrics(MetricsRegistry* metrics);
+
+    // Keep an utterance until the match stage decides. The oldest held
+    // utterance is evicted when every slot is taken.
+    void hold(uint32_t id, const int16_t* pcm, int num_samples);
+
+    // Append the held utterance as a record; false if it was not held or
+    // the write failed
+    bool commit(uint32_t id, const void* embedding, int dim, StashEmbedType type, float score,
+                const char* text);
+    void drop(uint32_t id);
+
+    int count() const { return count_; }    // Records in the open archive
+
+private:
+    enum SlotState { SLOT_FREE, SLOT_FILLING, SLOT_HELD, SLOT_WRITING };
+
+    struct Slot {
+        uint32_t id;
+        uint32_t seq;           // Hold order, for eviction
+        uint32_t num_samples;
+        uint8_t* adpcm;         // adpcm_encoded_size(max_samples) bytes (PSRAM)
+        SlotState state;        // Only HELD slots are evicted
+    };
+
+    bool reopen();
+    bool scan(File& f, uint32_t size);
+    bool create();
+    bool writeTail(File& f);
+    bool seal();
+    bool write(File& f, const void* data, size_t len, uint32_t* crc, uint32_t* checksum);
+    Slot* find(uint32_t id);
+
+    bool lockBus() { return !lock_ || lock_(); }
+    void unlockBus() { if (unlock_) unlock_(); }
+
+    fs::FS& fs_;
+    StashLockFn lock_;
+    StashUnlockFn unlock_;
+    SemaphoreHandle_t mutex_;   // Slot states (mel and match stages)
+
+    int sample_rate_;
+    int max_samples_;
+    Slot slots_[STASH_PENDING];
+    uint32_t seq_;
+    AdpcmEncoder enc_;
+
+    // Open archive
+    bool ready_;
+    int count_;
+    uint32_t data_end_;
+    uint32_t checksum_;
+    uint32_t offsets_[STASH_CLIPS];
+
+    Metric* m_clips_;
+    Metric* m_dropped_;
+};
+
+#endif // CLIP_STASH_H
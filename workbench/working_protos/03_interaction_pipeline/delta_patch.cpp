@@ -0,0 +1,196 @@
+// delta_patch.cpp - Streaming delta patch applier
+
+#include "delta_patch.h"
+
+DeltaPatcher::DeltaPatcher(fs::FS& fs, DeltaLockFn lock, DeltaUnlockFn unlock)
+    : fs_(fs), lock_(lock), unlock_(unlock) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+bool DeltaPatcher::lock() {
+    return lock_ ? lock_() : true;
+}
+
+void DeltaPatcher::unlock() {
+    if (unlock_) unlock_();
+}
+
+bool DeltaPatcher::readExact(File& f, void* buf, size_t len) {
+    lock();
+    size_t n = f.read((uint8_t*)buf, len);
+    unlock();
+    return n == len;
+}
+
+bool DeltaPatcher::copyRange(File& src, uint64_t offset, uint32_t length, File& dst) {
+    while (length > 0) {
+        uint32_t chunk = length < DELTA_BUF_SIZE ? length : DELTA_BUF_SIZE;
+        lock();
+        bool ok = src.seek((uint32_t)offset) && src.read(buf_, chunk) == chunk &&
+                  dst.write(buf_, chunk) == chunk;
+        unlock();
+        if (!ok) return false;
+
+        sha256_update(&sha_, buf_, chunk);
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool DeltaPatcher::copyData(File& patch, uint32_t length, File& dst) {
+    while (length > 0) {
+        uint32_t chunk = length < DELTA_BUF_SIZE ? length : DELTA_BUF_SIZE;
+        lock();
+        bool ok = patch.read(buf_, chunk) == chunk && dst.write(buf_, chunk) == chunk;
+        unlock();
+        if (!ok) return false;
+
+        sha256_update(&sha_, buf_, chunk);
+        length -= chunk;
+    }
+    return true;
+}
+
+bool DeltaPatcher::recover(fs::FS& fs, const char* path, const char* staged_suffix) {
+    char tmp_path[128], bak_path[128];
+    snprintf(tmp_path, sizeof(tmp_path), "%s%s", path, staged_suffix);
+    snprintf(bak_path, sizeof(bak_path), "%s.bak", path);
+
+    // The staged file is only renamed after it verified, so with path gone it is the
+    // new version; without it, put the old one back
+    if (!fs.exists(path) && fs.exists(bak_path)) {
+        bool have_new = fs.exists(tmp_path);
+        if (fs.rename(have_new ? tmp_path : bak_path, path)) {
+            Serial.printf("[patch] Recovered %s (%s version)\n", path, have_new ? "new" : "old");
+        }
+    }
+    if (!fs.exists(path)) {
+        return false;
+    }
+    if (fs.exists(bak_path)) {
+        fs.remove(bak_path);
+    }
+    return true;
+}
+
+bool DeltaPatcher::apply(const char* path, const char* patch_path) {
+    memset(&stats_, 0, sizeof(stats_));
+    uint32_t t_start = millis();
+
+    char tmp_path[128], bak_path[128];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.new", path);
+    snprintf(bak_path, sizeof(bak_path), "%s.bak", path);
+    DeltaHeader hdr;
+
+    lock();
+    recover(fs_, path);
+    File patch = fs_.open(patch_path, FILE_READ);
+    File old_file = fs_.open(path, FILE_READ);
+    if (old_file && fs_.exists(tmp_path)) {
+        fs_.remove(tmp_path);   // Unverified output of an interrupted update
+    }
+    unlock();
+
+    if (!patch || !old_file) {
+        Serial.printf("[patch] Cannot open %s\n", !patch ? patch_path : path);
+        return false;
+    }
+    if (!readExact(patch, &hdr, sizeof(hdr)) || hdr.magic != DELTA_MAGIC ||
+        hdr.version != DELTA_VERSION) {
+        Serial.printf("[patch] %s is not a v%d delta\n", patch_path, DELTA_VERSION);
+        return false;
+    }
+    if (old_file.size() != hdr.old_size) {
+        Serial.printf("[patch] %s is %u bytes, delta expects %u (wrong base version?)\n",
+                      path, (unsigned)old_file.size(), (unsigned)hdr.old_size);
+        return false;
+    }
+
+    lock();
+    File out = fs_.open(tmp_path, FILE_WRITE);
+    unlock();
+    if (!out) {
+        Serial.printf("[patch] Cannot create %s\n", tmp_path);
+        return false;
+    }
+
+    sha256_init(&sha_);
+    bool ok = true;
+    uint64_t written = 0;
+    for (;;) {
+        uint8_t op;
+        if (!readExact(patch, &op, 1)) {
+            Serial.println("[patch] Truncated delta");
+            ok = false;
+            break;
+        }
+        if (op == DELTA_OP_END) break;
+
+        if (op == DELTA_OP_COPY) {
+            uint64_t offset = 0;
+            uint32_t length = 0;
+            ok = readExact(patch, &offset, 8) && readExact(patch, &length, 4) &&
+                 offset + length <= hdr.old_size && copyRange(old_file, offset, length, out);
+            stats_.copied += length;
+            written += length;
+        } else if (op == DELTA_OP_DATA) {
+            uint32_t length = 0;
+            ok = readExact(patch, &length, 4) && copyData(patch, length, out);
+            stats_.literal += length;
+            written += length;
+        } else {
+            Serial.printf("[patch] Unknown op %u\n", op);
+            ok = false;
+        }
+        stats_.ops++;
+        if (!ok || written > hdr.new_size) {
+            Serial.printf("[patch] Op %u failed at output byte %u\n",
+                          (unsigned)stats_.ops, (unsigned)written);
+            ok = false;
+            break;
+        }
+    }
+
+    lock();
+    out.close();
+    old_file.close();
+    patch.close();
+    unlock();
+
+    // Verify before the old file is touched
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sha256_final(&sha_, digest);
+    if (ok && (written != hdr.new_size ||
+               memcmp(digest, hdr.new_sha256, SHA256_DIGEST_SIZE) != 0)) {
+        char hex[2 * SHA256_DIGEST_SIZE + 1];
+        sha256_hex(digest, hex);
+        Serial.printf("[patch] Verify failed: %u bytes sha256 %s\n", (unsigned)written, hex);
+        ok = false;
+    }
+
+    // Never a moment without a complete file: a power cut in between leaves
+    // .bak + .new, which recover() resolves
+    lock();
+    if (ok) {
+        ok = fs_.rename(path, bak_path) && fs_.rename(tmp_path, path);
+        if (ok) {
+            fs_.remove(bak_path);
+        } else {
+            Serial.printf("[patch] Could not replace %s (new version left in %s)\n",
+                          path, tmp_path);
+            recover(fs_, path);
+        }
+    } else {
+        fs_.remove(tmp_path);
+    }
+    unlock();
+
+    stats_.elapsed_ms = millis() - t_start;
+    if (ok) {
+        Serial.printf("[patch] %s: %u KB copied, %u KB from delta, %u ops, %u ms\n", path,
+                      (unsigned)(stats_.copied / 1024), (unsigned)(stats_.literal / 1024),
+                      (unsigned)stats_.ops, (unsigned)stats_.elapsed_ms);
+    }
+    return ok;
+}
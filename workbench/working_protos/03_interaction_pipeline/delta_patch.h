@@ -0,0 +1,90 @@
+// delta_patch.h - Apply binary delta patches to files on SD
+// tools/delta_patch.py diffs two versions of a model or dataset file in
+// fixed blocks: every block of the new file that already exists anywhere in
+// the old one (by content hash) becomes a COPY, the rest is shipped as DATA.
+// An update then transfers and writes only the changed blocks.
+//
+// The patcher streams old-file ranges and literal data into "<path>.new"
+// through one DELTA_BUF_SIZE buffer, hashes the output as it is written, and
+// only replaces <path> if size and SHA-256 match the patch header. On any
+// failure the old file is left untouched.
+//
+// The swap is <path> -> <path>.bak, <path>.new -> <path>, remove .bak, so a
+// power cut leaves either the old file or the verified new one, and
+// recover() (at boot, and before every apply()) finishes or undoes it.
+//
+// Patch format (little-endian):
+//   header: u32 magic "DLT1", u32 version, u32 block_size, u32 0,
+//           u64 old_size, u64 new_size, u8[32] old_sha256, u8[32] new_sha256
+//   ops:    u8 DELTA_OP_COPY, u64 old_offset, u32 length
+//           u8 DELTA_OP_DATA, u32 length, length bytes
+//           u8 DELTA_OP_END
+
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "sha256.h"
+
+#define DELTA_MAGIC         0x31544C44  // "DLT1"
+#define DELTA_VERSION       1
+#define DELTA_BUF_SIZE      4096        // RAM bound; a multiple of the SD sector
+
+enum DeltaOp : uint8_t {
+    DELTA_OP_END = 0,
+    DELTA_OP_COPY = 1,
+    DELTA_OP_DATA = 2,
+};
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t reserved;
+    uint64_t old_size;
+    uint64_t new_size;
+    uint8_t old_sha256[SHA256_DIGEST_SIZE];
+    uint8_t new_sha256[SHA256_DIGEST_SIZE];
+} DeltaHeader;
+
+typedef struct {
+    uint64_t copied;            // Bytes taken from the old file
+    uint64_t literal;           // Bytes taken from the patch
+    uint32_t ops;
+    uint32_t elapsed_ms;
+} DeltaStats;
+
+// Wraps each SD burst, so a bus shared with the LCD is released in between
+typedef bool (*DeltaLockFn)();
+typedef void (*DeltaUnlockFn)();
+
+class DeltaPatcher {
+public:
+    explicit DeltaPatcher(fs::FS& fs, DeltaLockFn lock = nullptr, DeltaUnlockFn unlock = nullptr);
+
+    // Patch path in place using patch_path; false (old file kept) on any error
+    bool apply(const char* path, const char* patch_path);
+
+    // Complete a swap a power cut interrupted; false if path is still missing.
+    // staged_suffix names the verified replacement (SyncClient stages in .part)
+    static bool recover(fs::FS& fs, const char* path, const char* staged_suffix = ".new");
+
+    const DeltaStats& stats() const { return stats_; }
+
+private:
+    bool copyRange(File& src, uint64_t offset, uint32_t length, File& dst);
+    bool copyData(File& patch, uint32_t length, File& dst);
+    bool readExact(File& f, void* buf, size_t len);
+    bool lock();
+    void unlock();
+
+    fs::FS& fs_;
+    DeltaLockFn lock_;
+    DeltaUnlockFn unlock_;
+    Sha256 sha_;
+    DeltaStats stats_;
+    uint8_t buf_[DELTA_BUF_SIZE];
+};
+
+#endif // DELTA_PATCH_H
@@ -0,0 +1,159 @@
+// hal.h - Hardware abstraction layer for the badge
+// ESP32 backends (hal_esp32.cpp) wrap the I2S / SD / Wire / Arduino_GFX calls
+// the sketches already use. Linux backends (hal_linux.cpp) replace each device
+// with a file so the pipeline can run and be measured on a desktop:
+//   mic -> WAV in, speaker -> WAV out, SD -> disk image, LCD -> PPM frames,
+//   IMU -> CSV replay, buttons -> CSV replay, WiFi -> host TCP sockets
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// Audio
+// ============================================================================
+
+class HalAudioIn {
+public:
+    virtual ~HalAudioIn() {}
+    virtual bool begin(int sample_rate) = 0;
+
+    // Blocking read of mono 16-bit samples; returns count read (0 on error)
+    virtual int read(int16_t* samples, int count) = 0;
+
+    virtual void end() {}
+};
+
+class HalAudioOut {
+public:
+    virtual ~HalAudioOut() {}
+    virtual bool begin(int sample_rate) = 0;
+
+    // Blocking write of mono 16-bit samples; returns count written
+    virtual int write(const int16_t* samples, int count) = 0;
+
+    virtual void end() {}
+};
+
+// ============================================================================
+// Block Storage (raw 512-byte sectors)
+// ============================================================================
+
+#define HAL_SECTOR_SIZE 512
+
+class HalBlockStorage {
+public:
+    virtual ~HalBlockStorage() {}
+    virtual bool begin() = 0;
+    virtual uint32_t sectorCount() = 0;
+    virtual bool readSectors(uint32_t lba, uint8_t* buffer, uint32_t count) = 0;
+    virtual bool writeSectors(uint32_t lba, const uint8_t* buffer, uint32_t count) = 0;
+};
+
+// ============================================================================
+// Display (RGB565, 320x240 landscape)
+// ============================================================================
+
+#define HAL_BLACK 0x0000
+#define HAL_WHITE 0xFFFF
+
+class HalDisplay {
+public:
+    virtual ~HalDisplay() {}
+    virtual bool begin() = 0;
+    virtual int width() = 0;
+    virtual int height() = 0;
+
+    virtual void setBacklight(bool on) = 0;
+    virtual void setRotation(uint8_t rotation) = 0;
+    virtual void fillScreen(uint16_t color) = 0;
+
+    // pixels are big-endian RGB565 (JPEGDEC RGB565_BIG_ENDIAN output)
+    virtual void drawBitmapBE(int16_t x, int16_t y, uint16_t* pixels, int16_t w, int16_t h) = 0;
+
+    // Text cursor API (subset of Arduino_GFX)
+    virtual void setCursor(int16_t x, int16_t y) = 0;
+    virtual void setTextColor(uint16_t color) = 0;
+    virtual void setTextSize(uint8_t size) = 0;
+    virtual void print(const char* text) = 0;
+
+    // Linux backend writes a frame dump here; no-op on the LCD
+    virtual void flush() {}
+};
+
+// ============================================================================
+// IMU (QMI8658)
+// ============================================================================
+
+typedef struct {
+    uint32_t t_ms;
+    float accel[3];     // g
+    float gyro[3];      // deg/s
+} ImuSample;
+
+class HalImu {
+public:
+    virtual ~HalImu() {}
+    virtual bool begin() = 0;
+    virtual bool read(ImuSample* sample) = 0;
+};
+
+// ============================================================================
+// Buttons
+// ============================================================================
+
+enum HalButtonId {
+    HAL_BUTTON_BOOT = 0,
+    HAL_BUTTON_COUNT
+};
+
+class HalButtons {
+public:
+    virtual ~HalButtons() {}
+    virtual bool begin() = 0;
+    virtual bool isPressed(HalButtonId id) = 0;
+};
+
+// ============================================================================
+// Network (TCP client over WiFi)
+// ============================================================================
+
+class HalNet {
+public:
+    virtual ~HalNet() {}
+
+    // Start joining the network in the background (no-op on Linux)
+    virtual bool begin(const char* ssid, const char* password) = 0;
+    virtual bool linkUp() = 0;
+
+    // One connection at a time; connect() closes any previous one
+    virtual bool connect(const char* host, uint16_t port, uint32_t timeout_ms) = 0;
+
+    // Bytes sent, or -1 once the connection is gone
+    virtual int write(const uint8_t* data, int len) = 0;
+
+    // Bytes received (> 0), 0 on timeout, -1 once the peer closed or the link dropped
+    virtual int read(uint8_t* data, int len, uint32_t timeout_ms) = 0;
+
+    virtual void close() = 0;
+};
+
+// ============================================================================
+// Board
+// ============================================================================
+
+typedef struct {
+    HalAudioIn* audio_in;
+    HalAudioOut* audio_out;
+    HalBlockStorage* storage;
+    HalDisplay* display;
+    HalImu* imu;
+    HalButtons* buttons;
+    HalNet* net;
+} Hal;
+
+// Backends for the current build target (ESP32 or Linux); created once
+Hal* hal_default();
+
+#endif // HAL_H
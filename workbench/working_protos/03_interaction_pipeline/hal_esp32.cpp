@@ -0,0 +1,287 @@
+// hal_esp32.cpp - HAL backends for the ESP32-S3-LCD-2 badge
+// Thin wrappers over the same drivers the bring-up sketches use.
+
+#ifdef ARDUINO
+
+#include "hal.h"
+#include "audio_recorder.h"
+#include <driver/i2s.h>
+#include <SD.h>
+#include <Wire.h>
+#include <WiFi.h>
+#include <FastIMU.h>
+#include <Arduino_GFX_Library.h>
+
+// Speaker pins (I2S1, MAX98357A)
+#define SPK_BCK_PIN    6
+#define SPK_WS_PIN     7
+#define SPK_DOUT_PIN   8
+
+// LCD pins (SPI shared with the SD card)
+#define LCD_CS   45
+#define LCD_DC   42
+#define LCD_BL   1
+#define LCD_SCK  39
+#define LCD_MOSI 38
+#define LCD_MISO 40
+
+// QMI8658 on I2C
+#define IMU_SDA      48
+#define IMU_SCL      47
+#define IMU_ADDRESS  0x6B
+
+#define BTN_BOOT 0
+
+// ============================================================================
+// Audio In: INMP441 pair on I2S0, downmixed by AudioRecorder
+// ============================================================================
+
+class Esp32AudioIn : public HalAudioIn {
+public:
+    bool begin(int sample_rate) override {
+        return recorder_.begin(sample_rate);
+    }
+
+    int read(int16_t* samples, int count) override {
+        return recorder_.record(samples, count) ? count : 0;
+    }
+
+    void end() override {
+        recorder_.end();
+    }
+
+private:
+    AudioRecorder recorder_;
+};
+
+// ============================================================================
+// Audio Out: MAX98357A on I2S1
+// ============================================================================
+
+class Esp32AudioOut : public HalAudioOut {
+public:
+    bool begin(int sample_rate) override {
+        i2s_config_t spk_config = {
+            .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
+            .sample_rate = sample_rate,
+            .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+            .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+            .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+            .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+            .dma_buf_count = 4,
+            .dma_buf_len = 512,
+            .use_apll = false,
+            .tx_desc_auto_clear = true,
+            .fixed_mclk = 0
+        };
+
+        i2s_pin_config_t spk_pins = {
+            .bck_io_num = SPK_BCK_PIN,
+            .ws_io_num = SPK_WS_PIN,
+            .data_out_num = SPK_DOUT_PIN,
+            .data_in_num = I2S_PIN_NO_CHANGE
+        };
+
+        if (i2s_driver_install(I2S_NUM_1, &spk_config, 0, NULL) != ESP_OK) {
+            return false;
+        }
+        if (i2s_set_pin(I2S_NUM_1, &spk_pins) != ESP_OK) {
+            i2s_driver_uninstall(I2S_NUM_1);
+            return false;
+        }
+        return true;
+    }
+
+    int write(const int16_t* samples, int count) override {
+        size_t written = 0;
+        i2s_write(I2S_NUM_1, samples, count * sizeof(int16_t), &written, portMAX_DELAY);
+        return written / sizeof(int16_t);
+    }
+
+    void end() override {
+        i2s_driver_uninstall(I2S_NUM_1);
+    }
+};
+
+// ============================================================================
+// Block Storage: raw SD sectors (card must already be mounted with SD.begin)
+// ============================================================================
+
+class Esp32SdBlocks : public HalBlockStorage {
+public:
+    bool begin() override {
+        return SD.cardType() != CARD_NONE;
+    }
+
+    uint32_t sectorCount() override {
+        return SD.numSectors();
+    }
+
+    bool readSectors(uint32_t lba, uint8_t* buffer, uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            if (!SD.readRAW(buffer + i * HAL_SECTOR_SIZE, lba + i)) return false;
+        }
+        return true;
+    }
+
+    bool writeSectors(uint32_t lba, const uint8_t* buffer, uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            if (!SD.writeRAW((uint8_t*)buffer + i * HAL_SECTOR_SIZE, lba + i)) return false;
+        }
+        return true;
+    }
+};
+
+// ============================================================================
+// Display: ST7789 320x240 through Arduino_GFX
+// ============================================================================
+
+class Esp32Display : public HalDisplay {
+public:
+    Esp32Display() : gfx_(nullptr) {}
+
+    bool begin() override {
+        Arduino_DataBus* bus = new Arduino_ESP32SPI(LCD_DC, LCD_CS, LCD_SCK, LCD_MOSI, LCD_MISO);
+        gfx_ = new Arduino_ST7789(bus, -1, 1, true, 240, 320);
+        if (!gfx_->begin()) {
+            return false;
+        }
+        pinMode(LCD_BL, OUTPUT);
+        gfx_->setTextWrap(true);
+        return true;
+    }
+
+    int width() override { return gfx_->width(); }
+    int height() override { return gfx_->height(); }
+
+    void setBacklight(bool on) override { digitalWrite(LCD_BL, on ? HIGH : LOW); }
+    void setRotation(uint8_t rotation) override { gfx_->setRotation(rotation); }
+    void fillScreen(uint16_t color) override { gfx_->fillScreen(color); }
+
+    void drawBitmapBE(int16_t x, int16_t y, uint16_t* pixels, int16_t w, int16_t h) override {
+        gfx_->draw16bitBeRGBBitmap(x, y, pixels, w, h);
+    }
+
+    void setCursor(int16_t x, int16_t y) override { gfx_->setCursor(x, y); }
+    void setTextColor(uint16_t color) override { gfx_->setTextColor(color); }
+    void setTextSize(uint8_t size) override { gfx_->setTextSize(size); }
+    void print(const char* text) override { gfx_->print(text); }
+
+private:
+    Arduino_GFX* gfx_;
+};
+
+// ============================================================================
+// IMU: QMI8658 through FastIMU
+// ============================================================================
+
+class Esp32Imu : public HalImu {
+public:
+    bool begin() override {
+        Wire.begin(IMU_SDA, IMU_SCL);
+        calData calib = {0};
+        return imu_.init(calib, IMU_ADDRESS) == 0;
+    }
+
+    bool read(ImuSample* sample) override {
+        AccelData accel;
+        GyroData gyro;
+        imu_.update();
+        imu_.getAccel(&accel);
+        imu_.getGyro(&gyro);
+
+        sample->t_ms = millis();
+        sample->accel[0] = accel.accelX;
+        sample->accel[1] = accel.accelY;
+        sample->accel[2] = accel.accelZ;
+        sample->gyro[0] = gyro.gyroX;
+        sample->gyro[1] = gyro.gyroY;
+        sample->gyro[2] = gyro.gyroZ;
+        return true;
+    }
+
+private:
+    QMI8658 imu_;
+};
+
+// ============================================================================
+// Buttons: BOOT (GPIO0, active low)
+// ============================================================================
+
+class Esp32Buttons : public HalButtons {
+public:
+    bool begin() override {
+        pinMode(BTN_BOOT, INPUT_PULLUP);
+        return true;
+    }
+
+    bool isPressed(HalButtonId id) override {
+        return id == HAL_BUTTON_BOOT && digitalRead(BTN_BOOT) == LOW;
+    }
+};
+
+// ============================================================================
+// Network: WiFi station + WiFiClient
+// ============================================================================
+
+class Esp32Net : public HalNet {
+public:
+    bool begin(const char* ssid, const char* password) override {
+        WiFi.mode(WIFI_STA);
+        WiFi.setAutoReconnect(true);
+        WiFi.begin(ssid, password);
+        return true;
+    }
+
+    bool linkUp() override {
+        return WiFi.status() == WL_CONNECTED;
+    }
+
+    bool connect(const char* host, uint16_t port, uint32_t timeout_ms) override {
+        client_.stop();
+        return linkUp() && client_.connect(host, port, (int32_t)timeout_ms);
+    }
+
+    int write(const uint8_t* data, int len) override {
+        if (!client_.connected()) return -1;
+        size_t n = client_.write(data, len);
+        return n > 0 ? (int)n : -1;
+    }
+
+    int read(uint8_t* data, int len, uint32_t timeout_ms) override {
+        // Sleep a tick between polls instead of spinning on available()
+        uint32_t start = millis();
+        while (!client_.available()) {
+            if (!client_.connected() || !linkUp()) return -1;
+            if (millis() - start >= timeout_ms) return 0;
+            vTaskDelay(1);
+        }
+        int n = client_.read(data, len);
+        return n > 0 ? n : -1;
+    }
+
+    void close() override {
+        client_.stop();
+    }
+
+private:
+    WiFiClient client_;
+};
+
+// ============================================================================
+// Board
+// ============================================================================
+
+Hal* hal_default() {
+    static Esp32AudioIn audio_in;
+    static Esp32AudioOut audio_out;
+    static Esp32SdBlocks storage;
+    static Esp32Display display;
+    static Esp32Imu imu;
+    static Esp32Buttons buttons;
+    static Esp32Net net;
+    static Hal hal = {&audio_in, &audio_out, &storage, &display, &imu, &buttons, &net};
+    return &hal;
+}
+
+#endif // ARDUINO
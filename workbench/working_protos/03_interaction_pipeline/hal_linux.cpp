@@ -0,0 +1,621 @@
+// hal_linux.cpp - File-backed HAL backends for the host build (workbench/host)
+// Devices are replaced by files named on the command line:
+//   --mic in.wav        16-bit PCM, mono or stereo (downmixed); silence after EOF
+//   --spk out.wav       16-bit mono PCM, header updated on every write
+//   --sd-image sd.img   Raw sector image for HalBlockStorage
+//   --frames DIR        One PPM per display flush (frame_00000.ppm, ...)
+//   --imu imu.csv       t_ms,ax,ay,az,gx,gy,gz rows replayed against millis()
+//   --buttons btn.csv   t_ms,button,state rows (button "boot", state 0/1)
+// The network is the host's own TCP stack (tools/sync_server.py on localhost).
+// Audio is paced to the sample clock so queue and latency figures match the
+// I2S DMA timing; without --mic / --spk the devices read silence / discard.
+
+#ifndef ARDUINO
+
+#include "hal.h"
+#include <glcdfont.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#define LCD_WIDTH   320
+#define LCD_HEIGHT  240
+#define CSV_MAX_ROWS 65536
+
+// Sleep until `deadline_us` on the micros() clock (no-op if already late)
+static void sleep_until_us(uint64_t deadline_us) {
+    uint64_t now = micros();
+    if (deadline_us > now) {
+        usleep((useconds_t)(deadline_us - now));
+    }
+}
+
+// ============================================================================
+// Audio In: WAV file as the microphone
+// ============================================================================
+
+class LinuxAudioIn : public HalAudioIn {
+public:
+    LinuxAudioIn() : fp_(nullptr), channels_(1), sample_rate_(16000), data_left_(0), clock_us_(0) {}
+
+    bool begin(int sample_rate) override {
+        sample_rate_ = sample_rate;
+        clock_us_ = micros();
+
+        const char* path = host_arg("mic", nullptr);
+        if (!path) {
+            Serial.println("[hal] no --mic file, microphone reads silence");
+            return true;
+        }
+
+        fp_ = fopen(path, "rb");
+        if (!fp_ || !parseHeader()) {
+            Serial.printf("ERROR: %s is not a 16-bit PCM WAV file\n", path);
+            return false;
+        }
+        Serial.printf("[hal] mic <- %s (%d ch, %u bytes)\n", path, channels_, data_left_);
+        return true;
+    }
+
+    int read(int16_t* samples, int count) override {
+        int got = 0;
+        int16_t frame[2];
+        while (fp_ && got < count && data_left_ >= channels_ * sizeof(int16_t)) {
+            if (fread(frame, sizeof(int16_t), channels_, fp_) != (size_t)channels_) {
+                data_left_ = 0;
+                break;
+            }
+            data_left_ -= channels_ * sizeof(int16_t);
+            samples[got++] = channels_ == 2 ? (int16_t)(((int32_t)frame[0] + frame[1]) / 2) : frame[0];
+        }
+        memset(samples + got, 0, (count - got) * sizeof(int16_t));
+
+        // Block like an I2S DMA read: one buffer per count/sample_rate seconds
+        clock_us_ += (uint64_t)count * 1000000ULL / sample_rate_;
+        sleep_until_us(clock_us_);
+        return count;
+    }
+
+    void end() override {
+        if (fp_) fclose(fp_);
+        fp_ = nullptr;
+    }
+
+private:
+    bool parseHeader() {
+        char riff[12];
+        if (fread(riff, 1, 12, fp_) != 12 || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+            return false;
+        }
+
+        bool have_fmt = false;
+        char id[4];
+        uint32_t size;
+        while (fread(id, 1, 4, fp_) == 4 && fread(&size, 4, 1, fp_) == 1) {
+            if (!memcmp(id, "fmt ", 4)) {
+                uint16_t fmt[8];
+                if (size < 16 || fread(fmt, 1, 16, fp_) != 16) return false;
+                fseek(fp_, size - 16, SEEK_CUR);
+                uint16_t format = fmt[0];
+                channels_ = fmt[1];
+                uint32_t rate = fmt[2] | ((uint32_t)fmt[3] << 16);
+                uint16_t bits = fmt[7];
+                if (format != 1 || bits != 16 || channels_ < 1 || channels_ > 2) return false;
+                if ((int)rate != sample_rate_) {
+                    Serial.printf("[hal] WARNING: mic WAV is %u Hz, pipeline runs at %d Hz\n",
+                                  rate, sample_rate_);
+                }
+                have_fmt = true;
+            } else if (!memcmp(id, "data", 4)) {
+                data_left_ = size;
+                return have_fmt;
+            } else {
+                fseek(fp_, size + (size & 1), SEEK_CUR);
+            }
+        }
+        return false;
+    }
+
+    FILE* fp_;
+    int channels_;
+    int sample_rate_;
+    uint32_t data_left_;
+    uint64_t clock_us_;
+};
+
+// ============================================================================
+// Audio Out: speaker as a WAV file
+// ============================================================================
+
+class LinuxAudioOut : public HalAudioOut {
+public:
+    LinuxAudioOut() : fp_(nullptr), sample_rate_(16000), data_bytes_(0), clock_us_(0) {}
+
+    bool begin(int sample_rate) override {
+        sample_rate_ = sample_rate;
+        clock_us_ = micros();
+
+        const char* path = host_arg("spk", nullptr);
+        if (!path) {
+            return true;
+        }
+
+        fp_ = fopen(path, "wb");
+        if (!fp_) {
+            Serial.printf("ERROR: Cannot create %s\n", path);
+            return false;
+        }
+        writeHeader();
+        Serial.printf("[hal] speaker -> %s\n", path);
+        return true;
+    }
+
+    int write(const int16_t* samples, int count) override {
+        if (fp_) {
+            fwrite(samples, sizeof(int16_t), count, fp_);
+            data_bytes_ += count * sizeof(int16_t);
+            writeHeader();
+        }
+
+        // Output can't run ahead of the DAC; idle gaps don't build credit
+        uint64_t now = micros();
+        if (clock_us_ < now) clock_us_ = now;
+        clock_us_ += (uint64_t)count * 1000000ULL / sample_rate_;
+        sleep_until_us(clock_us_);
+        return count;
+    }
+
+    void end() override {
+        if (fp_) fclose(fp_);
+        fp_ = nullptr;
+    }
+
+private:
+    void writeHeader() {
+        uint32_t byte_rate = sample_rate_ * sizeof(int16_t);
+        uint8_t h[44];
+        memcpy(h, "RIFF", 4);
+        put32(h + 4, 36 + data_bytes_);
+        memcpy(h + 8, "WAVEfmt ", 8);
+        put32(h + 16, 16);
+        put16(h + 20, 1);                   // PCM
+        put16(h + 22, 1);                   // mono
+        put32(h + 24, sample_rate_);
+        put32(h + 28, byte_rate);
+        put16(h + 32, sizeof(int16_t));
+        put16(h + 34, 16);
+        memcpy(h + 36, "data", 4);
+        put32(h + 40, data_bytes_);
+
+        long pos = ftell(fp_);
+        fseek(fp_, 0, SEEK_SET);
+        fwrite(h, 1, sizeof(h), fp_);
+        fseek(fp_, pos > (long)sizeof(h) ? pos : (long)sizeof(h), SEEK_SET);
+        fflush(fp_);
+    }
+
+    static void put16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+    static void put32(uint8_t* p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+
+    FILE* fp_;
+    int sample_rate_;
+    uint32_t data_bytes_;
+    uint64_t clock_us_;
+};
+
+// ============================================================================
+// Block Storage: raw disk image
+// ============================================================================
+
+class LinuxBlockImage : public HalBlockStorage {
+public:
+    LinuxBlockImage() : fp_(nullptr), sectors_(0) {}
+
+    bool begin() override {
+        const char* path = host_arg("sd-image", nullptr);
+        if (!path) {
+            Serial.println("ERROR: No --sd-image for block storage");
+            return false;
+        }
+        fp_ = fopen(path, "r+b");
+        if (!fp_) {
+            Serial.printf("ERROR: Cannot open %s\n", path);
+            return false;
+        }
+        fseek(fp_, 0, SEEK_END);
+        sectors_ = ftell(fp_) / HAL_SECTOR_SIZE;
+        return true;
+    }
+
+    uint32_t sectorCount() override {
+        return sectors_;
+    }
+
+    bool readSectors(uint32_t lba, uint8_t* buffer, uint32_t count) override {
+        if (!fp_ || lba + count > sectors_) return false;
+        fseek(fp_, (long)lba * HAL_SECTOR_SIZE, SEEK_SET);
+        return fread(buffer, HAL_SECTOR_SIZE, count, fp_) == count;
+    }
+
+    bool writeSectors(uint32_t lba, const uint8_t* buffer, uint32_t count) override {
+        if (!fp_ || lba + count > sectors_) return false;
+        fseek(fp_, (long)lba * HAL_SECTOR_SIZE, SEEK_SET);
+        bool ok = fwrite(buffer, HAL_SECTOR_SIZE, count, fp_) == count;
+        fflush(fp_);
+        return ok;
+    }
+
+private:
+    FILE* fp_;
+    uint32_t sectors_;
+};
+
+// ============================================================================
+// Display: RGB565 framebuffer dumped as PPM frames
+// ============================================================================
+
+class LinuxFrameDump : public HalDisplay {
+public:
+    LinuxFrameDump()
+        : width_(LCD_WIDTH), height_(LCD_HEIGHT), backlight_(false), dirty_(false),
+          frame_dir_(nullptr), frame_count_(0),
+          cursor_x_(0), cursor_y_(0), text_color_(0xFFFF), text_size_(1) {
+        memset(fb_, 0, sizeof(fb_));
+    }
+
+    bool begin() override {
+        frame_dir_ = host_arg("frames", nullptr);
+        if (frame_dir_) {
+            mkdir(frame_dir_, 0755);
+            Serial.printf("[hal] display frames -> %s/\n", frame_dir_);
+        }
+        return true;
+    }
+
+    int width() override { return width_; }
+    int height() override { return height_; }
+
+    void setBacklight(bool on) override {
+        backlight_ = on;
+        dirty_ = true;
+    }
+
+    void setRotation(uint8_t rotation) override {
+        bool landscape = rotation & 1;
+        width_ = landscape ? LCD_WIDTH : LCD_HEIGHT;
+        height_ = landscape ? LCD_HEIGHT : LCD_WIDTH;
+    }
+
+    void fillScreen(uint16_t color) override {
+        for (int i = 0; i < width_ * height_; i++) fb_[i] = color;
+        dirty_ = true;
+    }
+
+    void drawBitmapBE(int16_t x, int16_t y, uint16_t* pixels, int16_t w, int16_t h) override {
+        for (int row = 0; row < h; row++) {
+            for (int col = 0; col < w; col++) {
+                uint16_t be = pixels[row * w + col];
+                setPixel(x + col, y + row, (uint16_t)((be >> 8) | (be << 8)));
+            }
+        }
+        dirty_ = true;
+    }
+
+    void setCursor(int16_t x, int16_t y) override { cursor_x_ = x; cursor_y_ = y; }
+    void setTextColor(uint16_t color) override { text_color_ = color; }
+    void setTextSize(uint8_t size) override { text_size_ = size ? size : 1; }
+
+    // Classic 5x7 GFX font in a 6x8 cell, wrapping like Arduino_GFX
+    void print(const char* text) override {
+        for (const char* p = text; *p; p++) {
+            if (*p == '\n') {
+                cursor_x_ = 0;
+                cursor_y_ += 8 * text_size_;
+                continue;
+            }
+            if (*p == '\r') continue;
+
+            if (cursor_x_ + 6 * text_size_ > width_) {
+                cursor_x_ = 0;
+                cursor_y_ += 8 * text_size_;
+            }
+            drawChar(cursor_x_, cursor_y_, (uint8_t)*p);
+            cursor_x_ += 6 * text_size_;
+        }
+        dirty_ = true;
+    }
+
+    void flush() override {
+        if (!dirty_ || !frame_dir_) return;
+        dirty_ = false;
+
+        char path[256];
+        snprintf(path, sizeof(path), "%s/frame_%05u.ppm", frame_dir_, frame_count_++);
+        FILE* fp = fopen(path, "wb");
+        if (!fp) return;
+
+        fprintf(fp, "P6\n%d %d\n255\n", width_, height_);
+        for (int i = 0; i < width_ * height_; i++) {
+            uint16_t c = backlight_ ? fb_[i] : 0;
+            uint8_t rgb[3] = {
+                (uint8_t)(((c >> 11) & 0x1F) * 255 / 31),
+                (uint8_t)(((c >> 5) & 0x3F) * 255 / 63),
+                (uint8_t)((c & 0x1F) * 255 / 31)
+            };
+            fwrite(rgb, 1, 3, fp);
+        }
+        fclose(fp);
+    }
+
+private:
+    void setPixel(int x, int y, uint16_t color) {
+        if (x >= 0 && x < width_ && y >= 0 && y < height_) {
+            fb_[y * width_ + x] = color;
+        }
+    }
+
+    void drawChar(int x, int y, uint8_t c) {
+        for (int col = 0; col < 5; col++) {
+            uint8_t bits = font[c * 5 + col];
+            for (int row = 0; row < 8; row++, bits >>= 1) {
+                if (!(bits & 1)) continue;
+                for (int dy = 0; dy < text_size_; dy++) {
+                    for (int dx = 0; dx < text_size_; dx++) {
+                        setPixel(x + col * text_size_ + dx, y + row * text_size_ + dy, text_color_);
+                    }
+                }
+            }
+        }
+    }
+
+    uint16_t fb_[LCD_WIDTH * LCD_HEIGHT];
+    int width_;
+    int height_;
+    bool backlight_;
+    bool dirty_;
+    const char* frame_dir_;
+    uint32_t frame_count_;
+    int cursor_x_;
+    int cursor_y_;
+    uint16_t text_color_;
+    int text_size_;
+};
+
+// ============================================================================
+// CSV replay helper: rows of numbers, lines not starting with a digit skipped
+// ============================================================================
+
+static int load_csv(const char* path, float* rows, int cols, int max_rows) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+
+    char line[256];
+    int n = 0;
+    while (n < max_rows && fgets(line, sizeof(line), fp)) {
+        if (!isdigit((unsigned char)line[0])) continue;
+        char* p = line;
+        int c = 0;
+        for (; c < cols; c++) {
+            char* end;
+            rows[n * cols + c] = strtof(p, &end);
+            if (end == p) break;
+            p = end;
+            while (*p == ',' || *p == ' ') p++;
+        }
+        if (c == cols) n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+// ============================================================================
+// IMU: CSV replay (t_ms,ax,ay,az,gx,gy,gz)
+// ============================================================================
+
+class LinuxImuReplay : public HalImu {
+public:
+    LinuxImuReplay() : rows_(nullptr), count_(0), next_(0), start_ms_(0) {}
+
+    bool begin() override {
+        const char* path = host_arg("imu", nullptr);
+        if (!path) return false;
+
+        rows_ = (float*)malloc(CSV_MAX_ROWS * 7 * sizeof(float));
+        count_ = rows_ ? load_csv(path, rows_, 7, CSV_MAX_ROWS) : -1;
+        if (count_ <= 0) {
+            Serial.printf("ERROR: No IMU rows in %s\n", path);
+            return false;
+        }
+        start_ms_ = millis();
+        Serial.printf("[hal] imu <- %s (%d samples)\n", path, count_);
+        return true;
+    }
+
+    // Latest sample whose timestamp has passed; holds the last row at the end
+    bool read(ImuSample* sample) override {
+        if (count_ <= 0) return false;
+        uint32_t elapsed = millis() - start_ms_;
+        while (next_ < count_ && rows_[next_ * 7] <= elapsed) next_++;
+        if (next_ == 0) return false;
+
+        const float* r = &rows_[(next_ - 1) * 7];
+        sample->t_ms = start_ms_ + (uint32_t)r[0];
+        for (int i = 0; i < 3; i++) {
+            sample->accel[i] = r[1 + i];
+            sample->gyro[i] = r[4 + i];
+        }
+        return true;
+    }
+
+private:
+    float* rows_;
+    int count_;
+    int next_;
+    uint32_t start_ms_;
+};
+
+// ============================================================================
+// Buttons: CSV replay (t_ms,button,state)
+// ============================================================================
+
+class LinuxButtonReplay : public HalButtons {
+public:
+    LinuxButtonReplay() : count_(0), next_(0), start_ms_(0) {
+        memset(pressed_, 0, sizeof(pressed_));
+    }
+
+    bool begin() override {
+        start_ms_ = millis();
+        const char* path = host_arg("buttons", nullptr);
+        if (!path) return true;
+
+        FILE* fp = fopen(path, "r");
+        if (!fp) {
+            Serial.printf("ERROR: Cannot open %s\n", path);
+            return false;
+        }
+        char line[128];
+        char name[32];
+        uint32_t t;
+        int state;
+        while (count_ < MAX_EVENTS && fgets(line, sizeof(line), fp)) {
+            if (sscanf(line, "%u , %31[^,] , %d", &t, name, &state) != 3) continue;
+            if (strcmp(name, "boot") != 0) continue;
+            events_[count_++] = {t, HAL_BUTTON_BOOT, state != 0};
+        }
+        fclose(fp);
+        Serial.printf("[hal] buttons <- %s (%d events)\n", path, count_);
+        return true;
+    }
+
+    bool isPressed(HalButtonId id) override {
+        uint32_t elapsed = millis() - start_ms_;
+        while (next_ < count_ && events_[next_].t_ms <= elapsed) {
+            pressed_[events_[next_].id] = events_[next_].pressed;
+            next_++;
+        }
+        return id < HAL_BUTTON_COUNT && pressed_[id];
+    }
+
+private:
+    static const int MAX_EVENTS = 256;
+
+    struct Event {
+        uint32_t t_ms;
+        HalButtonId id;
+        bool pressed;
+    };
+
+    Event events_[MAX_EVENTS];
+    int count_;
+    int next_;
+    uint32_t start_ms_;
+    bool pressed_[HAL_BUTTON_COUNT];
+};
+
+// ============================================================================
+// Board
+// ============================================================================
+
+// ============================================================================
+// Network: POSIX TCP sockets
+// ============================================================================
+
+class LinuxNet : public HalNet {
+public:
+    LinuxNet() : fd_(-1) {}
+
+    bool begin(const char* ssid, const char* password) override {
+        return true;
+    }
+
+    bool linkUp() override {
+        return true;
+    }
+
+    bool connect(const char* host, uint16_t port, uint32_t timeout_ms) override {
+        close();
+        char service[8];
+        snprintf(service, sizeof(service), "%u", port);
+        struct addrinfo hints = {};
+        struct addrinfo* addrs = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host, service, &hints, &addrs) != 0) {
+            return false;
+        }
+
+        // Non-blocking connect so timeout_ms applies, like WiFiClient
+        for (struct addrinfo* a = addrs; a && fd_ < 0; a = a->ai_next) {
+            fd_ = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd_ < 0) continue;
+            fcntl(fd_, F_SETFL, O_NONBLOCK);
+            if (::connect(fd_, a->ai_addr, a->ai_addrlen) != 0 &&
+                (errno != EINPROGRESS || !waitFor(POLLOUT, timeout_ms) || socketError() != 0)) {
+                close();
+            }
+        }
+        freeaddrinfo(addrs);
+        return fd_ >= 0;
+    }
+
+    int write(const uint8_t* data, int len) override {
+        int sent = 0;
+        while (fd_ >= 0 && sent < len) {
+            ssize_t n = send(fd_, data + sent, len - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += n;
+            } else if (n < 0 && errno == EAGAIN) {
+                if (!waitFor(POLLOUT, 5000)) return -1;
+            } else {
+                return -1;
+            }
+        }
+        return fd_ >= 0 ? sent : -1;
+    }
+
+    int read(uint8_t* data, int len, uint32_t timeout_ms) override {
+        if (fd_ < 0) return -1;
+        if (!waitFor(POLLIN, timeout_ms)) return 0;
+        ssize_t n = recv(fd_, data, len, 0);
+        return n > 0 ? (int)n : -1;
+    }
+
+    void close() override {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    bool waitFor(short events, uint32_t timeout_ms) {
+        struct pollfd p = {fd_, events, 0};
+        return poll(&p, 1, (int)timeout_ms) > 0;
+    }
+
+    int socketError() {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len);
+        return err;
+    }
+
+    int fd_;
+};
+
+Hal* hal_default() {
+    static LinuxAudioIn audio_in;
+    static LinuxAudioOut audio_out;
+    static LinuxBlockImage storage;
+    static LinuxFrameDump display;
+    static LinuxImuReplay imu;
+    static LinuxButtonReplay buttons;
+    static LinuxNet net;
+    static Hal hal = {&audio_in, &audio_out, &storage, &display, &imu, &buttons, &net};
+    return &hal;
+}
+
+#endif // !ARDUINO
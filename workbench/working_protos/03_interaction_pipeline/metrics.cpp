@@ -0,0 +1,361 @@
+// metrics.cpp - Registry storage, console commands and snapshot encoding
+
+#include "metrics.h"
+
+// Guards metric values (updated from every task, read by the console)
+static portMUX_TYPE metrics_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const TYPE_NAMES[] = {"counter", "gauge", "hist"};
+
+MetricsRegistry::MetricsRegistry()
+    : num_metrics_(0), num_samplers_(0), line_len_(0), tracing_(false), last_trace_ms_(0) {
+}
+
+// ============================================================================
+// Registration
+// ============================================================================
+
+Metric* MetricsRegistry::registerMetric(const char* name, const char* unit, MetricType type) {
+    for (int i = 0; i < num_metrics_; i++) {
+        if (strcmp(metrics_[i].name, name) == 0) {
+            return metrics_[i].type == type ? &metrics_[i] : nullptr;
+        }
+    }
+    if (num_metrics_ >= METRICS_MAX) {
+        Serial.printf("ERROR: Metrics registry full, dropping %s\n", name);
+        return nullptr;
+    }
+
+    Metric* m = &metrics_[num_metrics_];
+    memset(m, 0, sizeof(Metric));
+    m->name = name;
+    m->unit = unit;
+    m->type = type;
+    m->min = UINT32_MAX;
+    num_metrics_++;
+    return m;
+}
+
+Metric* MetricsRegistry::counter(const char* name, const char* unit) {
+    return registerMetric(name, unit, METRIC_COUNTER);
+}
+
+Metric* MetricsRegistry::gauge(const char* name, const char* unit) {
+    return registerMetric(name, unit, METRIC_GAUGE);
+}
+
+Metric* MetricsRegistry::histogram(const char* name, const char* unit) {
+    return registerMetric(name, unit, METRIC_HISTOGRAM);
+}
+
+bool MetricsRegistry::addSampler(MetricSampler fn, void* arg) {
+    if (num_samplers_ >= METRICS_MAX_SAMPLERS) return false;
+    samplers_[num_samplers_] = fn;
+    sampler_args_[num_samplers_] = arg;
+    num_samplers_++;
+    return true;
+}
+
+// ============================================================================
+// Updates
+// ============================================================================
+
+void MetricsRegistry::add(Metric* m, uint32_t n) {
+    if (!m) return;
+    portENTER_CRITICAL(&metrics_mux);
+    m->count += n;
+    portEXIT_CRITICAL(&metrics_mux);
+}
+
+void MetricsRegistry::set(Metric* m, float value) {
+    if (!m) return;
+    m->value = value;   // Aligned 32-bit store
+}
+
+void MetricsRegistry::record(Metric* m, uint32_t value) {
+    if (!m) return;
+    int b = (value == 0) ? 0 : 31 - __builtin_clz(value);
+    if (b >= METRIC_HIST_BUCKETS) b = METRIC_HIST_BUCKETS - 1;
+
+    portENTER_CRITICAL(&metrics_mux);
+    m->buckets[b]++;
+    m->count++;
+    m->sum += value;
+    if (value < m->min) m->min = value;
+    if (value > m->max) m->max = value;
+    portEXIT_CRITICAL(&metrics_mux);
+}
+
+void MetricsRegistry::sample() {
+    for (int i = 0; i < num_samplers_; i++) {
+        samplers_[i](this, sampler_args_[i]);
+    }
+}
+
+void MetricsRegistry::reset() {
+    portENTER_CRITICAL(&metrics_mux);
+    for (int i = 0; i < num_metrics_; i++) {
+        Metric* m = &metrics_[i];
+        m->count = 0;
+        m->min = UINT32_MAX;
+        m->max = 0;
+        m->sum = 0;
+        memset(m->buckets, 0, sizeof(m->buckets));
+    }
+    portEXIT_CRITICAL(&metrics_mux);
+}
+
+// ============================================================================
+// Text Output
+// ============================================================================
+
+// Consistent copy of one metric (no printing inside the spinlock)
+static Metric copy_metric(const Metric* m) {
+    portENTER_CRITICAL(&metrics_mux);
+    Metric c = *m;
+    portEXIT_CRITICAL(&metrics_mux);
+    return c;
+}
+
+static uint32_t hist_percentile(const Metric* m, float p) {
+    if (m->count == 0) return 0;
+    uint32_t target = (uint32_t)(p * m->count + 0.5f);
+    if (target < 1) target = 1;
+    uint32_t seen = 0;
+    for (int b = 0; b < METRIC_HIST_BUCKETS; b++) {
+        seen += m->buckets[b];
+        if (seen >= target) {
+            uint32_t upper = 2u << b;
+            return upper < m->max ? upper : m->max;
+        }
+    }
+    return m->max;
+}
+
+void MetricsRegistry::print() {
+    sample();
+
+    Serial.println("\n========================================");
+    Serial.println("METRICS");
+    Serial.println("========================================");
+    for (int i = 0; i < num_metrics_; i++) {
+        Metric m = copy_metric(&metrics_[i]);
+        switch (m.type) {
+        case METRIC_COUNTER:
+            Serial.printf("  %-20s %-7s %10u %s\n", m.name, TYPE_NAMES[m.type], m.count, m.unit);
+            break;
+        case METRIC_GAUGE:
+            Serial.printf("  %-20s %-7s %10.2f %s\n", m.name, TYPE_NAMES[m.type], m.value, m.unit);
+            break;
+        case METRIC_HISTOGRAM:
+            if (m.count == 0) {
+                Serial.printf("  %-20s %-7s n=0\n", m.name, TYPE_NAMES[m.type]);
+            } else {
+                Serial.printf("  %-20s %-7s n=%-5u min=%u mean=%u p50<=%u p90<=%u max=%u %s\n",
+                              m.name, TYPE_NAMES[m.type], m.count, m.min,
+                              (uint32_t)(m.sum / m.count), hist_percentile(&m, 0.5f),
+                              hist_percentile(&m, 0.9f), m.max, m.unit);
+            }
+            break;
+        }
+    }
+    Serial.println("========================================\n");
+}
+
+void MetricsRegistry::trace() {
+    if (!tracing_) return;
+    uint32_t now = millis();
+    if (now - last_trace_ms_ < METRICS_TRACE_MS) return;
+    last_trace_ms_ = now;
+
+    sample();
+    Serial.printf("[trace] t=%.1f", now / 1000.0f);
+    for (int i = 0; i < num_metrics_; i++) {
+        Metric m = copy_metric(&metrics_[i]);
+        if (m.type == METRIC_COUNTER) {
+            Serial.printf(" %s=%u", m.name, m.count);
+        } else if (m.type == METRIC_GAUGE) {
+            Serial.printf(" %s=%.1f", m.name, m.value);
+        } else if (m.count > 0) {
+            Serial.printf(" %s=%u/%u", m.name, m.count, (uint32_t)(m.sum / m.count));
+        }
+    }
+    Serial.println();
+}
+
+// ============================================================================
+// Console
+// ============================================================================
+
+const char* MetricsRegistry::readLine() {
+    while (Serial.available()) {
+        char c = Serial.read();
+        if (c == '\r' || c == '\n') {
+            if (line_len_ == 0) continue;
+            line_[line_len_] = '\0';
+            line_len_ = 0;
+            return line_;
+        }
+        if (line_len_ < METRICS_LINE_MAX - 1) {
+            line_[line_len_++] = c;
+        }
+    }
+    return nullptr;
+}
+
+bool MetricsRegistry::command(const char* line) {
+    if (strcmp(line, "stats") == 0) {
+        print();
+    } else if (strcmp(line, "reset") == 0) {
+        reset();
+        Serial.println("Metrics reset");
+    } else if (strcmp(line, "trace on") == 0) {
+        tracing_ = true;
+        last_trace_ms_ = millis() - METRICS_TRACE_MS;
+    } else if (strcmp(line, "trace off") == 0) {
+        tracing_ = false;
+    } else if (strcmp(line, "schema") == 0) {
+        sendFrame("#MCH", true);
+    } else if (strcmp(line, "snap") == 0) {
+        sample();
+        sendFrame("#MTS", false);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Binary Snapshots
+// ============================================================================
+
+static uint8_t* put_u8(uint8_t* p, uint8_t v) {
+    *p++ = v;
+    return p;
+}
+
+static uint8_t* put_u16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = v >> (8 * i);
+    return p + 4;
+}
+
+static uint8_t* put_u64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = v >> (8 * i);
+    return p + 8;
+}
+
+static uint8_t* put_str(uint8_t* p, const char* s) {
+    size_t n = strlen(s);
+    if (n > 255) n = 255;
+    p = put_u8(p, n);
+    memcpy(p, s, n);
+    return p + n;
+}
+
+size_t MetricsRegistry::schemaSize() {
+    size_t size = 8;
+    for (int i = 0; i < num_metrics_; i++) {
+        size += 3 + strlen(metrics_[i].name) + strlen(metrics_[i].unit);
+    }
+    return size;
+}
+
+size_t MetricsRegistry::encodeSchema(uint8_t* buf, size_t cap) {
+    if (schemaSize() > cap) return 0;
+
+    uint8_t* p = buf;
+    p = put_u32(p, METRICS_SCHEMA_MAGIC);
+    p = put_u16(p, num_metrics_);
+    p = put_u16(p, 0);
+    for (int i = 0; i < num_metrics_; i++) {
+        p = put_u8(p, metrics_[i].type);
+        p = put_str(p, metrics_[i].name);
+        p = put_str(p, metrics_[i].unit);
+    }
+    return p - buf;
+}
+
+size_t MetricsRegistry::snapshotSize() {
+    size_t size = 12;
+    for (int i = 0; i < num_metrics_; i++) {
+        size += metrics_[i].type == METRIC_HISTOGRAM ? 22 + 4 * METRIC_HIST_BUCKETS : 4;
+    }
+    return size;
+}
+
+size_t MetricsRegistry::encodeSnapshot(uint8_t* buf, size_t cap) {
+    if (snapshotSize() > cap) return 0;
+
+    uint8_t* p = buf;
+    p = put_u32(p, METRICS_SNAPSHOT_MAGIC);
+    p = put_u32(p, millis());
+    p = put_u16(p, num_metrics_);
+    p = put_u16(p, 0);
+    for (int i = 0; i < num_metrics_; i++) {
+        Metric m = copy_metric(&metrics_[i]);
+        if (m.type == METRIC_COUNTER) {
+            p = put_u32(p, m.count);
+        } else if (m.type == METRIC_GAUGE) {
+            uint32_t bits;
+            memcpy(&bits, &m.value, 4);
+            p = put_u32(p, bits);
+        } else {
+            // Only the occupied bucket range
+            int first = 0, last = -1;
+            for (int b = 0; b < METRIC_HIST_BUCKETS; b++) {
+                if (m.buckets[b]) {
+                    if (last < 0) first = b;
+                    last = b;
+                }
+            }
+            p = put_u32(p, m.count);
+            p = put_u32(p, m.count ? m.min : 0);
+            p = put_u32(p, m.max);
+            p = put_u64(p, m.sum);
+            p = put_u8(p, first);
+            p = put_u8(p, last - first + 1);
+            for (int b = first; b <= last; b++) {
+                p = put_u32(p, m.buckets[b]);
+            }
+        }
+    }
+    return p - buf;
+}
+
+// Base64 straight to Serial, so no second buffer is needed
+static void print_base64(const uint8_t* data, size_t len) {
+    static const char ALPHABET[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char quad[5] = {0};
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < len) v |= data[i + 1] << 8;
+        if (i + 2 < len) v |= data[i + 2];
+        quad[0] = ALPHABET[(v >> 18) & 0x3F];
+        quad[1] = ALPHABET[(v >> 12) & 0x3F];
+        quad[2] = (i + 1 < len) ? ALPHABET[(v >> 6) & 0x3F] : '=';
+        quad[3] = (i + 2 < len) ? ALPHABET[v & 0x3F] : '=';
+        Serial.print(quad);
+    }
+}
+
+void MetricsRegistry::sendFrame(const char* tag, bool schema) {
+    size_t cap = schema ? schemaSize() : snapshotSize();
+    uint8_t* buf = (uint8_t*)malloc(cap);
+    if (!buf) {
+        Serial.printf("ERROR: No memory for %s frame\n", tag);
+        return;
+    }
+
+    size_t len = schema ? encodeSchema(buf, cap) : encodeSnapshot(buf, cap);
+    Serial.printf("%s ", tag);
+    print_base64(buf, len);
+    Serial.println();
+    free(buf);
+}
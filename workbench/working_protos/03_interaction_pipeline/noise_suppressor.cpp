@@ -0,0 +1,136 @@
+// noise_suppressor.cpp - Minimum-statistics noise suppression
+
+#include "noise_suppressor.h"
+#include <math.h>
+
+NoiseSuppressor::NoiseSuppressor()
+    : mode_(NS_WIENER), enabled_(false), gain_floor_(0), frames_(0), subwindow_pos_(0),
+      subwindow_(0), smoothed_(nullptr), noise_(nullptr), prev_clean_(nullptr),
+      cur_min_(nullptr), sub_min_(nullptr), atten_sum_(0), atten_frames_(0),
+      m_noise_db_(nullptr), m_atten_db_(nullptr) {
+}
+
+NoiseSuppressor::~NoiseSuppressor() {
+    end();
+}
+
+bool NoiseSuppressor::begin(NsMode mode) {
+    mode_ = mode;
+    gain_floor_ = powf(10.0f, NS_GAIN_FLOOR_DB / 20.0f);
+
+    // One block: 4 per-bin arrays + the sub-window minima
+    float* block = (float*)ps_malloc((4 + NS_SUBWINDOWS) * NS_BINS * sizeof(float));
+    if (!block) {
+        return false;
+    }
+    smoothed_ = block;
+    noise_ = block + NS_BINS;
+    prev_clean_ = block + 2 * NS_BINS;
+    cur_min_ = block + 3 * NS_BINS;
+    sub_min_ = block + 4 * NS_BINS;
+
+    reset();
+    enabled_ = true;
+    return true;
+}
+
+void NoiseSuppressor::end() {
+    enabled_ = false;
+    if (smoothed_) free(smoothed_);
+    smoothed_ = noise_ = prev_clean_ = cur_min_ = sub_min_ = nullptr;
+}
+
+void NoiseSuppressor::reset() {
+    frames_ = 0;
+    subwindow_pos_ = 0;
+    subwindow_ = 0;
+}
+
+void NoiseSuppressor::addMetrics(MetricsRegistry* metrics) {
+    m_noise_db_ = metrics->gauge("ns.noise_db", "dB");
+    m_atten_db_ = metrics->gauge("ns.atten_db", "dB");
+    metrics->addSampler(sampleMetrics, this);
+}
+
+void NoiseSuppressor::sampleMetrics(MetricsRegistry* metrics, void* arg) {
+    NoiseSuppressor* self = (NoiseSuppressor*)arg;
+    if (!self->noise_ || self->frames_ == 0) return;
+
+    float sum = 0.0f;
+    for (int k = 0; k < NS_BINS; k++) {
+        sum += self->noise_[k];
+    }
+    MetricsRegistry::set(self->m_noise_db_, 10.0f * log10f(sum / NS_BINS + 1e-20f));
+    if (self->atten_frames_ > 0) {
+        MetricsRegistry::set(self->m_atten_db_, self->atten_sum_ / self->atten_frames_);
+        self->atten_sum_ = 0.0f;
+        self->atten_frames_ = 0;
+    }
+}
+
+void NoiseSuppressor::process(float* power) {
+    if (!enabled_ || !smoothed_) return;
+
+    // The first frame after reset() seeds everything; VAD preroll puts a
+    // little background at the start of each utterance
+    if (frames_ == 0) {
+        for (int k = 0; k < NS_BINS; k++) {
+            smoothed_[k] = cur_min_[k] = noise_[k] = prev_clean_[k] = power[k];
+        }
+        for (int u = 0; u < NS_SUBWINDOWS; u++) {
+            memcpy(sub_min_ + u * NS_BINS, power, NS_BINS * sizeof(float));
+        }
+    }
+    frames_++;
+
+    // Noise estimate: minimum of the smoothed power over the whole window
+    for (int k = 0; k < NS_BINS; k++) {
+        float s = NS_SMOOTHING * smoothed_[k] + (1.0f - NS_SMOOTHING) * power[k];
+        smoothed_[k] = s;
+        float m = s < cur_min_[k] ? s : cur_min_[k];
+        cur_min_[k] = m;
+        for (int u = 0; u < NS_SUBWINDOWS; u++) {
+            float v = sub_min_[u * NS_BINS + k];
+            if (v < m) m = v;
+        }
+        noise_[k] = NS_BIAS * m;
+    }
+
+    // Close a sub-window: its minimum replaces the oldest one
+    if (++subwindow_pos_ == NS_SUBWINDOW_FRAMES) {
+        memcpy(sub_min_ + subwindow_ * NS_BINS, cur_min_, NS_BINS * sizeof(float));
+        memcpy(cur_min_, smoothed_, NS_BINS * sizeof(float));
+        subwindow_ = (subwindow_ + 1) % NS_SUBWINDOWS;
+        subwindow_pos_ = 0;
+    }
+
+    // Gains
+    float floor_sq = gain_floor_ * gain_floor_;
+    float in_sum = 0.0f;
+    float out_sum = 0.0f;
+    for (int k = 0; k < NS_BINS; k++) {
+        float p = power[k];
+        float n = noise_[k] + 1e-20f;
+        float out;
+        if (mode_ == NS_WIENER) {
+            float snr_post = p / n - 1.0f;
+            float snr_prio = NS_DD_ALPHA * prev_clean_[k] / n +
+                             (1.0f - NS_DD_ALPHA) * (snr_post > 0.0f ? snr_post : 0.0f);
+            float g = snr_prio / (1.0f + snr_prio);
+            if (g < gain_floor_) g = gain_floor_;
+            out = g * g * p;
+        } else {
+            out = p - NS_OVERSUBTRACT * n;
+            if (out < floor_sq * p) out = floor_sq * p;
+        }
+        prev_clean_[k] = out;
+        power[k] = out;
+        in_sum += p;
+        out_sum += out;
+    }
+
+    if (in_sum > 0.0f) {
+        atten_sum_ += 10.0f * log10f((out_sum + 1e-20f) / in_sum);
+        atten_frames_++;
+    }
+}
@@ -0,0 +1,82 @@
+// noise_suppressor.h - Stationary noise suppression on the mel power spectrum
+// Works in place on the |X[k]|^2 frames MelSpectrogram already computes, so
+// the denoised spectrum feeds the filterbank without a second FFT:
+//
+//   FFT -> power -> NoiseSuppressor::process() -> mel filterbank -> log
+//
+// Noise estimate: minimum statistics (Martin 2001, simplified). Each bin's
+// power is smoothed over time and its minimum tracked over NS_SUBWINDOWS
+// sub-windows of NS_SUBWINDOW_FRAMES frames (~1 s). Speech rarely fills a
+// bin for that long, so the minimum follows fans and hum but not the voice.
+// The estimate persists across utterances, since mel only sees speech.
+//
+// Gains: decision-directed Wiener (default) or power spectral subtraction,
+// both floored at NS_GAIN_FLOOR_DB so residual noise stays smooth instead
+// of turning into musical tones.
+
+#ifndef NOISE_SUPPRESSOR_H
+#define NOISE_SUPPRESSOR_H
+
+#include <Arduino.h>
+#include "metrics.h"
+
+#define NS_BINS                 (512 / 2 + 1)   // FFT_SIZE / 2 + 1 (mel_spectrogram.h)
+#define NS_SUBWINDOWS           8
+#define NS_SUBWINDOW_FRAMES     12              // 8 x 12 x 10 ms hop = 0.96 s
+#define NS_SMOOTHING            0.85f           // Power smoothing before the minimum
+#define NS_BIAS                 2.0f            // Minimum -> mean noise power
+#define NS_DD_ALPHA             0.98f           // Decision-directed a-priori SNR weight
+#define NS_OVERSUBTRACT         2.0f            // Spectral subtraction factor
+#define NS_GAIN_FLOOR_DB        -18.0f
+
+enum NsMode {
+    NS_WIENER = 0,
+    NS_SPECTRAL_SUBTRACTION
+};
+
+class NoiseSuppressor {
+public:
+    NoiseSuppressor();
+    ~NoiseSuppressor();
+
+    bool begin(NsMode mode = NS_WIENER);
+    void end();
+
+    // Forget the noise estimate (e.g. after moving to a new room)
+    void reset();
+
+    // Turn the gains off; process() then leaves frames untouched
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+    bool enabled() const { return enabled_; }
+
+    // ns.noise_db (mean noise estimate), ns.atten_db (mean attenuation over
+    // the frames since the last sample)
+    void addMetrics(MetricsRegistry* metrics);
+
+    // Denoise one power spectrum of NS_BINS bins in place
+    void process(float* power);
+
+private:
+    static void sampleMetrics(MetricsRegistry* metrics, void* arg);
+
+    NsMode mode_;
+    volatile bool enabled_;
+    float gain_floor_;
+    int frames_;                // Frames seen since reset()
+    int subwindow_pos_;         // Frames into the current sub-window
+    int subwindow_;             // Ring index of the current sub-window
+
+    float* smoothed_;           // NS_BINS
+    float* noise_;              // NS_BINS
+    float* prev_clean_;         // NS_BINS, G^2 |X|^2 of the previous frame
+    float* cur_min_;            // NS_BINS
+    float* sub_min_;            // NS_SUBWINDOWS x NS_BINS
+
+    float atten_sum_;           // For ns.atten_db
+    int atten_frames_;
+
+    Metric* m_noise_db_;
+    Metric* m_atten_db_;
+};
+
+#endif // NOISE_SUPPRESSOR_H
@@ -0,0 +1,348 @@
+// pipeline.cpp - Stage scheduling, bounded queues, budgets and latency stats
+
+#include "pipeline.h"
+
+// Payload header placed in front of every alloc() block (keeps 16B alignment)
+typedef struct {
+    uint32_t owner;
+    uint32_t size;
+    uint32_t reserved[2];
+} PayloadHeader;
+
+// Blocks at or above this size go to PSRAM, smaller ones to internal heap
+#define PSRAM_ALLOC_THRESHOLD 4096
+
+// Guards budgets and interaction bookkeeping (touched from every stage task)
+static portMUX_TYPE pipeline_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================================================
+// Latency Histogram
+// ============================================================================
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    count = 0;
+    min_us = UINT32_MAX;
+    max_us = 0;
+    sum_us = 0;
+    memset(buckets, 0, sizeof(buckets));
+}
+
+void LatencyHistogram::record(uint32_t us) {
+    int b = (us == 0) ? 0 : 31 - __builtin_clz(us);
+    if (b >= LATENCY_HIST_BUCKETS) b = LATENCY_HIST_BUCKETS - 1;
+    buckets[b]++;
+    count++;
+    sum_us += us;
+    if (us < min_us) min_us = us;
+    if (us > max_us) max_us = us;
+}
+
+uint32_t LatencyHistogram::percentile(float p) const {
+    if (count == 0) return 0;
+    uint32_t target = (uint32_t)(p * count + 0.5f);
+    if (target < 1) target = 1;
+    uint32_t seen = 0;
+    for (int b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= target) {
+            uint32_t upper = (b >= 31) ? UINT32_MAX : (2u << b);
+            return upper < max_us ? upper : max_us;
+        }
+    }
+    return max_us;
+}
+
+void LatencyHistogram::print(const char* name) const {
+    if (count == 0) {
+        Serial.printf("  %-12s n=0\n", name);
+        return;
+    }
+    Serial.printf("  %-12s n=%-4u min=%.2f mean=%.2f p50<=%.2f p90<=%.2f max=%.2f ms\n",
+                  name, count, min_us / 1000.0f, (sum_us / count) / 1000.0f,
+                  percentile(0.5f) / 1000.0f, percentile(0.9f) / 1000.0f,
+                  max_us / 1000.0f);
+    Serial.print("               ");
+    for (int b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+        if (buckets[b]) {
+            Serial.printf(" <%.3gms:%u", (2u << b) / 1000.0f, buckets[b]);
+        }
+    }
+    Serial.println();
+}
+
+// ============================================================================
+// Pipeline Setup
+// ============================================================================
+
+Pipeline::Pipeline()
+    : num_stages_(0), next_interaction_id_(1), first_output_id_(0),
+      completed_id_(0), interactions_(0) {
+}
+
+int Pipeline::addStage(const StageConfig& cfg, void* ctx) {
+    if (num_stages_ >= PIPELINE_MAX_STAGES) {
+        return -1;
+    }
+
+    PipelineStage* s = &stages_[num_stages_];
+    *s = PipelineStage();
+    s->cfg = cfg;
+    s->pipeline = this;
+    s->ctx = ctx;
+    s->index = num_stages_;
+    return num_stages_++;
+}
+
+bool Pipeline::connect(int from, int to) {
+    if (from < 0 || from >= num_stages_ || to < 0 || to >= num_stages_) {
+        return false;
+    }
+    PipelineStage* s = &stages_[from];
+    if (s->num_outputs >= PIPELINE_MAX_OUTPUTS || stages_[to].cfg.queue_depth == 0) {
+        return false;
+    }
+    s->outputs[s->num_outputs++] = &stages_[to];
+    return true;
+}
+
+bool Pipeline::start() {
+    // Queues first, so no task can emit into a missing queue
+    for (int i = 0; i < num_stages_; i++) {
+        PipelineStage* s = &stages_[i];
+        if (s->cfg.queue_depth > 0) {
+            s->input = xQueueCreate(s->cfg.queue_depth, sizeof(PipelineMsg));
+            if (!s->input) {
+                Serial.printf("ERROR: Queue for stage %s failed\n", s->cfg.name);
+                return false;
+            }
+        }
+    }
+
+    for (int i = 0; i < num_stages_; i++) {
+        PipelineStage* s = &stages_[i];
+        BaseType_t ok = xTaskCreatePinnedToCore(
+            stageTask,
+            s->cfg.name,
+            s->cfg.stack_size,
+            s,
+            s->cfg.priority,
+            &s->task,
+            s->cfg.core
+        );
+        if (ok != pdPASS) {
+            Serial.printf("ERROR: Task for stage %s failed\n", s->cfg.name);
+            return false;
+        }
+        Serial.printf("  Stage %-8s core %d prio %u stack %u budget %u KB queue %u\n",
+                      s->cfg.name, (int)s->cfg.core, (unsigned)s->cfg.priority,
+                      (unsigned)s->cfg.stack_size, (unsigned)(s->cfg.mem_budget / 1024),
+                      (unsigned)s->cfg.queue_depth);
+    }
+    return true;
+}
+
+void Pipeline::stageTask(void* param) {
+    PipelineStage* s = (PipelineStage*)param;
+
+    if (s->cfg.init && !s->cfg.init(s)) {
+        Serial.printf("ERROR: Stage %s init failed, stage stopped\n", s->cfg.name);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    PipelineMsg msg;
+    for (;;) {
+        if (!s->input) {
+            // Source stage: run() is expected to block on its device
+            s->cfg.run(s, nullptr);
+            continue;
+        }
+
+        if (xQueueReceive(s->input, &msg, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        uint32_t t0 = micros();
+        s->wait.record(t0 - msg.t_enqueue_us);
+        s->cfg.run(s, &msg);
+        s->service.record(micros() - t0);
+    }
+}
+
+// ============================================================================
+// Payload Memory
+// ============================================================================
+
+void* Pipeline::alloc(PipelineStage* owner, size_t size) {
+    size_t total = size + sizeof(PayloadHeader);
+
+    portENTER_CRITICAL(&pipeline_mux);
+    bool fits = owner->mem_used + total <= owner->cfg.mem_budget;
+    if (fits) {
+        owner->mem_used += total;
+        if (owner->mem_used > owner->mem_peak) owner->mem_peak = owner->mem_used;
+    } else {
+        owner->budget_denials++;
+    }
+    portEXIT_CRITICAL(&pipeline_mux);
+
+    if (!fits) {
+        return nullptr;
+    }
+
+    PayloadHeader* h = (PayloadHeader*)(total >= PSRAM_ALLOC_THRESHOLD ? ps_malloc(total) : malloc(total));
+    if (!h) {
+        portENTER_CRITICAL(&pipeline_mux);
+        owner->mem_used -= total;
+        portEXIT_CRITICAL(&pipeline_mux);
+        return nullptr;
+    }
+
+    h->owner = owner->index;
+    h->size = total;
+    return h + 1;
+}
+
+void Pipeline::release(void* payload) {
+    if (!payload) return;
+
+    PayloadHeader* h = (PayloadHeader*)payload - 1;
+    PipelineStage* owner = &stages_[h->owner];
+
+    portENTER_CRITICAL(&pipeline_mux);
+    owner->mem_used -= h->size;
+    portEXIT_CRITICAL(&pipeline_mux);
+
+    free(h);
+}
+
+// ============================================================================
+// Message Passing
+// ============================================================================
+
+bool Pipeline::emit(PipelineStage* from, int output, PipelineMsg* msg, TickType_t timeout) {
+    if (output < 0 || output >= from->num_outputs) {
+        release(msg->payload);
+        return false;
+    }
+
+    PipelineMsg copy = *msg;
+    copy.t_enqueue_us = micros();
+    if (xQueueSend(from->outputs[output]->input, &copy, timeout) != pdTRUE) {
+        from->dropped++;
+        release(msg->payload);
+        return false;
+    }
+    return true;
+}
+
+bool Pipeline::broadcast(PipelineStage* from, PipelineMsg* msg, TickType_t timeout) {
+    if (from->num_outputs == 0) {
+        release(msg->payload);
+        return false;
+    }
+
+    bool all_ok = true;
+    for (int i = from->num_outputs - 1; i >= 0; i--) {
+        PipelineMsg out = *msg;
+        if (i > 0 && msg->payload) {
+            out.payload = alloc(from, msg->size);
+            if (!out.payload) {
+                all_ok = false;
+                continue;
+            }
+            memcpy(out.payload, msg->payload, msg->size);
+        }
+        all_ok &= emit(from, i, &out, timeout);
+    }
+    return all_ok;
+}
+
+// ============================================================================
+// End-to-End Response Time
+// ============================================================================
+
+uint32_t Pipeline::nextInteractionId() {
+    portENTER_CRITICAL(&pipeline_mux);
+    uint32_t id = next_interaction_id_++;
+    portEXIT_CRITICAL(&pipeline_mux);
+    return id;
+}
+
+void Pipeline::markFirstOutput(const PipelineMsg* msg) {
+    uint32_t now = micros();
+    portENTER_CRITICAL(&pipeline_mux);
+    bool first = msg->interaction_id != first_output_id_;
+    if (first) first_output_id_ = msg->interaction_id;
+    portEXIT_CRITICAL(&pipeline_mux);
+
+    if (first) {
+        e2e_first_output_.record(now - msg->t_origin_us);
+    }
+}
+
+void Pipeline::markComplete(const PipelineMsg* msg) {
+    uint32_t now = micros();
+    portENTER_CRITICAL(&pipeline_mux);
+    bool first = msg->interaction_id != completed_id_;
+    if (first) {
+        completed_id_ = msg->interaction_id;
+        interactions_++;
+    }
+    portEXIT_CRITICAL(&pipeline_mux);
+
+    if (first) {
+        e2e_complete_.record(now - msg->t_origin_us);
+    }
+}
+
+// ============================================================================
+// Stats Export
+// ============================================================================
+
+void Pipeline::printStats() {
+    Serial.println("\n========================================");
+    Serial.printf("PIPELINE STATS (%u interactions)\n", interactions_);
+    Serial.println("========================================");
+    Serial.println("Stage     Core  Mem used/peak/budget KB   Denied  Dropped");
+    for (int i = 0; i < num_stages_; i++) {
+        PipelineStage* s = &stages_[i];
+        Serial.printf("%-8s  %4d  %6u/%6u/%6u       %6u  %7u\n",
+                      s->cfg.name, (int)s->cfg.core,
+                      (unsigned)(s->mem_used / 1024), (unsigned)(s->mem_peak / 1024),
+                      (unsigned)(s->cfg.mem_budget / 1024),
+                      s->budget_denials, s->dropped);
+    }
+
+    Serial.println("\nService time per stage:");
+    for (int i = 0; i < num_stages_; i++) {
+        if (stages_[i].input) stages_[i].service.print(stages_[i].cfg.name);
+    }
+
+    Serial.println("\nQueue wait per stage:");
+    for (int i = 0; i < num_stages_; i++) {
+        if (stages_[i].input) stages_[i].wait.print(stages_[i].cfg.name);
+    }
+
+    Serial.println("\nEnd-to-end (speech end -> ...):");
+    e2e_first_output_.print("first_out");
+    e2e_complete_.print("complete");
+    Serial.println("========================================\n");
+}
+
+void Pipeline::resetStats() {
+    for (int i = 0; i < num_stages_; i++) {
+        stages_[i].service.reset();
+        stages_[i].wait.reset();
+        stages_[i].budget_denials = 0;
+        stages_[i].dropped = 0;
+        stages_[i].mem_peak = stages_[i].mem_used;
+    }
+    e2e_first_output_.reset();
+    e2e_complete_.reset();
+    interactions_ = 0;
+}
@@ -0,0 +1,140 @@
+// pipeline.h - Event-driven interaction pipeline
+// Stages are FreeRTOS tasks pinned to a core, connected by bounded queues.
+// Each stage declares a memory budget; payloads are charged to the stage
+// that allocated them and credited back when the consumer releases them.
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+#define PIPELINE_MAX_STAGES   8
+#define PIPELINE_MAX_OUTPUTS  3
+#define LATENCY_HIST_BUCKETS  24     // log2(us) buckets: 1us .. ~16s
+
+// Message flags
+#define MSG_FLAG_END    (1 << 0)     // Last message of an interaction
+#define MSG_FLAG_CANNED (1 << 1)     // Text is the canned response
+
+// Queue item passed between stages (copied by value into the queue)
+typedef struct {
+    uint32_t interaction_id;
+    uint32_t t_origin_us;       // Speech end timestamp (start of response time)
+    uint32_t t_enqueue_us;      // Set by Pipeline::emit()
+    uint32_t flags;
+    void* payload;              // Allocated with Pipeline::alloc()
+    size_t size;
+} PipelineMsg;
+
+// Log2-bucketed latency histogram (microseconds)
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint32_t us);
+    void reset();
+
+    // Upper bound of the bucket holding the p-th percentile (0..1)
+    uint32_t percentile(float p) const;
+
+    void print(const char* name) const;
+
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+};
+
+class Pipeline;
+struct PipelineStage;
+
+// init runs once inside the stage task before the first message.
+// run receives nullptr for source stages (no input queue).
+typedef bool (*StageInitFn)(PipelineStage* stage);
+typedef void (*StageRunFn)(PipelineStage* stage, PipelineMsg* msg);
+
+typedef struct {
+    const char* name;
+    StageInitFn init;
+    StageRunFn run;
+    BaseType_t core;
+    UBaseType_t priority;
+    uint32_t stack_size;
+    size_t mem_budget;          // Max bytes of live payloads owned by stage
+    UBaseType_t queue_depth;    // Input queue length (0 = source stage)
+} StageConfig;
+
+struct PipelineStage {
+    StageConfig cfg;
+    Pipeline* pipeline;
+    void* ctx;                  // User context passed to addStage()
+    uint8_t index;
+
+    QueueHandle_t input;
+    PipelineStage* outputs[PIPELINE_MAX_OUTPUTS];
+    int num_outputs;
+    TaskHandle_t task;
+
+    size_t mem_used;
+    size_t mem_peak;
+    uint32_t budget_denials;    // alloc() refused: budget exhausted
+    uint32_t dropped;           // emit() timed out: downstream full
+
+    LatencyHistogram service;   // Time spent in run()
+    LatencyHistogram wait;      // Time spent queued before run()
+};
+
+class Pipeline {
+public:
+    Pipeline();
+
+    // Returns stage index, or -1 if the table is full
+    int addStage(const StageConfig& cfg, void* ctx);
+
+    // Connect output slot of `from` to the input queue of `to`
+    bool connect(int from, int to);
+
+    // Create queues and tasks
+    bool start();
+
+    PipelineStage* stage(int index) { return &stages_[index]; }
+    int numStages() const { return num_stages_; }
+
+    // Payload memory charged against the stage budget (PSRAM for large blocks)
+    void* alloc(PipelineStage* owner, size_t size);
+    void release(void* payload);
+
+    // Send to one output. Always takes ownership of msg->payload: if the queue
+    // stays full past `timeout` the payload is released and counted as dropped.
+    bool emit(PipelineStage* from, int output, PipelineMsg* msg, TickType_t timeout);
+
+    // Send to every output; payload is duplicated for outputs after the first
+    bool broadcast(PipelineStage* from, PipelineMsg* msg, TickType_t timeout);
+
+    // End-to-end response time bookkeeping
+    uint32_t nextInteractionId();
+    void markFirstOutput(const PipelineMsg* msg);
+    void markComplete(const PipelineMsg* msg);
+
+    void printStats();
+    void resetStats();
+
+private:
+    static void stageTask(void* param);
+
+    PipelineStage stages_[PIPELINE_MAX_STAGES];
+    int num_stages_;
+    uint32_t next_interaction_id_;
+    uint32_t first_output_id_;
+    uint32_t completed_id_;
+    uint32_t interactions_;
+
+    LatencyHistogram e2e_first_output_;
+    LatencyHistogram e2e_complete_;
+};
+
+#endif // PIPELINE_H
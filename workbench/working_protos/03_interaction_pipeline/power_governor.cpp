@@ -0,0 +1,277 @@
+// power_governor.cpp - Frequency switching, light sleep and time-in-state energy
+
+#include "power_governor.h"
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+
+// Draw estimates for the ESP32-S3 module + octal PSRAM on the 3.3 V rail,
+// from datasheet currents at each clock; calibrate against a USB meter.
+// 80 MHz is the floor: below it APB drops and the I2S / SPI clocks shift.
+const PowerStateInfo POWER_STATES[POWER_STATE_COUNT] = {
+    // name        MHz   mW       sleep
+    {"sleep",      0,    3.0f,    true},
+    {"idle",       80,   90.0f,   true},
+    {"listen",     80,   130.0f,  false},
+    {"video",      160,  190.0f,  true},
+    {"load",       240,  260.0f,  false},
+    {"inference",  240,  310.0f,  false},
+};
+
+PowerGovernor::PowerGovernor()
+    : lock_(NULL), base_(POWER_IDLE), current_(POWER_IDLE), low_since_ms_(0), wake_pin_(-1),
+      since_us_(0), switches_(0), sleeps_(0),
+      interactions_(0), interaction_mj_sum_(0), interaction_mj_max_(0) {
+    memset(demand_, 0, sizeof(demand_));
+    memset(state_us_, 0, sizeof(state_us_));
+    memset(interaction_live_, 0, sizeof(interaction_live_));
+}
+
+bool PowerGovernor::begin(PowerState base) {
+    if (base == POWER_SLEEP) {
+        Serial.println("ERROR: Power base state cannot be sleep");
+        return false;
+    }
+    lock_ = xSemaphoreCreateMutex();
+    if (!lock_) {
+        Serial.println("ERROR: Power governor lock failed");
+        return false;
+    }
+
+    base_ = base;
+    current_ = base;
+    since_us_ = micros();
+    if (!setCpuFrequencyMhz(POWER_STATES[base].cpu_mhz)) {
+        Serial.printf("ERROR: Cannot set CPU to %u MHz\n", POWER_STATES[base].cpu_mhz);
+        return false;
+    }
+    Serial.printf("[power] %s at %u MHz\n", POWER_STATES[base].name, getCpuFrequencyMhz());
+    return true;
+}
+
+void PowerGovernor::setBase(PowerState base) {
+    if (base == POWER_SLEEP) return;
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    base_ = base;
+    PowerState target = demanded();
+    if (target > current_) {
+        enter(target);
+    } else if (target < current_ && !low_since_ms_) {
+        low_since_ms_ = millis() | 1;
+    }
+    xSemaphoreGive(lock_);
+}
+
+// ============================================================================
+// Demand
+// ============================================================================
+
+PowerState PowerGovernor::demanded() const {
+    for (int s = POWER_STATE_COUNT - 1; s > base_; s--) {
+        if (demand_[s] > 0) return (PowerState)s;
+    }
+    return base_;
+}
+
+bool PowerGovernor::canSleep() const {
+    if (!POWER_STATES[base_].allow_sleep) return false;
+    for (int s = 0; s < POWER_STATE_COUNT; s++) {
+        if (demand_[s] > 0 && !POWER_STATES[s].allow_sleep) return false;
+    }
+    return true;
+}
+
+void PowerGovernor::acquire(PowerState state) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    demand_[state]++;
+    PowerState target = demanded();
+    if (target > current_) {
+        enter(target);
+    }
+    if (target >= current_) {
+        low_since_ms_ = 0;
+    }
+    xSemaphoreGive(lock_);
+}
+
+void PowerGovernor::release(PowerState state) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    if (demand_[state] > 0) {
+        demand_[state]--;
+    }
+    if (demanded() < current_ && !low_since_ms_) {
+        low_since_ms_ = millis() | 1;
+    }
+    xSemaphoreGive(lock_);
+}
+
+void PowerGovernor::poll() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    PowerState target = demanded();
+    if (target >= current_) {
+        low_since_ms_ = 0;
+    } else if (low_since_ms_ && millis() - low_since_ms_ >= POWER_DOWN_HOLD_MS) {
+        enter(target);
+        low_since_ms_ = 0;
+    }
+    xSemaphoreGive(lock_);
+}
+
+void PowerGovernor::enter(PowerState state) {
+    account(micros());
+
+    uint32_t from_mhz = POWER_STATES[current_].cpu_mhz;
+    uint32_t to_mhz = POWER_STATES[state].cpu_mhz;
+    if (to_mhz != from_mhz) {
+        if (setCpuFrequencyMhz(to_mhz)) {
+            switches_++;
+            Serial.printf("[power] %s -> %s: %u -> %u MHz\n", POWER_STATES[current_].name,
+                          POWER_STATES[state].name, from_mhz, to_mhz);
+        } else {
+            Serial.printf("ERROR: Cannot set CPU to %u MHz\n", to_mhz);
+        }
+    }
+    current_ = state;
+}
+
+void PowerGovernor::account(uint32_t now_us) {
+    state_us_[current_] += now_us - since_us_;
+    since_us_ = now_us;
+}
+
+// ============================================================================
+// Light Sleep
+// ============================================================================
+
+void PowerGovernor::wakeOnLow(int pin) {
+    wake_pin_ = pin;
+}
+
+void PowerGovernor::sleepUntil(uint32_t deadline_us) {
+    poll();
+
+    int32_t gap = (int32_t)(deadline_us - micros());
+    if (gap <= 0) return;
+
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    bool sleep = gap >= POWER_MIN_SLEEP_US && canSleep();
+    PowerState awake = current_;
+    if (sleep) {
+        account(micros());
+        current_ = POWER_SLEEP;
+        sleeps_++;
+    }
+    xSemaphoreGive(lock_);
+
+    if (sleep) {
+        Serial.flush();
+        esp_sleep_enable_timer_wakeup(gap - POWER_SLEEP_WAKE_US);
+        if (wake_pin_ >= 0) {
+            gpio_wakeup_enable((gpio_num_t)wake_pin_, GPIO_INTR_LOW_LEVEL);
+            esp_sleep_enable_gpio_wakeup();
+        }
+        esp_light_sleep_start();
+
+        xSemaphoreTake(lock_, portMAX_DELAY);
+        account(micros());
+        if (current_ == POWER_SLEEP) {
+            current_ = awake;
+        }
+        xSemaphoreGive(lock_);
+    }
+
+    // Remainder (wake-up margin, or the whole gap when staying awake)
+    gap = (int32_t)(deadline_us - micros());
+    if (gap >= 1000) {
+        delay(gap / 1000);
+        gap = (int32_t)(deadline_us - micros());
+    }
+    if (gap > 0) {
+        delayMicroseconds(gap);
+    }
+}
+
+// ============================================================================
+// Energy
+// ============================================================================
+
+float PowerGovernor::energyLocked() {
+    account(micros());
+    float mj = 0;
+    for (int s = 0; s < POWER_STATE_COUNT; s++) {
+        mj += state_us_[s] * POWER_STATES[s].est_mw / 1e6f;    // us * mW = nJ
+    }
+    return mj;
+}
+
+float PowerGovernor::energyMj() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    float mj = energyLocked();
+    xSemaphoreGive(lock_);
+    return mj;
+}
+
+void PowerGovernor::beginInteraction(uint32_t id) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    int slot = id % POWER_MAX_INTERACTIONS;
+    interaction_id_[slot] = id;
+    interaction_start_mj_[slot] = energyLocked();
+    interaction_live_[slot] = true;
+    xSemaphoreGive(lock_);
+}
+
+void PowerGovernor::endInteraction(uint32_t id) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    int slot = id % POWER_MAX_INTERACTIONS;
+    if (interaction_live_[slot] && interaction_id_[slot] == id) {
+        float mj = energyLocked() - interaction_start_mj_[slot];
+        interaction_live_[slot] = false;
+        interactions_++;
+        interaction_mj_sum_ += mj;
+        if (mj > interaction_mj_max_) interaction_mj_max_ = mj;
+    }
+    xSemaphoreGive(lock_);
+}
+
+void PowerGovernor::printStats() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    float total_mj = energyLocked();
+    uint64_t total_us = 0;
+    for (int s = 0; s < POWER_STATE_COUNT; s++) {
+        total_us += state_us_[s];
+    }
+    if (total_us == 0) total_us = 1;
+
+    Serial.println("\n========================================");
+    Serial.println("POWER (estimated from time in state)");
+    Serial.println("========================================");
+    Serial.println("  State       MHz    time s  share   est mW   energy mJ");
+    for (int s = 0; s < POWER_STATE_COUNT; s++) {
+        float mj = state_us_[s] * POWER_STATES[s].est_mw / 1e6f;
+        Serial.printf("  %-10s  %3u  %8.2f  %4.1f%%  %7.1f  %10.1f%s\n",
+                      POWER_STATES[s].name, POWER_STATES[s].cpu_mhz, state_us_[s] / 1e6f,
+                      100.0f * state_us_[s] / total_us, POWER_STATES[s].est_mw, mj,
+                      s == current_ ? "  <" : "");
+    }
+    Serial.printf("\n  Frequency switches: %u, light sleeps: %u\n", switches_, sleeps_);
+    Serial.printf("  Average draw: %.1f mW over %.1f s\n", total_mj * 1e3f / total_us * 1e3f,
+                  total_us / 1e6f);
+    if (interactions_ > 0) {
+        Serial.printf("  Energy per interaction: n=%u mean %.1f mJ max %.1f mJ\n", interactions_,
+                      interaction_mj_sum_ / interactions_, interaction_mj_max_);
+    }
+    Serial.println("========================================\n");
+    xSemaphoreGive(lock_);
+}
+
+void PowerGovernor::resetStats() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    memset(state_us_, 0, sizeof(state_us_));
+    since_us_ = micros();
+    switches_ = 0;
+    sleeps_ = 0;
+    interactions_ = 0;
+    interaction_mj_sum_ = 0;
+    interaction_mj_max_ = 0;
+    memset(interaction_live_, 0, sizeof(interaction_live_));
+    xSemaphoreGive(lock_);
+}
@@ -0,0 +1,115 @@
+// power_governor.h - CPU frequency / light-sleep governor
+// Work that needs the CPU acquires a power state while it runs; the highest
+// outstanding demand sets the clock. Raising the clock is immediate, dropping
+// it waits POWER_DOWN_HOLD_MS (applied by poll()) so back-to-back stages do
+// not bounce between frequencies. Time in each state is accumulated and
+// multiplied by the estimated draw to give energy per interaction.
+
+#ifndef POWER_GOVERNOR_H
+#define POWER_GOVERNOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#define POWER_DOWN_HOLD_MS      100     // Demand must stay low this long before downclocking
+#define POWER_MIN_SLEEP_US      3000    // Shorter gaps are waited out awake
+#define POWER_SLEEP_WAKE_US     1000    // Light-sleep wake-up latency (PSRAM + flash)
+#define POWER_MAX_INTERACTIONS  4       // Interactions tracked concurrently
+
+// Ordered by CPU demand; the governor runs the highest requested state
+enum PowerState {
+    POWER_SLEEP = 0,        // Light sleep between paced frames / IMU polls
+    POWER_IDLE,             // Waiting on a button or a paused video
+    POWER_LISTEN,           // Mic capture + VAD
+    POWER_VIDEO,            // Paced MJPEG decode at 10 fps
+    POWER_LOAD,             // Bulk flash / SD copies (models, video)
+    POWER_INFERENCE,        // Mel, YAMNet, LLM matmuls
+    POWER_STATE_COUNT
+};
+
+typedef struct {
+    const char* name;
+    uint32_t cpu_mhz;       // 0 = light sleep
+    float est_mw;           // Module draw estimate, LCD backlight excluded
+    bool allow_sleep;       // false: light sleep would stall it (I2S DMA, matmul workers)
+} PowerStateInfo;
+
+extern const PowerStateInfo POWER_STATES[POWER_STATE_COUNT];
+
+class PowerGovernor {
+public:
+    PowerGovernor();
+
+    // base = state when nothing is acquired
+    bool begin(PowerState base);
+    void setBase(PowerState base);
+
+    // Demand a state while work runs (counted; safe from any task)
+    void acquire(PowerState state);
+    void release(PowerState state);
+
+    // Apply pending downclocks; call from loop()
+    void poll();
+
+    // Wait until deadline_us (micros()). Light-sleeps when the gap is long
+    // enough and no base/acquired state forbids it, otherwise delays.
+    void sleepUntil(uint32_t deadline_us);
+
+    // Light sleep also ends when this pin reads low (BOOT button)
+    void wakeOnLow(int pin);
+
+    PowerState state() const { return current_; }
+
+    // Energy per interaction: delta of the time-in-state energy between
+    // begin and end for the same id
+    void beginInteraction(uint32_t id);
+    void endInteraction(uint32_t id);
+
+    float energyMj();
+    void printStats();
+    void resetStats();
+
+private:
+    void enter(PowerState state);     // Caller holds lock_
+    void account(uint32_t now_us);    // Caller holds lock_
+    PowerState demanded() const;
+    bool canSleep() const;
+    float energyLocked();
+
+    SemaphoreHandle_t lock_;
+    PowerState base_;
+    PowerState current_;
+    int demand_[POWER_STATE_COUNT];
+    uint32_t low_since_ms_;           // Demand first fell below current_ (0 = not pending)
+    int wake_pin_;
+
+    uint32_t since_us_;
+    uint64_t state_us_[POWER_STATE_COUNT];
+    uint32_t switches_;
+    uint32_t sleeps_;
+
+    uint32_t interaction_id_[POWER_MAX_INTERACTIONS];
+    float interaction_start_mj_[POWER_MAX_INTERACTIONS];
+    bool interaction_live_[POWER_MAX_INTERACTIONS];
+    uint32_t interactions_;
+    float interaction_mj_sum_;
+    float interaction_mj_max_;
+};
+
+// Holds a power demand for the enclosing scope (governor may be nullptr)
+class PowerDemand {
+public:
+    PowerDemand(PowerGovernor* gov, PowerState state) : gov_(gov), state_(state) {
+        if (gov_) gov_->acquire(state_);
+    }
+    ~PowerDemand() {
+        if (gov_) gov_->release(state_);
+    }
+
+private:
+    PowerGovernor* gov_;
+    PowerState state_;
+};
+
+#endif // POWER_GOVERNOR_H
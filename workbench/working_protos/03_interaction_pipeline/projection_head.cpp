@@ -0,0 +1,128 @@
+// projection_head.cpp - Int8 projection head implementation
+
+#include "projection_head.h"
+#include "matmul_kernels.h"
+#include <math.h>
+
+ProjectionHead::ProjectionHead()
+    : in_dim_(0), out_dim_(0), weights_(nullptr), scales_(nullptr), bias_(nullptr),
+      row_sums_(nullptr), xq_(nullptr), acc_(nullptr) {
+}
+
+ProjectionHead::~ProjectionHead() {
+    end();
+}
+
+bool ProjectionHead::begin(const char* path, int in_dim) {
+    File file = SD.open(path, FILE_READ);
+    if (!file) {
+        Serial.printf("ERROR: Cannot open %s\n", path);
+        return false;
+    }
+
+    ProjectionHeader header;
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != PROJECTION_MAGIC || header.version != PROJECTION_VERSION) {
+        Serial.printf("ERROR: %s is not a projection head\n", path);
+        file.close();
+        return false;
+    }
+    if ((int)header.in_dim != in_dim || header.out_dim == 0 || header.out_dim > 4096) {
+        Serial.printf("ERROR: Projection is %u -> %u, embeddings are %d-D\n",
+                      header.in_dim, header.out_dim, in_dim);
+        file.close();
+        return false;
+    }
+
+    in_dim_ = header.in_dim;
+    out_dim_ = header.out_dim;
+    size_t weight_bytes = (size_t)out_dim_ * in_dim_;
+    weights_ = (int8_t*)ps_malloc(weight_bytes);
+    scales_ = (float*)malloc(out_dim_ * (2 * sizeof(float) + sizeof(int32_t) + sizeof(float)));
+    xq_ = (int8_t*)malloc(in_dim_);
+    if (!weights_ || !scales_ || !xq_) {
+        Serial.println("ERROR: Failed to allocate projection head");
+        file.close();
+        end();
+        return false;
+    }
+    bias_ = scales_ + out_dim_;
+    row_sums_ = (int32_t*)(bias_ + out_dim_);
+    acc_ = (float*)(row_sums_ + out_dim_);
+
+    size_t vec_bytes = out_dim_ * sizeof(float);
+    bool ok = file.read((uint8_t*)weights_, weight_bytes) == weight_bytes &&
+              file.read((uint8_t*)scales_, vec_bytes) == vec_bytes &&
+              file.read((uint8_t*)bias_, vec_bytes) == vec_bytes;
+    file.close();
+    if (!ok) {
+        Serial.printf("ERROR: %s truncated\n", path);
+        end();
+        return false;
+    }
+
+    for (int i = 0; i < out_dim_; i++) {
+        const int8_t* row = weights_ + (size_t)i * in_dim_;
+        int32_t sum = 0;
+        for (int j = 0; j < in_dim_; j++) sum += row[j];
+        row_sums_[i] = sum;
+    }
+
+    Serial.printf("Projection head: %d -> %d (%u KB int8)\n", in_dim_, out_dim_,
+                  (unsigned)(weight_bytes / 1024));
+    return true;
+}
+
+void ProjectionHead::end() {
+    if (weights_) free(weights_);
+    if (scales_) free(scales_);
+    if (xq_) free(xq_);
+    weights_ = nullptr;
+    scales_ = bias_ = acc_ = nullptr;
+    row_sums_ = nullptr;
+    xq_ = nullptr;
+    in_dim_ = out_dim_ = 0;
+}
+
+void ProjectionHead::project(const float* x, int8_t* out) {
+    // One scale for the whole vector: YAMNet embeddings are ReLU outputs
+    // without per-channel outliers worth a finer grid
+    float amax = 0.0f;
+    for (int j = 0; j < in_dim_; j++) {
+        float a = fabsf(x[j]);
+        if (a > amax) amax = a;
+    }
+    float scale = amax > 0.0f ? amax / 127.0f : 1.0f;
+    float inv = 1.0f / scale;
+    for (int j = 0; j < in_dim_; j++) {
+        xq_[j] = (int8_t)lrintf(x[j] * inv);
+    }
+    project(xq_, scale, 0, out);
+}
+
+void ProjectionHead::project(const int8_t* x, float scale, int zero_point, int8_t* out) {
+    if (!weights_) {
+        memset(out, 0, out_dim_);
+        return;
+    }
+
+    // One group per row: int32 sums over the whole input, then row scale
+    // x input scale. The zero point comes out as zp * sum(row).
+    matmul_rows_q8(acc_, x, &scale, weights_, scales_, in_dim_, in_dim_, 0, out_dim_);
+    for (int i = 0; i < out_dim_; i++) {
+        acc_[i] += bias_[i] - scales_[i] * scale * zero_point * (float)row_sums_[i];
+    }
+    finish(out);
+}
+
+void ProjectionHead::finish(int8_t* out) {
+    float norm = 0.0f;
+    for (int i = 0; i < out_dim_; i++) norm += acc_[i] * acc_[i];
+    norm = sqrtf(norm);
+    float k = norm > 0.0f ? PROJECTION_ONE / norm : 0.0f;
+
+    for (int i = 0; i < out_dim_; i++) {
+        long q = lrintf(acc_[i] * k);
+        out[i] = (int8_t)(q > PROJECTION_ONE ? PROJECTION_ONE : q < -PROJECTION_ONE ? -PROJECTION_ONE : q);
+    }
+}
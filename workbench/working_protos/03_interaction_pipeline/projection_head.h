@@ -0,0 +1,66 @@
+// projection_head.h - Int8 projection + L2 normalization after YAMNet
+// Maps the 1024-D YAMNet embedding to a PROJECTION_DIM unit vector stored
+// as int8 (x 127), the row format of a version 2 match index:
+//
+//   YAMNet output tensor -> quantize (float only) -> W x + b -> L2 -> int8
+//
+// The matvec reads the output tensor in place. An int8 tensor is used with
+// its own scale and zero point; a float tensor is quantized once into a
+// 1 KB buffer. Either way the rows go through matmul_rows_q8, so weights
+// stay int8 in PSRAM (256 KB) and sums stay int32 until the per-row scale.
+// A match entry shrinks from 4 KB of floats to 256 bytes, and a search is
+// one int8 dot product per entry.
+//
+// File (tools/build_projection.py): ProjectionHeader, int8 W[out][in] row
+// major, float scale[out], float bias[out].
+
+#ifndef PROJECTION_HEAD_H
+#define PROJECTION_HEAD_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#define PROJECTION_MAGIC    0x4A4F5250   // "PROJ" little-endian
+#define PROJECTION_VERSION  1
+#define PROJECTION_DIM      256
+#define PROJECTION_ONE      127          // Int8 value of 1.0 in a projected vector
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t in_dim;
+    uint32_t out_dim;
+} ProjectionHeader;
+
+class ProjectionHead {
+public:
+    ProjectionHead();
+    ~ProjectionHead();
+
+    // Load from SD (caller holds the SPI bus); the file's in_dim must match
+    bool begin(const char* path, int in_dim);
+    void end();
+
+    int inDim() const { return in_dim_; }
+    int outDim() const { return out_dim_; }
+
+    // Float input, e.g. a float output tensor
+    void project(const float* x, int8_t* out);
+
+    // Quantized input: real value = scale * (x - zero_point)
+    void project(const int8_t* x, float scale, int zero_point, int8_t* out);
+
+private:
+    void finish(int8_t* out);
+
+    int in_dim_;
+    int out_dim_;
+    int8_t* weights_;       // out_dim x in_dim (PSRAM)
+    float* scales_;         // out_dim
+    float* bias_;           // out_dim
+    int32_t* row_sums_;     // out_dim, sum of each weight row (zero-point term)
+    int8_t* xq_;            // in_dim, quantized float input
+    float* acc_;            // out_dim
+};
+
+#endif // PROJECTION_HEAD_H
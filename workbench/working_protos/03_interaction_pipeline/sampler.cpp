@@ -0,0 +1,132 @@
+// sampler.cpp - Token sampling implementation
+
+#include "sampler.h"
+#include "fast_math.h"
+
+// Forward declarations
+static int sample_argmax(v4sf* probabilities, int n);
+static int sample_mult(v4sf* probabilities, int n, v4sf coin);
+static int sample_topp(v4sf* probabilities, int n, v4sf topp, ProbIndex* probindex, v4sf coin);
+static unsigned int random_u32(unsigned long long* state);
+static v4sf random_f32(unsigned long long* state);
+static void softmax_sampling(v4sf* x, int size);
+
+static int sample_argmax(v4sf* probabilities, int n) {
+    int max_i = 0;
+    v4sf max_p = probabilities[0];
+    for (int i = 1; i < n; i++) {
+        if (probabilities[i] > max_p) {
+            max_i = i;
+            max_p = probabilities[i];
+        }
+    }
+    return max_i;
+}
+
+static int sample_mult(v4sf* probabilities, int n, v4sf coin) {
+    v4sf cdf = 0.0f;
+    for (int i = 0; i < n; i++) {
+        cdf += probabilities[i];
+        if (coin < cdf) {
+            return i;
+        }
+    }
+    return n - 1;
+}
+
+static int compare_prob(const void* a, const void* b) {
+    ProbIndex* a_ = (ProbIndex*)a;
+    ProbIndex* b_ = (ProbIndex*)b;
+    if (a_->prob > b_->prob) return -1;
+    if (a_->prob < b_->prob) return 1;
+    return 0;
+}
+
+static int sample_topp(v4sf* probabilities, int n, v4sf topp, ProbIndex* probindex, v4sf coin) {
+    int n0 = 0;
+    const v4sf cutoff = (1.0f - topp) / (n - 1);
+    for (int i = 0; i < n; i++) {
+        if (probabilities[i] >= cutoff) {
+            probindex[n0].index = i;
+            probindex[n0].prob = probabilities[i];
+            n0++;
+        }
+    }
+    qsort(probindex, n0, sizeof(ProbIndex), compare_prob);
+
+    v4sf cumulative_prob = 0.0f;
+    int last_idx = n0 - 1;
+    for (int i = 0; i < n0; i++) {
+        cumulative_prob += probindex[i].prob;
+        if (cumulative_prob > topp) {
+            last_idx = i;
+            break;
+        }
+    }
+
+    v4sf r = coin * cumulative_prob;
+    v4sf cdf = 0.0f;
+    for (int i = 0; i <= last_idx; i++) {
+        cdf += probindex[i].prob;
+        if (r < cdf) {
+            return probindex[i].index;
+        }
+    }
+    return probindex[last_idx].index;
+}
+
+static unsigned int random_u32(unsigned long long* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (*state * 0x2545F4914F6CDD1Dull) >> 32;
+}
+
+static v4sf random_f32(unsigned long long* state) {
+    return (random_u32(state) >> 8) / 16777216.0f;
+}
+
+static void softmax_sampling(v4sf* x, int size) {
+    v4sf max_val = x[0];
+    for (int i = 1; i < size; i++) {
+        if (x[i] > max_val) max_val = x[i];
+    }
+
+    v4sf sum = fast_exp_shift_sum(x, size, max_val);
+
+    for (int i = 0; i < size; i++) {
+        x[i] /= sum;
+    }
+}
+
+void build_sampler(Sampler* sampler, int vocab_size, float temperature, float topp, unsigned long long rng_seed) {
+    sampler->vocab_size = vocab_size;
+    sampler->temperature = temperature;
+    sampler->topp = topp;
+    sampler->rng_state = rng_seed;
+    sampler->probindex = (ProbIndex*)malloc(sampler->vocab_size * sizeof(ProbIndex));
+    Serial.println("Sampler built");
+}
+
+void free_sampler(Sampler* sampler) {
+    free(sampler->probindex);
+}
+
+int sample(Sampler* sampler, v4sf* logits) {
+    int next;
+    if (sampler->temperature == 0.0f) {
+        next = sample_argmax(logits, sampler->vocab_size);
+    } else {
+        for (int q = 0; q < sampler->vocab_size; q++) {
+            logits[q] /= sampler->temperature;
+        }
+        softmax_sampling(logits, sampler->vocab_size);
+        v4sf coin = random_f32(&sampler->rng_state);
+        if (sampler->topp <= 0 || sampler->topp >= 1) {
+            next = sample_mult(logits, sampler->vocab_size, coin);
+        } else {
+            next = sample_topp(logits, sampler->vocab_size, sampler->topp, sampler->probindex, coin);
+        }
+    }
+    return next;
+}
@@ -0,0 +1,27 @@
+// sha256.h - Streaming SHA-256 (FIPS 180-4)
+// Portable C, so the device and the host build hash identically. Used to
+// verify patched files while they are written (delta_patch.h).
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;            // Bytes hashed so far
+    uint8_t block[64];
+    size_t block_len;
+} Sha256;
+
+void sha256_init(Sha256* ctx);
+void sha256_update(Sha256* ctx, const void* data, size_t len);
+void sha256_final(Sha256* ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// Lowercase hex, out must hold 2 * SHA256_DIGEST_SIZE + 1 chars
+void sha256_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char* out);
+
+#endif // SHA256_H
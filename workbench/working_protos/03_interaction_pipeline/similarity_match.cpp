@@ -0,0 +1,628 @@
+// similarity_match.cpp - Cosine similarity search implementation
+
+#include "similarity_match.h"
+#include "crc32.h"
+#include <esp_dsp.h>
+#include <math.h>
+
+static void normalize(float* v, int n) {
+    float norm = 0.0f;
+    for (int j = 0; j < n; j++) norm += v[j] * v[j];
+    norm = sqrtf(norm);
+    if (norm > 0.0f) {
+        for (int j = 0; j < n; j++) v[j] /= norm;
+    }
+}
+
+SimilarityMatcher::SimilarityMatcher(fs::FS& fs, MatchLockFn lock, MatchUnlockFn unlock)
+    : fs_(fs), lock_(lock), unlock_(unlock), mutex_(nullptr), dim_(0), text_len_(0),
+      quantized_(false), row_bytes_(0), total_(0), capacity_(0), live_(0), sealed_(false),
+      sealed_end_(0), pending_(0), seg_records_(0), rows_(nullptr), texts_(nullptr),
+      dead_(nullptr), last_query_(nullptr), have_query_(false), power_(nullptr),
+      task_(nullptr), wake_(nullptr), force_(false), m_entries_(nullptr),
+      m_pending_(nullptr), m_compact_ms_(nullptr) {
+    base_path_[0] = seg_path_[0] = old_path_[0] = new_path_[0] = tmp_path_[0] = '\0';
+}
+
+SimilarityMatcher::~SimilarityMatcher() {
+    end();
+}
+
+bool SimilarityMatcher::begin(const char* index_path) {
+    // /match_index.bin -> /match_index.seg, .old, .new, .seg.tmp
+    char stem[MATCH_PATH_MAX];
+    snprintf(stem, sizeof(stem), "%s", index_path);
+    size_t len = strlen(stem);
+    if (len > 4 && strcmp(stem + len - 4, ".bin") == 0) stem[len - 4] = '\0';
+    snprintf(base_path_, sizeof(base_path_), "%s", index_path);
+    snprintf(seg_path_, sizeof(seg_path_), "%s.seg", stem);
+    snprintf(old_path_, sizeof(old_path_), "%s.old", stem);
+    snprintf(new_path_, sizeof(new_path_), "%s.new", stem);
+    snprintf(tmp_path_, sizeof(tmp_path_), "%s.seg.tmp", stem);
+
+    if (!mutex_) mutex_ = xSemaphoreCreateMutex();
+    recover();
+    if (!loadBase(base_path_)) {
+        return false;
+    }
+
+    // Sealed segment first (an interrupted compaction), then the active one
+    uint32_t valid = 0;
+    if (fs_.exists(old_path_)) {
+        int n = replay(old_path_, &valid);
+        sealed_ = true;
+        sealed_end_ = total_;
+        pending_ = n > 0 ? n : 0;
+    }
+
+    int n = fs_.exists(seg_path_) ? replay(seg_path_, &valid) : -1;
+    if (n < 0) {
+        // Missing, or written for another base format: start a fresh one
+        if (fs_.exists(seg_path_)) {
+            Serial.printf("WARNING: %s does not fit the index, enrollments dropped\n", seg_path_);
+        }
+        n = 0;
+        if (!createSegment()) {
+            Serial.printf("WARNING: Cannot create %s, enrollment is off\n", seg_path_);
+        }
+    } else {
+        File f = fs_.open(seg_path_, FILE_READ);
+        uint32_t size = f ? f.size() : 0;
+        if (f) f.close();
+        if (valid < size) {
+            Serial.printf("[match] %s: dropping a torn record (%u bytes)\n", seg_path_,
+                          (unsigned)(size - valid));
+            rewriteSegment(valid);
+        }
+    }
+    seg_records_ = n;
+    pending_ += n;
+
+    last_query_ = (uint8_t*)malloc(row_bytes_);
+    Serial.printf("Match index: %d entries × %d dims (%s), %d pending records\n", live_, dim_,
+                  quantized_ ? "int8" : "float", pending_);
+    return true;
+}
+
+// Finish or undo a compaction that lost power (see similarity_match.h)
+void SimilarityMatcher::recover() {
+    if (fs_.exists(new_path_)) {
+        MatchIndexHeader header;
+        File f = fs_.open(new_path_, FILE_READ);
+        bool complete = false;
+        if (f && f.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == MATCH_INDEX_MAGIC) {
+            size_t row = header.dim * (header.version == MATCH_INDEX_VERSION_Q8 ? 1 : sizeof(float));
+            complete = f.size() == sizeof(header) + (size_t)header.count * (row + header.text_len);
+        }
+        if (f) f.close();
+
+        if (complete) {
+            if (fs_.exists(old_path_)) fs_.remove(old_path_);
+            if (fs_.exists(base_path_)) fs_.remove(base_path_);
+            fs_.rename(new_path_, base_path_);
+            Serial.println("[match] Finished an interrupted compaction");
+        } else {
+            fs_.remove(new_path_);
+        }
+    }
+
+    if (fs_.exists(tmp_path_)) {
+        if (fs_.exists(seg_path_)) {
+            fs_.remove(tmp_path_);
+        } else {
+            fs_.rename(tmp_path_, seg_path_);
+        }
+    }
+}
+
+bool SimilarityMatcher::loadBase(const char* path) {
+    File file = fs_.open(path, FILE_READ);
+    if (!file) {
+        Serial.printf("ERROR: Cannot open %s\n", path);
+        return false;
+    }
+
+    MatchIndexHeader header;
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != MATCH_INDEX_MAGIC ||
+        (header.version != MATCH_INDEX_VERSION && header.version != MATCH_INDEX_VERSION_Q8)) {
+        Serial.printf("ERROR: %s is not a match index\n", path);
+        file.close();
+        return false;
+    }
+
+    dim_ = header.dim;
+    text_len_ = header.text_len;
+    quantized_ = header.version == MATCH_INDEX_VERSION_Q8;
+    row_bytes_ = dim_ * (quantized_ ? sizeof(int8_t) : sizeof(float));
+
+    if (!reserve(header.count + MATCH_GROW_ROWS)) {
+        Serial.println("ERROR: Failed to allocate match index");
+        file.close();
+        end();
+        return false;
+    }
+
+    for (int i = 0; i < (int)header.count; i++) {
+        uint8_t* row = rows_ + (size_t)i * row_bytes_;
+        char* text = texts_ + (size_t)i * text_len_;
+
+        if (file.read(row, row_bytes_) != row_bytes_ ||
+            file.read((uint8_t*)text, text_len_) != (size_t)text_len_) {
+            Serial.printf("ERROR: Match index truncated at entry %d\n", i);
+            file.close();
+            end();
+            return false;
+        }
+        text[text_len_ - 1] = '\0';
+
+        // Normalize once so match() is a single dot product per entry
+        // (int8 rows come out of the projection normalized)
+        if (!quantized_) normalize((float*)row, dim_);
+        dead_[i] = 0;
+    }
+    total_ = live_ = header.count;
+
+    file.close();
+    return true;
+}
+
+// Grow the arrays to hold rows entries (caller holds mutex_ after begin)
+bool SimilarityMatcher::reserve(int rows) {
+    if (rows <= capacity_) {
+        return true;
+    }
+    uint8_t* r = (uint8_t*)ps_realloc(rows_, (size_t)rows * row_bytes_);
+    if (r) rows_ = r;
+    char* t = (char*)ps_realloc(texts_, (size_t)rows * text_len_);
+    if (t) texts_ = t;
+    uint8_t* d = (uint8_t*)ps_realloc(dead_, rows);
+    if (d) dead_ = d;
+    if (!r || !t || !d) {
+        return false;
+    }
+    capacity_ = rows;
+    return true;
+}
+
+// ============================================================================
+// Search
+// ============================================================================
+
+template <typename Score>
+bool SimilarityMatcher::best(Score score, MatchResult* result) {
+    int best = -1;
+    float best_score = -2.0f;
+    for (int i = 0; i < total_; i++) {
+        if (dead_[i]) continue;
+        float s = score(rows_ + (size_t)i * row_bytes_);
+        if (s > best_score) {
+            best_score = s;
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+
+    result->score = best_score;
+    result->index = best;
+    strncpy(result->text, texts_ + (size_t)best * text_len_, MATCH_TEXT_LEN - 1);
+    result->text[MATCH_TEXT_LEN - 1] = '\0';
+    return true;
+}
+
+bool SimilarityMatcher::match(const float* query, MatchResult* result) {
+    if (!rows_ || quantized_) {
+        return false;
+    }
+
+    float qnorm = 0.0f;
+    for (int j = 0; j < dim_; j++) qnorm += query[j] * query[j];
+    qnorm = sqrtf(qnorm);
+    if (qnorm == 0.0f) {
+        return false;
+    }
+
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    if (last_query_) {
+        memcpy(last_query_, query, row_bytes_);
+        have_query_ = true;
+    }
+    bool ok = best([&](const uint8_t* row) {
+        float dot = 0.0f;
+        dsps_dotprod_f32_aes3((float*)query, (float*)row, &dot, dim_);
+        return dot / qnorm;
+    }, result);
+    xSemaphoreGive(mutex_);
+    return ok;
+}
+
+bool SimilarityMatcher::match(const int8_t* query, MatchResult* result) {
+    if (!rows_ || !quantized_) {
+        return false;
+    }
+
+    int32_t qnorm = 0;
+    for (int j = 0; j < dim_; j++) qnorm += (int32_t)query[j] * query[j];
+    if (qnorm == 0) {
+        return false;   // Silence through the projection
+    }
+
+    // Both sides are unit vectors x MATCH_Q8_ONE, so the int32 dot product
+    // is the cosine x MATCH_Q8_ONE^2
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    if (last_query_) {
+        memcpy(last_query_, query, row_bytes_);
+        have_query_ = true;
+    }
+    bool ok = best([&](const uint8_t* row) {
+        const int8_t* r = (const int8_t*)row;
+        int32_t dot = 0;
+        for (int j = 0; j < dim_; j++) {
+            dot += (int32_t)query[j] * r[j];
+        }
+        return (float)dot / (MATCH_Q8_ONE * MATCH_Q8_ONE);
+    }, result);
+    xSemaphoreGive(mutex_);
+    return ok;
+}
+
+// ============================================================================
+// Segments
+// ============================================================================
+
+// Records in path, applied in order; -1 if it is not a segment of this index
+int SimilarityMatcher::replay(const char* path, uint32_t* valid_bytes) {
+    File f = fs_.open(path, FILE_READ);
+    MatchSegmentHeader h;
+    uint32_t want_version = quantized_ ? MATCH_INDEX_VERSION_Q8 : MATCH_INDEX_VERSION;
+    if (!f || f.read((uint8_t*)&h, sizeof(h)) != sizeof(h) || h.magic != MATCH_SEGMENT_MAGIC ||
+        h.version != MATCH_SEGMENT_VERSION || h.index_version != want_version ||
+        (int)h.dim != dim_ || (int)h.text_len != text_len_) {
+        if (f) f.close();
+        return -1;
+    }
+
+    uint8_t* payload = (uint8_t*)malloc(row_bytes_ + text_len_);
+    *valid_bytes = sizeof(h);
+    int records = 0;
+    while (payload) {
+        uint32_t op, crc;
+        if (f.read((uint8_t*)&op, sizeof(op)) != sizeof(op)) break;
+        size_t len = op == MATCH_SEG_ADD ? row_bytes_ + text_len_ : op == MATCH_SEG_DEL ? text_len_ : 0;
+        if (len == 0 || f.read(payload, len) != len ||
+            f.read((uint8_t*)&crc, sizeof(crc)) != sizeof(crc) ||
+            crc32_update(crc32_update(0, &op, sizeof(op)), payload, len) != crc ||
+            apply(op, payload) < 0) {
+            break;
+        }
+        records++;
+        *valid_bytes += sizeof(op) + len + sizeof(crc);
+    }
+    free(payload);
+    f.close();
+    return records;
+}
+
+// One record into the arrays; rows changed, or -1 without memory
+int SimilarityMatcher::apply(uint32_t op, const uint8_t* payload) {
+    if (op == MATCH_SEG_ADD) {
+        if (total_ == capacity_ && !reserve(capacity_ + MATCH_GROW_ROWS)) {
+            return -1;
+        }
+        uint8_t* row = rows_ + (size_t)total_ * row_bytes_;
+        char* text = texts_ + (size_t)total_ * text_len_;
+        memcpy(row, payload, row_bytes_);
+        memcpy(text, payload + row_bytes_, text_len_);
+        text[text_len_ - 1] = '\0';
+        if (!quantized_) normalize((float*)row, dim_);
+        dead_[total_++] = 0;
+        live_++;
+        return 1;
+    }
+
+    // Tombstone: everything earlier with this text
+    const char* text = (const char*)payload;
+    int n = 0;
+    for (int i = 0; i < total_; i++) {
+        if (!dead_[i] && strncmp(texts_ + (size_t)i * text_len_, text, text_len_) == 0) {
+            dead_[i] = 1;
+            n++;
+        }
+    }
+    live_ -= n;
+    return n;
+}
+
+// Append one record to .seg (caller holds mutex_). Each append is its own
+// open/close, so a record is on the card when add() returns.
+bool SimilarityMatcher::append(uint32_t op, const uint8_t* payload, size_t len) {
+    uint32_t crc = crc32_update(crc32_update(0, &op, sizeof(op)), payload, len);
+    if (!lockBus()) {
+        return false;
+    }
+    File f = fs_.open(seg_path_, FILE_APPEND);
+    bool ok = f && f.write((uint8_t*)&op, sizeof(op)) == sizeof(op) &&
+              f.write(payload, len) == len &&
+              f.write((uint8_t*)&crc, sizeof(crc)) == sizeof(crc);
+    if (f) f.close();
+    unlockBus();
+    return ok;
+}
+
+// Empty .seg with its header (caller holds the bus)
+bool SimilarityMatcher::createSegment() {
+    MatchSegmentHeader h = {MATCH_SEGMENT_MAGIC, MATCH_SEGMENT_VERSION,
+                            (uint32_t)(quantized_ ? MATCH_INDEX_VERSION_Q8 : MATCH_INDEX_VERSION),
+                            (uint32_t)dim_, (uint32_t)text_len_};
+    File f = fs_.open(seg_path_, FILE_WRITE);
+    bool ok = f && f.write((uint8_t*)&h, sizeof(h)) == sizeof(h);
+    if (f) f.close();
+    return ok;
+}
+
+// Copy the valid prefix of .seg through .seg.tmp, so appends do not land
+// behind a torn record (there is no truncate). Caller holds the bus.
+bool SimilarityMatcher::rewriteSegment(uint32_t valid_bytes) {
+    File in = fs_.open(seg_path_, FILE_READ);
+    File out = fs_.open(tmp_path_, FILE_WRITE);
+    uint8_t buf[512];
+    bool ok = in && out;
+    for (uint32_t done = 0; ok && done < valid_bytes;) {
+        size_t n = valid_bytes - done < sizeof(buf) ? valid_bytes - done : sizeof(buf);
+        ok = in.read(buf, n) == n && out.write(buf, n) == n;
+        done += n;
+    }
+    if (in) in.close();
+    if (out) out.close();
+    ok = ok && fs_.remove(seg_path_) && fs_.rename(tmp_path_, seg_path_);
+    if (!ok) {
+        Serial.printf("WARNING: Cannot rewrite %s\n", seg_path_);
+    }
+    return ok;
+}
+
+bool SimilarityMatcher::add(const void* row, const char* text) {
+    if (!rows_ || !text || !text[0]) {
+        return false;
+    }
+    uint8_t* payload = (uint8_t*)calloc(1, row_bytes_ + text_len_);
+    if (!payload) {
+        return false;
+    }
+    memcpy(payload, row, row_bytes_);
+    strncpy((char*)payload + row_bytes_, text, text_len_ - 1);
+
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    bool ok = append(MATCH_SEG_ADD, payload, row_bytes_ + text_len_) &&
+              apply(MATCH_SEG_ADD, payload) > 0;
+    if (ok) {
+        seg_records_++;
+        pending_++;
+    }
+    xSemaphoreGive(mutex_);
+    free(payload);
+    return ok;
+}
+
+bool SimilarityMatcher::enroll(const char* text) {
+    if (!rows_ || !have_query_) {
+        return false;
+    }
+    uint8_t* row = (uint8_t*)malloc(row_bytes_);
+    if (!row) {
+        return false;
+    }
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    memcpy(row, last_query_, row_bytes_);
+    xSemaphoreGive(mutex_);
+    bool ok = add(row, text);
+    free(row);
+    return ok;
+}
+
+int SimilarityMatcher::remove(const char* text) {
+    if (!rows_ || !text || !text[0]) {
+        return 0;
+    }
+    char key[MATCH_TEXT_LEN] = {0};
+    strncpy(key, text, text_len_ - 1);
+
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    int n = 0;
+    for (int i = 0; i < total_; i++) {
+        if (!dead_[i] && strncmp(texts_ + (size_t)i * text_len_, key, text_len_) == 0) n++;
+    }
+    // Only tombstones that hide something are worth a record
+    if (n > 0) {
+        if (append(MATCH_SEG_DEL, (uint8_t*)key, text_len_)) {
+            apply(MATCH_SEG_DEL, (uint8_t*)key);
+            seg_records_++;
+            pending_++;
+        } else {
+            n = -1;
+        }
+    }
+    xSemaphoreGive(mutex_);
+    return n;
+}
+
+// ============================================================================
+// Compaction
+// ============================================================================
+
+bool SimilarityMatcher::compact() {
+    if (!rows_) {
+        return false;
+    }
+    PowerDemand demand(power_, POWER_LOAD);
+    uint32_t t_start = millis();
+
+    // 1. Seal: later adds and removes go to a fresh .seg
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    if (!sealed_) {
+        if (seg_records_ == 0) {
+            xSemaphoreGive(mutex_);
+            return true;
+        }
+        bool ok = lockBus();
+        ok = ok && fs_.rename(seg_path_, old_path_);
+        if (ok) {
+            sealed_ = true;
+            sealed_end_ = total_;
+            seg_records_ = 0;
+            ok = createSegment();
+        }
+        unlockBus();
+        if (!ok) {
+            xSemaphoreGive(mutex_);
+            Serial.println("[match] Compaction could not seal the segment");
+            return false;
+        }
+    }
+
+    // Rows below end no longer change, only their dead flags
+    int end = sealed_end_;
+    uint8_t* dead = (uint8_t*)malloc(end > 0 ? end : 1);
+    if (dead) memcpy(dead, dead_, end);
+    int merged = pending_ - seg_records_;
+    xSemaphoreGive(mutex_);
+    if (!dead) {
+        return false;
+    }
+
+    int live = 0;
+    for (int i = 0; i < end; i++) live += !dead[i];
+
+    // 2. Write the new base, 3. commit
+    bool ok = writeBase(new_path_, end, dead, live);
+    free(dead);
+    if (ok && lockBus()) {
+        ok = fs_.remove(old_path_) && (!fs_.exists(base_path_) || fs_.remove(base_path_)) &&
+             fs_.rename(new_path_, base_path_);
+        unlockBus();
+    }
+    if (!ok) {
+        Serial.println("[match] Compaction failed, retrying later");
+        return false;
+    }
+
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    dropMerged(end);
+    xSemaphoreGive(mutex_);
+
+    uint32_t elapsed = millis() - t_start;
+    MetricsRegistry::record(m_compact_ms_, elapsed);
+    Serial.printf("[match] Compacted %d records into %d entries in %u ms\n", merged, live,
+                  (unsigned)elapsed);
+    return true;
+}
+
+// Base + .old rows [0, end) -> path. The bus is taken per entry so the LCD
+// keeps drawing, and mutex_ with it, since an add() may move the arrays.
+bool SimilarityMatcher::writeBase(const char* path, int end, const uint8_t* dead, int live) {
+    MatchIndexHeader header = {MATCH_INDEX_MAGIC,
+                               (uint32_t)(quantized_ ? MATCH_INDEX_VERSION_Q8 : MATCH_INDEX_VERSION),
+                               (uint32_t)live, (uint32_t)dim_, (uint32_t)text_len_};
+    if (!lockBus()) {
+        return false;
+    }
+    File f = fs_.open(path, FILE_WRITE);
+    bool ok = f && f.write((uint8_t*)&header, sizeof(header)) == sizeof(header);
+    unlockBus();
+
+    for (int i = 0; ok && i < end; i++) {
+        if (dead[i]) continue;
+        xSemaphoreTake(mutex_, portMAX_DELAY);
+        ok = lockBus();
+        ok = ok && f.write(rows_ + (size_t)i * row_bytes_, row_bytes_) == row_bytes_ &&
+             f.write((uint8_t*)texts_ + (size_t)i * text_len_, text_len_) == (size_t)text_len_;
+        unlockBus();
+        xSemaphoreGive(mutex_);
+    }
+
+    if (lockBus()) {
+        if (f) f.close();
+        if (!ok) fs_.remove(path);
+        unlockBus();
+    }
+    return ok;
+}
+
+// The arrays now mirror the new base + .seg: drop rows below end that are
+// dead (caller holds mutex_)
+void SimilarityMatcher::dropMerged(int end) {
+    int out = 0;
+    for (int i = 0; i < total_; i++) {
+        if (i < end && dead_[i]) continue;
+        if (out != i) {
+            memcpy(rows_ + (size_t)out * row_bytes_, rows_ + (size_t)i * row_bytes_, row_bytes_);
+            memcpy(texts_ + (size_t)out * text_len_, texts_ + (size_t)i * text_len_, text_len_);
+            dead_[out] = dead_[i];
+        }
+        out++;
+    }
+    total_ = out;
+    sealed_ = false;
+    sealed_end_ = 0;
+    pending_ = seg_records_;
+}
+
+void SimilarityMatcher::addMetrics(MetricsRegistry* metrics) {
+    m_entries_ = metrics->gauge("match.entries");
+    m_pending_ = metrics->gauge("match.pending");
+    m_compact_ms_ = metrics->histogram("match.compact_ms", "ms");
+    metrics->addSampler(sampleMetrics, this);
+}
+
+bool SimilarityMatcher::startCompactor(PowerGovernor* power) {
+    power_ = power;
+    wake_ = xSemaphoreCreateBinary();
+    if (xTaskCreatePinnedToCore(compactTask, "match_compact", 4096, this, MATCH_COMPACT_PRIORITY,
+                                &task_, MATCH_COMPACT_CORE) != pdPASS) {
+        Serial.println("ERROR: match compaction task failed");
+        task_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void SimilarityMatcher::requestCompaction() {
+    force_ = true;
+    if (wake_) xSemaphoreGive(wake_);
+}
+
+void SimilarityMatcher::compactTask(void* arg) {
+    SimilarityMatcher* self = (SimilarityMatcher*)arg;
+    for (;;) {
+        xSemaphoreTake(self->wake_, pdMS_TO_TICKS(MATCH_COMPACT_CHECK_MS));
+        // Idle = nothing above listening: no inference, no model load
+        bool idle = !self->power_ || self->power_->state() <= POWER_LISTEN;
+        bool due = self->pending_ >= MATCH_COMPACT_RECORDS || self->sealed_;
+        if (self->force_ || (due && idle)) {
+            self->force_ = false;
+            self->compact();
+        }
+    }
+}
+
+void SimilarityMatcher::sampleMetrics(MetricsRegistry* metrics, void* arg) {
+    SimilarityMatcher* self = (SimilarityMatcher*)arg;
+    MetricsRegistry::set(self->m_entries_, self->live_);
+    MetricsRegistry::set(self->m_pending_, self->pending_);
+}
+
+void SimilarityMatcher::end() {
+    if (rows_) free(rows_);
+    if (texts_) free(texts_);
+    if (dead_) free(dead_);
+    if (last_query_) free(last_query_);
+    rows_ = nullptr;
+    texts_ = nullptr;
+    dead_ = nullptr;
+    last_query_ = nullptr;
+    have_query_ = false;
+    total_ = capacity_ = live_ = 0;
+}
@@ -0,0 +1,174 @@
+// similarity_match.h - Cosine similarity search over [embedding, string] pairs
+// Index file is produced by tools/build_match_index.py. Version 1 rows are
+// raw float embeddings; version 2 rows are projected int8 unit vectors
+// (projection_head.h), 16x smaller and searched with int32 dot products.
+//
+// Incremental enrollment: add() and remove() append a record to a delta
+// segment next to the base (/match_index.seg for /match_index.bin) and take
+// effect in memory at once. A remove is a tombstone for a text: it hides
+// every earlier entry with that text, in the base or in a segment. At boot
+// the base is loaded and the segments replayed in order.
+//
+// Segment: MatchSegmentHeader, then records of
+//   u32 op, ADD: row + char[text_len] / DEL: char[text_len], u32 crc32
+// A torn last record (power lost mid-append) fails its CRC and is dropped.
+//
+// Compaction (background task, when the power governor shows no inference
+// or load) merges the base and the segment into a new base:
+//   1. seal:   .seg -> .old, new appends go to a fresh .seg
+//   2. write:  live entries of base + .old -> .new
+//   3. commit: remove .old, remove the base, rename .new -> base
+// begin() finishes an interrupted commit: a complete .new already holds
+// .old, so it replaces the base and .old is dropped; a short .new is deleted
+// and .old is replayed like any segment.
+
+#ifndef SIMILARITY_MATCH_H
+#define SIMILARITY_MATCH_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "metrics.h"
+#include "power_governor.h"
+
+#define MATCH_INDEX_MAGIC   0x49424D45   // "EMBI" little-endian
+#define MATCH_INDEX_VERSION 1           // float rows
+#define MATCH_INDEX_VERSION_Q8 2        // int8 rows, unit length x MATCH_Q8_ONE
+#define MATCH_Q8_ONE        127
+#define MATCH_TEXT_LEN      128
+
+#define MATCH_SEGMENT_MAGIC     0x53424D45  // "EMBS"
+#define MATCH_SEGMENT_VERSION   1
+#define MATCH_SEG_ADD           1
+#define MATCH_SEG_DEL           2
+#define MATCH_PATH_MAX          64
+#define MATCH_GROW_ROWS         32      // Rows added when an enrollment finds the arrays full
+#define MATCH_COMPACT_RECORDS   32      // Segment records that make compaction worth it
+#define MATCH_COMPACT_CHECK_MS  10000
+#define MATCH_COMPACT_PRIORITY  1       // Below every stage
+#define MATCH_COMPACT_CORE      1
+
+// On-disk header, followed by count × (float[dim] or int8[dim], char[text_len])
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t dim;
+    uint32_t text_len;
+} MatchIndexHeader;
+
+// Segment header; rows are in the base's format
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t index_version;
+    uint32_t dim;
+    uint32_t text_len;
+} MatchSegmentHeader;
+
+typedef struct {
+    float score;
+    int index;
+    char text[MATCH_TEXT_LEN];
+} MatchResult;
+
+typedef bool (*MatchLockFn)();
+typedef void (*MatchUnlockFn)();
+
+class SimilarityMatcher {
+public:
+    // lock/unlock guard the SD bus around segment appends and compaction
+    SimilarityMatcher(fs::FS& fs = SD, MatchLockFn lock = nullptr, MatchUnlockFn unlock = nullptr);
+    ~SimilarityMatcher();
+
+    // Load the index from SD into PSRAM and replay its segments (caller
+    // holds the bus). Float rows are L2-normalized on load.
+    bool begin(const char* index_path);
+
+    // Best cosine match for a query embedding of length dim() (version 1)
+    bool match(const float* query, MatchResult* result);
+
+    // Same for a projected int8 unit vector (version 2)
+    bool match(const int8_t* query, MatchResult* result);
+
+    // Enroll the last match() query under text, or a row in the index's
+    // format. Searchable on return; false if the append or PSRAM failed.
+    bool enroll(const char* text);
+    bool add(const void* row, const char* text);
+
+    // Tombstone every entry with this text; returns how many were live
+    int remove(const char* text);
+
+    // match.entries (live), match.pending (segment records), match.compact_ms
+    void addMetrics(MetricsRegistry* metrics);
+
+    // Background compaction, after begin(). The task only merges while power
+    // is at or below POWER_LISTEN (power nullptr = whenever records are due).
+    bool startCompactor(PowerGovernor* power);
+    void requestCompaction();       // Merge at the next wake, idle or not
+    bool compact();
+
+    int count() const { return live_; }
+    int pending() const { return pending_; }    // Segment records not yet merged
+    int dim() const { return dim_; }
+    bool quantized() const { return quantized_; }
+
+    void end();
+
+private:
+    bool loadBase(const char* path);
+    bool reserve(int rows);
+    int replay(const char* path, uint32_t* valid_bytes);
+    int apply(uint32_t op, const uint8_t* payload);
+    bool append(uint32_t op, const uint8_t* payload, size_t len);
+    bool createSegment();
+    bool rewriteSegment(uint32_t valid_bytes);
+    bool writeBase(const char* path, int end, const uint8_t* dead, int live);
+    void dropMerged(int end);
+    void recover();
+    template <typename Score>
+    bool best(Score score, MatchResult* result);
+    static void compactTask(void* arg);
+    static void sampleMetrics(MetricsRegistry* metrics, void* arg);
+
+    bool lockBus() { return !lock_ || lock_(); }
+    void unlockBus() { if (unlock_) unlock_(); }
+
+    fs::FS& fs_;
+    MatchLockFn lock_;
+    MatchUnlockFn unlock_;
+    SemaphoreHandle_t mutex_;       // Arrays and counters below
+    char base_path_[MATCH_PATH_MAX];
+    char seg_path_[MATCH_PATH_MAX];     // Active segment
+    char old_path_[MATCH_PATH_MAX];     // Sealed segment being merged
+    char new_path_[MATCH_PATH_MAX];     // Compacted base being written
+    char tmp_path_[MATCH_PATH_MAX];     // .seg rewritten without a torn tail
+
+    int dim_;
+    int text_len_;
+    bool quantized_;
+    size_t row_bytes_;
+    int total_;             // Rows in use, live or dead
+    int capacity_;
+    int live_;
+    bool sealed_;           // .old exists
+    int sealed_end_;        // Rows [0, sealed_end_) are base + .old
+    int pending_;           // Records in .old + .seg
+    int seg_records_;       // Records in .seg
+    uint8_t* rows_;         // capacity × row_bytes, unit length (PSRAM)
+    char* texts_;           // capacity × text_len (PSRAM)
+    uint8_t* dead_;         // capacity
+    uint8_t* last_query_;   // row_bytes, for enroll()
+    bool have_query_;
+
+    PowerGovernor* power_;
+    TaskHandle_t task_;
+    SemaphoreHandle_t wake_;
+    volatile bool force_;
+    Metric* m_entries_;
+    Metric* m_pending_;
+    Metric* m_compact_ms_;
+};
+
+#endif // SIMILARITY_MATCH_H
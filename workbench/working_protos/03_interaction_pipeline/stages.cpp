@@ -0,0 +1,531 @@
+// stages.cpp - Stage bodies for the interaction pipeline
+
+#include "stages.h"
+#include <math.h>
+
+static SemaphoreHandle_t spi_bus_mux = NULL;
+
+// ============================================================================
+// Shared SPI Bus (SD card + LCD)
+// ============================================================================
+
+void spi_bus_init() {
+    if (!spi_bus_mux) {
+        spi_bus_mux = xSemaphoreCreateRecursiveMutex();
+    }
+}
+
+bool spi_bus_lock(TickType_t timeout) {
+    return xSemaphoreTakeRecursive(spi_bus_mux, timeout) == pdTRUE;
+}
+
+void spi_bus_unlock() {
+    xSemaphoreGiveRecursive(spi_bus_mux);
+}
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static inline AppContext* app_of(PipelineStage* s) {
+    return (AppContext*)s->ctx;
+}
+
+// Metrics (nullptr until register_stage_metrics(); updates are then no-ops)
+static Metric* m_audio_overruns = nullptr;
+static Metric* m_audio_short_reads = nullptr;
+static Metric* m_llm_tokens = nullptr;
+static Metric* m_llm_tok_s = nullptr;
+static Metric* m_llm_token_us = nullptr;
+static Metric* m_render_us = nullptr;
+static Metric* m_stage_stack[STAGE_COUNT];
+static char stage_stack_names[STAGE_COUNT][24];
+
+// Stage init: block until a deferred load finishes (nullptr = already loaded)
+static bool await_load(PipelineStage* s, BootFuture* load) {
+    if (!load || load->isReady()) {
+        return !load || load->ok();
+    }
+    Serial.printf("[%s] waiting for %s\n", s->cfg.name, load->name());
+    return load->wait();
+}
+
+// Send a NUL-terminated text piece to outputs [first_out, last_out]
+static void send_text(PipelineStage* s, const PipelineMsg* src, const char* text,
+                      uint32_t flags, int first_out, int last_out) {
+    size_t len = strlen(text) + 1;
+    for (int o = first_out; o <= last_out; o++) {
+        PipelineMsg out = *src;
+        out.flags = flags;
+        out.size = len;
+        out.payload = s->pipeline->alloc(s, len);
+        if (!out.payload) continue;
+        memcpy(out.payload, text, len);
+        s->pipeline->emit(s, o, &out, portMAX_DELAY);
+    }
+}
+
+// ============================================================================
+// Capture (source): one microphone DMA read per chunk
+// ============================================================================
+
+static void capture_run(PipelineStage* s, PipelineMsg* in) {
+    HalAudioIn* mic = app_of(s)->hal->audio_in;
+    size_t bytes = CAPTURE_CHUNK_SAMPLES * sizeof(int16_t);
+
+    int16_t* chunk = (int16_t*)s->pipeline->alloc(s, bytes);
+    if (!chunk) {
+        // Budget exhausted: VAD is behind. Drain one read so DMA doesn't stall.
+        static int16_t scratch[CAPTURE_CHUNK_SAMPLES];
+        mic->read(scratch, CAPTURE_CHUNK_SAMPLES);
+        MetricsRegistry::add(m_audio_overruns);
+        return;
+    }
+
+    if (mic->read(chunk, CAPTURE_CHUNK_SAMPLES) != CAPTURE_CHUNK_SAMPLES) {
+        s->pipeline->release(chunk);
+        MetricsRegistry::add(m_audio_short_reads);
+        vTaskDelay(pdMS_TO_TICKS(10));
+        return;
+    }
+
+    PipelineMsg msg = {};
+    msg.payload = chunk;
+    msg.size = bytes;
+    if (!s->pipeline->emit(s, 0, &msg, 0)) {   // Never block the microphone
+        MetricsRegistry::add(m_audio_overruns);
+    }
+}
+
+// ============================================================================
+// VAD: segment chunks into utterances (with one chunk of pre-roll)
+// ============================================================================
+
+typedef struct {
+    int16_t preroll[CAPTURE_CHUNK_SAMPLES];
+    bool have_preroll;
+    int16_t* utterance;
+    int samples;
+} VadState;
+
+static VadState vad_state;
+
+static bool vad_init(PipelineStage* s) {
+    app_of(s)->vad->begin();
+    memset(&vad_state, 0, sizeof(vad_state));
+    return true;
+}
+
+static void vad_append(const int16_t* samples, int n) {
+    int room = MAX_UTTERANCE_SAMPLES - vad_state.samples;
+    if (n > room) n = room;
+    memcpy(vad_state.utterance + vad_state.samples, samples, n * sizeof(int16_t));
+    vad_state.samples += n;
+}
+
+static void vad_close(PipelineStage* s, bool keep) {
+    if (!vad_state.utterance) return;
+
+    if (keep) {
+        PipelineMsg msg = {};
+        msg.interaction_id = s->pipeline->nextInteractionId();
+        msg.t_origin_us = micros();
+        msg.payload = vad_state.utterance;
+        msg.size = vad_state.samples * sizeof(int16_t);
+        Serial.printf("[vad] #%u utterance %d ms\n", msg.interaction_id,
+                      vad_state.samples * 1000 / SAMPLE_RATE);
+        if (app_of(s)->power) {
+            app_of(s)->power->beginInteraction(msg.interaction_id);
+        }
+        s->pipeline->emit(s, 0, &msg, 0);
+    } else {
+        s->pipeline->release(vad_state.utterance);
+    }
+    vad_state.utterance = nullptr;
+    vad_state.samples = 0;
+}
+
+static void vad_run(PipelineStage* s, PipelineMsg* in) {
+    AppContext* app = app_of(s);
+    const int16_t* chunk = (const int16_t*)in->payload;
+    int n = in->size / sizeof(int16_t);
+
+    for (int f = 0; f + VAD_FRAME_SAMPLES <= n; f += VAD_FRAME_SAMPLES) {
+        VadEvent ev = app->vad->processFrame(chunk + f);
+
+        if (ev == VAD_SPEECH_START && !vad_state.utterance) {
+            vad_state.utterance = (int16_t*)s->pipeline->alloc(s, MAX_UTTERANCE_SAMPLES * sizeof(int16_t));
+            vad_state.samples = 0;
+            if (vad_state.utterance) {
+                if (vad_state.have_preroll) vad_append(vad_state.preroll, CAPTURE_CHUNK_SAMPLES);
+                vad_append(chunk, f);   // Speech frames already seen in this chunk
+            } else {
+                // Counted in the stage's budget_denials; the speech is lost
+                Serial.printf("[vad] Utterance dropped: budget full (%u KB in use)\n",
+                              (unsigned)(s->mem_used / 1024));
+            }
+        }
+
+        if (vad_state.utterance && app->vad->inSpeech()) {
+            vad_append(chunk + f, VAD_FRAME_SAMPLES);
+            if (vad_state.samples >= MAX_UTTERANCE_SAMPLES) {
+                app->vad->reset();
+                vad_close(s, true);
+            }
+        } else if (ev == VAD_SPEECH_END) {
+            vad_close(s, true);
+        } else if (ev == VAD_SPEECH_DISCARD) {
+            vad_close(s, false);
+        }
+    }
+
+    memcpy(vad_state.preroll, chunk, CAPTURE_CHUNK_SAMPLES * sizeof(int16_t));
+    vad_state.have_preroll = true;
+    s->pipeline->release(in->payload);
+}
+
+// ============================================================================
+// Mel spectrogram
+// ============================================================================
+
+static void mel_run(PipelineStage* s, PipelineMsg* in) {
+    AppContext* app = app_of(s);
+    PowerDemand demand(app->power, POWER_INFERENCE);
+    size_t bytes = MEL_BINS * MEL_FRAMES * sizeof(float);
+
+    PipelineMsg out = *in;
+    out.payload = s->pipeline->alloc(s, bytes);
+    out.size = bytes;
+
+    bool ok = out.payload && app->mel->compute((int16_t*)in->payload,
+                                               in->size / sizeof(int16_t),
+                                               (float*)out.payload);
+    // The match stage decides later whether this utterance is worth keeping
+    if (app->stash && ok) {
+        app->stash->hold(in->interaction_id, (int16_t*)in->payload, in->size / sizeof(int16_t));
+    }
+    s->pipeline->release(in->payload);
+
+    if (!ok) {
+        Serial.printf("[mel] #%u failed\n", in->interaction_id);
+        s->pipeline->release(out.payload);
+        return;
+    }
+    s->pipeline->emit(s, 0, &out, portMAX_DELAY);
+}
+
+// ============================================================================
+// YAMNet embedding
+// ============================================================================
+
+static bool yamnet_init(PipelineStage* s) {
+    return await_load(s, app_of(s)->yamnet_ready);
+}
+
+static void yamnet_run(PipelineStage* s, PipelineMsg* in) {
+    AppContext* app = app_of(s);
+    PowerDemand demand(app->power, POWER_INFERENCE);
+    size_t bytes = app->projection ? app->projection->outDim() : EMBEDDING_DIM * sizeof(float);
+
+    PipelineMsg out = *in;
+    out.payload = s->pipeline->alloc(s, bytes);
+    out.size = bytes;
+
+    bool ok = out.payload &&
+              (app->projection
+                   ? app->yamnet->infer((float*)in->payload, app->projection, (int8_t*)out.payload)
+                   : app->yamnet->infer((float*)in->payload, (float*)out.payload));
+    s->pipeline->release(in->payload);
+
+    if (!ok) {
+        Serial.printf("[yamnet] #%u inference failed\n", in->interaction_id);
+        s->pipeline->release(out.payload);
+        return;
+    }
+    s->pipeline->emit(s, 0, &out, portMAX_DELAY);
+}
+
+// ============================================================================
+// Similarity match: outputs [0] llm, [1] render, [2] speaker
+// ============================================================================
+
+static bool match_init(PipelineStage* s) {
+    AppContext* app = app_of(s);
+    if (!await_load(s, app->match_ready)) {
+        return false;
+    }
+    // The projection head's output dim is known once YAMNet has loaded
+    bool q8 = app->projection != nullptr;
+    if (q8 && !await_load(s, app->yamnet_ready)) {
+        return false;
+    }
+    int dim = q8 ? app->projection->outDim() : EMBEDDING_DIM;
+    if (app->matcher->dim() != dim || app->matcher->quantized() != q8) {
+        Serial.printf("ERROR: Match index is %s %d-D, embeddings are %s %d-D\n",
+                      app->matcher->quantized() ? "int8" : "float", app->matcher->dim(),
+                      q8 ? "int8" : "float", dim);
+        return false;
+    }
+    return true;
+}
+
+static void match_run(PipelineStage* s, PipelineMsg* in) {
+    AppContext* app = app_of(s);
+
+    PipelineMsg out = *in;
+    out.payload = s->pipeline->alloc(s, sizeof(MatchResult));
+    out.size = sizeof(MatchResult);
+    MatchResult* result = (MatchResult*)out.payload;
+
+    bool ok = result && (app->projection ? app->matcher->match((int8_t*)in->payload, result)
+                                         : app->matcher->match((float*)in->payload, result));
+
+    if (ok && result->score >= app->match_threshold) {
+        s->pipeline->release(in->payload);
+        if (app->stash) app->stash->drop(in->interaction_id);
+        Serial.printf("[match] #%u %.3f \"%s\"\n", in->interaction_id, result->score, result->text);
+        s->pipeline->emit(s, 0, &out, portMAX_DELAY);
+        return;
+    }
+
+    Serial.printf("[match] #%u below threshold (%.3f)\n", in->interaction_id, ok ? result->score : 0.0f);
+    send_text(s, in, app->canned_response, MSG_FLAG_END | MSG_FLAG_CANNED, 1, 2);
+
+    // Answer first, then archive the utterance with its embedding for the
+    // server to transcribe
+    if (app->stash) {
+        bool q8 = app->projection != nullptr;
+        app->stash->commit(in->interaction_id, in->payload,
+                           q8 ? in->size : in->size / sizeof(float),
+                           q8 ? STASH_EMBED_I8 : STASH_EMBED_F32, ok ? result->score : 0.0f,
+                           ok ? result->text : "");
+    }
+    s->pipeline->release(in->payload);
+    if (out.payload) s->pipeline->release(out.payload);
+}
+
+// ============================================================================
+// LLM generation: streams text pieces to render + speaker
+// ============================================================================
+
+static bool llm_init(PipelineStage* s) {
+    return await_load(s, app_of(s)->llm_ready);
+}
+
+static void llm_run(PipelineStage* s, PipelineMsg* in) {
+    AppContext* app = app_of(s);
+    PowerDemand demand(app->power, POWER_INFERENCE);
+    MatchResult* match = (MatchResult*)in->payload;
+
+    int num_prompt_tokens = 0;
+    int* prompt_tokens = (int*)malloc((strlen(match->text) + 3) * sizeof(int));
+    if (prompt_tokens) {
+        encode(app->tokenizer, match->text, 1, 0, prompt_tokens, &num_prompt_tokens);
+    }
+
+    if (num_prompt_tokens < 1) {
+        Serial.printf("[llm] #%u encoding failed\n", in->interaction_id);
+        free(prompt_tokens);
+        send_text(s, in, app->canned_response, MSG_FLAG_END | MSG_FLAG_CANNED, 0, s->num_outputs - 1);
+        s->pipeline->release(in->payload);
+        return;
+    }
+
+    int token = prompt_tokens[0];
+    int pos = 0;
+    uint32_t t_start = micros();
+    while (pos < app->max_tokens && pos < app->transformer->config.seq_len) {
+        uint32_t t_token = micros();
+        v4sf* logits = forward(app->transformer, token, pos);
+        MetricsRegistry::record(m_llm_token_us, micros() - t_token);
+        if (!logits) {
+            Serial.printf("[llm] #%u forward pass failed\n", in->interaction_id);
+            break;
+        }
+
+        int next = (pos < num_prompt_tokens - 1) ? prompt_tokens[pos + 1]
+                                                  : sample(app->sampler, logits);
+        pos++;
+        if (next == 1) break;
+
+        char* piece = decode(app->tokenizer, token, next);
+        if (piece != NULL && piece[0] != '\0') {
+            bool printable = piece[1] != '\0' ||
+                             isprint((unsigned char)piece[0]) || isspace((unsigned char)piece[0]);
+            if (printable) {
+                send_text(s, in, piece, 0, 0, s->num_outputs - 1);
+            }
+        }
+        token = next;
+    }
+
+    uint32_t elapsed = micros() - t_start;
+    MetricsRegistry::add(m_llm_tokens, pos);
+    if (pos > 0 && elapsed > 0) {
+        MetricsRegistry::set(m_llm_tok_s, pos * 1e6f / elapsed);
+    }
+
+    free(prompt_tokens);
+    send_text(s, in, "", MSG_FLAG_END, 0, s->num_outputs - 1);
+    s->pipeline->release(in->payload);
+}
+
+// ============================================================================
+// Text render
+// ============================================================================
+
+static uint32_t render_interaction = 0;
+
+static bool render_init(PipelineStage* s) {
+    return app_of(s)->hal->display != nullptr;
+}
+
+static void render_run(PipelineStage* s, PipelineMsg* in) {
+    HalDisplay* gfx = app_of(s)->hal->display;
+    const char* text = (const char*)in->payload;
+
+    if (text[0] != '\0') {
+        s->pipeline->markFirstOutput(in);
+    }
+
+    if (spi_bus_lock()) {
+        MetricTimer timer(m_render_us);
+        if (in->interaction_id != render_interaction) {
+            render_interaction = in->interaction_id;
+            gfx->fillScreen(HAL_BLACK);
+            gfx->setCursor(0, 0);
+            gfx->setTextColor(HAL_WHITE);
+            gfx->setTextSize(2);
+        }
+        gfx->print(text);
+        gfx->flush();
+        spi_bus_unlock();
+    }
+
+    s->pipeline->release(in->payload);
+}
+
+// ============================================================================
+// Speaker: a short chime, then the response spoken by the TTS as its text
+// pieces arrive (or the recorded clip for the canned response). Everything
+// goes through the AudioPlayer, so this stage only waits when the TTS
+// phoneme queue is full.
+// ============================================================================
+
+#define CHIME_SAMPLES 1280   // 80ms @ 16kHz
+
+static int16_t chime[CHIME_SAMPLES];
+static uint32_t speaker_interaction = 0;
+static bool speaker_speaking = false;
+
+static bool speaker_init(PipelineStage* s) {
+    AppContext* app = app_of(s);
+    if (!app->player->begin(app->hal->audio_out, SAMPLE_RATE)) {
+        return false;
+    }
+
+    // 880Hz tone with a linear fade-out
+    for (int i = 0; i < CHIME_SAMPLES; i++) {
+        float env = 1.0f - (float)i / CHIME_SAMPLES;
+        chime[i] = (int16_t)(6000.0f * env * sinf(2.0f * M_PI * 880.0f * i / SAMPLE_RATE));
+    }
+    return true;
+}
+
+static void speaker_run(PipelineStage* s, PipelineMsg* in) {
+    AppContext* app = app_of(s);
+    if (in->interaction_id != speaker_interaction) {
+        speaker_interaction = in->interaction_id;
+        s->pipeline->markFirstOutput(in);
+
+        app->player->playBuffer(chime, CHIME_SAMPLES);
+        speaker_speaking = false;
+        if ((in->flags & MSG_FLAG_CANNED) && app->canned_audio) {
+            app->player->play(app->canned_audio);
+        } else if (app->tts) {
+            speaker_speaking = app->player->playStream(app->tts);
+        }
+    }
+
+    bool end = in->flags & MSG_FLAG_END;
+    if (speaker_speaking) {
+        app->tts->say((const char*)in->payload);
+        if (end) app->tts->finish();
+    }
+    s->pipeline->release(in->payload);
+
+    if (end) {
+        s->pipeline->markComplete(in);
+        s->pipeline->printStats();
+
+        PowerGovernor* power = app_of(s)->power;
+        if (power) {
+            power->endInteraction(in->interaction_id);
+            power->printStats();
+        }
+    }
+}
+
+// ============================================================================
+// Stage Table
+// ============================================================================
+
+static const StageConfig STAGE_TABLE[STAGE_COUNT] = {
+    // name       init          run          core prio stack  mem_budget    queue
+    {"capture",   nullptr,      capture_run, 0,   6,   4096,  24 * 1024,    0},
+    {"vad",       vad_init,     vad_run,     0,   5,   4096,  320 * 1024,   8},
+    {"mel",       nullptr,      mel_run,     1,   4,   8192,  64 * 1024,    1},
+    {"yamnet",    yamnet_init,  yamnet_run,  1,   4,   8192,  16 * 1024,    1},
+    {"match",     match_init,   match_run,   1,   4,   4096,  4 * 1024,     1},
+    {"llm",       llm_init,     llm_run,     0,   3,   8192,  8 * 1024,     1},
+    {"render",    render_init,  render_run,  1,   2,   4096,  4 * 1024,     32},
+    {"speaker",   speaker_init, speaker_run, 1,   3,   4096,  4 * 1024,     32},
+};
+
+static void sample_stage_stacks(MetricsRegistry* metrics, void* arg) {
+    Pipeline* pipeline = (Pipeline*)arg;
+    for (int i = 0; i < pipeline->numStages() && i < STAGE_COUNT; i++) {
+        TaskHandle_t task = pipeline->stage(i)->task;
+        if (task) {
+            MetricsRegistry::set(m_stage_stack[i], uxTaskGetStackHighWaterMark(task));
+        }
+    }
+}
+
+void register_stage_metrics(Pipeline* pipeline, MetricsRegistry* metrics) {
+    m_audio_overruns = metrics->counter("audio.overruns", "chunks");
+    m_audio_short_reads = metrics->counter("audio.short_reads", "reads");
+    m_llm_tokens = metrics->counter("llm.tokens", "tok");
+    m_llm_tok_s = metrics->gauge("llm.tok_s", "tok/s");
+    m_llm_token_us = metrics->histogram("llm.token_us", "us");
+    m_render_us = metrics->histogram("render.draw_us", "us");
+
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        snprintf(stage_stack_names[i], sizeof(stage_stack_names[i]), "stack.%s",
+                 STAGE_TABLE[i].name);
+        m_stage_stack[i] = metrics->gauge(stage_stack_names[i], "B free");
+    }
+    metrics->addSampler(sample_stage_stacks, pipeline);
+}
+
+bool build_interaction_pipeline(Pipeline* pipeline, AppContext* app) {
+    spi_bus_init();
+
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        if (pipeline->addStage(STAGE_TABLE[i], app) != i) {
+            return false;
+        }
+    }
+
+    // Linear chain up to the matcher, then fan-out.
+    // render and speaker have no dependency on each other and run concurrently.
+    return pipeline->connect(STAGE_CAPTURE, STAGE_VAD) &&
+           pipeline->connect(STAGE_VAD, STAGE_MEL) &&
+           pipeline->connect(STAGE_MEL, STAGE_YAMNET) &&
+           pipeline->connect(STAGE_YAMNET, STAGE_MATCH) &&
+           pipeline->connect(STAGE_MATCH, STAGE_LLM) &&
+           pipeline->connect(STAGE_MATCH, STAGE_RENDER) &&
+           pipeline->connect(STAGE_MATCH, STAGE_SPEAKER) &&
+           pipeline->connect(STAGE_LLM, STAGE_RENDER) &&
+           pipeline->connect(STAGE_LLM, STAGE_SPEAKER);
+}
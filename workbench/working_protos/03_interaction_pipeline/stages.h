@@ -0,0 +1,80 @@
+// stages.h - Interaction stages wired into the pipeline
+// capture -> vad -> mel -> yamnet -> match -> llm -> render + speaker
+
+#ifndef STAGES_H
+#define STAGES_H
+
+#include <Arduino.h>
+#include "hal.h"
+#include "boot.h"
+#include "power_governor.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "vad.h"
+#include "mel_spectrogram.h"
+#include "yamnet_inference.h"
+#include "similarity_match.h"
+#include "clip_stash.h"
+#include "llm_core.h"
+#include "tokenizer.h"
+#include "sampler.h"
+#include "audio_player.h"
+#include "tts.h"
+
+// Capture chunk = exactly one I2S_BUFFER_SIZE read (1024 stereo frames, see
+// audio_recorder.h), so AudioRecorder::record() never drops the tail of a DMA read
+#define CAPTURE_CHUNK_SAMPLES  1024
+#define MAX_UTTERANCE_SAMPLES  (5 * SAMPLE_RATE)
+
+// Stage indices (order of STAGE_TABLE in stages.cpp)
+enum StageId {
+    STAGE_CAPTURE = 0,
+    STAGE_VAD,
+    STAGE_MEL,
+    STAGE_YAMNET,
+    STAGE_MATCH,
+    STAGE_LLM,
+    STAGE_RENDER,
+    STAGE_SPEAKER,
+    STAGE_COUNT
+};
+
+// Everything the stages share; owned by the sketch
+typedef struct {
+    Hal* hal;                   // Microphone, speaker and display
+    AudioPlayer* player;        // Speaker output, started by the speaker stage
+    Tts* tts;                   // Speaks the response (nullptr = chime only)
+    PowerGovernor* power;       // Clock per active stage (nullptr = fixed clock)
+    VoiceActivityDetector* vad;
+    MelSpectrogram* mel;
+    YamNetInference* yamnet;
+    ProjectionHead* projection; // Int8 embeddings + version 2 index (nullptr = float, version 1)
+    SimilarityMatcher* matcher;
+    ClipStash* stash;           // Keeps below-threshold utterances for the server (nullptr = off)
+    Transformer* transformer;
+    Tokenizer* tokenizer;
+    Sampler* sampler;
+
+    // Deferred loads (nullptr = loaded before the pipeline started)
+    BootFuture* yamnet_ready;
+    BootFuture* match_ready;
+    BootFuture* llm_ready;      // Transformer, tokenizer and sampler
+
+    float match_threshold;      // Below this, answer with the canned response
+    int max_tokens;
+    const char* canned_response;
+    const char* canned_audio;   // WAV played with the canned response (nullptr = chime only)
+} AppContext;
+
+// Register stages and connect queues (does not start tasks)
+bool build_interaction_pipeline(Pipeline* pipeline, AppContext* app);
+
+// Stage counters/histograms plus per-task stack high-water gauges
+void register_stage_metrics(Pipeline* pipeline, MetricsRegistry* metrics);
+
+// SD card and LCD share the SPI pins; hold this around either
+void spi_bus_init();
+bool spi_bus_lock(TickType_t timeout = portMAX_DELAY);
+void spi_bus_unlock();
+
+#endif // STAGES_H
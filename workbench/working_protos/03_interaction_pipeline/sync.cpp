@@ -0,0 +1,870 @@
+// sync.cpp - Resumable sync client
+
+#include "sync.h"
+#include "delta_patch.h"
+#include "wav_file.h"
+#include <strings.h>
+
+static inline uint32_t min_u32(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+SyncClient::SyncClient(fs::FS& fs, SyncLockFn lock, SyncUnlockFn unlock)
+    : fs_(fs), lock_(lock), unlock_(unlock), net_(nullptr), power_(nullptr), task_(nullptr),
+      wake_(nullptr), port_(80), interval_ms_(15 * 60 * 1000), progress_(0), head_len_(0),
+      head_pos_(0), body_left_(0), out_len_(0), send_pos_(0), send_skip_(0), m_rx_(nullptr),
+      m_tx_(nullptr), m_drops_(nullptr), m_files_(nullptr), m_clips_(nullptr) {
+    host_[0] = '\0';
+    memset(&state_, 0, sizeof(state_));
+}
+
+bool SyncClient::lock() {
+    return lock_ ? lock_() : true;
+}
+
+void SyncClient::unlock() {
+    if (unlock_) unlock_();
+}
+
+// ============================================================================
+// Setup and task
+// ============================================================================
+
+bool SyncClient::begin(HalNet* net, const char* config_path, MetricsRegistry* metrics,
+                       PowerGovernor* power) {
+    net_ = net;
+    power_ = power;
+
+    lock();
+    File f = fs_.open(config_path, FILE_READ);
+    int len = f ? f.read(buf_, SYNC_CHUNK - 1) : 0;
+    if (f) f.close();
+    unlock();
+    if (len <= 0) {
+        Serial.printf("[sync] No %s, sync disabled\n", config_path);
+        return false;
+    }
+    buf_[len] = '\0';
+
+    char ssid[33] = "", password[65] = "";
+    char* save = nullptr;
+    for (char* line = strtok_r((char*)buf_, "\r\n", &save); line;
+         line = strtok_r(nullptr, "\r\n", &save)) {
+        char* eq = strchr(line, '=');
+        if (line[0] == '#' || !eq) continue;
+        *eq = '\0';
+        const char* value = eq + 1;
+        if (strcmp(line, "ssid") == 0) {
+            snprintf(ssid, sizeof(ssid), "%s", value);
+        } else if (strcmp(line, "password") == 0) {
+            snprintf(password, sizeof(password), "%s", value);
+        } else if (strcmp(line, "server") == 0) {
+            snprintf(host_, sizeof(host_), "%s", value);
+            char* colon = strrchr(host_, ':');
+            if (colon) {
+                *colon = '\0';
+                port_ = atoi(colon + 1);
+            }
+        } else if (strcmp(line, "interval_s") == 0) {
+            interval_ms_ = atoi(value) * 1000;
+        }
+    }
+    if (!host_[0] || interval_ms_ == 0) {
+        Serial.printf("[sync] %s needs server=host:port and interval_s > 0\n", config_path);
+        return false;
+    }
+
+    loadState();
+    net_->begin(ssid, password);
+
+    if (metrics) {
+        m_rx_ = metrics->counter("sync.rx_bytes", "B");
+        m_tx_ = metrics->counter("sync.tx_bytes", "B");
+        m_drops_ = metrics->counter("sync.drops");
+        m_files_ = metrics->counter("sync.files");
+        m_clips_ = metrics->counter("sync.clips");
+    }
+
+    wake_ = xSemaphoreCreateBinary();
+    if (xTaskCreatePinnedToCore(syncTask, "sync", 6144, this, SYNC_TASK_PRIORITY, &task_,
+                                SYNC_TASK_CORE) != pdPASS) {
+        Serial.println("ERROR: sync task failed");
+        task_ = nullptr;
+        return false;
+    }
+    Serial.printf("[sync] %s:%u every %u s\n", host_, port_, (unsigned)(interval_ms_ / 1000));
+    return true;
+}
+
+void SyncClient::recover() {
+    loadState();
+    lock();
+    for (int i = 0; i < state_.count; i++) {
+        DeltaPatcher::recover(fs_, state_.files[i].path, ".part");
+    }
+    unlock();
+}
+
+void SyncClient::requestSync() {
+    if (wake_) xSemaphoreGive(wake_);
+}
+
+void SyncClient::syncTask(void* arg) {
+    SyncClient* self = (SyncClient*)arg;
+    uint32_t wait_ms = min_u32(self->interval_ms_, SYNC_FIRST_CHECK_MS);
+    for (;;) {
+        xSemaphoreTake(self->wake_, pdMS_TO_TICKS(wait_ms));
+        self->runOnce();
+        wait_ms = self->interval_ms_;
+    }
+}
+
+void SyncClient::runOnce() {
+    if (!net_->linkUp()) {
+        Serial.println("[sync] WiFi not connected, next try at the next interval");
+        return;
+    }
+    PowerDemand demand(power_, POWER_LOAD);
+    uint32_t t_start = millis();
+
+    SyncEntry entries[SYNC_MAX_FILES];
+    char etag[sizeof(state_.etag)];
+    int n = checkManifest(entries, etag);
+    bool all_installed = n >= 0;
+    for (int i = 0; i < n; i++) {
+        const SyncEntry* e = &entries[i];
+        const SyncEntry* have = installed(e->path);
+        if (have ? strcmp(have->sha256, e->sha256) == 0 : localMatches(e)) continue;
+
+        Serial.printf("[sync] %s: new version, %u bytes\n", e->path, (unsigned)e->size);
+        progress_ = 0;
+        if (withRetry(e->path, [&] { return download(e); }) == SYNC_DONE) {
+            setInstalled(e);
+            saveState();
+            MetricsRegistry::add(m_files_);
+            Serial.printf("[sync] %s installed, reboot to load it\n", e->path);
+        } else {
+            all_installed = false;
+        }
+    }
+    // Remember the manifest only once everything in it is on SD, so a
+    // partial run is checked (and resumed) again next time
+    if (n > 0 && all_installed) {
+        snprintf(state_.etag, sizeof(state_.etag), "%s", etag);
+        saveState();
+    }
+
+    uint32_t total;
+    char id[17];
+    char path[SYNC_PATH_MAX + 8];
+    while (findArchive(path, &total, id)) {
+        Serial.printf("[sync] Uploading %s, %u KB\n", path, (unsigned)(total / 1024));
+        progress_ = 0;
+        SyncResult r = withRetry("upload", [&] {
+            return upload(id, total, [&](uint32_t skip) { return streamFile(path, skip, total); });
+        });
+        if (r != SYNC_DONE) break;
+        lock();
+        fs_.remove(path);
+        unlock();
+        MetricsRegistry::add(m_files_);
+    }
+
+    SyncClip clips[SYNC_BATCH_CLIPS];
+    int count;
+    while ((count = collectClips(clips, &total, id)) > 0) {
+        Serial.printf("[sync] Uploading %d clips, %u KB, batch %s\n", count,
+                      (unsigned)(total / 1024), id);
+        progress_ = 0;
+        SyncResult r = withRetry("upload", [&] {
+            return upload(id, total, [&](uint32_t skip) { return streamBatch(clips, count, skip); });
+        });
+        if (r != SYNC_DONE) break;
+
+        for (int i = 0; i < count; i++) {
+            snprintf(path, sizeof(path), SYNC_STASH_DIR "/%.*s", SYNC_PATH_MAX - 1, clips[i].name);
+            lock();
+            fs_.remove(path);
+            unlock();
+        }
+        MetricsRegistry::add(m_clips_, count);
+    }
+
+    Serial.printf("[sync] Done in %u ms\n", (unsigned)(millis() - t_start));
+}
+
+template <typename Op>
+SyncResult SyncClient::withRetry(const char* what, Op op) {
+    uint32_t backoff = SYNC_BACKOFF_MS;
+    int stalled = 0;
+    for (;;) {
+        uint32_t before = progress_;
+        SyncResult r = op();
+        net_->close();
+        if (r != SYNC_DROPPED) return r;
+
+        MetricsRegistry::add(m_drops_);
+        if (progress_ != before) {
+            stalled = 0;
+            backoff = SYNC_BACKOFF_MS;
+        }
+        if (++stalled >= SYNC_MAX_ATTEMPTS) {
+            Serial.printf("[sync] %s: no progress after %d attempts, next interval\n", what, stalled);
+            return r;
+        }
+        Serial.printf("[sync] %s: connection lost at %u bytes, retry in %u ms\n", what,
+                      (unsigned)progress_, (unsigned)backoff);
+        vTaskDelay(pdMS_TO_TICKS(backoff));
+        backoff = min_u32(backoff * 2, SYNC_BACKOFF_MAX_MS);
+
+        // Ride out a WiFi drop before trying again
+        for (int i = 0; i < SYNC_BACKOFF_MAX_MS / 1000 && !net_->linkUp(); i++) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+    }
+}
+
+// ============================================================================
+// Installed-version state
+// ============================================================================
+
+void SyncClient::loadState() {
+    memset(&state_, 0, sizeof(state_));
+    lock();
+    File f = fs_.open(SYNC_STATE_PATH, FILE_READ);
+    int len = f ? f.read(buf_, SYNC_CHUNK - 1) : 0;
+    if (f) f.close();
+    unlock();
+    if (len <= 0) return;
+    buf_[len] = '\0';
+
+    char* save = nullptr;
+    for (char* line = strtok_r((char*)buf_, "\n", &save); line; line = strtok_r(nullptr, "\n", &save)) {
+        SyncEntry e;
+        if (strncmp(line, "etag ", 5) == 0) {
+            snprintf(state_.etag, sizeof(state_.etag), "%s", line + 5);
+        } else if (sscanf(line, "%63s %64s", e.path, e.sha256) == 2) {
+            e.size = 0;
+            setInstalled(&e);
+        }
+    }
+}
+
+bool SyncClient::saveState() {
+    int len = snprintf((char*)buf_, SYNC_CHUNK, "etag %s\n", state_.etag);
+    for (int i = 0; i < state_.count; i++) {
+        len += snprintf((char*)buf_ + len, SYNC_CHUNK - len, "%s %s\n", state_.files[i].path,
+                        state_.files[i].sha256);
+    }
+
+    lock();
+    File f = fs_.open(SYNC_STATE_PATH, FILE_WRITE);
+    bool ok = f && f.write(buf_, len) == (size_t)len;
+    if (f) f.close();
+    unlock();
+    return ok;
+}
+
+const SyncEntry* SyncClient::installed(const char* path) const {
+    for (int i = 0; i < state_.count; i++) {
+        if (strcmp(state_.files[i].path, path) == 0) return &state_.files[i];
+    }
+    return nullptr;
+}
+
+void SyncClient::setInstalled(const SyncEntry* e) {
+    SyncEntry* slot = (SyncEntry*)installed(e->path);
+    if (!slot) {
+        if (state_.count >= SYNC_MAX_FILES) return;
+        slot = &state_.files[state_.count++];
+    }
+    *slot = *e;
+}
+
+// ============================================================================
+// Downloads
+// ============================================================================
+
+// Entries of a changed manifest (0 if unchanged, -1 on error)
+int SyncClient::checkManifest(SyncEntry* entries, char* etag) {
+    char headers[128] = "";
+    if (state_.etag[0]) {
+        snprintf(headers, sizeof(headers), "If-None-Match: %s\r\n", state_.etag);
+    }
+
+    SyncResponse r;
+    if (!request("GET", "/manifest", headers, -1) || !readHead(&r)) {
+        Serial.printf("[sync] %s:%u unreachable\n", host_, port_);
+        net_->close();
+        return -1;
+    }
+    if (r.status == 304) {
+        net_->close();
+        return 0;
+    }
+    if (r.status != 200) {
+        Serial.printf("[sync] Manifest: HTTP %d\n", r.status);
+        net_->close();
+        return -1;
+    }
+
+    int len = 0, n = 0;
+    while (len < SYNC_CHUNK - 1 && (n = readBody(buf_ + len, SYNC_CHUNK - 1 - len)) > 0) {
+        len += n;
+    }
+    net_->close();
+    if (n < 0 || body_left_ != 0) {
+        Serial.println("[sync] Manifest truncated");
+        return -1;
+    }
+    buf_[len] = '\0';
+    snprintf(etag, sizeof(state_.etag), "%s", r.etag);
+
+    int count = 0;
+    char* save = nullptr;
+    for (char* line = strtok_r((char*)buf_, "\n", &save); line && count < SYNC_MAX_FILES;
+         line = strtok_r(nullptr, "\n", &save)) {
+        SyncEntry* e = &entries[count];
+        unsigned size;
+        if (sscanf(line, "%63s %u %64s", e->path, &size, e->sha256) == 3 && e->path[0] == '/' &&
+            strlen(e->sha256) == 2 * SHA256_DIGEST_SIZE) {
+            e->size = size;
+            count++;
+        }
+    }
+    return count;
+}
+
+SyncResult SyncClient::download(const SyncEntry* e) {
+    char part[SYNC_PATH_MAX + 8], bak[SYNC_PATH_MAX + 8];
+    snprintf(part, sizeof(part), "%s.part", e->path);
+
+    lock();
+    DeltaPatcher::recover(fs_, e->path, ".part");
+    File f = fs_.open(part, FILE_READ);
+    uint32_t have = f ? f.size() : 0;
+    if (f) f.close();
+    unlock();
+    if (have > e->size || !resumeHash(part, have)) {
+        have = 0;
+        sha256_init(&sha_);
+    }
+    progress_ = have;
+
+    if (have < e->size) {
+        char url[SYNC_PATH_MAX + 8];
+        char headers[160];
+        snprintf(url, sizeof(url), "/files%s", e->path);
+        snprintf(headers, sizeof(headers), "Range: bytes=%u-\r\nIf-Range: \"%s\"\r\n",
+                 (unsigned)have, e->sha256);
+
+        SyncResponse r;
+        if (!request("GET", url, headers, -1) || !readHead(&r)) {
+            return SYNC_DROPPED;
+        }
+        if (r.status == 200) {
+            // Server ignored the range (its file changed): start over
+            have = 0;
+            sha256_init(&sha_);
+        } else if (r.status != 206 || r.range_start != have) {
+            Serial.printf("[sync] %s: HTTP %d\n", url, r.status);
+            return SYNC_FAILED;
+        }
+
+        lock();
+        File out = fs_.open(part, have == 0 ? FILE_WRITE : FILE_APPEND);
+        unlock();
+        if (!out) {
+            Serial.printf("[sync] Cannot create %s\n", part);
+            return SYNC_FAILED;
+        }
+
+        bool dropped = false;
+        bool write_ok = true;
+        while (have < e->size && !dropped && write_ok) {
+            // Fill a whole chunk before touching SD
+            uint32_t want = min_u32(SYNC_CHUNK, e->size - have);
+            uint32_t len = 0;
+            while (len < want) {
+                int n = readBody(buf_ + len, want - len);
+                if (n <= 0) {
+                    dropped = true;
+                    break;
+                }
+                len += n;
+            }
+            // Keep the part file sector aligned, so resumed writes are too
+            if (dropped && have + len < e->size) {
+                len -= len % HAL_SECTOR_SIZE;
+            }
+            if (len == 0) break;
+
+            lock();
+            write_ok = out.write(buf_, len) == len;
+            unlock();
+            if (write_ok) {
+                sha256_update(&sha_, buf_, len);
+                have += len;
+                progress_ = have;
+            }
+        }
+
+        lock();
+        out.close();
+        unlock();
+        if (!write_ok) {
+            Serial.printf("[sync] %s: SD write failed\n", part);
+            return SYNC_FAILED;
+        }
+        if (have < e->size) {
+            saveHashState(part);
+            return SYNC_DROPPED;
+        }
+    }
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    char hex[2 * SHA256_DIGEST_SIZE + 1];
+    sha256_final(&sha_, digest);
+    sha256_hex(digest, hex);
+
+    char sidecar[SYNC_PATH_MAX + 12];
+    snprintf(sidecar, sizeof(sidecar), "%s.sha", part);
+    snprintf(bak, sizeof(bak), "%s.bak", e->path);
+    bool ok = strcmp(hex, e->sha256) == 0;
+    bool installed = false;
+    lock();
+    fs_.remove(sidecar);
+    if (!ok) {
+        fs_.remove(part);
+    } else if (!fs_.exists(e->path)) {
+        installed = fs_.rename(part, e->path);
+    } else {
+        // Never a moment without a complete file: a power cut in between
+        // leaves .bak + .part, which recover() resolves
+        installed = fs_.rename(e->path, bak) && fs_.rename(part, e->path);
+        if (installed) {
+            fs_.remove(bak);
+        } else {
+            DeltaPatcher::recover(fs_, e->path, ".part");
+        }
+    }
+    unlock();
+    if (!ok) {
+        Serial.printf("[sync] %s: sha256 %s does not match the manifest\n", e->path, hex);
+        return SYNC_FAILED;
+    }
+    if (!installed) {
+        Serial.printf("[sync] Could not replace %s (new version left in %s)\n", e->path, part);
+        return SYNC_FAILED;
+    }
+    return SYNC_DONE;
+}
+
+// First sync: a file already on SD (copied by hand) that matches is kept
+bool SyncClient::localMatches(const SyncEntry* e) {
+    lock();
+    File f = fs_.open(e->path, FILE_READ);
+    bool ok = f && f.size() == e->size;
+    unlock();
+    if (!ok) {
+        lock();
+        if (f) f.close();
+        unlock();
+        return false;
+    }
+
+    Sha256 ctx;
+    sha256_init(&ctx);
+    for (uint32_t done = 0; ok && done < e->size;) {
+        uint32_t len = min_u32(SYNC_CHUNK, e->size - done);
+        lock();
+        ok = f.read(buf_, len) == len;
+        unlock();
+        sha256_update(&ctx, buf_, len);
+        done += len;
+    }
+    lock();
+    f.close();
+    unlock();
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    char hex[2 * SHA256_DIGEST_SIZE + 1];
+    sha256_final(&ctx, digest);
+    sha256_hex(digest, hex);
+    if (!ok || strcmp(hex, e->sha256) != 0) return false;
+    setInstalled(e);
+    saveState();
+    return true;
+}
+
+// Hash state for a part file of `have` bytes: the state saved when the last
+// attempt dropped, or a re-read of the file if that is missing or stale
+// (power cut mid-transfer)
+bool SyncClient::resumeHash(const char* part, uint32_t have) {
+    sha256_init(&sha_);
+    if (have == 0) return true;
+
+    char sidecar[SYNC_PATH_MAX + 12];
+    snprintf(sidecar, sizeof(sidecar), "%s.sha", part);
+    lock();
+    File f = fs_.open(sidecar, FILE_READ);
+    bool ok = f && f.read((uint8_t*)&sha_, sizeof(sha_)) == sizeof(sha_) && sha_.length == have;
+    if (f) f.close();
+    unlock();
+    if (ok) return true;
+
+    Serial.printf("[sync] Re-hashing %u bytes of %s\n", (unsigned)have, part);
+    sha256_init(&sha_);
+    lock();
+    File p = fs_.open(part, FILE_READ);
+    unlock();
+    ok = p;
+    for (uint32_t done = 0; done < have && ok;) {
+        uint32_t len = min_u32(SYNC_CHUNK, have - done);
+        lock();
+        ok = p.read(buf_, len) == len;
+        unlock();
+        sha256_update(&sha_, buf_, len);
+        done += len;
+    }
+    lock();
+    p.close();
+    unlock();
+    return ok;
+}
+
+void SyncClient::saveHashState(const char* part) {
+    char sidecar[SYNC_PATH_MAX + 12];
+    snprintf(sidecar, sizeof(sidecar), "%s.sha", part);
+    lock();
+    File f = fs_.open(sidecar, FILE_WRITE);
+    if (f) {
+        f.write((const uint8_t*)&sha_, sizeof(sha_));
+        f.close();
+    }
+    unlock();
+}
+
+// ============================================================================
+// Uploads
+// ============================================================================
+
+// Up to SYNC_BATCH_CLIPS stashed clips, the batch size in bytes and a batch
+// id that stays the same across retries (hash of names, lengths and the
+// first samples)
+int SyncClient::collectClips(SyncClip* clips, uint32_t* total, char* id) {
+    int count = 0;
+    *total = 8;
+    Sha256 ctx;
+    sha256_init(&ctx);
+
+    lock();
+    File dir = fs_.open(SYNC_STASH_DIR);
+    bool is_dir = dir && dir.isDirectory();
+    unlock();
+    if (!is_dir) return 0;
+
+    for (;;) {
+        lock();
+        File f = dir.openNextFile();
+        bool more = f;
+        WavInfo info;
+        const char* name = f ? f.name() : "";
+        int name_len = strlen(name);
+        bool ok = more && !f.isDirectory() && name_len > 4 && name_len < SYNC_PATH_MAX &&
+                  strcasecmp(name + name_len - 4, ".wav") == 0 && wav_read_info(f, &info) &&
+                  info.format == WAV_FORMAT_PCM;
+        int head = 0;
+        if (ok) {
+            head = f.read((uint8_t*)pcm_, sizeof(pcm_));
+            SyncClip* c = &clips[count];
+            memcpy(c->name, name, name_len + 1);
+            c->sample_rate = info.sample_rate;
+            c->num_samples = info.num_samples;
+            c->data_offset = info.data_offset;
+        }
+        if (f) f.close();
+        unlock();
+        if (!more) break;
+        if (!ok) continue;
+
+        SyncClip* c = &clips[count++];
+        sha256_update(&ctx, c->name, strlen(c->name) + 1);
+        sha256_update(&ctx, &c->num_samples, sizeof(c->num_samples));
+        sha256_update(&ctx, pcm_, head > 0 ? head : 0);
+        *total += 1 + strlen(c->name) + 8 + adpcm_encoded_size(c->num_samples);
+        if (count == SYNC_BATCH_CLIPS) break;
+    }
+    lock();
+    dir.close();
+    unlock();
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    char hex[2 * SHA256_DIGEST_SIZE + 1];
+    sha256_final(&ctx, digest);
+    sha256_hex(digest, hex);
+    memcpy(id, hex, 16);
+    id[16] = '\0';
+    return count;
+}
+
+// The first sealed clip stash archive: its path, logical size and an id
+// from its checksum and size
+bool SyncClient::findArchive(char* path, uint32_t* total, char* id) {
+    lock();
+    File dir = fs_.open(SYNC_STASH_DIR);
+    bool found = false;
+    if (dir && dir.isDirectory()) {
+        for (File f = dir.openNextFile(); f && !found; f = dir.openNextFile()) {
+            const char* name = f.name();
+            int name_len = strlen(name);
+            StashHeader h;
+            found = !f.isDirectory() && name_len > 4 && name_len < SYNC_PATH_MAX &&
+                    strcasecmp(name + name_len - 4, ".csa") == 0 &&
+                    strcmp(name, STASH_OPEN_PATH + sizeof(STASH_DIR)) != 0 &&
+                    stash_read_header(f, &h, total) &&
+                    h.sealed;
+            if (found) {
+                snprintf(path, SYNC_PATH_MAX + 8, SYNC_STASH_DIR "/%s", name);
+                snprintf(id, 17, "%08x%08x", (unsigned)h.checksum, (unsigned)*total);
+            }
+            f.close();
+        }
+    }
+    if (dir) dir.close();
+    unlock();
+    return found;
+}
+
+// Bytes of batch id already on the server (-1 if it could not be asked)
+int64_t SyncClient::queryUpload(const char* id) {
+    char url[32];
+    snprintf(url, sizeof(url), "/upload/%s", id);
+    SyncResponse r;
+    if (!request("GET", url, "", -1) || !readHead(&r) || r.status != 200) {
+        return -1;
+    }
+    char text[24];
+    int len = 0, n = 0;
+    while (len < (int)sizeof(text) - 1 && (n = readBody((uint8_t*)text + len, sizeof(text) - 1 - len)) > 0) {
+        len += n;
+    }
+    text[len] = '\0';
+    net_->close();
+    return len > 0 ? atoll(text) : -1;
+}
+
+// body(skip) sends the batch from byte skip on
+template <typename Body>
+SyncResult SyncClient::upload(const char* id, uint32_t total, Body body) {
+    int64_t have = queryUpload(id);
+    if (have < 0) return SYNC_DROPPED;
+    if (have > total) {
+        Serial.printf("[sync] Batch %s: server holds %u of %u bytes\n", id, (unsigned)have,
+                      (unsigned)total);
+        return SYNC_FAILED;
+    }
+    progress_ = have;
+    if (have == total) return SYNC_DONE;    // Finished by an attempt whose reply was lost
+
+    char url[32];
+    char headers[128];
+    snprintf(url, sizeof(url), "/upload/%s", id);
+    snprintf(headers, sizeof(headers),
+             "Content-Type: application/octet-stream\r\nContent-Range: bytes %u-%u/%u\r\n",
+             (unsigned)have, (unsigned)(total - 1), (unsigned)total);
+    if (!request("PUT", url, headers, total - have) || !body(have)) {
+        return SYNC_DROPPED;
+    }
+
+    SyncResponse r;
+    if (!readHead(&r)) return SYNC_DROPPED;
+    if (r.status == 409) return SYNC_DROPPED;  // Offset moved under us; ask again
+    if (r.status != 200) {
+        Serial.printf("[sync] Batch %s: HTTP %d\n", id, r.status);
+        return SYNC_FAILED;
+    }
+    progress_ = total;
+    return SYNC_DONE;
+}
+
+// Regenerate the batch and send everything from byte `skip` on. ADPCM
+// blocks depend on the previous ones, so a partly sent clip is re-encoded
+// from its start; whole clips before `skip` are not read at all.
+bool SyncClient::streamBatch(const SyncClip* clips, int count, uint32_t skip) {
+    out_len_ = 0;
+    send_pos_ = 0;
+    send_skip_ = skip;
+
+    uint32_t header[2] = {SYNC_CLIP_MAGIC, (uint32_t)count};
+    if (!emit(header, sizeof(header))) return false;
+
+    for (int i = 0; i < count; i++) {
+        const SyncClip* c = &clips[i];
+        uint8_t name_len = strlen(c->name);
+        uint32_t info[2] = {c->sample_rate, c->num_samples};
+        if (!emit(&name_len, 1) || !emit(c->name, name_len) || !emit(info, sizeof(info))) {
+            return false;
+        }
+
+        uint32_t clip_bytes = adpcm_encoded_size(c->num_samples);
+        if (send_pos_ + clip_bytes <= send_skip_) {
+            send_pos_ += clip_bytes;
+            continue;
+        }
+
+        char path[SYNC_PATH_MAX + 8];
+        snprintf(path, sizeof(path), SYNC_STASH_DIR "/%.*s", SYNC_PATH_MAX - 1, c->name);
+        lock();
+        File f = fs_.open(path, FILE_READ);
+        bool ok = f && f.seek(c->data_offset);
+        unlock();
+
+        adpcm_encoder_init(&enc_);
+        uint8_t block[ADPCM_BLOCK_BYTES];
+        for (uint32_t s = 0; ok && s < c->num_samples; s += ADPCM_BLOCK_SAMPLES) {
+            int n = min_u32(ADPCM_BLOCK_SAMPLES, c->num_samples - s);
+            lock();
+            ok = f.read((uint8_t*)pcm_, n * sizeof(int16_t)) == n * sizeof(int16_t);
+            unlock();
+            adpcm_encode_block(&enc_, pcm_, n, block);
+            ok = ok && emit(block, sizeof(block));
+        }
+        lock();
+        if (f) f.close();
+        unlock();
+        if (!ok) return false;
+    }
+    return flushOut();
+}
+
+// An archive is already in its upload form: copy it SD -> socket
+bool SyncClient::streamFile(const char* path, uint32_t skip, uint32_t total) {
+    lock();
+    File f = fs_.open(path, FILE_READ);
+    bool ok = f && f.seek(skip);
+    unlock();
+
+    for (uint32_t pos = skip; ok && pos < total;) {
+        uint32_t n = min_u32(SYNC_CHUNK, total - pos);
+        lock();
+        ok = f.read(buf_, n) == n;
+        unlock();
+        out_len_ = n;
+        ok = ok && flushOut();
+        pos += n;
+    }
+    lock();
+    if (f) f.close();
+    unlock();
+    return ok;
+}
+
+bool SyncClient::emit(const void* data, uint32_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    if (send_pos_ < send_skip_) {
+        uint32_t n = min_u32(len, send_skip_ - send_pos_);
+        p += n;
+        len -= n;
+        send_pos_ += n;
+    }
+    while (len > 0) {
+        uint32_t n = min_u32(len, SYNC_CHUNK - out_len_);
+        memcpy(buf_ + out_len_, p, n);
+        out_len_ += n;
+        p += n;
+        len -= n;
+        send_pos_ += n;
+        if (out_len_ == SYNC_CHUNK && !flushOut()) return false;
+    }
+    return true;
+}
+
+bool SyncClient::flushOut() {
+    if (out_len_ > 0 && net_->write(buf_, out_len_) != out_len_) {
+        return false;
+    }
+    MetricsRegistry::add(m_tx_, out_len_);
+    progress_ += out_len_;
+    out_len_ = 0;
+    return true;
+}
+
+// ============================================================================
+// HTTP
+// ============================================================================
+
+bool SyncClient::request(const char* method, const char* url, const char* headers, int64_t body_len) {
+    if (!net_->connect(host_, port_, SYNC_TIMEOUT_MS)) {
+        return false;
+    }
+    char req[512];
+    int n = snprintf(req, sizeof(req), "%s %s HTTP/1.1\r\nHost: %s:%u\r\nConnection: close\r\n%s",
+                     method, url, host_, port_, headers);
+    if (body_len >= 0 && n < (int)sizeof(req)) {
+        n += snprintf(req + n, sizeof(req) - n, "Content-Length: %u\r\n", (unsigned)body_len);
+    }
+    if (n < (int)sizeof(req)) {
+        n += snprintf(req + n, sizeof(req) - n, "\r\n");
+    }
+    return n < (int)sizeof(req) && net_->write((const uint8_t*)req, n) == n;
+}
+
+bool SyncClient::readHead(SyncResponse* r) {
+    head_len_ = 0;
+    head_pos_ = 0;
+    char* end = nullptr;
+    while (!end) {
+        if (head_len_ >= (int)sizeof(head_) - 1) return false;
+        int n = net_->read((uint8_t*)head_ + head_len_, sizeof(head_) - 1 - head_len_, SYNC_TIMEOUT_MS);
+        if (n <= 0) return false;
+        head_len_ += n;
+        head_[head_len_] = '\0';
+        end = strstr(head_, "\r\n\r\n");
+    }
+    end[2] = '\0';
+    head_pos_ = end + 4 - head_;
+
+    r->status = 0;
+    r->content_length = -1;
+    r->range_start = 0;
+    r->etag[0] = '\0';
+    if (sscanf(head_, "HTTP/1.%*d %d", &r->status) != 1) return false;
+    for (char* line = strstr(head_, "\r\n"); line && line[2]; line = strstr(line + 2, "\r\n")) {
+        const char* h = line + 2;
+        unsigned start;
+        if (strncasecmp(h, "Content-Length:", 15) == 0) {
+            r->content_length = atoll(h + 15);
+        } else if (strncasecmp(h, "Content-Range:", 14) == 0 && sscanf(h + 14, " bytes %u", &start) == 1) {
+            r->range_start = start;
+        } else if (strncasecmp(h, "ETag:", 5) == 0) {
+            sscanf(h + 5, " %79[^\r\n]", r->etag);
+        }
+    }
+    body_left_ = r->content_length;
+    return true;
+}
+
+int SyncClient::readBody(uint8_t* out, int len) {
+    if (body_left_ == 0) return 0;
+    if (body_left_ > 0 && len > body_left_) len = body_left_;
+
+    int n;
+    if (head_pos_ < head_len_) {
+        n = min_u32(len, head_len_ - head_pos_);
+        memcpy(out, head_ + head_pos_, n);
+        head_pos_ += n;
+    } else {
+        n = net_->read(out, len, SYNC_TIMEOUT_MS);
+        if (n <= 0) {
+            if (n < 0 && body_left_ < 0) {
+                body_left_ = 0;     // Body delimited by the close
+                return 0;
+            }
+            return -1;
+        }
+    }
+    if (body_left_ > 0) body_left_ -= n;
+    MetricsRegistry::add(m_rx_, n);
+    return n;
+}
@@ -0,0 +1,191 @@
+// sync.h - Resumable model/dataset downloads and clip uploads
+// A task below every pipeline stage wakes each interval_s (or on request)
+// and talks plain HTTP/1.1 to the server named in /sync.cfg. tools/sync_server.py
+// is a local stand-in with the same endpoints:
+//
+//   GET /manifest         If-None-Match: last ETag. 304 = nothing new; 200 =
+//                         one "<sd path> <size> <sha256>" line per file
+//   GET /files/<path>     Range: bytes=<have>-, If-Range: "<sha256>". Streamed
+//                         to <path>.part in SYNC_CHUNK writes, hashed on the
+//                         fly, and swapped in once size and hash match
+//   GET /upload/<id>      Bytes of batch <id> the server already holds
+//   PUT /upload/<id>      Content-Range: bytes <have>-<total-1>/<total>, then
+//                         the rest of the batch
+//
+// A dropped connection keeps <path>.part (plus its hash state in
+// <path>.part.sha) or the server's partial batch. The next attempt continues
+// from there after a backoff, so WiFi drops never restart a transfer. SD
+// writes take the bus lock per chunk, so rendering and model loads interleave.
+// The swap is the delta patcher's: <path> -> <path>.bak, <path>.part -> <path>,
+// remove .bak. recover() at boot (and download() before it starts) finishes or
+// undoes one a power cut interrupted.
+//
+// Upload batch, little-endian, built from up to SYNC_BATCH_CLIPS mono 16-bit
+// WAVs in /stash. Clips are deleted once the server holds the whole batch.
+//   u32 magic "CLB1", u32 clip_count,
+//   per clip: u8 name_len, name, u32 sample_rate, u32 num_samples,
+//             adpcm_encoded_size(num_samples) bytes of IMA ADPCM (adpcm.h)
+// Sealed clip stash archives (/stash/<checksum>.csa, clip_stash.h) go first,
+// byte for byte, under the id <checksum><size>; the server tells the two
+// formats apart by their magic.
+//
+// /sync.cfg holds key=value lines: ssid, password, server (host:port), interval_s.
+// Installed versions are tracked in /sync.state ("etag <etag>", "<path> <sha256>").
+
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "hal.h"
+#include "sha256.h"
+#include "adpcm.h"
+#include "clip_stash.h"
+#include "metrics.h"
+#include "power_governor.h"
+
+#define SYNC_CHUNK              4096    // SD write size, a multiple of the sector
+#define SYNC_MAX_FILES          8       // Manifest entries
+#define SYNC_PATH_MAX           64
+#define SYNC_BATCH_CLIPS        10
+#define SYNC_MAX_ATTEMPTS       5       // Consecutive attempts without progress
+#define SYNC_BACKOFF_MS         1000    // Doubles per failed attempt
+#define SYNC_BACKOFF_MAX_MS     30000
+#define SYNC_TIMEOUT_MS         10000   // Connect and per-read timeout
+#define SYNC_TASK_PRIORITY      1       // Below every stage (render is 2)
+#define SYNC_TASK_CORE          1
+#define SYNC_FIRST_CHECK_MS     60000   // After boot, once models have loaded
+#define SYNC_CLIP_MAGIC         0x31424C43  // "CLB1"
+#define SYNC_STATE_PATH         "/sync.state"
+#define SYNC_STASH_DIR          "/stash"
+
+typedef bool (*SyncLockFn)();
+typedef void (*SyncUnlockFn)();
+
+typedef struct {
+    char path[SYNC_PATH_MAX];
+    uint32_t size;
+    char sha256[2 * SHA256_DIGEST_SIZE + 1];
+} SyncEntry;
+
+// Contents of SYNC_STATE_PATH
+typedef struct {
+    char etag[80];              // Manifest whose files are all installed
+    int count;
+    SyncEntry files[SYNC_MAX_FILES];
+} SyncState;
+
+typedef struct {
+    char name[SYNC_PATH_MAX];
+    uint32_t sample_rate;
+    uint32_t num_samples;
+    uint32_t data_offset;
+} SyncClip;
+
+typedef struct {
+    int status;
+    int64_t content_length;     // -1 = until close
+    uint32_t range_start;       // From Content-Range (206)
+    char etag[80];
+} SyncResponse;
+
+// Outcome of one transfer attempt
+enum SyncResult {
+    SYNC_DONE = 0,
+    SYNC_DROPPED,               // Connection lost; partial data kept for the retry
+    SYNC_FAILED                 // Server refused or the data did not verify
+};
+
+class SyncClient {
+public:
+    SyncClient(fs::FS& fs, SyncLockFn lock = nullptr, SyncUnlockFn unlock = nullptr);
+
+    // Read config_path, start joining WiFi and start the sync task. False
+    // (sync stays off) without a usable config file.
+    bool begin(HalNet* net, const char* config_path, MetricsRegistry* metrics = nullptr,
+               PowerGovernor* power = nullptr);
+
+    // Wake the task for a check now instead of at the next interval
+    void requestSync();
+
+    // Complete installs a power cut interrupted, for every path in
+    // SYNC_STATE_PATH. Call at boot, before anything loads those files.
+    void recover();
+
+    bool running() const { return task_ != nullptr; }
+
+private:
+    static void syncTask(void* arg);
+    void runOnce();
+
+    // Downloads
+    int checkManifest(SyncEntry* entries, char* etag);
+    SyncResult download(const SyncEntry* e);
+    bool localMatches(const SyncEntry* e);
+    bool resumeHash(const char* part, uint32_t have);
+    void saveHashState(const char* part);
+    const SyncEntry* installed(const char* path) const;
+    void setInstalled(const SyncEntry* e);
+    void loadState();
+    bool saveState();
+
+    // Uploads
+    int collectClips(SyncClip* clips, uint32_t* total, char* id);
+    bool findArchive(char* path, uint32_t* total, char* id);
+    template <typename Body>
+    SyncResult upload(const char* id, uint32_t total, Body body);
+    int64_t queryUpload(const char* id);
+    bool streamBatch(const SyncClip* clips, int count, uint32_t skip);
+    bool streamFile(const char* path, uint32_t skip, uint32_t total);
+    bool emit(const void* data, uint32_t len);
+    bool flushOut();
+
+    // HTTP, one request per connection
+    bool request(const char* method, const char* url, const char* headers, int64_t body_len);
+    bool readHead(SyncResponse* r);
+    int readBody(uint8_t* out, int len);    // > 0 bytes, 0 = body complete, -1 = dropped
+
+    // Repeat op while it drops, until SYNC_MAX_ATTEMPTS attempts in a row
+    // leave progress_ where it was
+    template <typename Op>
+    SyncResult withRetry(const char* what, Op op);
+
+    bool lock();
+    void unlock();
+
+    fs::FS& fs_;
+    SyncLockFn lock_;
+    SyncUnlockFn unlock_;
+    HalNet* net_;
+    PowerGovernor* power_;
+    TaskHandle_t task_;
+    SemaphoreHandle_t wake_;
+
+    char host_[64];
+    uint16_t port_;
+    uint32_t interval_ms_;
+    SyncState state_;
+
+    uint32_t progress_;         // Bytes moved by the current transfer
+    Sha256 sha_;                // Hash of the .part file so far
+    char head_[1024];           // Response header, then body bytes read along with it
+    int head_len_;
+    int head_pos_;
+    int64_t body_left_;         // -1 = until close
+    uint8_t buf_[SYNC_CHUNK];   // Download chunk / upload send buffer
+    int out_len_;
+    uint32_t send_pos_;         // Batch offset of the next emitted byte
+    uint32_t send_skip_;        // Bytes the server already holds
+    int16_t pcm_[ADPCM_BLOCK_SAMPLES];
+    AdpcmEncoder enc_;
+
+    Metric* m_rx_;
+    Metric* m_tx_;
+    Metric* m_drops_;
+    Metric* m_files_;
+    Metric* m_clips_;
+};
+
+#endif // SYNC_H
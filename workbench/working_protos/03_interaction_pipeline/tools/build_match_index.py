@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Build the /match_index.bin file read by SimilarityMatcher.
+
+Input is a JSON list of entries:
+    [{"text": "show me the schedule", "embedding": [0.12, ...]}, ...]
+
+"embeddings" is accepted as an alias of "embedding", so the JSON written by
+EmbeddingWriter (tests/yamnet_audio_embedding) can be pasted in directly.
+
+With --projection the embeddings go through the same int8 projection head
+the badge runs (projection_head.h) and the index is written as version 2:
+int8 unit vectors, 256 bytes per entry instead of 4 KB. Copy both files to
+the SD card together.
+
+Usage:
+    python3 build_match_index.py dataset.json match_index.bin
+    python3 build_match_index.py --projection projection.bin dataset.json match_index.bin
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+import build_projection
+
+MAGIC = 0x49424D45   # "EMBI"
+VERSION = 1
+VERSION_Q8 = 2
+TEXT_LEN = 128
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("dataset")
+    ap.add_argument("output")
+    ap.add_argument("--projection", help="projection.bin; write an int8 version 2 index")
+    args = ap.parse_args()
+
+    with open(args.dataset) as f:
+        entries = json.load(f)
+
+    if not entries:
+        print("ERROR: dataset is empty")
+        sys.exit(1)
+
+    vectors = [e.get("embedding", e.get("embeddings")) for e in entries]
+    dim = len(vectors[0])
+    for i, v in enumerate(vectors):
+        if v is None or len(v) != dim:
+            print(f"ERROR: entry {i} has no embedding of dim {dim}")
+            sys.exit(1)
+
+    version, row_fmt = VERSION, "f"
+    if args.projection:
+        head = build_projection.read(args.projection)
+        if head[0] != dim:
+            print(f"ERROR: projection takes {head[0]} dims, embeddings have {dim}")
+            sys.exit(1)
+        vectors = [build_projection.project(head, v) for v in vectors]
+        dim = head[1]
+        version, row_fmt = VERSION_Q8, "b"
+
+    with open(args.output, "wb") as out:
+        out.write(struct.pack("<5I", MAGIC, version, len(entries), dim, TEXT_LEN))
+        for entry, vec in zip(entries, vectors):
+            text = entry["text"].encode("utf-8")[:TEXT_LEN - 1]
+            out.write(struct.pack(f"<{dim}{row_fmt}", *vec))
+            out.write(text.ljust(TEXT_LEN, b"\0"))
+
+    size = 20 + len(entries) * (dim * struct.calcsize(row_fmt) + TEXT_LEN)
+    print(f"Wrote {len(entries)} entries x {dim} dims ({size // 1024} KB) to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Build the /projection.bin file read by ProjectionHead.
+
+The head maps 1024-D YAMNet embeddings to 256-D int8 unit vectors. Without
+a trained matrix this writes a seeded Gaussian random projection, which
+keeps cosine similarities close to those of the full embeddings. Give
+--center the match dataset to subtract its mean embedding through the
+bias: ReLU embeddings share a large common component, and removing it
+spreads the scores of different phrases apart.
+
+A trained head (e.g. exported from a Keras Dense layer) can be packed from
+JSON instead: {"weights": [[...in_dim] x out_dim], "bias": [...out_dim]}.
+
+Usage:
+    python3 build_projection.py projection.bin
+    python3 build_projection.py --center dataset.json projection.bin
+    python3 build_projection.py --matrix head.json projection.bin
+
+Then rebuild the index with the same head:
+    python3 build_match_index.py --projection projection.bin dataset.json match_index.bin
+"""
+
+import argparse
+import json
+import random
+import struct
+import sys
+
+MAGIC = 0x4A4F5250   # "PROJ"
+VERSION = 1
+
+
+def quantize_rows(weights):
+    """Per-row symmetric int8: returns (int8 rows, scales)."""
+    rows, scales = [], []
+    for row in weights:
+        amax = max(abs(v) for v in row)
+        scale = amax / 127 if amax > 0 else 1.0
+        rows.append([max(-127, min(127, round(v / scale))) for v in row])
+        scales.append(scale)
+    return rows, scales
+
+
+def read(path):
+    """(in_dim, out_dim, int8 rows, scales, bias) of a projection.bin."""
+    with open(path, "rb") as f:
+        magic, version, in_dim, out_dim = struct.unpack("<4I", f.read(16))
+        if magic != MAGIC or version != VERSION:
+            sys.exit(f"{path} is not a projection head")
+        flat = struct.unpack(f"<{in_dim * out_dim}b", f.read(in_dim * out_dim))
+        scales = list(struct.unpack(f"<{out_dim}f", f.read(4 * out_dim)))
+        bias = list(struct.unpack(f"<{out_dim}f", f.read(4 * out_dim)))
+    rows = [flat[i * in_dim:(i + 1) * in_dim] for i in range(out_dim)]
+    return in_dim, out_dim, rows, scales, bias
+
+
+def project(head, x):
+    """ProjectionHead::project(const float*) bit for bit where it matters:
+    one int8 scale for the input, int32 row sums, int8 unit vector out."""
+    in_dim, out_dim, rows, scales, bias = head
+    amax = max(abs(v) for v in x)
+    xs = amax / 127 if amax > 0 else 1.0
+    xq = [round(v / xs) for v in x]
+    acc = [sum(w * q for w, q in zip(row, xq)) * s * xs + b
+           for row, s, b in zip(rows, scales, bias)]
+    norm = sum(a * a for a in acc) ** 0.5
+    k = 127 / norm if norm > 0 else 0.0
+    return [max(-127, min(127, round(a * k))) for a in acc]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("output")
+    ap.add_argument("--matrix", help="Trained head as JSON (weights, bias)")
+    ap.add_argument("--center", help="Match dataset JSON; subtract its mean embedding")
+    ap.add_argument("--in-dim", type=int, default=1024)
+    ap.add_argument("--out-dim", type=int, default=256)
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+
+    if args.matrix:
+        with open(args.matrix) as f:
+            m = json.load(f)
+        weights = m["weights"]
+        bias = m.get("bias") or [0.0] * len(weights)
+        if len({len(r) for r in weights}) != 1 or len(bias) != len(weights):
+            sys.exit("weights must be out_dim rows of in_dim, bias out_dim")
+    else:
+        rng = random.Random(args.seed)
+        weights = [[rng.gauss(0, 1) for _ in range(args.in_dim)] for _ in range(args.out_dim)]
+        bias = [0.0] * args.out_dim
+    out_dim, in_dim = len(weights), len(weights[0])
+    rows, scales = quantize_rows(weights)
+
+    if args.center:
+        with open(args.center) as f:
+            vectors = [e.get("embedding", e.get("embeddings")) for e in json.load(f)]
+        if not vectors or any(v is None or len(v) != in_dim for v in vectors):
+            sys.exit(f"{args.center}: every entry needs a {in_dim}-D embedding")
+        mean = [sum(col) / len(vectors) for col in zip(*vectors)]
+        bias = [b - s * sum(w * m for w, m in zip(row, mean))
+                for row, s, b in zip(rows, scales, bias)]
+
+    with open(args.output, "wb") as out:
+        out.write(struct.pack("<4I", MAGIC, VERSION, in_dim, out_dim))
+        for row in rows:
+            out.write(struct.pack(f"<{in_dim}b", *row))
+        out.write(struct.pack(f"<{out_dim}f", *scales))
+        out.write(struct.pack(f"<{out_dim}f", *bias))
+
+    size = 16 + out_dim * (in_dim + 8)
+    print(f"Wrote {in_dim} -> {out_dim} projection ({size // 1024} KB) to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""List, verify and unpack clip stash archives (.csa, see clip_stash.h).
+
+Each record holds an utterance the badge could not match: ADPCM audio, its
+embedding, the best match score and string. unpack writes <id>.wav per
+record and a records.json with the rest, ready to be transcribed and added
+to the match dataset.
+
+An archive copied off a badge that lost power mid-append may carry a stale
+header; the records are then found by scanning their CRCs, as the badge
+does at boot.
+
+Usage:
+    python3 clip_stash.py list stash/open.csa
+    python3 clip_stash.py verify uploads/*.csa
+    python3 clip_stash.py unpack 1a2b3c4d.csa out/
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+import wave
+import zlib
+
+from sync_server import ADPCM_BLOCK_BYTES, ADPCM_BLOCK_SAMPLES, adpcm_decode_block
+
+MAGIC = 0x31415343          # "CSA1"
+VERSION = 1
+RECORD_MAGIC = 0x43455243   # "CREC"
+INDEX_MAGIC = 0x58444943    # "CIDX"
+HEADER = struct.Struct("<8I")
+RECORD = struct.Struct("<IIIfIHBB")
+
+
+def adpcm_size(num_samples):
+    return (num_samples + ADPCM_BLOCK_SAMPLES - 1) // ADPCM_BLOCK_SAMPLES * ADPCM_BLOCK_BYTES
+
+
+def parse_record(data, pos):
+    """The record at pos as a dict, or None if it is torn or corrupt."""
+    if pos + RECORD.size + 4 > len(data):
+        return None
+    magic, length, iid, score, num_samples, dim, etype, text_len = RECORD.unpack_from(data, pos)
+    if magic != RECORD_MAGIC or length < RECORD.size + 4 or pos + length > len(data):
+        return None
+    (crc,) = struct.unpack_from("<I", data, pos + length - 4)
+    if zlib.crc32(data[pos:pos + length - 4]) != crc:
+        return None
+    p = pos + RECORD.size
+    embed_bytes = dim * (4 if etype == 0 else 1)
+    embedding = list(struct.unpack_from(f"<{dim}{'f' if etype == 0 else 'b'}", data, p))
+    p += embed_bytes
+    text = data[p:p + text_len].decode("utf-8", "replace")
+    p += text_len
+    if p + adpcm_size(num_samples) + 4 != pos + length:
+        return None
+    return {"offset": pos, "length": length, "interaction_id": iid, "score": round(score, 4),
+            "num_samples": num_samples, "embed_type": "f32" if etype == 0 else "i8",
+            "embedding": embedding, "text": text, "adpcm": data[p:p + adpcm_size(num_samples)]}
+
+
+def read(data):
+    """(header dict, records, problems). Trusts the index when header and
+    index check out, otherwise scans the records like ClipStash::begin()."""
+    problems = []
+    if len(data) < HEADER.size:
+        return None, [], ["shorter than a header"]
+    fields = HEADER.unpack_from(data, 0)
+    magic, version, rate, count, data_end, checksum, sealed, header_crc = fields
+    header = {"sample_rate": rate, "count": count, "data_end": data_end,
+              "checksum": checksum, "sealed": bool(sealed)}
+    header_ok = (magic == MAGIC and version == VERSION and
+                 zlib.crc32(data[:HEADER.size - 4]) == header_crc)
+
+    offsets = None
+    if header_ok and data_end + 12 + 4 * count <= len(data):
+        imagic, icount = struct.unpack_from("<2I", data, data_end)
+        end = data_end + 8 + 4 * count
+        (icrc,) = struct.unpack_from("<I", data, end)
+        if imagic == INDEX_MAGIC and icount == count and zlib.crc32(data[data_end:end]) == icrc:
+            offsets = struct.unpack_from(f"<{count}I", data, data_end + 8)
+    if offsets is None:
+        problems.append("stale header or index, scanned records")
+        if not header_ok:
+            header = {"sample_rate": rate if magic == MAGIC else 16000}
+
+    records = []
+    if offsets is not None:
+        for off in offsets:
+            rec = parse_record(data, off)
+            if rec is None:
+                problems.append(f"record at {off} is corrupt")
+                continue
+            records.append(rec)
+        if zlib.crc32(data[HEADER.size:data_end]) != checksum:
+            problems.append("archive checksum mismatch")
+    else:
+        pos = HEADER.size
+        while (rec := parse_record(data, pos)) is not None:
+            records.append(rec)
+            pos += rec["length"]
+    return header, records, problems
+
+
+def write_wav(path, rate, rec):
+    samples = []
+    blocks = rec["adpcm"]
+    for b in range(0, len(blocks), ADPCM_BLOCK_BYTES):
+        samples += adpcm_decode_block(blocks[b:b + ADPCM_BLOCK_BYTES])
+    n = rec["num_samples"]
+    with wave.open(path, "wb") as w:
+        w.setnchannels(1)
+        w.setsampwidth(2)
+        w.setframerate(rate)
+        w.writeframes(struct.pack(f"<{n}h", *samples[:n]))
+
+
+def unpack(data, out_dir):
+    """Write <id>.wav per record plus records.json; returns the WAV names."""
+    header, records, problems = read(data)
+    if header is None:
+        raise ValueError(problems[0])
+    os.makedirs(out_dir, exist_ok=True)
+    names, meta = [], []
+    for rec in records:
+        name = f"{rec['interaction_id']:06d}_{rec['offset']:08x}.wav"
+        write_wav(os.path.join(out_dir, name), header["sample_rate"], rec)
+        names.append(name)
+        meta.append({"wav": name, **{k: v for k, v in rec.items() if k not in ("adpcm", "offset", "length")}})
+    with open(os.path.join(out_dir, "records.json"), "w") as f:
+        json.dump(meta, f)
+    return names
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    for cmd in ("list", "verify"):
+        sub.add_parser(cmd).add_argument("archives", nargs="+")
+    p = sub.add_parser("unpack")
+    p.add_argument("archive")
+    p.add_argument("out_dir")
+    args = ap.parse_args()
+
+    if args.cmd == "unpack":
+        with open(args.archive, "rb") as f:
+            names = unpack(f.read(), args.out_dir)
+        print(f"Unpacked {len(names)} clips to {args.out_dir}")
+        return
+
+    bad = 0
+    for path in args.archives:
+        with open(path, "rb") as f:
+            header, records, problems = read(f.read())
+        bad += bool(problems)
+        if args.cmd == "verify":
+            print(f"{path}: {'; '.join(problems) if problems else 'OK'} ({len(records)} clips)")
+            continue
+        state = "sealed" if header.get("sealed") else "open"
+        print(f"{path}: {len(records)} clips, {state}" + (f" ({'; '.join(problems)})" if problems else ""))
+        for rec in records:
+            secs = rec["num_samples"] / header["sample_rate"]
+            print(f"  #{rec['interaction_id']:<5} {secs:5.2f} s  {rec['score']:.3f}  "
+                  f"{len(rec['embedding'])}-D {rec['embed_type']}  \"{rec['text']}\"")
+    sys.exit(1 if bad and args.cmd == "verify" else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Make and apply binary delta patches for model and dataset files.
+
+The old file is indexed in --block-size blocks by content hash. Each block of
+the new file that exists anywhere in the old one becomes a COPY of that
+range, and everything else is shipped as DATA. Adjacent ops are merged. The
+badge applies the patch with DeltaPatcher (delta_patch.h), which streams
+it into <file>.new and checks the SHA-256 before replacing the file.
+
+Usage:
+    python3 delta_patch.py diff old/match_index.bin new/match_index.bin match_index.dlt
+    python3 delta_patch.py apply old/match_index.bin match_index.dlt out.bin
+    python3 delta_patch.py info match_index.dlt
+
+"apply" mirrors the on-device applier, so a patch can be checked before it
+is published.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+MAGIC = 0x31544C44   # "DLT1"
+VERSION = 1
+HEADER = struct.Struct("<4I2Q32s32s")
+OP_END, OP_COPY, OP_DATA = 0, 1, 2
+MAX_OP_LEN = 0xFFFFFFFF
+
+
+def block_key(data):
+    return hashlib.blake2b(data, digest_size=16).digest()
+
+
+def diff(old, new, block_size):
+    """List of ("copy", offset, length) / ("data", bytes) ops."""
+    index = {}
+    for off in range(0, len(old) - block_size + 1, block_size):
+        index.setdefault(block_key(old[off:off + block_size]), off)
+    tail = len(old) % block_size
+    if tail:
+        index.setdefault(block_key(old[-tail:]), len(old) - tail)
+
+    ops = []
+    for off in range(0, len(new), block_size):
+        block = new[off:off + block_size]
+        prev = ops[-1] if ops else None
+        # Extending the current run beats a lookup: repeated blocks (zero
+        # padding, tied rows) would otherwise split it at every duplicate
+        if prev and prev[0] == "copy" and old[prev[1] + prev[2]:prev[1] + prev[2] + len(block)] == block:
+            src = prev[1] + prev[2]
+        else:
+            src = index.get(block_key(block))
+        if src is not None and old[src:src + len(block)] == block:
+            if prev and prev[0] == "copy" and prev[1] + prev[2] == src and \
+                    prev[2] + len(block) <= MAX_OP_LEN:
+                ops[-1] = ("copy", prev[1], prev[2] + len(block))
+            else:
+                ops.append(("copy", src, len(block)))
+        elif ops and ops[-1][0] == "data" and len(ops[-1][1]) + len(block) <= MAX_OP_LEN:
+            ops[-1] = ("data", ops[-1][1] + block)
+        else:
+            ops.append(("data", block))
+    return ops
+
+
+def encode(old, new, ops, block_size):
+    out = bytearray(HEADER.pack(MAGIC, VERSION, block_size, 0, len(old), len(new),
+                                hashlib.sha256(old).digest(), hashlib.sha256(new).digest()))
+    for op in ops:
+        if op[0] == "copy":
+            out += struct.pack("<BQI", OP_COPY, op[1], op[2])
+        else:
+            out += struct.pack("<BI", OP_DATA, len(op[1])) + op[1]
+    out += bytes([OP_END])
+    return bytes(out)
+
+
+def parse(patch):
+    """(header tuple, ops) of an encoded patch."""
+    magic, version, block_size, _, old_size, new_size, old_sha, new_sha = \
+        HEADER.unpack_from(patch, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a DLT1 patch")
+    ops = []
+    pos = HEADER.size
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            offset, length = struct.unpack_from("<QI", patch, pos)
+            pos += 12
+            ops.append(("copy", offset, length))
+        elif op == OP_DATA:
+            (length,) = struct.unpack_from("<I", patch, pos)
+            pos += 4
+            ops.append(("data", patch[pos:pos + length]))
+            pos += length
+        else:
+            raise ValueError(f"unknown op {op} at byte {pos - 1}")
+    return (block_size, old_size, new_size, old_sha, new_sha), ops
+
+
+def cmd_diff(args):
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+    ops = diff(old, new, args.block_size)
+    patch = encode(old, new, ops, args.block_size)
+    with open(args.patch, "wb") as f:
+        f.write(patch)
+
+    copied = sum(op[2] for op in ops if op[0] == "copy")
+    literal = len(new) - copied
+    print(f"Wrote {args.patch}: {len(patch) / 1024:.1f} KB for a {len(new) / 1024:.1f} KB file "
+          f"({100.0 * len(patch) / max(1, len(new)):.1f}%)")
+    print(f"  {len(ops)} ops, {copied / 1024:.1f} KB copied from old, "
+          f"{literal / 1024:.1f} KB literal, block size {args.block_size}")
+
+
+def cmd_apply(args):
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.patch, "rb") as f:
+        (_, old_size, new_size, old_sha, new_sha), ops = parse(f.read())
+    if len(old) != old_size or hashlib.sha256(old).digest() != old_sha:
+        print(f"ERROR: {args.old} is not the version this patch was made from")
+        sys.exit(1)
+
+    out = bytearray()
+    for op in ops:
+        out += old[op[1]:op[1] + op[2]] if op[0] == "copy" else op[1]
+    if len(out) != new_size or hashlib.sha256(out).digest() != new_sha:
+        print("ERROR: patched output does not match the new file hash")
+        sys.exit(1)
+    with open(args.output, "wb") as f:
+        f.write(out)
+    print(f"Wrote {args.output}: {len(out)} bytes, sha256 {new_sha.hex()}")
+
+
+def cmd_info(args):
+    with open(args.patch, "rb") as f:
+        (block_size, old_size, new_size, old_sha, new_sha), ops = parse(f.read())
+    copied = sum(op[2] for op in ops if op[0] == "copy")
+    print(f"block size {block_size}, {len(ops)} ops")
+    print(f"old {old_size} bytes sha256 {old_sha.hex()}")
+    print(f"new {new_size} bytes sha256 {new_sha.hex()}")
+    print(f"copied {copied} bytes, literal {new_size - copied} bytes")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("diff", help="Make a patch from old to new")
+    p.add_argument("old")
+    p.add_argument("new")
+    p.add_argument("patch")
+    p.add_argument("--block-size", type=int, default=4096,
+                   help="Match granularity in bytes (default 4096)")
+    p.set_defaults(fn=cmd_diff)
+
+    p = sub.add_parser("apply", help="Apply a patch (same checks as the badge)")
+    p.add_argument("old")
+    p.add_argument("patch")
+    p.add_argument("output")
+    p.set_defaults(fn=cmd_apply)
+
+    p = sub.add_parser("info", help="Print a patch header and op summary")
+    p.add_argument("patch")
+    p.set_defaults(fn=cmd_info)
+
+    args = ap.parse_args()
+    args.fn(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""Poll the badge metrics console and record / plot the snapshots.
+
+Talks to MetricsRegistry (metrics.h) over the serial console: sends "schema"
+once, then "snap" every --interval seconds, and decodes the "#MCH" / "#MTS"
+base64 frames. Other output from the badge is passed through with --echo.
+
+Connect either to the board (needs pyserial) or to a host build, which reads
+commands from stdin:
+    python3 metrics_monitor.py --port /dev/ttyACM0 --csv run.csv --plot run.png
+    python3 metrics_monitor.py --exec "../../../host/_host_build/03_interaction_pipeline.host \\
+        --sd sd --ffat ffat --mic speech.wav" --duration 20 --plot run.png
+
+Counters and gauges are recorded as-is; histograms as their mean over the
+samples since the previous snapshot. --metrics limits the CSV/plot columns.
+"""
+
+import argparse
+import base64
+import csv
+import shlex
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+SCHEMA_MAGIC = 0x3148434D    # "MCH1"
+SNAPSHOT_MAGIC = 0x3153544D  # "MTS1"
+COUNTER, GAUGE, HISTOGRAM = 0, 1, 2
+TYPE_NAMES = {COUNTER: "counter", GAUGE: "gauge", HISTOGRAM: "hist"}
+
+
+def parse_schema(data):
+    magic, count, _ = struct.unpack_from("<IHH", data, 0)
+    if magic != SCHEMA_MAGIC:
+        raise ValueError("bad schema magic")
+    off = 8
+    schema = []
+    for _ in range(count):
+        mtype = data[off]
+        name_len = data[off + 1]
+        name = data[off + 2:off + 2 + name_len].decode()
+        off += 2 + name_len
+        unit_len = data[off]
+        unit = data[off + 1:off + 1 + unit_len].decode()
+        off += 1 + unit_len
+        schema.append((name, mtype, unit))
+    return schema
+
+
+def parse_snapshot(data, schema):
+    magic, t_ms, count, _ = struct.unpack_from("<IIHH", data, 0)
+    if magic != SNAPSHOT_MAGIC:
+        raise ValueError("bad snapshot magic")
+    if count != len(schema):
+        return t_ms, None    # Registry grew; schema must be re-read
+    off = 12
+    values = {}
+    for name, mtype, _ in schema:
+        if mtype == COUNTER:
+            values[name] = struct.unpack_from("<I", data, off)[0]
+            off += 4
+        elif mtype == GAUGE:
+            values[name] = struct.unpack_from("<f", data, off)[0]
+            off += 4
+        else:
+            n, vmin, vmax, vsum = struct.unpack_from("<IIIQ", data, off)
+            first, nb = data[off + 20], data[off + 21]
+            off += 22
+            buckets = struct.unpack_from(f"<{nb}I", data, off)
+            off += 4 * nb
+            values[name] = {"count": n, "min": vmin, "max": vmax, "sum": vsum,
+                            "first": first, "buckets": buckets}
+    return t_ms, values
+
+
+class Link:
+    """Line-oriented connection to a serial port or a host-build process."""
+
+    def __init__(self, args):
+        self.proc = None
+        if args.exec:
+            self.proc = subprocess.Popen(shlex.split(args.exec), stdin=subprocess.PIPE,
+                                         stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                         bufsize=0)
+            self.rx = self.proc.stdout
+        else:
+            try:
+                import serial
+            except ImportError:
+                print("ERROR: --port needs pyserial (pip install pyserial)")
+                sys.exit(1)
+            self.port = serial.Serial(args.port, args.baud, timeout=0.1)
+            self.rx = self.port
+
+        self.lines = []
+        self.lock = threading.Lock()
+        self.closed = False
+        threading.Thread(target=self._reader, daemon=True).start()
+
+    def _reader(self):
+        buf = b""
+        while True:
+            chunk = self.rx.read(1) if self.proc else self.rx.read(256)
+            if self.proc and not chunk:
+                self.closed = True
+                return
+            buf += chunk
+            while b"\n" in buf:
+                line, buf = buf.split(b"\n", 1)
+                with self.lock:
+                    self.lines.append(line.decode(errors="replace").rstrip("\r"))
+
+    def send(self, text):
+        data = (text + "\n").encode()
+        if self.proc:
+            try:
+                self.proc.stdin.write(data)
+                self.proc.stdin.flush()
+            except BrokenPipeError:
+                self.closed = True
+        else:
+            self.port.write(data)
+
+    def take(self):
+        with self.lock:
+            lines, self.lines = self.lines, []
+        return lines
+
+    def close(self):
+        if self.proc and self.proc.poll() is None:
+            self.proc.terminate()
+
+
+def row_value(value, prev):
+    """Histogram -> mean of the samples since the previous snapshot."""
+    if not isinstance(value, dict):
+        return value
+    if prev and value["count"] >= prev["count"]:
+        n = value["count"] - prev["count"]
+        s = value["sum"] - prev["sum"]
+    else:
+        n, s = value["count"], value["sum"]
+    return s / n if n else None
+
+
+def plot(path, names, schema_units, times, rows):
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print("matplotlib not installed; skipping plot (CSV still written)")
+        return
+    fig, axes = plt.subplots(len(names), 1, figsize=(10, 1.8 * len(names)), sharex=True,
+                             squeeze=False)
+    for ax, name in zip(axes[:, 0], names):
+        pts = [(t, r[name]) for t, r in zip(times, rows) if r.get(name) is not None]
+        if pts:
+            ax.plot([p[0] for p in pts], [p[1] for p in pts], drawstyle="steps-post")
+        ax.set_ylabel(f"{name}\n[{schema_units.get(name, '')}]", fontsize=7, rotation=0,
+                      ha="right", va="center")
+        ax.grid(alpha=0.3)
+    axes[-1, 0].set_xlabel("badge time (s)")
+    fig.tight_layout()
+    fig.savefig(path, dpi=100)
+    print(f"Wrote {path}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument("--port", help="Serial port of the badge")
+    src.add_argument("--exec", help="Host build command line (talks over stdin/stdout)")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--interval", type=float, default=1.0, help="Seconds between snapshots")
+    ap.add_argument("--duration", type=float, default=0, help="Stop after N seconds (0 = Ctrl-C)")
+    ap.add_argument("--metrics", help="Comma-separated metric names to record")
+    ap.add_argument("--csv", help="Write samples to this CSV file")
+    ap.add_argument("--plot", help="Write a PNG with one panel per metric")
+    ap.add_argument("--echo", action="store_true", help="Print the badge's other output")
+    args = ap.parse_args()
+
+    link = Link(args)
+    schema = None
+    prev = {}
+    times, rows = [], []
+    start = time.time()
+    next_poll = start
+
+    try:
+        while not link.closed and (args.duration <= 0 or time.time() - start < args.duration):
+            now = time.time()
+            if now >= next_poll:
+                link.send("snap" if schema else "schema")
+                next_poll = now + args.interval
+
+            for line in link.take():
+                if line.startswith("#MCH "):
+                    schema = parse_schema(base64.b64decode(line[5:]))
+                    print(f"Schema: {len(schema)} metrics")
+                elif line.startswith("#MTS ") and schema:
+                    t_ms, values = parse_snapshot(base64.b64decode(line[5:]), schema)
+                    if values is None:
+                        schema = None
+                        continue
+                    row = {name: row_value(v, prev.get(name)) for name, v in values.items()}
+                    prev = values
+                    times.append(t_ms / 1000.0)
+                    rows.append(row)
+                elif args.echo:
+                    print(line)
+            time.sleep(0.02)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        link.close()
+
+    if not rows:
+        print("ERROR: no snapshots received")
+        sys.exit(1)
+
+    names = [n for n, _, _ in schema] if schema else list(rows[-1])
+    if args.metrics:
+        wanted = args.metrics.split(",")
+        names = [n for n in names if n in wanted]
+    units = {n: u for n, _, u in schema} if schema else {}
+
+    print(f"\n{len(rows)} snapshots over {times[-1] - times[0]:.1f} s")
+    for name in names:
+        vals = [r[name] for r in rows if r.get(name) is not None]
+        if vals:
+            print(f"  {name:<20} last={vals[-1]:<12.4g} min={min(vals):<12.4g} "
+                  f"max={max(vals):<12.4g} {units.get(name, '')}")
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            w = csv.writer(f)
+            w.writerow(["t_s"] + names)
+            for t, r in zip(times, rows):
+                w.writerow([f"{t:.3f}"] + ["" if r.get(n) is None else r[n] for n in names])
+        print(f"Wrote {args.csv}")
+    if args.plot:
+        plot(args.plot, names, units, times, rows)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Measure what mel noise suppression does to match scores (host build).
+
+For each mode (ns off, ns on), every clean speech WAV is run through the host
+build once and its embedding (--embeddings) goes into a match index. Each clip
+is then mixed with noise at every SNR and run again, and the [match] score of
+its utterance is read back. The table shows how far noise pulls the score
+below the clean 1.0, with and without suppression.
+
+Usage:
+    python3 noise_eval.py --sd sd --ffat ffat speech.wav [more.wav ...]
+    python3 noise_eval.py --sd sd --ffat ffat --noise fan,hum --snr 10,5,0 speech.wav
+    python3 noise_eval.py --sd sd --ffat ffat --noise-wav cafe.wav speech.wav
+
+--sd must hold what the pipeline loads from SD (tok512.bin, ...); its
+match_index.bin is replaced by the clean-speech index in a scratch copy.
+Inputs are mono 16-bit 16 kHz WAVs. SNR is measured over the whole clip.
+"""
+
+import argparse
+import json
+import math
+import os
+import random
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import wave
+
+SAMPLE_RATE = 16000
+LEAD_S = 2.0        # Noise before the speech, so the VAD floor settles
+TAIL_S = 1.5        # After it, past the VAD hangover
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_HOST = os.path.join(HERE, "..", "..", "..", "host", "_host_build",
+                            "03_interaction_pipeline.host")
+
+MATCH_RE = re.compile(r"\[match\] #(\d+) (?:below threshold \()?([0-9.]+)")
+
+
+def read_wav(path):
+    with wave.open(path, "rb") as w:
+        if w.getnchannels() != 1 or w.getsampwidth() != 2 or w.getframerate() != SAMPLE_RATE:
+            sys.exit(f"{path}: need mono 16-bit {SAMPLE_RATE} Hz")
+        n = w.getnframes()
+        return list(struct.unpack(f"<{n}h", w.readframes(n)))
+
+
+def write_wav(path, samples):
+    with wave.open(path, "wb") as w:
+        w.setnchannels(1)
+        w.setsampwidth(2)
+        w.setframerate(SAMPLE_RATE)
+        clipped = [max(-32768, min(32767, int(round(s)))) for s in samples]
+        w.writeframes(struct.pack(f"<{len(clipped)}h", *clipped))
+
+
+def power(samples):
+    return sum(s * s for s in samples) / max(len(samples), 1)
+
+
+def make_noise(kind, n, rng):
+    """Stationary noise shapes typical of the badge's rooms."""
+    out = []
+    if kind == "white":
+        out = [rng.gauss(0, 1) for _ in range(n)]
+    elif kind == "fan":
+        # Brown-ish rumble plus a blade tone
+        y = 0.0
+        for i in range(n):
+            y = 0.97 * y + rng.gauss(0, 1)
+            out.append(y + 2.0 * math.sin(2 * math.pi * 120 * i / SAMPLE_RATE))
+    elif kind == "hum":
+        # Mains harmonics over a low crowd murmur
+        y = 0.0
+        for i in range(n):
+            y = 0.9 * y + rng.gauss(0, 1)
+            t = i / SAMPLE_RATE
+            tones = sum(math.sin(2 * math.pi * 50 * h * t) / h for h in range(1, 7))
+            out.append(3.0 * tones + 0.5 * y)
+    else:
+        sys.exit(f"unknown noise '{kind}' (white, fan, hum)")
+    return out
+
+
+def mix(speech, noise, snr_db):
+    lead = int(LEAD_S * SAMPLE_RATE)
+    total = lead + len(speech) + int(TAIL_S * SAMPLE_RATE)
+    noise = (noise * (total // len(noise) + 1))[:total]
+    scale = math.sqrt(power(speech) / (power(noise) * 10 ** (snr_db / 10))) if snr_db is not None else 0
+    out = [scale * v for v in noise]
+    for i, s in enumerate(speech):
+        out[lead + i] += s
+    return out
+
+
+def run(args, sd, wav_path, ns, embeddings=None):
+    """First utterance's match score, or None if nothing was matched."""
+    seconds = int(len(read_wav(wav_path)) / SAMPLE_RATE + 4)
+    cmd = [args.host, "--sd", sd, "--ffat", args.ffat, "--mic", wav_path, "--seconds", str(seconds)]
+    if embeddings:
+        cmd += ["--embeddings", embeddings]
+    proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT, text=True)
+    proc.stdin.write(f"ns {'on' if ns else 'off'}\n")
+    proc.stdin.flush()
+    out, _ = proc.communicate(timeout=seconds + 30)
+    scores = [float(m.group(2)) for m in MATCH_RE.finditer(out)]
+    if len(scores) > 1:
+        print(f"  warning: {os.path.basename(wav_path)} split into {len(scores)} utterances")
+    return scores[0] if scores else None
+
+
+def build_index(args, tmp, sd, clips, ns):
+    entries = []
+    for name, speech in clips:
+        wav_path = os.path.join(tmp, "clean.wav")
+        emb_path = os.path.join(tmp, "emb.jsonl")
+        if os.path.exists(emb_path):
+            os.remove(emb_path)
+        write_wav(wav_path, mix(speech, [0.0], None))
+        run(args, sd, wav_path, ns, emb_path)
+        with open(emb_path) as f:
+            line = f.readline()
+        if not line:
+            sys.exit(f"{name}: no utterance detected in the clean clip")
+        entries.append({"text": name, "embedding": json.loads(line)})
+
+    dataset = os.path.join(tmp, "dataset.json")
+    with open(dataset, "w") as f:
+        json.dump(entries, f)
+    subprocess.run([sys.executable, os.path.join(HERE, "build_match_index.py"), dataset,
+                    os.path.join(sd, "match_index.bin")], check=True, stdout=subprocess.DEVNULL)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("speech", nargs="+", help="Clean mono 16 kHz WAVs")
+    ap.add_argument("--sd", required=True)
+    ap.add_argument("--ffat", required=True)
+    ap.add_argument("--host", default=DEFAULT_HOST, help="Host build of this sketch")
+    ap.add_argument("--noise", default="fan,hum,white", help="Generated noise types")
+    ap.add_argument("--noise-wav", help="Use a recorded noise WAV instead")
+    ap.add_argument("--snr", default="10,5,0", help="SNRs in dB")
+    args = ap.parse_args()
+
+    clips = [(os.path.splitext(os.path.basename(p))[0], read_wav(p)) for p in args.speech]
+    snrs = [float(s) for s in args.snr.split(",")]
+    rng = random.Random(1)
+    if args.noise_wav:
+        noises = [(os.path.basename(args.noise_wav), read_wav(args.noise_wav))]
+    else:
+        n = int((LEAD_S + TAIL_S) * SAMPLE_RATE) + max(len(s) for _, s in clips)
+        noises = [(k, make_noise(k, n, rng)) for k in args.noise.split(",")]
+
+    scores = {}     # (clip, noise, snr, ns) -> score
+    with tempfile.TemporaryDirectory() as tmp:
+        sd = os.path.join(tmp, "sd")
+        shutil.copytree(args.sd, sd, symlinks=True)
+        for ns in (False, True):
+            print(f"ns {'on' if ns else 'off'}: indexing {len(clips)} clean clip(s)")
+            build_index(args, tmp, sd, clips, ns)
+            for name, speech in clips:
+                for noise_name, noise in noises:
+                    for snr in snrs:
+                        wav_path = os.path.join(tmp, "noisy.wav")
+                        write_wav(wav_path, mix(speech, noise, snr))
+                        scores[name, noise_name, snr, ns] = run(args, sd, wav_path, ns)
+
+    fmt = lambda v: "   -  " if v is None else f"{v:6.3f}"
+    print(f"\n{'clip':<16} {'noise':<10} {'SNR':>5}  {'off':>6}  {'on':>6}  {'change':>6}")
+    deltas = []
+    for name, _ in clips:
+        for noise_name, _ in noises:
+            for snr in snrs:
+                off = scores[name, noise_name, snr, False]
+                on = scores[name, noise_name, snr, True]
+                delta = on - off if off is not None and on is not None else None
+                if delta is not None:
+                    deltas.append(delta)
+                print(f"{name:<16} {noise_name:<10} {snr:5.0f}  {fmt(off)}  {fmt(on)}  "
+                      f"{'   -  ' if delta is None else f'{delta:+6.3f}'}")
+    if deltas:
+        print(f"\nMean score change with suppression: {sum(deltas) / len(deltas):+.3f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,275 @@
+#!/usr/bin/env python3
+"""Local stand-in for the badge sync server (see sync.h).
+
+Serves every file under --files as a manifest entry ("/<relative path> <size>
+<sha256>") with ranged, resumable downloads, and accepts resumable CLB1 clip
+batches and CSA1 clip stash archives. Finished uploads are unpacked to
+--uploads/<batch id>/<clip>.wav as 16-bit PCM; archives also keep the .csa
+and a records.json with embeddings, scores and best matches (clip_stash.py).
+
+Usage:
+    python3 sync_server.py --files release/ --uploads uploads/ --port 8080
+    python3 sync_server.py --files release/ --uploads uploads/ --drop-every 64
+
+--drop-every KB cuts every download response and upload body after that many
+KB, as a WiFi drop would. The client has to resume to finish anything bigger.
+"""
+
+import argparse
+import hashlib
+import os
+import re
+import struct
+import sys
+import wave
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+CLIP_MAGIC = 0x31424C43   # "CLB1"
+ADPCM_BLOCK_BYTES = 256
+ADPCM_BLOCK_SAMPLES = 505
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+]
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def adpcm_decode_block(block):
+    """One 256-byte IMA ADPCM block -> ADPCM_BLOCK_SAMPLES samples (adpcm.cpp)."""
+    predictor = struct.unpack_from("<h", block, 0)[0]
+    index = min(max(block[2], 0), 88)
+    out = [predictor]
+    for byte in block[4:]:
+        for nibble in (byte & 0x0F, byte >> 4):
+            step = STEP_TABLE[index]
+            diff = step >> 3
+            if nibble & 1:
+                diff += step >> 2
+            if nibble & 2:
+                diff += step >> 1
+            if nibble & 4:
+                diff += step
+            predictor += -diff if nibble & 8 else diff
+            predictor = min(max(predictor, -32768), 32767)
+            index = min(max(index + INDEX_TABLE[nibble], 0), 88)
+            out.append(predictor)
+    return out
+
+
+def unpack_batch(data, out_dir):
+    """Write each clip of a CLB1 batch as a PCM WAV; returns the clip names."""
+    magic, count = struct.unpack_from("<2I", data, 0)
+    if magic != CLIP_MAGIC:
+        raise ValueError("not a CLB1 batch")
+    os.makedirs(out_dir, exist_ok=True)
+    pos = 8
+    names = []
+    for _ in range(count):
+        name_len = data[pos]
+        name = os.path.basename(data[pos + 1:pos + 1 + name_len].decode())
+        pos += 1 + name_len
+        rate, num_samples = struct.unpack_from("<2I", data, pos)
+        pos += 8
+        blocks = (num_samples + ADPCM_BLOCK_SAMPLES - 1) // ADPCM_BLOCK_SAMPLES
+        samples = []
+        for b in range(blocks):
+            samples += adpcm_decode_block(data[pos:pos + ADPCM_BLOCK_BYTES])
+            pos += ADPCM_BLOCK_BYTES
+        with wave.open(os.path.join(out_dir, name), "wb") as w:
+            w.setnchannels(1)
+            w.setsampwidth(2)
+            w.setframerate(rate)
+            w.writeframes(struct.pack(f"<{num_samples}h", *samples[:num_samples]))
+        names.append(name)
+    if pos != len(data):
+        raise ValueError(f"{len(data) - pos} trailing bytes")
+    return names
+
+
+def sha256_file(path):
+    h = hashlib.sha256()
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(1 << 20), b""):
+            h.update(chunk)
+    return h.hexdigest()
+
+
+class SyncHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    files_dir = "."
+    uploads_dir = "."
+    drop_bytes = 0
+    hashes = {}     # path -> (mtime, size, sha256)
+
+    def log_message(self, fmt, *args):
+        sys.stderr.write("[server] " + (fmt % args) + "\n")
+
+    def file_sha(self, path):
+        st = os.stat(path)
+        cached = self.hashes.get(path)
+        if not cached or cached[:2] != (st.st_mtime, st.st_size):
+            cached = (st.st_mtime, st.st_size, sha256_file(path))
+            self.hashes[path] = cached
+        return cached[2]
+
+    def manifest(self):
+        lines = []
+        for root, _, names in os.walk(self.files_dir):
+            for name in sorted(names):
+                path = os.path.join(root, name)
+                rel = "/" + os.path.relpath(path, self.files_dir).replace(os.sep, "/")
+                lines.append(f"{rel} {os.path.getsize(path)} {self.file_sha(path)}\n")
+        return "".join(sorted(lines)).encode()
+
+    def reply(self, status, body=b"", headers=None):
+        self.send_response(status)
+        for k, v in (headers or {}).items():
+            self.send_header(k, v)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_GET(self):
+        if self.path == "/manifest":
+            body = self.manifest()
+            etag = '"%s"' % hashlib.sha256(body).hexdigest()[:16]
+            if self.headers.get("If-None-Match") == etag:
+                self.send_response(304)
+                self.send_header("ETag", etag)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+            else:
+                self.reply(200, body, {"ETag": etag, "Content-Type": "text/plain"})
+        elif self.path.startswith("/files/"):
+            self.send_file(self.path[len("/files/"):])
+        elif self.path.startswith("/upload/"):
+            batch_id = self.batch_id()
+            if batch_id:
+                self.reply(200, b"%d\n" % self.upload_size(batch_id))
+        else:
+            self.reply(404)
+
+    def send_file(self, rel):
+        path = os.path.realpath(os.path.join(self.files_dir, rel))
+        if not path.startswith(os.path.realpath(self.files_dir) + os.sep) or not os.path.isfile(path):
+            self.reply(404)
+            return
+        size = os.path.getsize(path)
+        etag = '"%s"' % self.file_sha(path)
+
+        start = 0
+        m = re.match(r"bytes=(\d+)-$", self.headers.get("Range", ""))
+        if m and self.headers.get("If-Range", etag) == etag:
+            start = int(m.group(1))
+            if start >= size:
+                self.reply(416, headers={"Content-Range": f"bytes */{size}"})
+                return
+            self.send_response(206)
+            self.send_header("Content-Range", f"bytes {start}-{size - 1}/{size}")
+        else:
+            self.send_response(200)
+        self.send_header("ETag", etag)
+        self.send_header("Content-Length", str(size - start))
+        self.end_headers()
+
+        limit = self.drop_bytes or size
+        with open(path, "rb") as f:
+            f.seek(start)
+            self.wfile.write(f.read(limit))
+        if start + limit < size:
+            self.log_message("dropping %s at byte %d", rel, start + limit)
+            self.close_connection = True
+
+    def batch_id(self):
+        batch_id = self.path[len("/upload/"):]
+        if not re.fullmatch(r"[0-9a-f]{16}", batch_id):
+            self.reply(400)
+            return None
+        return batch_id
+
+    def upload_size(self, batch_id):
+        done = os.path.join(self.uploads_dir, batch_id + ".done")
+        if os.path.exists(done):
+            with open(done) as f:
+                return int(f.read())
+        part = os.path.join(self.uploads_dir, batch_id + ".part")
+        return os.path.getsize(part) if os.path.exists(part) else 0
+
+    def do_PUT(self):
+        batch_id = self.batch_id() if self.path.startswith("/upload/") else None
+        if not batch_id:
+            if not self.path.startswith("/upload/"):
+                self.reply(404)
+            return
+        m = re.match(r"bytes (\d+)-(\d+)/(\d+)$", self.headers.get("Content-Range", ""))
+        length = int(self.headers.get("Content-Length", "0"))
+        if not m:
+            self.reply(400)
+            return
+        start, total = int(m.group(1)), int(m.group(3))
+        have = self.upload_size(batch_id)
+        if start != have:
+            self.reply(409, b"%d\n" % have)
+            return
+
+        # Stream the body straight to the partial file
+        part = os.path.join(self.uploads_dir, batch_id + ".part")
+        todo = length if not self.drop_bytes else min(length, self.drop_bytes)
+        with open(part, "ab") as f:
+            while todo > 0:
+                chunk = self.rfile.read(min(todo, 65536))
+                if not chunk:
+                    break
+                f.write(chunk)
+                todo -= len(chunk)
+        have = os.path.getsize(part)
+        if have < total:
+            self.log_message("dropping batch %s at byte %d of %d", batch_id, have, total)
+            self.close_connection = True
+            return
+
+        out_dir = os.path.join(self.uploads_dir, batch_id)
+        with open(part, "rb") as f:
+            data = f.read()
+        if struct.unpack_from("<I", data, 0)[0] == CLIP_MAGIC:
+            names = unpack_batch(data, out_dir)
+            os.remove(part)
+        else:
+            import clip_stash
+            names = clip_stash.unpack(data, out_dir)
+            os.replace(part, os.path.join(self.uploads_dir, batch_id + ".csa"))
+        with open(os.path.join(self.uploads_dir, batch_id + ".done"), "w") as f:
+            f.write(str(total))
+        self.log_message("batch %s: stored %d clips (%s)", batch_id, len(names), ", ".join(names))
+        self.reply(200, b"stored %d clips\n" % len(names))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("--files", required=True, help="Directory published as the manifest")
+    ap.add_argument("--uploads", required=True, help="Where clip batches are unpacked")
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--drop-every", type=int, default=0, metavar="KB",
+                    help="Cut each transfer after this many KB (0 = never)")
+    args = ap.parse_args()
+
+    os.makedirs(args.uploads, exist_ok=True)
+    SyncHandler.files_dir = args.files
+    SyncHandler.uploads_dir = args.uploads
+    SyncHandler.drop_bytes = args.drop_every * 1024
+    server = ThreadingHTTPServer(("", args.port), SyncHandler)
+    print(f"Serving {args.files} on port {args.port}, uploads to {args.uploads}")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,664 @@
+// tts.cpp - Streaming formant text-to-speech
+
+#include "tts.h"
+#include <math.h>
+#include <ctype.h>
+
+// ============================================================================
+// Phonemes
+// ============================================================================
+
+enum {
+    PH_SIL = 0, PH_PAU,
+    PH_AA, PH_AE, PH_AH, PH_AO, PH_AW, PH_AY, PH_EH, PH_ER, PH_EY,
+    PH_IH, PH_IY, PH_OW, PH_OY, PH_UH, PH_UW,
+    PH_L, PH_R, PH_W, PH_Y, PH_M, PH_N, PH_NG,
+    PH_HH, PH_F, PH_TH, PH_S, PH_SH, PH_V, PH_DH, PH_Z, PH_ZH,
+    PH_P, PH_T, PH_K, PH_B, PH_D, PH_G, PH_CH, PH_JH,
+    PH_END,                     // End of utterance: a short tail, then read() returns 0
+    PH_COUNT
+};
+
+enum { KIND_PAUSE, KIND_VOWEL, KIND_SONORANT, KIND_ASPIRATE, KIND_FRIC, KIND_STOP };
+
+enum { TTS_UNSTRESSED = 0, TTS_STRESSED, TTS_REDUCED };
+
+typedef struct {
+    const char* name;
+    uint8_t kind;
+    uint8_t dur_ms;             // Stops: closure
+    uint16_t f1, f2, f3;        // Stops: locus during the closure
+    uint16_t f1b, f2b;          // Diphthong end point (0 = steady)
+    uint8_t av;                 // Voicing, percent
+    uint8_t af;                 // Frication (aspiration for HH), percent
+    uint16_t ff, fb;            // Frication resonator, Hz
+    uint8_t burst_ms;           // Stops: burst, or frication for affricates
+    uint8_t asp_ms;             // Stops: aspiration after the burst
+} PhonemeDef;
+
+// Formants from Peterson & Barney / Klatt (adult male), durations from
+// Klatt's inherent-duration table, shortened for a brisker pace
+static const PhonemeDef PHONEMES[PH_COUNT] = {
+    // name  kind           dur  f1   f2    f3    f1b  f2b   av   af  ff    fb    burst asp
+    {"SIL", KIND_PAUSE,    250, 500, 1500, 2500, 0,   0,    0,   0,  0,    0,    0,  0},
+    {"PAU", KIND_PAUSE,    100, 500, 1500, 2500, 0,   0,    0,   0,  0,    0,    0,  0},
+    {"AA",  KIND_VOWEL,    120, 730, 1090, 2440, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"AE",  KIND_VOWEL,    120, 660, 1720, 2410, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"AH",  KIND_VOWEL,    80,  620, 1220, 2550, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"AO",  KIND_VOWEL,    120, 570, 840,  2410, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"AW",  KIND_VOWEL,    160, 730, 1090, 2440, 320, 870,  100, 0,  0,    0,    0,  0},
+    {"AY",  KIND_VOWEL,    160, 730, 1090, 2440, 300, 2200, 100, 0,  0,    0,    0,  0},
+    {"EH",  KIND_VOWEL,    90,  530, 1840, 2480, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"ER",  KIND_VOWEL,    110, 490, 1350, 1690, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"EY",  KIND_VOWEL,    140, 480, 1720, 2520, 300, 2200, 100, 0,  0,    0,    0,  0},
+    {"IH",  KIND_VOWEL,    70,  390, 1990, 2550, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"IY",  KIND_VOWEL,    110, 270, 2290, 3010, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"OW",  KIND_VOWEL,    140, 570, 900,  2410, 320, 800,  100, 0,  0,    0,    0,  0},
+    {"OY",  KIND_VOWEL,    170, 570, 840,  2410, 300, 2100, 100, 0,  0,    0,    0,  0},
+    {"UH",  KIND_VOWEL,    80,  440, 1020, 2240, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"UW",  KIND_VOWEL,    110, 300, 870,  2240, 0,   0,    100, 0,  0,    0,    0,  0},
+    {"L",   KIND_SONORANT, 60,  310, 1050, 2880, 0,   0,    80,  0,  0,    0,    0,  0},
+    {"R",   KIND_SONORANT, 60,  310, 1060, 1380, 0,   0,    80,  0,  0,    0,    0,  0},
+    {"W",   KIND_SONORANT, 60,  290, 610,  2150, 0,   0,    80,  0,  0,    0,    0,  0},
+    {"Y",   KIND_SONORANT, 50,  260, 2070, 3020, 0,   0,    80,  0,  0,    0,    0,  0},
+    {"M",   KIND_SONORANT, 70,  270, 1000, 2200, 0,   0,    55,  0,  0,    0,    0,  0},
+    {"N",   KIND_SONORANT, 60,  270, 1500, 2500, 0,   0,    55,  0,  0,    0,    0,  0},
+    {"NG",  KIND_SONORANT, 70,  270, 2000, 2700, 0,   0,    55,  0,  0,    0,    0,  0},
+    {"HH",  KIND_ASPIRATE, 60,  500, 1500, 2500, 0,   0,    0,   50, 0,    0,    0,  0},
+    {"F",   KIND_FRIC,     90,  340, 1100, 2080, 0,   0,    0,   25, 5000, 4000, 0,  0},
+    {"TH",  KIND_FRIC,     90,  320, 1290, 2540, 0,   0,    0,   20, 5000, 4000, 0,  0},
+    {"S",   KIND_FRIC,     100, 320, 1390, 2530, 0,   0,    0,   55, 5500, 1500, 0,  0},
+    {"SH",  KIND_FRIC,     100, 300, 1840, 2750, 0,   0,    0,   55, 2600, 1000, 0,  0},
+    {"V",   KIND_FRIC,     60,  220, 1100, 2080, 0,   0,    50,  15, 5000, 4000, 0,  0},
+    {"DH",  KIND_FRIC,     50,  270, 1290, 2540, 0,   0,    50,  12, 4000, 3000, 0,  0},
+    {"Z",   KIND_FRIC,     80,  240, 1390, 2530, 0,   0,    50,  35, 5500, 1500, 0,  0},
+    {"ZH",  KIND_FRIC,     80,  300, 1840, 2750, 0,   0,    50,  35, 2600, 1000, 0,  0},
+    {"P",   KIND_STOP,     60,  400, 800,  2200, 0,   0,    0,   35, 1500, 2000, 10, 40},
+    {"T",   KIND_STOP,     50,  400, 1700, 2600, 0,   0,    0,   55, 4500, 2000, 12, 40},
+    {"K",   KIND_STOP,     60,  400, 2000, 2500, 0,   0,    0,   50, 2200, 1200, 20, 45},
+    {"B",   KIND_STOP,     55,  200, 800,  2200, 0,   0,    15,  25, 1500, 2000, 8,  0},
+    {"D",   KIND_STOP,     45,  200, 1700, 2600, 0,   0,    15,  40, 4000, 2000, 10, 0},
+    {"G",   KIND_STOP,     55,  200, 2000, 2500, 0,   0,    15,  35, 2000, 1200, 15, 0},
+    {"CH",  KIND_STOP,     45,  300, 1840, 2750, 0,   0,    0,   50, 2600, 1000, 70, 0},
+    {"JH",  KIND_STOP,     40,  200, 1840, 2750, 0,   0,    15,  35, 2600, 1000, 55, 0},
+    {"END", KIND_PAUSE,    40,  500, 1500, 2500, 0,   0,    0,   0,  0,    0,    0,  0},
+};
+
+static int phoneme_by_name(const char* name, int len) {
+    for (int i = 0; i < PH_COUNT; i++) {
+        if ((int)strlen(PHONEMES[i].name) == len && strncmp(PHONEMES[i].name, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// "AH N D" -> phoneme ids; returns the count
+static int parse_phonemes(const char* s, uint8_t* out, int max) {
+    int n = 0;
+    while (*s && n < max) {
+        while (*s == ' ') s++;
+        int len = 0;
+        while (s[len] && s[len] != ' ') len++;
+        int ph = len ? phoneme_by_name(s, len) : -1;
+        if (ph >= 0) out[n++] = ph;
+        s += len;
+    }
+    return n;
+}
+
+// ============================================================================
+// Letter to sound
+// ============================================================================
+
+// Whole words the rules get wrong; mostly the function words of the
+// stories datasets. reduced = spoken unstressed and short.
+typedef struct {
+    const char* word;
+    const char* phonemes;
+    bool reduced;
+} TtsWord;
+
+static const TtsWord WORDS[] = {
+    {"a", "AH", true},            {"the", "DH AH", true},        {"to", "T UW", true},
+    {"of", "AH V", true},         {"and", "AE N D", true},       {"was", "W AA Z", true},
+    {"is", "IH Z", true},         {"in", "IH N", true},          {"it", "IH T", true},
+    {"i", "AY", true},            {"you", "Y UW", true},         {"he", "HH IY", true},
+    {"she", "SH IY", true},       {"we", "W IY", true},          {"me", "M IY", true},
+    {"be", "B IY", true},         {"they", "DH EY", true},       {"them", "DH EH M", true},
+    {"then", "DH EH N", true},    {"there", "DH EH R", true},    {"their", "DH EH R", true},
+    {"this", "DH IH S", true},    {"that", "DH AE T", true},     {"with", "W IH DH", true},
+    {"what", "W AH T", true},     {"are", "AA R", true},         {"were", "W ER", true},
+    {"her", "HH ER", true},       {"his", "HH IH Z", true},      {"has", "HH AE Z", true},
+    {"as", "AE Z", true},         {"for", "F AO R", true},       {"from", "F R AH M", true},
+    {"or", "AO R", true},         {"your", "Y AO R", true},      {"our", "AW R", true},
+    {"do", "D UW", true},         {"does", "D AH Z", true},      {"into", "IH N T UW", true},
+    {"upon", "AH P AA N", true},  {"an", "AE N", true},          {"at", "AE T", true},
+    {"on", "AA N", true},         {"but", "B AH T", true},       {"so", "S OW", true},
+    {"one", "W AH N", false},     {"once", "W AH N S", false},   {"two", "T UW", false},
+    {"said", "S EH D", false},    {"have", "HH AE V", false},    {"give", "G IH V", false},
+    {"live", "L IH V", false},    {"love", "L AH V", false},     {"come", "K AH M", false},
+    {"some", "S AH M", false},    {"done", "D AH N", false},     {"where", "W EH R", false},
+    {"friend", "F R EH N D", false}, {"very", "V EH R IY", false}, {"many", "M EH N IY", false},
+    {"any", "EH N IY", false},    {"only", "OW N L IY", false},  {"know", "N OW", false},
+    {"because", "B IH K AH Z", false}, {"people", "P IY P AH L", false}, {"eye", "AY", false},
+    {"eyes", "AY Z", false},      {"sure", "SH UH R", false},    {"though", "DH OW", false},
+    {"through", "TH R UW", false}, {"mom", "M AA M", false},      {"sorry", "S AA R IY", false},
+    {"zero", "Z IY R OW", false}, {"three", "TH R IY", false},   {"four", "F AO R", false},
+    {"five", "F AY V", false},    {"six", "S IH K S", false},    {"seven", "S EH V AH N", false},
+    {"eight", "EY T", false},     {"nine", "N AY N", false},
+};
+
+static const char* const DIGITS[10] = {
+    "zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine",
+};
+
+// Context codes. Left: '^' word start, 'U' after a voiceless consonant.
+// Right: '$' word end, 'V' vowel next, 'I' e/i/y next, 'E' consonant + final
+// e next (magic e: "time", "named", "cakes").
+typedef struct {
+    char left;
+    const char* match;
+    char right;
+    const char* phonemes;
+} TtsRule;
+
+static const TtsRule RULES[] = {
+    {0,   "tion", 0,   "SH AH N"},
+    {0,   "sion", 0,   "ZH AH N"},
+    {0,   "ture", 0,   "CH ER"},
+    {0,   "ough", 0,   "AO"},
+    {0,   "augh", 0,   "AO"},
+    {0,   "eigh", 0,   "EY"},
+    {0,   "igh",  0,   "AY"},
+    {0,   "tch",  0,   "CH"},
+    {0,   "dge",  0,   "JH"},
+    {0,   "all",  0,   "AO L"},
+    {0,   "ould", 0,   "UH D"},
+    {0,   "ing",  '$', "IH NG"},
+    {0,   "le",   '$', "AH L"},
+    {0,   "ge",   '$', "JH"},
+    {0,   "ee",   0,   "IY"},
+    {0,   "ea",   0,   "IY"},
+    {0,   "ai",   0,   "EY"},
+    {0,   "ay",   0,   "EY"},
+    {0,   "au",   0,   "AO"},
+    {0,   "aw",   0,   "AO"},
+    {0,   "ar",   0,   "AA R"},
+    {0,   "er",   0,   "ER"},
+    {0,   "ir",   0,   "ER"},
+    {0,   "ur",   0,   "ER"},
+    {0,   "or",   0,   "AO R"},
+    {0,   "ook",  0,   "UH K"},
+    {0,   "oo",   0,   "UW"},
+    {0,   "ou",   0,   "AW"},
+    {0,   "ow",   '$', "OW"},
+    {0,   "ow",   0,   "AW"},
+    {0,   "oa",   0,   "OW"},
+    {0,   "oi",   0,   "OY"},
+    {0,   "oy",   0,   "OY"},
+    {0,   "ew",   0,   "UW"},
+    {0,   "ey",   '$', "IY"},
+    {0,   "ie",   '$', "AY"},
+    {0,   "ie",   0,   "IY"},
+    {0,   "th",   0,   "TH"},
+    {0,   "sh",   0,   "SH"},
+    {0,   "ch",   0,   "CH"},
+    {0,   "ph",   0,   "F"},
+    {0,   "wh",   0,   "W"},
+    {0,   "ck",   0,   "K"},
+    {0,   "ng",   0,   "NG"},
+    {0,   "qu",   0,   "K W"},
+    {'^', "kn",   0,   "N"},
+    {'^', "wr",   0,   "R"},
+    {0,   "a",    'E', "EY"},
+    {0,   "i",    'E', "AY"},
+    {0,   "o",    'E', "OW"},
+    {0,   "u",    'E', "UW"},
+    {0,   "a",    '$', "AH"},
+    {0,   "a",    0,   "AE"},
+    {0,   "e",    '$', ""},
+    {0,   "e",    0,   "EH"},
+    {0,   "i",    0,   "IH"},
+    {0,   "o",    '$', "OW"},
+    {0,   "o",    0,   "AA"},
+    {0,   "u",    0,   "AH"},
+    {'^', "y",    0,   "Y"},
+    {0,   "y",    '$', "IY"},
+    {0,   "y",    0,   "IH"},
+    {0,   "c",    'I', "S"},
+    {0,   "c",    0,   "K"},
+    {0,   "x",    0,   "K S"},
+    {'U', "s",    '$', "S"},
+    {0,   "s",    '$', "Z"},
+    {0,   "b",    0,   "B"},
+    {0,   "d",    0,   "D"},
+    {0,   "f",    0,   "F"},
+    {0,   "g",    0,   "G"},
+    {0,   "h",    0,   "HH"},
+    {0,   "j",    0,   "JH"},
+    {0,   "k",    0,   "K"},
+    {0,   "l",    0,   "L"},
+    {0,   "m",    0,   "M"},
+    {0,   "n",    0,   "N"},
+    {0,   "p",    0,   "P"},
+    {0,   "r",    0,   "R"},
+    {0,   "s",    0,   "S"},
+    {0,   "t",    0,   "T"},
+    {0,   "v",    0,   "V"},
+    {0,   "w",    0,   "W"},
+    {0,   "z",    0,   "Z"},
+};
+
+static bool is_vowel_letter(char c) {
+    return c && strchr("aeiouy", c) != nullptr;
+}
+
+static bool context_ok(const TtsRule* r, const char* word, int pos, int end) {
+    switch (r->left) {
+        case '^': if (pos != 0) return false; break;
+        case 'U': if (pos == 0 || !strchr("ptkf", word[pos - 1])) return false; break;
+    }
+    const char* next = word + end;
+    switch (r->right) {
+        case '$': return *next == '\0';
+        case 'V': return is_vowel_letter(*next);
+        case 'I': return *next && strchr("eiy", *next);
+        case 'E':
+            return *next && !is_vowel_letter(*next) && next[1] == 'e' &&
+                   (next[2] == '\0' || (strchr("sd", next[2]) && next[3] == '\0'));
+    }
+    return true;
+}
+
+// Letter-to-sound for one lowercase word; returns the phoneme count
+int Tts::wordToPhonemes(const char* word, uint8_t* out, int max) {
+    for (size_t i = 0; i < sizeof(WORDS) / sizeof(WORDS[0]); i++) {
+        if (strcmp(word, WORDS[i].word) == 0) {
+            return parse_phonemes(WORDS[i].phonemes, out, max);
+        }
+    }
+
+    int n = 0;
+    int len = strlen(word);
+    int pos = 0;
+    while (pos < len && n < max) {
+        // Past tense: "wanted" -> IH D, "jumped" -> T, "played" -> D
+        if (pos >= 2 && pos == len - 2 && word[pos] == 'e' && word[pos + 1] == 'd') {
+            char prev = word[pos - 1];
+            n += parse_phonemes(strchr("td", prev) ? "IH D" : strchr("pkfsxh", prev) ? "T" : "D",
+                                out + n, max - n);
+            break;
+        }
+        // "my", "by", "sky"
+        if (word[pos] == 'y' && pos == len - 1 && len <= 3 && pos > 0) {
+            n += parse_phonemes("AY", out + n, max - n);
+            break;
+        }
+
+        const TtsRule* rule = nullptr;
+        int end = pos;
+        for (size_t r = 0; r < sizeof(RULES) / sizeof(RULES[0]); r++) {
+            int mlen = strlen(RULES[r].match);
+            if (strncmp(word + pos, RULES[r].match, mlen) == 0 &&
+                context_ok(&RULES[r], word, pos, pos + mlen)) {
+                rule = &RULES[r];
+                end = pos + mlen;
+                break;
+            }
+        }
+        if (!rule) {
+            pos++;          // Not a letter we know
+            continue;
+        }
+        n += parse_phonemes(rule->phonemes, out + n, max - n);
+
+        // Doubled consonants sound once
+        if (end - pos == 1 && !is_vowel_letter(word[pos]) && word[end] == word[pos]) {
+            end++;
+        }
+        pos = end;
+    }
+    return n;
+}
+
+static bool is_reduced_word(const char* word) {
+    for (size_t i = 0; i < sizeof(WORDS) / sizeof(WORDS[0]); i++) {
+        if (strcmp(word, WORDS[i].word) == 0) {
+            return WORDS[i].reduced;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// Producer (speaker stage)
+// ============================================================================
+
+Tts::Tts()
+    : sample_rate_(16000), queue_(nullptr), word_len_(0), prod_utterance_(0),
+      cut_utterance_(UINT32_MAX), in_utterance_(false), end_pending_(false),
+      play_utterance_(0), seg_(0), seg_frames_(0), f0_base_(0), phase_(0),
+      noise_(0x12345678), synth_us_(0), synth_samples_(0), m_rtf_(nullptr), m_words_(nullptr) {
+    item_.phoneme = PH_SIL;
+    item_.stress = TTS_UNSTRESSED;
+    memset(&target_, 0, sizeof(target_));
+    memset(&cur_, 0, sizeof(cur_));
+    memset(&r1_, 0, sizeof(r1_));
+    memset(&r2_, 0, sizeof(r2_));
+    memset(&r3_, 0, sizeof(r3_));
+    memset(&rf_, 0, sizeof(rf_));
+}
+
+bool Tts::begin(int sample_rate) {
+    sample_rate_ = sample_rate;
+    queue_ = xQueueCreate(TTS_QUEUE_LEN, sizeof(TtsItem));
+    return queue_ != nullptr;
+}
+
+void Tts::addMetrics(MetricsRegistry* metrics) {
+    m_rtf_ = metrics->gauge("tts.rtf_pct", "%");
+    m_words_ = metrics->counter("tts.words", "words");
+}
+
+// Waits while the synth is behind, but gives up once the utterance is cut:
+// after a stop nothing reads the queue until the next playStream()
+void Tts::push(uint8_t phoneme, uint8_t stress) {
+    TtsItem item = {phoneme, stress, (uint8_t)prod_utterance_};
+    while (!cut()) {
+        if (xQueueSend(queue_, &item, pdMS_TO_TICKS(20)) == pdPASS) return;
+    }
+}
+
+void Tts::say(const char* text) {
+    if (cut()) return;
+    for (const char* p = text; *p; p++) {
+        char c = *p;
+        if (isalpha((unsigned char)c)) {
+            if (word_len_ == TTS_WORD_MAX) flushWord();
+            word_[word_len_++] = tolower((unsigned char)c);
+        } else if (c == '\'') {
+            continue;                       // "don't" -> "dont"
+        } else {
+            flushWord();
+            if (isdigit((unsigned char)c)) {
+                strcpy(word_, DIGITS[c - '0']);
+                word_len_ = strlen(word_);
+                flushWord();
+            } else if (strchr(",;:", c)) {
+                push(PH_PAU, TTS_UNSTRESSED);
+            } else if (strchr(".!?\n", c)) {
+                push(PH_SIL, TTS_UNSTRESSED);
+            }
+        }
+    }
+}
+
+void Tts::finish() {
+    if (cut()) {
+        word_len_ = 0;
+    } else {
+        flushWord();
+        push(PH_END, TTS_UNSTRESSED);
+    }
+    prod_utterance_++;
+}
+
+// Queue the buffered word. Content words stress their first vowel; function
+// words are reduced throughout.
+void Tts::flushWord() {
+    if (word_len_ == 0) return;
+    word_[word_len_] = '\0';
+    word_len_ = 0;
+
+    uint8_t phonemes[TTS_MAX_WORD_PHONEMES];
+    int n = wordToPhonemes(word_, phonemes, TTS_MAX_WORD_PHONEMES);
+    bool reduced = is_reduced_word(word_);
+    bool stressed = false;
+    for (int i = 0; i < n; i++) {
+        uint8_t stress = TTS_UNSTRESSED;
+        if (PHONEMES[phonemes[i]].kind == KIND_VOWEL) {
+            if (reduced) {
+                stress = TTS_REDUCED;
+            } else if (!stressed) {
+                stress = TTS_STRESSED;
+                stressed = true;
+            }
+        }
+        push(phonemes[i], stress);
+    }
+    MetricsRegistry::add(m_words_);
+}
+
+// ============================================================================
+// Consumer (player reader task)
+// ============================================================================
+
+#define F0_START        125.0f  // Hz at the start of a sentence
+#define F0_FLOOR        90.0f
+#define F0_DECLINE      0.06f   // Hz per frame (12 Hz/s)
+#define F0_STRESS       20.0f   // Added on stressed vowels
+#define FORMANT_GLIDE   0.30f   // Per-frame approach to the targets
+#define AMP_GLIDE       0.50f
+#define F0_GLIDE        0.15f
+#define OPEN_QUOTIENT   0.6f
+#define VOICE_GAIN      0.35f
+#define ASP_GAIN        0.08f
+#define FRIC_GAIN       0.25f
+#define OUTPUT_GAIN     9000.0f
+
+static int segment_count(const PhonemeDef* ph) {
+    if (ph->kind == KIND_STOP) return ph->asp_ms ? 3 : 2;   // Closure, burst, aspiration
+    if (ph->kind == KIND_VOWEL && ph->f1b) return 2;        // Diphthong halves
+    return 1;
+}
+
+void Tts::startSegment(int kind) {
+    const PhonemeDef* ph = &PHONEMES[item_.phoneme];
+    int ms = ph->dur_ms;
+
+    target_.f1 = ph->f1;
+    target_.f2 = ph->f2;
+    target_.f3 = ph->f3;
+    target_.av = ph->av / 100.0f;
+    target_.ah = 0;
+    target_.af = 0;
+    target_.ff = ph->ff ? ph->ff : cur_.ff;
+    target_.fb = ph->fb ? ph->fb : cur_.fb;
+    target_.f0 = f0_base_;
+
+    switch (kind) {
+        case KIND_PAUSE:
+            target_.av = 0;
+            break;
+        case KIND_VOWEL:
+            if (item_.stress == TTS_STRESSED) {
+                ms = ms * 6 / 5;
+                target_.f0 += F0_STRESS;
+            } else if (item_.stress == TTS_REDUCED) {
+                ms = ms * 7 / 10;
+            }
+            if (ph->f1b) {
+                ms /= 2;
+                if (seg_ == 1) {
+                    target_.f1 = ph->f1b;
+                    target_.f2 = ph->f2b;
+                }
+            }
+            break;
+        case KIND_ASPIRATE:
+            target_.ah = ph->af / 100.0f;
+            break;
+        case KIND_FRIC:
+            target_.af = ph->af / 100.0f;
+            break;
+        case KIND_STOP:
+            if (seg_ == 1) {
+                ms = ph->burst_ms;
+                target_.af = ph->af / 100.0f;
+            } else if (seg_ == 2) {
+                ms = ph->asp_ms;
+                target_.ah = 0.4f;
+                target_.av = 0;
+            }
+            break;
+    }
+
+    seg_frames_ = (ms * sample_rate_ / 1000 + TTS_FRAME / 2) / TTS_FRAME;
+    if (seg_frames_ < 1) seg_frames_ = 1;
+
+    if (item_.phoneme == PH_SIL) {
+        f0_base_ = F0_START;
+    } else if (item_.phoneme == PH_PAU) {
+        f0_base_ = fminf(f0_base_ + 8.0f, F0_START);
+    }
+}
+
+// Move to the next segment: the rest of the current phoneme, else the next
+// queued one. False if nothing is queued and wait is false.
+bool Tts::nextSegment(bool wait) {
+    const PhonemeDef* ph = &PHONEMES[item_.phoneme];
+    if (seg_ + 1 < segment_count(ph)) {
+        seg_++;
+        startSegment(ph->kind);
+        return true;
+    }
+
+    // Skip what is left of utterances cancel() cut
+    TtsItem item;
+    do {
+        if (xQueueReceive(queue_, &item, wait ? portMAX_DELAY : 0) != pdPASS) {
+            return false;
+        }
+    } while (item.utterance != (uint8_t)play_utterance_);
+    item_ = item;
+    seg_ = 0;
+    startSegment(PHONEMES[item_.phoneme].kind);
+    return true;
+}
+
+void Tts::setResonator(TtsResonator* r, float f, float bw, bool peak_gain) {
+    float t = 1.0f / sample_rate_;
+    float rr = expf(-(float)M_PI * bw * t);
+    float theta = 2.0f * (float)M_PI * f * t;
+    r->c = -rr * rr;
+    r->b = 2.0f * rr * cosf(theta);
+    // Unity gain at DC for the cascade (formant peaks come out naturally),
+    // unity gain at the centre for the frication resonator
+    r->a = peak_gain ? (1.0f - rr) * sqrtf(1.0f - 2.0f * rr * cosf(2.0f * theta) + rr * rr)
+                     : 1.0f - r->b - r->c;
+}
+
+static inline float resonate(TtsResonator* r, float x) {
+    float y = r->a * x + r->b * r->y1 + r->c * r->y2;
+    r->y2 = r->y1;
+    r->y1 = y;
+    return y;
+}
+
+void Tts::synthFrame(int16_t* out) {
+    cur_.f1 += (target_.f1 - cur_.f1) * FORMANT_GLIDE;
+    cur_.f2 += (target_.f2 - cur_.f2) * FORMANT_GLIDE;
+    cur_.f3 += (target_.f3 - cur_.f3) * FORMANT_GLIDE;
+    cur_.ff += (target_.ff - cur_.ff) * FORMANT_GLIDE;
+    cur_.fb += (target_.fb - cur_.fb) * FORMANT_GLIDE;
+    cur_.av += (target_.av - cur_.av) * AMP_GLIDE;
+    cur_.ah += (target_.ah - cur_.ah) * AMP_GLIDE;
+    cur_.af += (target_.af - cur_.af) * AMP_GLIDE;
+    cur_.f0 += (target_.f0 - cur_.f0) * F0_GLIDE;
+
+    f0_base_ = fmaxf(f0_base_ - F0_DECLINE, F0_FLOOR);
+    target_.f0 = fmaxf(target_.f0 - F0_DECLINE, F0_FLOOR);
+
+    setResonator(&r1_, cur_.f1, 60.0f, false);
+    setResonator(&r2_, cur_.f2, 90.0f, false);
+    setResonator(&r3_, cur_.f3, 150.0f, false);
+
+    float dphase = cur_.f0 / sample_rate_;
+    float av = cur_.av * VOICE_GAIN;
+    float ah = cur_.ah * ASP_GAIN;
+    float af = cur_.af * FRIC_GAIN;
+    if (af > 0.0001f) {
+        setResonator(&rf_, cur_.ff, cur_.fb, true);
+    }
+    for (int i = 0; i < TTS_FRAME; i++) {
+        // Glottal flow derivative (KLGLOTT88): 2t - 3t^2 over the open phase
+        phase_ += dphase;
+        if (phase_ >= 1.0f) phase_ -= 1.0f;
+        float t = phase_ * (1.0f / OPEN_QUOTIENT);
+        float glottal = t < 1.0f ? 2.0f * t - 3.0f * t * t : 0.0f;
+
+        noise_ = noise_ * 1664525u + 1013904223u;
+        float noise = (int32_t)noise_ * (1.0f / 2147483648.0f);
+
+        float y = resonate(&r1_, av * glottal + ah * noise);
+        y = resonate(&r2_, y);
+        y = resonate(&r3_, y);
+        if (af > 0.0001f) {
+            y += resonate(&rf_, af * noise);
+        }
+
+        float s = y * OUTPUT_GAIN;
+        out[i] = s > 32767.0f ? 32767 : (s < -32768.0f ? -32768 : (int16_t)s);
+    }
+}
+
+int Tts::read(int16_t* out, int max) {
+    if (end_pending_) {
+        end_pending_ = false;
+        return 0;
+    }
+
+    if (!in_utterance_) {
+        in_utterance_ = true;
+        item_.phoneme = PH_SIL;
+        seg_ = 0;
+        seg_frames_ = 0;
+        f0_base_ = F0_START;
+        cur_.f0 = F0_START;
+        synth_us_ = 0;
+        synth_samples_ = 0;
+    }
+
+    int n = 0;
+    while (n + TTS_FRAME <= max) {
+        if (seg_frames_ == 0) {
+            if (item_.phoneme == PH_END) {
+                in_utterance_ = false;
+                play_utterance_++;
+                if (synth_samples_ > 0) {
+                    MetricsRegistry::set(m_rtf_, synth_us_ * 1e-4f * sample_rate_ / synth_samples_);
+                }
+                if (n > 0) end_pending_ = true;
+                return n;
+            }
+            // Hand over what is ready rather than wait for the next word
+            if (!nextSegment(n == 0)) break;
+        }
+        uint32_t t0 = micros();
+        synthFrame(out + n);
+        synth_us_ += micros() - t0;
+        synth_samples_ += TTS_FRAME;
+        n += TTS_FRAME;
+        seg_frames_--;
+    }
+    return n;
+}
+
+void Tts::cancel() {
+    if (end_pending_) {
+        end_pending_ = false;   // The cut utterance had already ended
+        in_utterance_ = false;
+        return;
+    }
+    if (in_utterance_ && item_.phoneme == PH_END) {
+        in_utterance_ = false;  // Its END was dequeued, only the tail was left
+        play_utterance_++;
+        return;
+    }
+    // Drop the rest of the current utterance, or the next one if it had
+    // not started: the producer stops queueing it, read() skips what is queued
+    cut_utterance_ = play_utterance_;
+    play_utterance_++;
+    in_utterance_ = false;
+}
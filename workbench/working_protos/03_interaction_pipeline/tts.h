@@ -0,0 +1,126 @@
+// tts.h - Streaming formant text-to-speech
+// Turns LLM text pieces into speech while they are still being generated:
+//
+//   say(piece) -> words -> letter-to-sound rules -> phoneme queue
+//   read()     -> phoneme targets -> formant synthesizer -> PCM (AudioPlayer)
+//
+// The producer side (say/finish) runs in the speaker stage. A word is queued
+// as soon as the next piece starts a new word, so the look-ahead is one word
+// of at most TTS_WORD_MAX letters. The synthesizer runs in the player's
+// reader task, one TTS_FRAME at a time.
+//
+// Synthesis is a cascade formant model: a KLGLOTT88-style glottal pulse
+// plus aspiration noise through F1..F3 resonators for voiced sounds, and
+// noise through one parallel resonator for frication and stop bursts.
+// Targets move toward each phoneme with a one-pole glide, which stands in
+// for coarticulation. That is four resonators and a noise step per sample,
+// with coefficients set once per frame, so synthesis needs a few percent
+// of one ESP32-S3 core (tts.rtf_pct).
+//
+// English letter-to-sound is a rule table plus a small word list tuned to
+// the vocabulary of the stories models. Unknown words come out readable but
+// not always right.
+
+#ifndef TTS_H
+#define TTS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "audio_player.h"
+#include "metrics.h"
+
+#define TTS_FRAME               80      // Samples per parameter update (5 ms at 16 kHz)
+#define TTS_WORD_MAX            24      // Longer words are split
+#define TTS_QUEUE_LEN           512     // Phonemes; say() waits when the synth is this far behind
+#define TTS_MAX_WORD_PHONEMES   32
+
+// One queued phoneme
+typedef struct {
+    uint8_t phoneme;
+    uint8_t stress;             // TTS_STRESSED / TTS_UNSTRESSED / TTS_REDUCED
+    uint8_t utterance;          // Low bits of the producer's utterance number
+} TtsItem;
+
+// Per-frame synthesizer controls
+typedef struct {
+    float f0;                   // Hz
+    float f1, f2, f3;           // Hz
+    float av;                   // Voicing amplitude, 0..1
+    float ah;                   // Aspiration into the cascade, 0..1
+    float af;                   // Frication into the parallel resonator, 0..1
+    float ff, fb;               // Frication centre and bandwidth, Hz
+} TtsParams;
+
+// Two-pole resonator, y = a*x + b*y1 + c*y2
+typedef struct {
+    float a, b, c;
+    float y1, y2;
+} TtsResonator;
+
+class Tts : public PlayerSource {
+public:
+    Tts();
+
+    bool begin(int sample_rate);
+
+    // tts.rtf_pct (synthesis time / audio time of the last utterance, in
+    // percent), tts.words
+    void addMetrics(MetricsRegistry* metrics);
+
+    // Producer side, one utterance at a time: any number of say() calls,
+    // then finish(). Each utterance is one AudioPlayer::playStream(). Once
+    // the player cancels an utterance, its remaining say() calls queue
+    // nothing, so a stopped stream never leaves the producer blocked.
+    void say(const char* text);
+    void finish();
+
+    // PlayerSource (player reader task)
+    int read(int16_t* out, int max) override;
+    bool finished() const override { return end_pending_; }
+    void cancel() override;
+
+private:
+    // Producer
+    bool cut() const { return cut_utterance_ == prod_utterance_; }
+    void flushWord();
+    void push(uint8_t phoneme, uint8_t stress);
+    int wordToPhonemes(const char* word, uint8_t* out, int max);
+
+    // Consumer
+    bool nextSegment(bool wait);
+    void startSegment(int kind);
+    void synthFrame(int16_t* out);
+    void setResonator(TtsResonator* r, float f, float bw, bool peak_gain);
+
+    int sample_rate_;
+    QueueHandle_t queue_;
+
+    char word_[TTS_WORD_MAX + 1];
+    int word_len_;
+    uint32_t prod_utterance_;   // Utterance say() is queueing
+
+    // Written by cancel(), read by the producer
+    volatile uint32_t cut_utterance_;
+
+    // Consumer state (player reader task only)
+    bool in_utterance_;
+    bool end_pending_;          // END seen; the next read() returns 0
+    uint32_t play_utterance_;   // Utterance read() plays; older queued items are skipped
+    TtsItem item_;
+    int seg_;                   // Segment within the phoneme (closure, burst, ...)
+    int seg_frames_;            // Frames left in the current segment
+    float f0_base_;             // Declination line
+    TtsParams target_;
+    TtsParams cur_;
+    TtsResonator r1_, r2_, r3_, rf_;
+    float phase_;
+    uint32_t noise_;
+    uint32_t synth_us_;         // Per utterance, for tts.rtf
+    uint32_t synth_samples_;
+
+    Metric* m_rtf_;
+    Metric* m_words_;
+};
+
+#endif // TTS_H
@@ -0,0 +1,63 @@
+// vad.cpp - Energy-based voice activity detector implementation
+
+#include "vad.h"
+#include <math.h>
+
+VoiceActivityDetector::VoiceActivityDetector()
+    : threshold_db_(9.0f), noise_floor_db_(-60.0f), last_db_(-90.0f),
+      in_speech_(false), speech_run_(0), silence_run_(0), speech_frames_(0) {
+}
+
+void VoiceActivityDetector::begin(float threshold_db) {
+    threshold_db_ = threshold_db;
+    noise_floor_db_ = -60.0f;
+    reset();
+}
+
+void VoiceActivityDetector::reset() {
+    in_speech_ = false;
+    speech_run_ = 0;
+    silence_run_ = 0;
+    speech_frames_ = 0;
+}
+
+float VoiceActivityDetector::frameEnergyDb(const int16_t* frame) {
+    float sum = 0.0f;
+    for (int i = 0; i < VAD_FRAME_SAMPLES; i++) {
+        float s = frame[i] / 32768.0f;
+        sum += s * s;
+    }
+    return 10.0f * log10f(sum / VAD_FRAME_SAMPLES + 1e-9f);
+}
+
+VadEvent VoiceActivityDetector::processFrame(const int16_t* frame) {
+    float db = frameEnergyDb(frame);
+    last_db_ = db;
+    bool loud = db > noise_floor_db_ + threshold_db_;
+
+    // Noise floor: fast to fall, slow to rise, frozen while speaking
+    if (!in_speech_) {
+        float rate = (db < noise_floor_db_) ? 0.2f : 0.01f;
+        noise_floor_db_ += rate * (db - noise_floor_db_);
+    }
+
+    if (!in_speech_) {
+        speech_run_ = loud ? speech_run_ + 1 : 0;
+        if (speech_run_ >= VAD_START_FRAMES) {
+            in_speech_ = true;
+            speech_frames_ = speech_run_;
+            silence_run_ = 0;
+            return VAD_SPEECH_START;
+        }
+        return VAD_NONE;
+    }
+
+    speech_frames_++;
+    silence_run_ = loud ? 0 : silence_run_ + 1;
+    if (silence_run_ >= VAD_HANGOVER_FRAMES) {
+        bool long_enough = (speech_frames_ - silence_run_) >= VAD_MIN_FRAMES;
+        reset();
+        return long_enough ? VAD_SPEECH_END : VAD_SPEECH_DISCARD;
+    }
+    return VAD_NONE;
+}
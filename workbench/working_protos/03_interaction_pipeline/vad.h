@@ -0,0 +1,48 @@
+// vad.h - Energy-based voice activity detector
+// Tracks an adaptive noise floor and segments 16kHz mono audio into utterances
+
+#ifndef VAD_H
+#define VAD_H
+
+#include <Arduino.h>
+
+#define VAD_FRAME_SAMPLES   256     // 16ms @ 16kHz (4 frames per capture chunk)
+#define VAD_START_FRAMES    5       // 80ms of speech opens an utterance
+#define VAD_HANGOVER_FRAMES 44      // 700ms of silence closes it
+#define VAD_MIN_FRAMES      19      // Utterances shorter than 300ms are dropped
+
+enum VadEvent {
+    VAD_NONE = 0,
+    VAD_SPEECH_START,
+    VAD_SPEECH_END,
+    VAD_SPEECH_DISCARD
+};
+
+class VoiceActivityDetector {
+public:
+    VoiceActivityDetector();
+
+    // threshold_db: how far above the noise floor counts as speech
+    void begin(float threshold_db = 9.0f);
+    void reset();
+
+    // Process one 16ms frame; returns the state transition it caused
+    VadEvent processFrame(const int16_t* frame);
+
+    bool inSpeech() const { return in_speech_; }
+    float noiseFloorDb() const { return noise_floor_db_; }
+    float lastFrameDb() const { return last_db_; }
+
+private:
+    float frameEnergyDb(const int16_t* frame);
+
+    float threshold_db_;
+    float noise_floor_db_;
+    float last_db_;
+    bool in_speech_;
+    int speech_run_;
+    int silence_run_;
+    int speech_frames_;
+};
+
+#endif // VAD_H
@@ -0,0 +1,60 @@
+// wav_file.cpp - RIFF/WAVE header parsing
+
+#include "wav_file.h"
+#include "adpcm.h"
+
+static uint32_t le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+bool wav_read_info(File& f, WavInfo* info) {
+    uint8_t hdr[12];
+    if (!f.seek(0) || f.read(hdr, 12) != 12 || memcmp(hdr, "RIFF", 4) != 0 ||
+        memcmp(hdr + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    memset(info, 0, sizeof(*info));
+    bool have_fmt = false;
+    uint16_t channels = 0, bits = 0, block_align = 0;
+    uint32_t pos = 12;
+    while (pos + 8 <= f.size()) {
+        uint8_t chunk[8];
+        if (!f.seek(pos) || f.read(chunk, 8) != 8) return false;
+        uint32_t size = le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            uint8_t fmt[16];
+            if (f.read(fmt, 16) != 16) return false;
+            info->format = le16(fmt);
+            channels = le16(fmt + 2);
+            info->sample_rate = le32(fmt + 4);
+            block_align = le16(fmt + 12);
+            bits = le16(fmt + 14);
+            have_fmt = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            info->data_offset = pos + 8;
+            uint32_t avail = f.size() - info->data_offset;
+            info->data_size = size < avail ? size : avail;
+            break;
+        }
+        pos += 8 + size + (size & 1);   // Chunks are word aligned
+    }
+    if (!have_fmt || info->data_offset == 0 || channels != 1) {
+        return false;
+    }
+
+    if (info->format == WAV_FORMAT_PCM && bits == 16) {
+        info->num_samples = info->data_size / 2;
+    } else if (info->format == WAV_FORMAT_IMA_ADPCM && block_align == ADPCM_BLOCK_BYTES) {
+        info->data_size -= info->data_size % ADPCM_BLOCK_BYTES;
+        info->num_samples = info->data_size / ADPCM_BLOCK_BYTES * ADPCM_BLOCK_SAMPLES;
+    } else {
+        return false;
+    }
+    return f.seek(info->data_offset);
+}
@@ -0,0 +1,27 @@
+// wav_file.h - RIFF/WAVE header parsing for clips on SD
+// Mono 16-bit PCM and mono IMA ADPCM with 256-byte blocks (adpcm.h) are
+// accepted; everything else is rejected so callers can stream the data
+// chunk without further checks.
+
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+#define WAV_FORMAT_PCM          1
+#define WAV_FORMAT_IMA_ADPCM    0x11
+
+typedef struct {
+    uint16_t format;            // WAV_FORMAT_PCM or WAV_FORMAT_IMA_ADPCM
+    uint32_t sample_rate;
+    uint32_t data_offset;       // First byte of the data chunk
+    uint32_t data_size;
+    uint32_t num_samples;
+} WavInfo;
+
+// Parse the header of f (caller holds the SD bus); leaves f positioned at
+// data_offset. False for unsupported or truncated files.
+bool wav_read_info(File& f, WavInfo* info);
+
+#endif // WAV_FILE_H
@@ -0,0 +1,149 @@
+// yamnet_inference_host.cpp - Host stand-in for YAMNet (no TFLite on Linux)
+// Produces a deterministic 1024-D embedding from the mel features: per-bin
+// mean and deviation over the 96 frames, through a fixed seeded projection.
+// Not YAMNet's embedding space, but stable, so the match/LLM stages and the
+// latency harness behave reproducibly. Build match indexes for host runs
+// from embeddings this stand-in produces: --embeddings FILE appends one
+// JSON array per inference.
+
+#ifndef ARDUINO
+
+#include "yamnet_inference.h"
+#include <stdio.h>
+
+#define POOLED_DIM (2 * MEL_BINS)
+
+YamNetInference::YamNetInference()
+    : initialized_(false), model_data_(nullptr), model_size_(0), projection_(nullptr) {
+}
+
+YamNetInference::~YamNetInference() {
+    end();
+}
+
+bool YamNetInference::begin(const char* model_path) {
+    // Read the model if it is there so load time and PSRAM use stay comparable
+    if (!loadModelFromSD(model_path)) {
+        Serial.printf("[host] %s not found, using projection stand-in only\n", model_path);
+    }
+
+    if (!initInterpreter()) {
+        Serial.println("ERROR: Failed to allocate projection");
+        return false;
+    }
+
+    Serial.println("YAMNet stand-in initialized (random projection)");
+    initialized_ = true;
+    return true;
+}
+
+bool YamNetInference::loadModelFromSD(const char* model_path) {
+    File model_file = SD.open(model_path, FILE_READ);
+    if (!model_file) {
+        return false;
+    }
+
+    model_size_ = model_file.size();
+    model_data_ = (uint8_t*)ps_malloc(model_size_);
+    if (!model_data_) {
+        model_file.close();
+        return false;
+    }
+
+    size_t bytes_read = model_file.read(model_data_, model_size_);
+    model_file.close();
+    Serial.printf("Model loaded: %u bytes (not interpreted on host)\n", (unsigned)bytes_read);
+    return bytes_read == model_size_;
+}
+
+bool YamNetInference::initInterpreter() {
+    projection_ = (float*)ps_malloc(EMBEDDING_DIM * POOLED_DIM * sizeof(float));
+    if (!projection_) {
+        return false;
+    }
+
+    // xorshift32 with a fixed seed, uniform in [-1, 1)
+    uint32_t state = 0x59414D4E;   // "YAMN"
+    float scale = 1.0f / sqrtf((float)POOLED_DIM);
+    for (int i = 0; i < EMBEDDING_DIM * POOLED_DIM; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        projection_[i] = ((state >> 8) * (2.0f / 16777216.0f) - 1.0f) * scale;
+    }
+    return true;
+}
+
+bool YamNetInference::invoke(float* mel_features) {
+    if (!initialized_) {
+        return false;
+    }
+
+    // Pool over frames: mean and standard deviation per mel bin
+    float pooled[POOLED_DIM];
+    for (int bin = 0; bin < MEL_BINS; bin++) {
+        float sum = 0.0f;
+        float sum_sq = 0.0f;
+        for (int frame = 0; frame < MEL_FRAMES; frame++) {
+            float v = mel_features[frame * MEL_BINS + bin];
+            sum += v;
+            sum_sq += v * v;
+        }
+        float mean = sum / MEL_FRAMES;
+        float var = sum_sq / MEL_FRAMES - mean * mean;
+        pooled[bin] = mean;
+        pooled[MEL_BINS + bin] = sqrtf(var > 0.0f ? var : 0.0f);
+    }
+
+    for (int i = 0; i < EMBEDDING_DIM; i++) {
+        const float* row = projection_ + i * POOLED_DIM;
+        float acc = 0.0f;
+        for (int j = 0; j < POOLED_DIM; j++) {
+            acc += row[j] * pooled[j];
+        }
+        embedding_[i] = acc > 0.0f ? acc : 0.0f;   // ReLU, like YAMNet's embedding layer
+    }
+
+    const char* dump_path = host_arg("embeddings", nullptr);
+    FILE* dump = dump_path ? fopen(dump_path, "a") : nullptr;
+    if (dump) {
+        for (int i = 0; i < EMBEDDING_DIM; i++) {
+            fprintf(dump, "%c%.6g", i ? ',' : '[', embedding_[i]);
+        }
+        fprintf(dump, "]\n");
+        fclose(dump);
+    }
+    return true;
+}
+
+bool YamNetInference::infer(float* mel_features, float* embeddings) {
+    if (!invoke(mel_features)) {
+        return false;
+    }
+    memcpy(embeddings, embedding_, sizeof(embedding_));
+    return true;
+}
+
+bool YamNetInference::infer(float* mel_features, ProjectionHead* head, int8_t* embedding) {
+    if (!invoke(mel_features) || head->inDim() != EMBEDDING_DIM) {
+        return false;
+    }
+    head->project(embedding_, embedding);
+    return true;
+}
+
+void YamNetInference::end() {
+    if (projection_) {
+        free(projection_);
+        projection_ = nullptr;
+    }
+
+    if (model_data_) {
+        free(model_data_);
+        model_data_ = nullptr;
+    }
+
+    initialized_ = false;
+}
+
+#endif // !ARDUINO